@@ -0,0 +1,204 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <check.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cets_decrypt.h"
+#include "test_common.h"
+
+/* AES-128 CTR test vector from NIST SP 800-38A, F.5.2 */
+static const uint8_t nist_key[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf,
+                                   0x4f, 0x3c};
+static const uint8_t nist_counter[] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc,
+                                       0xfd, 0xfe, 0xff};
+static const uint8_t nist_plaintext[] = {0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73,
+                                         0x93, 0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7,
+                                         0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51};
+static const uint8_t nist_ciphertext[] = {0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99,
+                                          0x0d, 0xb6, 0xce, 0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17,
+                                          0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff};
+
+static void init_nist_au_key(cets_au_key_t* au_key)
+{
+    memset(au_key, 0, sizeof(*au_key));
+    au_key->key = nist_key;
+    memcpy(au_key->iv, nist_counter, sizeof(nist_counter));
+    au_key->iv_size = 16;
+}
+
+START_TEST(test_cets_decrypt_nist_vector)
+    cets_au_key_t au_key;
+    init_nist_au_key(&au_key);
+    uint8_t data[sizeof(nist_ciphertext)];
+    memcpy(data, nist_ciphertext, sizeof(data));
+
+    cets_decryptor_t* decryptor = cets_decryptor_new();
+    ck_assert(cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    assert_bytes_eq(data, sizeof(data), nist_plaintext, sizeof(nist_plaintext));
+
+    /* The counter starts from the IV again for every AU */
+    ck_assert(cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    assert_bytes_eq(data, sizeof(data), nist_ciphertext, sizeof(nist_ciphertext));
+    cets_decryptor_free(decryptor);
+END_TEST
+
+START_TEST(test_cets_decrypt_byte_offset)
+    cets_au_key_t au_key;
+    init_nist_au_key(&au_key);
+    au_key.byte_offset = 5;
+    uint8_t data[5 + sizeof(nist_ciphertext)] = {1, 2, 3, 4, 5};
+    memcpy(data + 5, nist_ciphertext, sizeof(nist_ciphertext));
+
+    cets_decryptor_t* decryptor = cets_decryptor_new();
+    ck_assert(cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    uint8_t clear[] = {1, 2, 3, 4, 5};
+    assert_bytes_eq(data, 5, clear, 5);
+    assert_bytes_eq(data + 5, sizeof(data) - 5, nist_plaintext, sizeof(nist_plaintext));
+
+    /* The whole payload is clear */
+    au_key.byte_offset = sizeof(data);
+    ck_assert(cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    assert_bytes_eq(data, 5, clear, 5);
+
+    au_key.byte_offset = sizeof(data) + 1;
+    ck_assert(!cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    cets_decryptor_free(decryptor);
+END_TEST
+
+START_TEST(test_cets_decrypt_8_byte_iv)
+    cets_au_key_t au_key;
+    init_nist_au_key(&au_key);
+    au_key.iv_size = 8;
+    uint8_t data[sizeof(nist_plaintext)];
+    memcpy(data, nist_plaintext, sizeof(data));
+
+    /* An 8 byte IV is the same as a 16 byte IV with a zero block counter */
+    cets_au_key_t au_key_16;
+    init_nist_au_key(&au_key_16);
+    memset(au_key_16.iv + 8, 0, 8);
+    uint8_t expected[sizeof(nist_plaintext)];
+    memcpy(expected, nist_plaintext, sizeof(expected));
+
+    cets_decryptor_t* decryptor = cets_decryptor_new();
+    ck_assert(cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    ck_assert(cets_decryptor_decrypt(decryptor, &au_key_16, expected, sizeof(expected)));
+    assert_bytes_eq(data, sizeof(data), expected, sizeof(expected));
+    ck_assert(memcmp(data, nist_plaintext, sizeof(data)) != 0);
+    cets_decryptor_free(decryptor);
+END_TEST
+
+START_TEST(test_cets_decrypt_no_key)
+    cets_au_key_t au_key;
+    init_nist_au_key(&au_key);
+    au_key.key = NULL;
+    uint8_t data[sizeof(nist_ciphertext)];
+    memcpy(data, nist_ciphertext, sizeof(data));
+
+    cets_decryptor_t* decryptor = cets_decryptor_new();
+    ck_assert(!cets_decryptor_decrypt(decryptor, &au_key, data, sizeof(data)));
+    assert_bytes_eq(data, sizeof(data), nist_ciphertext, sizeof(nist_ciphertext));
+    cets_decryptor_free(decryptor);
+END_TEST
+
+static char* write_key_file(const char* contents)
+{
+    char* file_name = NULL;
+    int fd = g_file_open_tmp("cets_keys_XXXXXX.txt", &file_name, NULL);
+    ck_assert_int_ne(fd, -1);
+    close(fd);
+    ck_assert(g_file_set_contents(file_name, contents, -1, NULL));
+    return file_name;
+}
+
+START_TEST(test_cets_keys_read_file)
+    char* file_name = write_key_file(
+            "# test keys\n"
+            "\n"
+            "00112233445566778899aabbccddeeff:2b7e151628aed2a6abf7158809cf4f3c\n"
+            "  FFEEDDCCBBAA99887766554433221100:000102030405060708090A0B0C0D0E0F  \n");
+    cets_keys_t* keys = cets_keys_read_file(file_name);
+    remove(file_name);
+    g_free(file_name);
+
+    ck_assert_ptr_ne(keys, NULL);
+    ck_assert_uint_eq(keys->keys->len, 2);
+
+    uint8_t key_id[] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+    const uint8_t* key = cets_keys_find(keys, key_id);
+    ck_assert_ptr_ne(key, NULL);
+    assert_bytes_eq(key, CETS_KEY_SIZE, nist_key, sizeof(nist_key));
+
+    uint8_t key_id_2[] = {0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+                          0x00};
+    key = cets_keys_find(keys, key_id_2);
+    ck_assert_ptr_ne(key, NULL);
+    ck_assert_uint_eq(key[0], 0x00);
+    ck_assert_uint_eq(key[15], 0x0f);
+
+    key_id[0] = 0x01;
+    ck_assert_ptr_eq(cets_keys_find(keys, key_id), NULL);
+    cets_keys_free(keys);
+END_TEST
+
+START_TEST(test_cets_keys_read_file_invalid)
+    char* file_name = write_key_file("00112233445566778899aabbccddeeff:2b7e151628aed2a6abf7158809cf4f\n");
+    cets_keys_t* keys = cets_keys_read_file(file_name);
+    remove(file_name);
+    g_free(file_name);
+    ck_assert_ptr_eq(keys, NULL);
+
+    file_name = write_key_file("00112233445566778899aabbccddeeff 2b7e151628aed2a6abf7158809cf4f3c\n");
+    keys = cets_keys_read_file(file_name);
+    remove(file_name);
+    g_free(file_name);
+    ck_assert_ptr_eq(keys, NULL);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("CETS decryption");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_cets_decrypt_nist_vector);
+    tcase_add_test(tc_core, test_cets_decrypt_byte_offset);
+    tcase_add_test(tc_core, test_cets_decrypt_8_byte_iv);
+    tcase_add_test(tc_core, test_cets_decrypt_no_key);
+    tcase_add_test(tc_core, test_cets_keys_read_file);
+    tcase_add_test(tc_core, test_cets_keys_read_file_invalid);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
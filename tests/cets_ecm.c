@@ -189,6 +189,28 @@ START_TEST(test_cets_ecm_too_many_au)
     ck_assert_ptr_eq(cets_ecm, NULL);
 END_TEST
 
+/* Skipping the AUs has to read the same states, and find the same errors */
+START_TEST(test_cets_ecm_read_states)
+    uint8_t ecm_bytes[] = {96, 66, 187, 39, 117, 59, 168, 63, 12, 115, 111, 33, 192, 232, 103, 104, 56, 66, 8, 3, 235,
+        135, 110, 243, 186, 152, 241, 219, 16, 40, 210, 231, 95, 101, 196, 78, 15, 187, 127, 129, 149, 165, 147,
+        127, 128, 72, 1, 165, 188, 54, 154, 154, 159, 72, 26, 177, 82, 229, 245, 41, 229, 130, 69, 16, 132, 148,
+        6, 113, 128, 66, 205, 249, 65, 205, 5, 213, 147, 23, 238, 173, 11, 113, 115, 111, 202, 151, 140, 99, 144};
+    cets_ecm_t* expected = cets_ecm_read(ecm_bytes, sizeof(ecm_bytes));
+    ck_assert_ptr_ne(expected, NULL);
+
+    cets_ecm_t cets_ecm;
+    ck_assert(cets_ecm_read_states(ecm_bytes, sizeof(ecm_bytes), &cets_ecm));
+    ck_assert_int_eq(cets_ecm.next_key_id_flag, expected->next_key_id_flag);
+    ck_assert_int_eq(cets_ecm.num_states, expected->num_states);
+    ck_assert_int_eq(cets_ecm.states[0].transport_scrambling_control, expected->states[0].transport_scrambling_control);
+    ck_assert_int_eq(cets_ecm.states[0].num_au, expected->states[0].num_au);
+    ck_assert_ptr_eq(cets_ecm.states[0].au, NULL);
+    assert_bytes_eq(cets_ecm.next_key_id, 16, expected->next_key_id, 16);
+    cets_ecm_free(expected);
+
+    ck_assert(!cets_ecm_read_states(ecm_bytes, sizeof(ecm_bytes) - 1, &cets_ecm));
+END_TEST
+
 Suite *suite(void)
 {
     Suite *s;
@@ -208,6 +230,7 @@ Suite *suite(void)
     tcase_add_test(tc_core, test_cets_ecm_read_too_many_states);
     tcase_add_test(tc_core, test_cets_ecm_too_few_au);
     tcase_add_test(tc_core, test_cets_ecm_too_many_au);
+    tcase_add_test(tc_core, test_cets_ecm_read_states);
     suite_add_tcase(s, tc_core);
 
     return s;
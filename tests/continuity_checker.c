@@ -0,0 +1,178 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <string.h>
+
+#include "continuity_checker.h"
+#include "ts.h"
+
+
+typedef struct {
+    uint16_t pid;
+    uint8_t continuity_counter;
+    uint8_t adaptation_field_control;
+    bool discontinuity_indicator;
+} test_packet_t;
+
+static ts_headers_t* make_headers(const test_packet_t* packets, size_t num_packets)
+{
+    uint8_t* bytes = g_new(uint8_t, num_packets * TS_SIZE);
+    memset(bytes, 0xFF, num_packets * TS_SIZE);
+    for (size_t i = 0; i < num_packets; ++i) {
+        uint8_t* packet = bytes + i * TS_SIZE;
+        packet[0] = 0x47;
+        packet[1] = packets[i].pid >> 8;
+        packet[2] = packets[i].pid & 0xFF;
+        packet[3] = (packets[i].adaptation_field_control << 4) | packets[i].continuity_counter;
+        if (packets[i].adaptation_field_control & TS_ADAPTATION_FIELD) {
+            packet[4] = 1;
+            packet[5] = packets[i].discontinuity_indicator ? 0x80 : 0;
+        }
+    }
+    ts_headers_t* headers = ts_headers_new(num_packets);
+    ck_assert_uint_eq(ts_headers_read(headers, bytes, num_packets), num_packets);
+    g_free(bytes);
+    return headers;
+}
+
+START_TEST(test_continuity_valid)
+    test_packet_t packets[] = {
+        {256, 14, TS_PAYLOAD},
+        {257, 3, TS_PAYLOAD},
+        {256, 15, TS_PAYLOAD},
+        /* wraps */
+        {256, 0, TS_PAYLOAD | TS_ADAPTATION_FIELD},
+        /* adaptation field only doesn't increment */
+        {256, 0, TS_ADAPTATION_FIELD},
+        /* one duplicate is allowed */
+        {256, 1, TS_PAYLOAD},
+        {256, 1, TS_PAYLOAD},
+        {256, 2, TS_PAYLOAD},
+        /* null packets are ignored */
+        {PID_NULL, 7, TS_PAYLOAD},
+        {PID_NULL, 2, TS_PAYLOAD},
+        {257, 4, TS_PAYLOAD}
+    };
+    size_t num_packets = G_N_ELEMENTS(packets);
+    ts_headers_t* headers = make_headers(packets, num_packets);
+    continuity_checker_t* checker = continuity_checker_new();
+
+    ck_assert_uint_eq(continuity_checker_check(checker, headers, num_packets, 0), 0);
+    ck_assert_uint_eq(checker->errors->len, 0);
+
+    continuity_checker_free(checker);
+    ts_headers_free(headers);
+END_TEST
+
+START_TEST(test_continuity_errors)
+    test_packet_t packets[] = {
+        {256, 0, TS_PAYLOAD},
+        {256, 2, TS_PAYLOAD},
+        /* a second duplicate is an error */
+        {256, 2, TS_PAYLOAD},
+        {256, 2, TS_PAYLOAD},
+        /* adaptation field only must not increment */
+        {256, 3, TS_ADAPTATION_FIELD},
+        /* unless discontinuity_indicator is set */
+        {256, 9, TS_ADAPTATION_FIELD, true},
+        {256, 10, TS_PAYLOAD}
+    };
+    size_t num_packets = G_N_ELEMENTS(packets);
+    ts_headers_t* headers = make_headers(packets, num_packets);
+    continuity_checker_t* checker = continuity_checker_new();
+
+    ck_assert_uint_eq(continuity_checker_check(checker, headers, num_packets, 1000), 3);
+    ck_assert_uint_eq(checker->errors->len, 3);
+
+    continuity_error_t* error = &g_array_index(checker->errors, continuity_error_t, 0);
+    ck_assert_uint_eq(error->offset, 1000 + TS_SIZE);
+    ck_assert_uint_eq(error->pid, 256);
+    ck_assert_uint_eq(error->expected, 1);
+    ck_assert_uint_eq(error->actual, 2);
+
+    error = &g_array_index(checker->errors, continuity_error_t, 1);
+    ck_assert_uint_eq(error->offset, 1000 + 3 * TS_SIZE);
+    ck_assert_uint_eq(error->expected, 3);
+    ck_assert_uint_eq(error->actual, 2);
+
+    error = &g_array_index(checker->errors, continuity_error_t, 2);
+    ck_assert_uint_eq(error->offset, 1000 + 4 * TS_SIZE);
+    ck_assert_uint_eq(error->expected, 2);
+    ck_assert_uint_eq(error->actual, 3);
+
+    continuity_checker_free(checker);
+    ts_headers_free(headers);
+END_TEST
+
+START_TEST(test_continuity_across_blocks)
+    test_packet_t first[] = {
+        {256, 5, TS_PAYLOAD},
+        {256, 6, TS_PAYLOAD},
+        /* not checked */
+        {256, 12, TS_PAYLOAD}
+    };
+    test_packet_t second[] = {
+        {256, 8, TS_PAYLOAD}
+    };
+    ts_headers_t* first_headers = make_headers(first, G_N_ELEMENTS(first));
+    ts_headers_t* second_headers = make_headers(second, G_N_ELEMENTS(second));
+    continuity_checker_t* checker = continuity_checker_new();
+
+    ck_assert_uint_eq(continuity_checker_check(checker, first_headers, 2, 0), 0);
+    ck_assert_uint_eq(continuity_checker_check(checker, second_headers, 10, 2 * TS_SIZE), 1);
+
+    continuity_error_t* error = &g_array_index(checker->errors, continuity_error_t, 0);
+    ck_assert_uint_eq(error->offset, 2 * TS_SIZE);
+    ck_assert_uint_eq(error->expected, 7);
+    ck_assert_uint_eq(error->actual, 8);
+
+    continuity_checker_free(checker);
+    ts_headers_free(first_headers);
+    ts_headers_free(second_headers);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Continuity Checker");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_continuity_valid);
+    tcase_add_test(tc_core, test_continuity_errors);
+    tcase_add_test(tc_core, test_continuity_across_blocks);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
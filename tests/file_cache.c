@@ -0,0 +1,199 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <check.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_cache.h"
+#include "test_common.h"
+
+START_TEST(test_file_cache_shares_handles)
+    file_handle_t* a = file_cache_open("tests/pcrb-example.six");
+    ck_assert_ptr_ne(a, NULL);
+    file_handle_t* b = file_cache_open("tests/pcrb-example.six");
+    ck_assert_ptr_eq(a, b);
+    ck_assert_uint_eq(a->refcount, 2);
+    ck_assert_uint_eq(file_cache_num_open(), 1);
+
+    file_cache_release(a);
+    file_cache_release(b);
+    ck_assert_uint_eq(file_cache_num_open(), 1);
+
+    /* Unused handles are reused */
+    file_handle_t* c = file_cache_open("tests/pcrb-example.six");
+    ck_assert_ptr_eq(a, c);
+    file_cache_release(c);
+
+    file_cache_close_unused();
+    ck_assert_uint_eq(file_cache_num_open(), 0);
+END_TEST
+
+START_TEST(test_file_cache_lru)
+    file_cache_max_open = 1;
+    file_handle_t* a = file_cache_open("tests/pcrb-example.six");
+    file_handle_t* b = file_cache_open("tests/subsegment-example.six");
+    ck_assert_ptr_ne(a, NULL);
+    ck_assert_ptr_ne(b, NULL);
+
+    /* Files in use aren't closed, even over the limit */
+    ck_assert_uint_eq(file_cache_num_open(), 2);
+
+    file_cache_release(a);
+    ck_assert_uint_eq(file_cache_num_open(), 1);
+    file_cache_release(b);
+    ck_assert_uint_eq(file_cache_num_open(), 1);
+
+    /* b was used most recently, so it's the one still open */
+    file_handle_t* c = file_cache_open("tests/subsegment-example.six");
+    ck_assert_ptr_eq(b, c);
+    file_cache_release(c);
+
+    file_cache_close_unused();
+END_TEST
+
+START_TEST(test_file_cache_missing_file)
+    ck_assert_ptr_eq(file_cache_open("tests/does-not-exist"), NULL);
+    ck_assert_uint_eq(file_cache_num_open(), 0);
+END_TEST
+
+START_TEST(test_file_cache_reopens_changed_files)
+    gchar* file_name = NULL;
+    int fd = g_file_open_tmp("file_cache_XXXXXX", &file_name, NULL);
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    ck_assert(g_file_set_contents(file_name, "old", -1, NULL));
+
+    uint8_t buf[8];
+    size_t bytes_read;
+    file_handle_t* a = file_cache_open(file_name);
+    ck_assert_ptr_ne(a, NULL);
+
+    /* Replacing the file while it's in use */
+    ck_assert(g_file_set_contents(file_name, "newer", -1, NULL));
+    file_handle_t* b = file_cache_open(file_name);
+    ck_assert_ptr_ne(b, NULL);
+    ck_assert_ptr_ne(a, b);
+    ck_assert_uint_eq(file_cache_num_open(), 2);
+    ck_assert(file_handle_read(a, 0, buf, sizeof(buf), &bytes_read));
+    assert_bytes_eq(buf, bytes_read, (const uint8_t*)"old", 3);
+    ck_assert(file_handle_read(b, 0, buf, sizeof(buf), &bytes_read));
+    assert_bytes_eq(buf, bytes_read, (const uint8_t*)"newer", 5);
+
+    file_cache_release(a);
+    ck_assert_uint_eq(file_cache_num_open(), 1);
+    file_cache_release(b);
+
+    /* Rewriting it in place while it isn't */
+    FILE* f = fopen(file_name, "w");
+    ck_assert_ptr_ne(f, NULL);
+    fputs("rewritten", f);
+    fclose(f);
+    file_handle_t* c = file_cache_open(file_name);
+    ck_assert_ptr_ne(c, NULL);
+    ck_assert_uint_eq(file_cache_num_open(), 1);
+    ck_assert(file_handle_read(c, 0, buf, sizeof(buf), &bytes_read));
+    assert_bytes_eq(buf, bytes_read, (const uint8_t*)"rewritte", 8);
+    file_cache_release(c);
+
+    /* Rewriting it at the same size within the same second */
+    struct stat st;
+    ck_assert_int_eq(stat(file_name, &st), 0);
+    f = fopen(file_name, "r+");
+    ck_assert_ptr_ne(f, NULL);
+    fputs("REWRITTEN", f);
+    fclose(f);
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    times[1].tv_nsec = (times[1].tv_nsec + 1) % 1000000000;
+    ck_assert_int_eq(utimensat(AT_FDCWD, file_name, times, 0), 0);
+    c = file_cache_open(file_name);
+    ck_assert_ptr_ne(c, NULL);
+    ck_assert_int_eq(c->version.mtime, (int64_t)times[1].tv_sec * 1000000000 + times[1].tv_nsec);
+    ck_assert(file_handle_read(c, 0, buf, sizeof(buf), &bytes_read));
+    assert_bytes_eq(buf, bytes_read, (const uint8_t*)"REWRITTE", 8);
+    file_cache_release(c);
+
+    /* Deleted files aren't read through an old descriptor either */
+    ck_assert_int_eq(remove(file_name), 0);
+    ck_assert_ptr_eq(file_cache_open(file_name), NULL);
+    ck_assert_uint_eq(file_cache_num_open(), 0);
+    g_free(file_name);
+END_TEST
+
+START_TEST(test_file_handle_read)
+    gchar* contents;
+    gsize length;
+    ck_assert(g_file_get_contents("tests/pcrb-example.six", &contents, &length, NULL));
+
+    file_handle_t* file = file_cache_open("tests/pcrb-example.six");
+    ck_assert_ptr_ne(file, NULL);
+
+    uint64_t size;
+    ck_assert(file_handle_get_size(file, &size));
+    ck_assert_uint_eq(size, length);
+
+    uint8_t buf[100];
+    size_t bytes_read;
+    ck_assert(file_handle_read(file, 10, buf, sizeof(buf), &bytes_read));
+    assert_bytes_eq(buf, bytes_read, (uint8_t*)contents + 10, sizeof(buf));
+
+    /* Reads stop at the end of the file */
+    ck_assert(file_handle_read(file, length - 20, buf, sizeof(buf), &bytes_read));
+    assert_bytes_eq(buf, bytes_read, (uint8_t*)contents + length - 20, 20);
+    ck_assert(file_handle_read(file, length + 20, buf, sizeof(buf), &bytes_read));
+    ck_assert_uint_eq(bytes_read, 0);
+
+    file_cache_release(file);
+    file_cache_close_unused();
+    g_free(contents);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("File Cache");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_file_cache_shares_handles);
+    tcase_add_test(tc_core, test_file_cache_lru);
+    tcase_add_test(tc_core, test_file_cache_missing_file);
+    tcase_add_test(tc_core, test_file_cache_reopens_changed_files);
+    tcase_add_test(tc_core, test_file_handle_read);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
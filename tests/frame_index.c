@@ -0,0 +1,232 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frame_index.h"
+#include "psi.h"
+#include "test_common.h"
+
+
+static frame_t* add_frame(frame_index_t* index, uint8_t* payload, size_t payload_len, bool random_access)
+{
+    pes_packet_t pes = {
+        .pts_flag = true,
+        .pts = 3003 * (index->frames->len + 1),
+        .payload = payload,
+        .payload_len = payload_len
+    };
+    frame_index_add_pes(index, &pes, 188 * index->frames->len, 188, random_access);
+    return &g_array_index(index->frames, frame_t, index->frames->len - 1);
+}
+
+START_TEST(test_frame_index_avc)
+    frame_index_t* index = frame_index_new(0x100, STREAM_TYPE_AVC);
+
+    /* access unit delimiter, then an IDR slice with slice_type 7 */
+    uint8_t idr[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0xf0, 0x00, 0x00, 0x01, 0x65, 0x88};
+    frame_t* frame = add_frame(index, idr, sizeof(idr), true);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_I);
+    ck_assert_uint_eq(frame->sap_type, 1);
+    ck_assert_uint_eq(frame->flags, FRAME_HAS_PTS | FRAME_RANDOM_ACCESS);
+    ck_assert_uint_eq(frame->pts, 3003);
+    ck_assert_uint_eq(frame->dts, 3003);
+
+    uint8_t p[] = {0x00, 0x00, 0x01, 0x41, 0x9a};
+    frame = add_frame(index, p, sizeof(p), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_P);
+    ck_assert_uint_eq(frame->sap_type, 0);
+
+    uint8_t b[] = {0x00, 0x00, 0x01, 0x01, 0x9e};
+    frame = add_frame(index, b, sizeof(b), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_B);
+
+    /* A non-IDR I slice with random_access_indicator, and an emulation_prevention_three_byte in first_mb_in_slice */
+    uint8_t i[] = {0x00, 0x00, 0x01, 0x41, 0x00, 0x00, 0x03, 0x01, 0xff, 0xff, 0xfe, 0xc0};
+    frame = add_frame(index, i, sizeof(i), true);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_I);
+    ck_assert_uint_eq(frame->sap_type, 2);
+
+    /* Cut off before slice_type */
+    uint8_t truncated[] = {0x00, 0x00, 0x01, 0x41, 0x00};
+    frame = add_frame(index, truncated, sizeof(truncated), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_UNKNOWN);
+
+    /* first_mb_in_slice starts with more leading zeros than fit in 32 bits */
+    uint8_t corrupt[] = {0x00, 0x00, 0x01, 0x41, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x80};
+    frame = add_frame(index, corrupt, sizeof(corrupt), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_UNKNOWN);
+
+    ck_assert_uint_eq(index->frames->len, 6);
+    ck_assert_uint_eq(g_array_index(index->frames, frame_t, 3).offset, 188 * 3);
+    frame_index_free(index);
+END_TEST
+
+START_TEST(test_frame_index_other_streams)
+    frame_index_t* index = frame_index_new(0x100, STREAM_TYPE_HEVC);
+    uint8_t idr_w_radl[] = {0x00, 0x00, 0x01, 0x46, 0x01, 0x00, 0x00, 0x01, 0x26, 0x01, 0xaf};
+    frame_t* frame = add_frame(index, idr_w_radl, sizeof(idr_w_radl), true);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_I);
+    ck_assert_uint_eq(frame->sap_type, 2);
+    uint8_t cra[] = {0x00, 0x00, 0x01, 0x2a, 0x01, 0xaf};
+    ck_assert_uint_eq(add_frame(index, cra, sizeof(cra), true)->sap_type, 3);
+    uint8_t trail_r[] = {0x00, 0x00, 0x01, 0x02, 0x01, 0xaf};
+    frame = add_frame(index, trail_r, sizeof(trail_r), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_UNKNOWN);
+    ck_assert_uint_eq(frame->sap_type, 0);
+    frame_index_free(index);
+
+    index = frame_index_new(0x101, STREAM_TYPE_MPEG2_VIDEO);
+    /* sequence header, then a picture header with picture_coding_type 2 */
+    uint8_t mpeg2_p[] = {0x00, 0x00, 0x01, 0xb3, 0x14, 0x00, 0x00, 0x01, 0x00, 0x00, 0x50, 0xff};
+    frame = add_frame(index, mpeg2_p, sizeof(mpeg2_p), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_P);
+    ck_assert_uint_eq(frame->sap_type, 0);
+    uint8_t mpeg2_i[] = {0x00, 0x00, 0x01, 0x00, 0x00, 0x08, 0xff};
+    ck_assert_uint_eq(add_frame(index, mpeg2_i, sizeof(mpeg2_i), true)->sap_type, 1);
+    frame_index_free(index);
+
+    index = frame_index_new(0x102, STREAM_TYPE_MPEG2_AAC);
+    uint8_t adts[] = {0xff, 0xf1};
+    frame = add_frame(index, adts, sizeof(adts), false);
+    ck_assert_uint_eq(frame->picture_type, PICTURE_TYPE_UNKNOWN);
+    ck_assert_uint_eq(frame->sap_type, 1);
+    frame_index_free(index);
+END_TEST
+
+static char* write_temp_file(const char* template, const char* contents)
+{
+    char* file_name = NULL;
+    int fd = g_file_open_tmp(template, &file_name, NULL);
+    ck_assert_int_ne(fd, -1);
+    close(fd);
+    ck_assert(g_file_set_contents(file_name, contents, -1, NULL));
+    return file_name;
+}
+
+START_TEST(test_frame_index_file)
+    char* segment_file_name = write_temp_file("segment_XXXXXX.ts", "not really a segment");
+    char* index_file_name = frame_index_file_name(segment_file_name, 0, 0);
+    ck_assert(g_str_has_suffix(index_file_name, ".ts.fidx"));
+    char* range_file_name = frame_index_file_name(segment_file_name, 188, 375);
+    ck_assert(g_str_has_suffix(range_file_name, ".ts.188-375.fidx"));
+    g_free(range_file_name);
+
+    frame_index_file_t* file = frame_index_file_new();
+    file->flags = FRAME_INDEX_FILE_PASSED;
+    file->key = 0xdeadbeef;
+    file->pmt_fingerprint = 0x12345678;
+    uint64_t splice_point = (UINT64_C(1) << 33) - 1;
+    g_array_append_val(file->splice_points, splice_point);
+    frame_index_t* video = frame_index_new(0x100, STREAM_TYPE_AVC);
+    video->sap = 1;
+    video->earliest_playout_time = 3003;
+    video->latest_playout_time = 6006;
+    video->duration = -1;
+    uint8_t idr[] = {0x00, 0x00, 0x01, 0x65, 0x88};
+    add_frame(video, idr, sizeof(idr), true);
+    uint8_t p[] = {0x00, 0x00, 0x01, 0x41, 0x9a};
+    add_frame(video, p, sizeof(p), false)->size = 0x12345678;
+    g_ptr_array_add(file->indexes, video);
+    g_ptr_array_add(file->indexes, frame_index_new(0x101, STREAM_TYPE_MPEG2_AAC));
+
+    file_version_t version;
+    ck_assert(file_version_get(segment_file_name, &version));
+    ck_assert(frame_index_file_write(file, index_file_name, segment_file_name, &version, 0, 0));
+    frame_index_file_t* read = frame_index_file_read(index_file_name, segment_file_name, 0, 0);
+    ck_assert_ptr_ne(read, NULL);
+    ck_assert_uint_eq(read->flags, FRAME_INDEX_FILE_PASSED);
+    ck_assert_uint_eq(read->key, 0xdeadbeef);
+    ck_assert_uint_eq(read->pat_fingerprint, 0);
+    ck_assert_uint_eq(read->pmt_fingerprint, 0x12345678);
+    ck_assert_uint_eq(read->splice_points->len, 1);
+    ck_assert_uint_eq(g_array_index(read->splice_points, uint64_t, 0), splice_point);
+    ck_assert_uint_eq(read->indexes->len, 2);
+    frame_index_t* read_video = g_ptr_array_index(read->indexes, 0);
+    ck_assert_uint_eq(read_video->pid, 0x100);
+    ck_assert_uint_eq(read_video->stream_type, STREAM_TYPE_AVC);
+    ck_assert_uint_eq(read_video->sap, 1);
+    ck_assert_int_eq(read_video->earliest_playout_time, 3003);
+    ck_assert_int_eq(read_video->latest_playout_time, 6006);
+    ck_assert_int_eq(read_video->duration, -1);
+    ck_assert_uint_eq(read_video->frames->len, 2);
+    ck_assert_int_eq(memcmp(read_video->frames->data, video->frames->data, 2 * sizeof(frame_t)), 0);
+    frame_index_t* read_audio = g_ptr_array_index(read->indexes, 1);
+    ck_assert_uint_eq(read_audio->pid, 0x101);
+    ck_assert_uint_eq(read_audio->frames->len, 0);
+    frame_index_file_free(read);
+
+    /* For a different byte range */
+    ck_assert_ptr_eq(frame_index_file_read(index_file_name, segment_file_name, 0, 187), NULL);
+
+    /* The segment changed since the index was written */
+    ck_assert(g_file_set_contents(segment_file_name, "a different segment", -1, NULL));
+    ck_assert_ptr_eq(frame_index_file_read(index_file_name, segment_file_name, 0, 0), NULL);
+
+    /* Or since it was read, so the index would be for the wrong bytes */
+    ck_assert(!frame_index_file_write(file, index_file_name, segment_file_name, &version, 0, 0));
+    ck_assert_ptr_eq(frame_index_file_read(index_file_name, segment_file_name, 0, 0), NULL);
+
+    /* Truncated */
+    ck_assert(file_version_get(segment_file_name, &version));
+    ck_assert(frame_index_file_write(file, index_file_name, segment_file_name, &version, 0, 0));
+    gchar* contents;
+    gsize len;
+    ck_assert(g_file_get_contents(index_file_name, &contents, &len, NULL));
+    ck_assert(g_file_set_contents(index_file_name, contents, len - 1, NULL));
+    g_free(contents);
+    ck_assert_ptr_eq(frame_index_file_read(index_file_name, segment_file_name, 0, 0), NULL);
+
+    frame_index_file_free(file);
+    remove(index_file_name);
+    remove(segment_file_name);
+    g_free(index_file_name);
+    g_free(segment_file_name);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Frame Index");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_frame_index_avc);
+    tcase_add_test(tc_core, test_frame_index_other_streams);
+    tcase_add_test(tc_core, test_frame_index_file);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -458,6 +458,179 @@ START_TEST(test_read_styp_size_not_divisible_by_four)
     ck_assert_ptr_eq(boxes, NULL);
 END_TEST
 
+START_TEST(test_read_boxes_from_file_range)
+    int error = 0;
+    size_t boxes_len;
+    /* Just the master 'sidx', which immediately follows the 24 byte 'styp' */
+    box_t** boxes = read_boxes_from_file_range("tests/subsegment-example.six", 24, 24 + 344 - 1, &boxes_len,
+            &error);
+
+    ck_assert(!error);
+    ck_assert_ptr_ne(boxes, NULL);
+    ck_assert_uint_eq(boxes_len, 1);
+    ck_assert_uint_eq(boxes[0]->type, BOX_TYPE_SIDX);
+    ck_assert_uint_eq(boxes[0]->size, 344);
+
+    sidx_t* sidx = (sidx_t*)boxes[0];
+    ck_assert_uint_eq(sidx->reference_count, 26);
+
+    free_boxes(boxes, boxes_len);
+END_TEST
+
+START_TEST(test_read_boxes_from_file_range_past_end)
+    int error = 0;
+    size_t boxes_len;
+    box_t** boxes = read_boxes_from_file_range("tests/subsegment-example.six", 24600, 24700, &boxes_len, &error);
+
+    ck_assert(error);
+    ck_assert_ptr_eq(boxes, NULL);
+    ck_assert_uint_eq(boxes_len, 0);
+END_TEST
+
+START_TEST(test_box_iterator)
+    box_iterator_t* it = box_iterator_new("tests/pcrb-example.six", 0, 0);
+    ck_assert_ptr_ne(it, NULL);
+
+    uint32_t expected_types[] = {BOX_TYPE_STYP, BOX_TYPE_SIDX, BOX_TYPE_PCRB};
+    uint64_t offset = 0;
+    size_t num_boxes = 0;
+    int error = 0;
+    box_t* box;
+    while ((box = box_iterator_next(it, &error)) != NULL) {
+        ck_assert_uint_lt(num_boxes, 3);
+        ck_assert_uint_eq(box->type, expected_types[num_boxes]);
+        offset += box->size;
+        ck_assert_uint_eq(box_iterator_offset(it), offset);
+        free_box(box);
+        ++num_boxes;
+    }
+    ck_assert(!error);
+    ck_assert_uint_eq(num_boxes, 3);
+    ck_assert_uint_eq(offset, 442);
+
+    box_iterator_free(it);
+END_TEST
+
+START_TEST(test_box_views_match_boxes)
+    int error = 0;
+    size_t boxes_len;
+    box_t** boxes = read_boxes_from_file("tests/subsegment-example.six", &boxes_len, &error);
+    ck_assert(!error);
+
+    box_iterator_t* it = box_iterator_new("tests/subsegment-example.six", 0, 0);
+    ck_assert_ptr_ne(it, NULL);
+
+    size_t box_index = 0;
+    uint64_t offset = 0;
+    box_view_t view;
+    while (box_iterator_next_view(it, &view, &error)) {
+        ck_assert_uint_lt(box_index, boxes_len);
+        box_t* box = boxes[box_index];
+        ck_assert_uint_eq(view.type, box->type);
+        ck_assert_uint_eq(view.size, box->size);
+        ck_assert_uint_eq(view.offset, offset);
+        ck_assert_uint_eq(view.data_len, box->size - 8);
+        offset += view.size;
+
+        if (view.type == BOX_TYPE_SIDX) {
+            sidx_t* expected = (sidx_t*)box;
+            sidx_t sidx;
+            ck_assert(read_sidx_view(&view, &sidx));
+            ck_assert_ptr_eq(sidx.references, NULL);
+            ck_assert_uint_eq(sidx.reference_id, expected->reference_id);
+            ck_assert_uint_eq(sidx.timescale, expected->timescale);
+            ck_assert_uint_eq(sidx.earliest_presentation_time, expected->earliest_presentation_time);
+            ck_assert_uint_eq(sidx.first_offset, expected->first_offset);
+            ck_assert_uint_eq(sidx.reference_count, expected->reference_count);
+            for (size_t i = 0; i < sidx.reference_count; ++i) {
+                sidx_reference_t ref;
+                sidx_get_reference(&sidx, i, &ref);
+                ck_assert_uint_eq(ref.reference_type, expected->references[i].reference_type);
+                ck_assert_uint_eq(ref.referenced_size, expected->references[i].referenced_size);
+                ck_assert_uint_eq(ref.subsegment_duration, expected->references[i].subsegment_duration);
+                ck_assert_uint_eq(ref.starts_with_sap, expected->references[i].starts_with_sap);
+                ck_assert_uint_eq(ref.sap_type, expected->references[i].sap_type);
+                ck_assert_uint_eq(ref.sap_delta_time, expected->references[i].sap_delta_time);
+            }
+        } else if (view.type == BOX_TYPE_SSIX) {
+            ssix_t* expected = (ssix_t*)box;
+            ssix_t ssix;
+            ck_assert(read_ssix_view(&view, &ssix));
+            ck_assert_ptr_eq(ssix.subsegments, NULL);
+            ck_assert_uint_eq(ssix.subsegment_count, expected->subsegment_count);
+
+            ssix_cursor_t cursor;
+            ssix_cursor_init(&cursor, &ssix);
+            uint32_t i = 0;
+            uint32_t ranges_count;
+            while (ssix_cursor_next_subsegment(&cursor, &ranges_count)) {
+                ck_assert_uint_lt(i, expected->subsegment_count);
+                ck_assert_uint_eq(ranges_count, expected->subsegments[i].ranges_count);
+                uint32_t j = 0;
+                ssix_subsegment_range_t range;
+                while (ssix_cursor_next_range(&cursor, &range)) {
+                    ck_assert_uint_eq(range.level, expected->subsegments[i].ranges[j].level);
+                    ck_assert_uint_eq(range.range_size, expected->subsegments[i].ranges[j].range_size);
+                    ++j;
+                }
+                ck_assert_uint_eq(j, ranges_count);
+                ++i;
+            }
+            ck_assert_uint_eq(i, expected->subsegment_count);
+        }
+        ++box_index;
+    }
+    ck_assert(!error);
+    ck_assert_uint_eq(box_index, boxes_len);
+
+    box_iterator_free(it);
+    free_boxes(boxes, boxes_len);
+END_TEST
+
+START_TEST(test_read_pcrb_view)
+    box_iterator_t* it = box_iterator_new("tests/pcrb-example.six", 0, 0);
+    ck_assert_ptr_ne(it, NULL);
+
+    int error = 0;
+    box_view_t view;
+    for (size_t i = 0; i < 3; ++i) {
+        ck_assert(box_iterator_next_view(it, &view, &error));
+    }
+    ck_assert(!box_iterator_next_view(it, &view, &error));
+    ck_assert(!error);
+    ck_assert_uint_eq(view.type, BOX_TYPE_PCRB);
+
+    box_t* box = read_box_from_view(&view, &error);
+    ck_assert(!error);
+    pcrb_t* expected = (pcrb_t*)box;
+
+    pcrb_t pcrb;
+    ck_assert(read_pcrb_view(&view, &pcrb));
+    ck_assert_ptr_eq(pcrb.pcr, NULL);
+    ck_assert_uint_eq(pcrb.subsegment_count, expected->subsegment_count);
+    for (size_t i = 0; i < pcrb.subsegment_count; ++i) {
+        ck_assert_uint_eq(pcrb_get_pcr(&pcrb, i), expected->pcr[i]);
+    }
+
+    free_box(box);
+    box_iterator_free(it);
+END_TEST
+
+START_TEST(test_read_sidx_view_bad_reference_count)
+    uint8_t bytes[] = {0, 0, 0, 32, 's', 'i', 'd', 'x', 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 1};
+
+    box_iterator_t* it = box_iterator_new_from_buffer(bytes, sizeof(bytes));
+    int error = 0;
+    box_view_t view;
+    ck_assert(box_iterator_next_view(it, &view, &error));
+    ck_assert(!error);
+
+    sidx_t sidx;
+    ck_assert(!read_sidx_view(&view, &sidx));
+    box_iterator_free(it);
+END_TEST
+
 Suite *suite(void)
 {
     Suite *s;
@@ -477,6 +650,12 @@ Suite *suite(void)
     tcase_add_test(tc_core, test_read_styp_data_too_short);
     tcase_add_test(tc_core, test_read_styp_data_too_long);
     tcase_add_test(tc_core, test_read_styp_size_not_divisible_by_four);
+    tcase_add_test(tc_core, test_read_boxes_from_file_range);
+    tcase_add_test(tc_core, test_read_boxes_from_file_range_past_end);
+    tcase_add_test(tc_core, test_box_iterator);
+    tcase_add_test(tc_core, test_box_views_match_boxes);
+    tcase_add_test(tc_core, test_read_pcrb_view);
+    tcase_add_test(tc_core, test_read_sidx_view_bad_reference_count);
 
     suite_add_tcase(s, tc_core);
 
@@ -0,0 +1,225 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <string.h>
+
+#include "json.h"
+#include "test_common.h"
+
+static bool parses(const char* text)
+{
+    GHashTable* fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    bool result = json_parse_object(text, fields);
+    g_hash_table_destroy(fields);
+    return result;
+}
+
+static void assert_string_value(const char* json, const char* expected)
+{
+    gchar* value = json_string_value(json);
+    if (expected == NULL) {
+        ck_assert_msg(value == NULL, "%s should be invalid, but its value is \"%s\"", json, value);
+    } else {
+        ck_assert_msg(value != NULL, "%s should be valid", json);
+        ck_assert_str_eq(value, expected);
+    }
+    g_free(value);
+}
+
+START_TEST(test_json_string_escapes)
+    assert_string_value("\"\"", "");
+    assert_string_value("\"plain /path/to/file.ts\"", "plain /path/to/file.ts");
+    assert_string_value("\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"", "a\"b\\c/d\b\f\n\r\t");
+    assert_string_value("\"\\u0041\\u00e9\\u20AC\"", "A\xc3\xa9\xe2\x82\xac");
+
+    /* Unknown escapes, unescaped control characters and anything after the string */
+    assert_string_value("\"\\x41\"", NULL);
+    assert_string_value("\"\\u12\"", NULL);
+    assert_string_value("\"\\u12g4\"", NULL);
+    assert_string_value("\"a\nb\"", NULL);
+    assert_string_value("\"a\" ", NULL);
+    assert_string_value("a", NULL);
+
+    /* Everything json_append_string() writes reads back the same */
+    char all[128];
+    for (size_t i = 0; i < sizeof(all) - 1; ++i) {
+        all[i] = i + 1;
+    }
+    all[sizeof(all) - 1] = 0;
+    GString* json = g_string_new(NULL);
+    json_append_string(json, all);
+    assert_string_value(json->str, all);
+    g_string_free(json, true);
+END_TEST
+
+START_TEST(test_json_string_surrogates)
+    assert_string_value("\"\\ud83d\\ude00\"", "\xf0\x9f\x98\x80");
+    assert_string_value("\"\\uD800\\uDC00x\"", "\xf0\x90\x80\x80x");
+
+    /* A high surrogate has to be followed by a low one, and low ones can't be on their own */
+    assert_string_value("\"\\ud83d\"", NULL);
+    assert_string_value("\"\\ud83dx\"", NULL);
+    assert_string_value("\"\\ud83d\\u0041\"", NULL);
+    assert_string_value("\"\\ud83d\\ud83d\"", NULL);
+    assert_string_value("\"\\ud83d\\ude0\"", NULL);
+    assert_string_value("\"\\ude00\"", NULL);
+    assert_string_value("\"\\ude00\\ud83d\"", NULL);
+END_TEST
+
+START_TEST(test_json_string_nul)
+    /* Values are C strings, so NUL would cut them short */
+    assert_string_value("\"\\u0000\"", NULL);
+    assert_string_value("\"/path\\u0000.ts\"", NULL);
+    ck_assert(!parses("{\"a\\u0000b\": 1}"));
+
+    /* Values are kept as raw JSON until they're used */
+    GHashTable* fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    ck_assert(json_parse_object("{\"mpd\": \"a\\u0000b\"}", fields));
+    assert_string_value(g_hash_table_lookup(fields, "mpd"), NULL);
+    g_hash_table_destroy(fields);
+END_TEST
+
+START_TEST(test_json_parse_object)
+    GHashTable* fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    ck_assert(json_parse_object(" {\"id\": 1, \"mpd\" : \"/a \\\"b\\\"\",\"t\":true,\"f\":false,\"n\":null,"
+            "\"a\\u0062\":-1.5e+3}\n", fields));
+    ck_assert_uint_eq(g_hash_table_size(fields), 6);
+    ck_assert_str_eq(g_hash_table_lookup(fields, "id"), "1");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "mpd"), "\"/a \\\"b\\\"\"");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "t"), "true");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "f"), "false");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "n"), "null");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "ab"), "-1.5e+3");
+    g_hash_table_destroy(fields);
+
+    ck_assert(parses("{}"));
+    ck_assert(parses(" { } "));
+END_TEST
+
+START_TEST(test_json_parse_numbers)
+    const char* valid[] = { "0", "-0", "12", "1.5", "1e5", "1E-5", "-12.25e+10", "4294967295",
+            "18446744073709551615" };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i) {
+        gchar* text = g_strdup_printf("{\"n\": %s}", valid[i]);
+        ck_assert_msg(parses(text), "%s should parse", text);
+        g_free(text);
+    }
+    const char* invalid[] = { "01", "1.", ".5", "-", "+1", "1e", "1e+", "1.e5", "0x10", "-inf", "nan", "--1",
+            "1-2" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        gchar* text = g_strdup_printf("{\"n\": %s}", invalid[i]);
+        ck_assert_msg(!parses(text), "%s shouldn't parse", text);
+        g_free(text);
+    }
+END_TEST
+
+START_TEST(test_json_parse_malformed)
+    const char* invalid[] = {
+        "", " ", "{", "}", "[1]", "{\"a\"", "{\"a\":", "{\"a\":1", "{\"a\":1,", "{\"a\":1,}", "{,}",
+        "{\"a\" 1}", "{\"a\":1 \"b\":2}", "{a:1}", "{'a':1}", "{\"a\":\"b}", "{\"a\":\"\\\"}", "{\"a\":\"\\",
+        "{\"a\":tru}", "{\"a\":truex}", "{\"a\":nul}", "{\"a\":{}}", "{\"a\":1}x", "{\"a\":1}}",
+        "{\"a\":1}{}", "{\"\\q\":1}"
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        ck_assert_msg(!parses(invalid[i]), "%s shouldn't parse", invalid[i]);
+    }
+
+    /* Every prefix of a valid object is truncated */
+    const char* valid = "{\"id\": \"\\ud83d\\ude00\", \"n\": -1.5e3, \"t\": true}";
+    ck_assert(parses(valid));
+    for (size_t len = 0; len < strlen(valid); ++len) {
+        gchar* truncated = g_strndup(valid, len);
+        ck_assert_msg(!parses(truncated), "%s shouldn't parse", truncated);
+        g_free(truncated);
+    }
+END_TEST
+
+START_TEST(test_json_parse_number_arrays)
+    GHashTable* fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    ck_assert(json_parse_object("{\"a\": [1, 2 ,3], \"e\":[ ], \"n\": [-1.5e3]}", fields));
+    ck_assert_str_eq(g_hash_table_lookup(fields, "a"), "[1, 2 ,3]");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "e"), "[ ]");
+    ck_assert_str_eq(g_hash_table_lookup(fields, "n"), "[-1.5e3]");
+    g_hash_table_destroy(fields);
+
+    const char* invalid[] = { "[", "[1", "[1,", "[1,]", "[,1]", "[,]", "[1 2]", "[01]", "[\"a\"]", "[true]", "[[1]]",
+            "[{}]", "[1]]" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        gchar* text = g_strdup_printf("{\"a\": %s}", invalid[i]);
+        ck_assert_msg(!parses(text), "%s shouldn't parse", text);
+        g_free(text);
+    }
+END_TEST
+
+START_TEST(test_json_uint64_array_value)
+    GArray* values = json_uint64_array_value("[]");
+    ck_assert_ptr_ne(values, NULL);
+    ck_assert_uint_eq(values->len, 0);
+    g_array_free(values, true);
+
+    values = json_uint64_array_value("[0, 8589934591,18446744073709551615 ]");
+    ck_assert_ptr_ne(values, NULL);
+    ck_assert_uint_eq(values->len, 3);
+    ck_assert_uint_eq(g_array_index(values, uint64_t, 0), 0);
+    ck_assert_uint_eq(g_array_index(values, uint64_t, 1), 8589934591);
+    ck_assert(g_array_index(values, uint64_t, 2) == UINT64_MAX);
+    g_array_free(values, true);
+
+    const char* invalid[] = { "[-1]", "[-0]", "[1.5]", "[1e3]", "[18446744073709551616]", "[1,]", "1", "\"[1]\"",
+            "[1] ", " [1]", "" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        values = json_uint64_array_value(invalid[i]);
+        ck_assert_msg(values == NULL, "%s shouldn't be an array of uint64_t", invalid[i]);
+    }
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("JSON");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_json_string_escapes);
+    tcase_add_test(tc_core, test_json_string_surrogates);
+    tcase_add_test(tc_core, test_json_string_nul);
+    tcase_add_test(tc_core, test_json_parse_object);
+    tcase_add_test(tc_core, test_json_parse_numbers);
+    tcase_add_test(tc_core, test_json_parse_malformed);
+    tcase_add_test(tc_core, test_json_parse_number_arrays);
+    tcase_add_test(tc_core, test_json_uint64_array_value);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
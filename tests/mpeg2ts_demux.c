@@ -0,0 +1,339 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <string.h>
+
+#include "crc32m.h"
+#include "mpeg2ts_demux.h"
+#include "test_common.h"
+
+static uint8_t pat_bytes[] = {0, 0, 176, 13, 0, 1, 193, 0, 0, 0, 1, 240, 0, 42, 177, 4, 178};
+static uint8_t pmt_bytes[] = {0, 2, 128, 120, 0, 1, 1, 0, 0, 1, 0, 0, 17, 37, 15, 255, 255, 73, 68, 51, 32, 255, 73,
+        68, 51, 32, 0, 31, 0, 1, 27, 1, 0, 0, 18, 9, 16, 99, 101, 1, 44, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 15, 1, 1,
+        0, 24, 10, 4, 101, 110, 103, 0, 9, 16, 99, 101, 1, 45, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 21, 1, 2, 0, 33,
+        38, 13, 255, 255, 73, 68, 51, 32, 255, 73, 68, 51, 32, 0, 15, 9, 16, 99, 101, 1, 46, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 56, 19, 253, 173};
+
+typedef struct {
+    GArray* pids; /* uint16_t PID of each packet passed to a handler */
+    mpeg2ts_program_t* program;
+    unsigned num_pmts; /* times pmt_processor() was called */
+} demux_test_t;
+
+static void make_packet(ts_packet_t* ts, uint16_t pid, uint8_t continuity_counter, const uint8_t* payload,
+        size_t payload_len)
+{
+    uint8_t buf[TS_SIZE];
+    memset(buf, 0xFF, sizeof(buf));
+    buf[0] = TS_SYNC_BYTE;
+    buf[1] = (payload ? 0x40 : 0) | (pid >> 8);
+    buf[2] = pid & 0xFF;
+    buf[3] = 0x10 | continuity_counter;
+    if (payload) {
+        memcpy(buf + 4, payload, payload_len);
+    }
+    ck_assert(ts_read(ts, buf, sizeof(buf), 0));
+}
+
+/* Recalculates the CRC_32 of a section after a pointer_field of 0 */
+static void update_crc(uint8_t* payload, size_t payload_len)
+{
+    crc_t crc = crc_finalize(crc_update(crc_init(), payload + 1, payload_len - 5));
+    for (size_t i = 0; i < 4; ++i) {
+        payload[payload_len - 4 + i] = crc >> (24 - i * 8);
+    }
+}
+
+static void record_pid(ts_packet_t* ts, elementary_stream_info_t* esi, void* arg)
+{
+    demux_test_t* test = arg;
+    g_array_append_val(test->pids, ts->pid);
+}
+
+/* Called for every packet before it's demuxed. Unregistering PID 256 in the middle of a run of packets on it should
+ * take effect immediately. */
+static void unregister_pid(ts_packet_t* ts, elementary_stream_info_t* esi, void* arg)
+{
+    demux_test_t* test = arg;
+    if (ts->pid == 256 && ts->continuity_counter == 3) {
+        mpeg2ts_program_unregister_pid_processor(test->program, 256);
+    }
+}
+
+static void pmt_processor(mpeg2ts_program_t* m2p, void* arg)
+{
+    demux_test_t* test = arg;
+    test->program = m2p;
+    test->num_pmts++;
+    for (uint16_t pid = 256; pid <= 257; ++pid) {
+        demux_pid_handler_t* handler = demux_pid_handler_new(record_pid);
+        handler->arg = test;
+        mpeg2ts_program_register_pid_processor(m2p, pid, handler, NULL);
+    }
+}
+
+static void pat_processor(mpeg2ts_stream_t* m2s, void* arg)
+{
+    for (size_t i = 0; i < m2s->programs->len; ++i) {
+        mpeg2ts_program_t* m2p = g_ptr_array_index(m2s->programs, i);
+        m2p->pmt_processor = pmt_processor;
+        m2p->arg = arg;
+    }
+}
+
+static void test_demux(bool batch)
+{
+    ts_packet_t packets[10];
+    make_packet(&packets[0], PID_PAT, 0, pat_bytes, sizeof(pat_bytes));
+    make_packet(&packets[1], 0x1000, 0, pmt_bytes, sizeof(pmt_bytes));
+    make_packet(&packets[2], 256, 0, NULL, 0);
+    make_packet(&packets[3], 257, 0, NULL, 0);
+    make_packet(&packets[4], 256, 1, NULL, 0);
+    make_packet(&packets[5], 256, 1, NULL, 0); /* duplicate */
+    make_packet(&packets[6], 256, 2, NULL, 0);
+    make_packet(&packets[7], 256, 3, NULL, 0);
+    make_packet(&packets[8], 257, 1, NULL, 0);
+    make_packet(&packets[9], 256, 4, NULL, 0);
+
+    demux_test_t test = { g_array_new(false, false, sizeof(uint16_t)), NULL, 0 };
+    mpeg2ts_stream_t* m2s = mpeg2ts_stream_new();
+    m2s->pat_processor = pat_processor;
+    m2s->arg = &test;
+    m2s->ts_processor = demux_pid_handler_new(unregister_pid);
+    m2s->ts_processor->arg = &test;
+
+    if (batch) {
+        ck_assert_int_eq(mpeg2ts_stream_read_ts_packets(m2s, packets, G_N_ELEMENTS(packets)), 0);
+    } else {
+        for (size_t i = 0; i < G_N_ELEMENTS(packets); ++i) {
+            ck_assert_int_eq(mpeg2ts_stream_read_ts_packet(m2s, &packets[i]), 0);
+        }
+    }
+
+    uint16_t expected[] = {256, 257, 256, 256, 257};
+    assert_arrays_eq(ck_assert_uint_eq, (uint16_t*)test.pids->data, test.pids->len, expected,
+            G_N_ELEMENTS(expected));
+
+    mpeg2ts_stream_free(m2s);
+    g_array_free(test.pids, true);
+}
+
+START_TEST(test_read_ts_packet)
+    test_demux(false);
+END_TEST
+
+START_TEST(test_read_ts_packets)
+    test_demux(true);
+END_TEST
+
+/* Repeated sections are skipped without being parsed, but a new version has to be used even if the last one was
+ * skipped */
+START_TEST(test_repeated_pmt)
+    uint8_t pmt_v1_bytes[sizeof(pmt_bytes)];
+    memcpy(pmt_v1_bytes, pmt_bytes, sizeof(pmt_bytes));
+    pmt_v1_bytes[6] = 0xC3; /* version_number = 1 */
+    update_crc(pmt_v1_bytes, sizeof(pmt_v1_bytes));
+
+    ts_packet_t packets[7];
+    make_packet(&packets[0], PID_PAT, 0, pat_bytes, sizeof(pat_bytes));
+    make_packet(&packets[1], 0x1000, 0, pmt_bytes, sizeof(pmt_bytes));
+    make_packet(&packets[2], PID_PAT, 1, pat_bytes, sizeof(pat_bytes));
+    make_packet(&packets[3], 0x1000, 1, pmt_bytes, sizeof(pmt_bytes));
+    make_packet(&packets[4], 0x1000, 2, pmt_v1_bytes, sizeof(pmt_v1_bytes));
+    make_packet(&packets[5], 0x1000, 3, pmt_v1_bytes, sizeof(pmt_v1_bytes));
+    make_packet(&packets[6], 0x1000, 4, pmt_bytes, sizeof(pmt_bytes));
+
+    demux_test_t test = { g_array_new(false, false, sizeof(uint16_t)), NULL, 0 };
+    mpeg2ts_stream_t* m2s = mpeg2ts_stream_new();
+    m2s->pat_processor = pat_processor;
+    m2s->arg = &test;
+
+    unsigned expected_pmts[] = {0, 1, 1, 1, 2, 2, 3};
+    for (size_t i = 0; i < G_N_ELEMENTS(packets); ++i) {
+        ck_assert_int_eq(mpeg2ts_stream_read_ts_packet(m2s, &packets[i]), 0);
+        ck_assert_uint_eq(test.num_pmts, expected_pmts[i]);
+    }
+    ck_assert_uint_eq(m2s->programs->len, 1);
+    ck_assert_uint_eq(test.program->pmt->version_number, 0);
+
+    mpeg2ts_stream_free(m2s);
+    g_array_free(test.pids, true);
+END_TEST
+
+/* A PAT in two sections, each with one program, has to be complete before it's used */
+START_TEST(test_multi_section_pat)
+    uint8_t pat_section_bytes[2][sizeof(pat_bytes)];
+    for (uint8_t i = 0; i < 2; ++i) {
+        memcpy(pat_section_bytes[i], pat_bytes, sizeof(pat_bytes));
+        pat_section_bytes[i][7] = i;     /* section_number */
+        pat_section_bytes[i][8] = 1;     /* last_section_number */
+        pat_section_bytes[i][10] = i + 1; /* program_number */
+        pat_section_bytes[i][12] = i;    /* program_map_PID = 0x1000 + i */
+        update_crc(pat_section_bytes[i], sizeof(pat_bytes));
+    }
+
+    ts_packet_t packets[3];
+    make_packet(&packets[0], PID_PAT, 0, pat_section_bytes[1], sizeof(pat_bytes));
+    make_packet(&packets[1], PID_PAT, 1, pat_section_bytes[0], sizeof(pat_bytes));
+    make_packet(&packets[2], PID_PAT, 2, pat_section_bytes[1], sizeof(pat_bytes));
+
+    mpeg2ts_stream_t* m2s = mpeg2ts_stream_new();
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packet(m2s, &packets[0]), 0);
+    ck_assert_ptr_eq(m2s->pat, NULL);
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packet(m2s, &packets[1]), 0);
+    ck_assert_ptr_ne(m2s->pat, NULL);
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packet(m2s, &packets[2]), 0);
+
+    ck_assert_uint_eq(m2s->pat->num_programs, 2);
+    ck_assert_uint_eq(m2s->programs->len, 2);
+    for (uint16_t i = 0; i < 2; ++i) {
+        mpeg2ts_program_t* m2p = g_ptr_array_index(m2s->programs, i);
+        ck_assert_uint_eq(m2p->program_number, i + 1);
+        ck_assert_uint_eq(m2p->pid, 0x1000 + i);
+    }
+
+    mpeg2ts_stream_free(m2s);
+END_TEST
+
+/* Makes a packet with just an adaptation field carrying pcr */
+static void make_pcr_packet(ts_packet_t* ts, uint16_t pid, uint8_t continuity_counter, uint64_t pcr)
+{
+    uint8_t buf[TS_SIZE];
+    memset(buf, 0xFF, sizeof(buf));
+    uint64_t base = pcr / 300;
+    uint16_t extension = pcr % 300;
+    uint8_t header[] = {TS_SYNC_BYTE, pid >> 8, pid & 0xFF, 0x20 | continuity_counter, 183, 0x10, base >> 25,
+            (base >> 17) & 0xFF, (base >> 9) & 0xFF, (base >> 1) & 0xFF, ((base & 1) << 7) | 0x7E | (extension >> 8),
+            extension & 0xFF};
+    memcpy(buf, header, sizeof(header));
+    ck_assert(ts_read(ts, buf, sizeof(buf), 0));
+}
+
+/* Packets between PCRs get a PCR extrapolated from the last two, through a rollover */
+START_TEST(test_pcr_int)
+    int64_t first_pcr = PCR_ROLLOVER - 1500;
+    ts_packet_t packets[8];
+    make_packet(&packets[0], PID_PAT, 0, pat_bytes, sizeof(pat_bytes));
+    make_packet(&packets[1], 0x1000, 0, pmt_bytes, sizeof(pmt_bytes));
+    make_pcr_packet(&packets[2], 256, 0, first_pcr);
+    make_packet(&packets[3], 257, 0, NULL, 0);
+    make_packet(&packets[4], 257, 1, NULL, 0);
+    make_pcr_packet(&packets[5], 256, 0, first_pcr + 3000 - PCR_ROLLOVER);
+    make_packet(&packets[6], 257, 2, NULL, 0);
+    make_packet(&packets[7], 257, 3, NULL, 0);
+
+    demux_test_t test = { g_array_new(false, false, sizeof(uint16_t)), NULL, 0 };
+    mpeg2ts_stream_t* m2s = mpeg2ts_stream_new();
+    m2s->pat_processor = pat_processor;
+    m2s->arg = &test;
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packets(m2s, packets, G_N_ELEMENTS(packets)), 0);
+
+    uint64_t expected[] = {PCR_INVALID, PCR_INVALID, first_pcr, PCR_INVALID, PCR_INVALID, 1500, 2500, 3500};
+    for (size_t i = 0; i < G_N_ELEMENTS(packets); ++i) {
+        ck_assert_uint_eq(packets[i].pcr_int, expected[i]);
+    }
+    ck_assert_int_eq(test.program->pcr_info.first_pcr, first_pcr);
+    ck_assert_int_eq(test.program->pcr_info.num_rollovers, 1);
+    ck_assert_int_eq(test.program->pcr_info.pcr[1], PCR_ROLLOVER + 1500);
+    ck_assert_int_eq(test.program->pcr_info.packets_from_last_pcr, 2);
+    ck_assert(test.program->pcr_info.pcr_rate > 999.9 && test.program->pcr_info.pcr_rate < 1000.1);
+
+    mpeg2ts_stream_free(m2s);
+    g_array_free(test.pids, true);
+END_TEST
+
+static void record_table_id(const psi_section_t* section, elementary_stream_info_t* esi, void* arg)
+{
+    GArray* table_ids = arg;
+    g_array_append_val(table_ids, section->data[0]);
+}
+
+/* Sections go to the last filter registered for their table_id, and don't need the PID to be in a PMT */
+START_TEST(test_section_filters)
+    uint8_t sections[2][5] = {{0, 0xFC, 0x30, 1, 0}, {0, 0xC0, 0x30, 1, 0}};
+    ts_packet_t packets[4];
+    for (uint8_t i = 0; i < 4; ++i) {
+        make_packet(&packets[i], 0x200, i, sections[i % 2], sizeof(sections[0]));
+    }
+
+    GArray* table_ids[3];
+    section_filter_t* filters[3] = {section_filter_new(0, 0, record_table_id),
+            section_filter_new(0xFC, 0xFF, record_table_id), section_filter_new(0xC0, 0xC0, record_table_id)};
+    for (size_t i = 0; i < 3; ++i) {
+        table_ids[i] = g_array_new(false, false, 1);
+        filters[i]->arg = table_ids[i];
+    }
+
+    mpeg2ts_stream_t* m2s = mpeg2ts_stream_new();
+    ck_assert_int_eq(mpeg2ts_stream_register_section_filter(m2s, 0x200, filters[0]), 1);
+    ck_assert_int_eq(mpeg2ts_stream_register_section_filter(m2s, 0x200, filters[1]), 1);
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packets(m2s, packets, 2), 0);
+    /* This takes 0xFC from filters[1], so that one's dropped */
+    ck_assert_int_eq(mpeg2ts_stream_register_section_filter(m2s, 0x200, filters[2]), 1);
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packets(m2s, packets + 2, 2), 0);
+
+    uint8_t expected[3][2] = {{0xC0}, {0xFC}, {0xFC, 0xC0}};
+    size_t expected_len[3] = {1, 1, 2};
+    for (size_t i = 0; i < 3; ++i) {
+        assert_bytes_eq((uint8_t*)table_ids[i]->data, table_ids[i]->len, expected[i], expected_len[i]);
+    }
+
+    /* Once they're unregistered, the PID is handled like any other */
+    mpeg2ts_stream_unregister_section_filters(m2s, 0x200);
+    ck_assert_int_eq(mpeg2ts_stream_read_ts_packets(m2s, packets, 2), 0);
+    ck_assert_uint_eq(table_ids[2]->len, 2);
+
+    mpeg2ts_stream_free(m2s);
+    for (size_t i = 0; i < 3; ++i) {
+        g_array_free(table_ids[i], true);
+    }
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("MPEG-2 TS Demuxer");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_read_ts_packet);
+    tcase_add_test(tc_core, test_read_ts_packets);
+    tcase_add_test(tc_core, test_repeated_pmt);
+    tcase_add_test(tc_core, test_multi_section_pat);
+    tcase_add_test(tc_core, test_section_filters);
+    tcase_add_test(tc_core, test_pcr_int);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,159 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+
+#include "pcr_analyzer.h"
+#include "test_common.h"
+
+
+/* 27 MHz ticks per byte at 1 Mbit/s */
+#define TICKS_PER_BYTE 216
+
+/* Adds PCRs 40 ms apart at 1 Mbit/s, starting at pcr, with jitter[i] added to each */
+static void add_pcrs(pcr_analyzer_t* analyzer, uint64_t pcr, const int* jitter, size_t num_pcrs)
+{
+    uint64_t bytes = 27000000 / 25 / TICKS_PER_BYTE;
+    for (size_t i = 0; i < num_pcrs; ++i) {
+        uint64_t value = (pcr + i * bytes * TICKS_PER_BYTE + jitter[i]) % PCR_ROLLOVER;
+        ck_assert(pcr_analyzer_add(analyzer, value, i * bytes, false));
+    }
+}
+
+START_TEST(test_pcr_analyzer_constant_bitrate)
+    int jitter[10] = {0};
+    pcr_analyzer_t* analyzer = pcr_analyzer_new();
+    add_pcrs(analyzer, 27000000, jitter, G_N_ELEMENTS(jitter));
+    ck_assert_uint_eq(analyzer->errors->len, 0);
+
+    pcr_summary_t summary;
+    pcr_analyzer_summarize(analyzer, &summary);
+    ck_assert_uint_eq(summary.num_pcrs, 10);
+    ck_assert_uint_eq(summary.num_discontinuities, 0);
+    ck_assert_uint_eq(summary.min_interval, 1080000);
+    ck_assert_uint_eq(summary.max_interval, 1080000);
+    ck_assert(summary.bitrate > 999999 && summary.bitrate < 1000001);
+    ck_assert(summary.max_deviation < 0.001);
+
+    /* Between, before and after the PCRs */
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 100), 27000000 + 100 * TICKS_PER_BYTE);
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 5000 * 3 + 7), 27000000 + (5000 * 3 + 7) * TICKS_PER_BYTE);
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 5000 * 12), 27000000 + 5000 * 12 * TICKS_PER_BYTE);
+    pcr_analyzer_free(analyzer);
+END_TEST
+
+START_TEST(test_pcr_analyzer_jitter)
+    int jitter[6] = {270, -270, 0, 0, -270, 270};
+    pcr_analyzer_t* analyzer = pcr_analyzer_new();
+    add_pcrs(analyzer, 27000000, jitter, G_N_ELEMENTS(jitter));
+
+    pcr_summary_t summary;
+    pcr_analyzer_summarize(analyzer, &summary);
+    /* The jitter doesn't move the fit, so each PCR is its jitter away from it */
+    ck_assert(summary.max_deviation > 269 && summary.max_deviation < 271);
+    ck_assert(summary.rms_deviation > 220 && summary.rms_deviation < 221);
+    pcr_analyzer_free(analyzer);
+END_TEST
+
+START_TEST(test_pcr_analyzer_rollover)
+    int jitter[4] = {0};
+    pcr_analyzer_t* analyzer = pcr_analyzer_new();
+    add_pcrs(analyzer, PCR_ROLLOVER - 2000000, jitter, G_N_ELEMENTS(jitter));
+    ck_assert_uint_eq(analyzer->errors->len, 0);
+
+    pcr_summary_t summary;
+    pcr_analyzer_summarize(analyzer, &summary);
+    ck_assert_uint_eq(summary.num_rollovers, 1);
+    ck_assert_uint_eq(summary.max_interval, 1080000);
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 5000 * 2), 160000);
+    pcr_analyzer_free(analyzer);
+END_TEST
+
+START_TEST(test_pcr_analyzer_errors)
+    pcr_analyzer_t* analyzer = pcr_analyzer_new();
+    ck_assert(pcr_analyzer_add(analyzer, 27000000, 0, false));
+    /* 110 ms */
+    ck_assert(!pcr_analyzer_add(analyzer, 29970000, 188 * 10, false));
+    ck_assert(pcr_analyzer_add(analyzer, 30000000, 188 * 20, false));
+    ck_assert(!pcr_analyzer_add(analyzer, 20000000, 188 * 30, false));
+    /* Fine with discontinuity_indicator */
+    ck_assert(pcr_analyzer_add(analyzer, 10000000, 188 * 40, true));
+    ck_assert(pcr_analyzer_add(analyzer, 10001000, 188 * 50, false));
+    /* The largest base with an extension of 300 is ignored */
+    ck_assert(!pcr_analyzer_add(analyzer, PCR_ROLLOVER, 188 * 55, false));
+
+    ck_assert_uint_eq(analyzer->errors->len, 3);
+    pcr_error_t* error = &g_array_index(analyzer->errors, pcr_error_t, 0);
+    ck_assert_int_eq(error->type, PCR_INTERVAL_TOO_LONG);
+    ck_assert_uint_eq(error->offset, 188 * 10);
+    ck_assert_uint_eq(error->pcr, 29970000);
+    ck_assert_uint_eq(error->previous, 27000000);
+    error = &g_array_index(analyzer->errors, pcr_error_t, 1);
+    ck_assert_int_eq(error->type, PCR_BACKWARDS);
+    ck_assert_uint_eq(error->offset, 188 * 30);
+    error = &g_array_index(analyzer->errors, pcr_error_t, 2);
+    ck_assert_int_eq(error->type, PCR_OUT_OF_RANGE);
+    ck_assert_uint_eq(error->offset, 188 * 55);
+    ck_assert_uint_eq(error->pcr, PCR_ROLLOVER);
+    ck_assert_uint_eq(analyzer->last_pcr, 10001000);
+
+    pcr_summary_t summary;
+    pcr_analyzer_summarize(analyzer, &summary);
+    ck_assert_uint_eq(summary.num_pcrs, 6);
+    ck_assert_uint_eq(summary.num_discontinuities, 2);
+    /* Bytes after the last PCR of a run are on its time base */
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 188 * 25), 30015000);
+    /* A run with one PCR doesn't tell us anything */
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 188 * 35), PCR_INVALID);
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 188 * 45), 10000500);
+
+    pcr_analyzer_reset(analyzer);
+    ck_assert_uint_eq(analyzer->errors->len, 0);
+    ck_assert_uint_eq(pcr_analyzer_pcr_at(analyzer, 0), PCR_INVALID);
+    pcr_analyzer_free(analyzer);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("PCR Analyzer");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_pcr_analyzer_constant_bitrate);
+    tcase_add_test(tc_core, test_pcr_analyzer_jitter);
+    tcase_add_test(tc_core, test_pcr_analyzer_rollover);
+    tcase_add_test(tc_core, test_pcr_analyzer_errors);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,185 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <string.h>
+
+#include "crc32m.h"
+#include "scte35.h"
+#include "test_common.h"
+
+
+#define PTS_MAX ((UINT64_C(1) << 33) - 1)
+
+static size_t write_splice_time(uint8_t* buf, uint64_t pts_time)
+{
+    buf[0] = 0xFE | (pts_time >> 32);
+    buf[1] = pts_time >> 24;
+    buf[2] = pts_time >> 16;
+    buf[3] = pts_time >> 8;
+    buf[4] = pts_time;
+    return 5;
+}
+
+/* Writes a splice_info_section with the given splice command and no descriptors into section. If corrupt_crc is true,
+ * the section's CRC_32 is wrong. */
+static void make_splice_info_section(psi_section_t* section, uint8_t* buf, uint64_t pts_adjustment,
+        uint8_t splice_command_type, const uint8_t* command, size_t command_len, bool corrupt_crc)
+{
+    size_t section_length = 11 + command_len + 2 + 4;
+    buf[0] = TABLE_ID_SPLICE_INFO_SECTION;
+    buf[1] = 0x30 | (section_length >> 8);
+    buf[2] = section_length & 0xFF;
+    buf[3] = 0; // protocol_version
+    buf[4] = pts_adjustment >> 32;
+    buf[5] = pts_adjustment >> 24;
+    buf[6] = pts_adjustment >> 16;
+    buf[7] = pts_adjustment >> 8;
+    buf[8] = pts_adjustment;
+    buf[9] = 0; // cw_index
+    buf[10] = 0xFF; // tier
+    buf[11] = 0xF0 | (command_len >> 8);
+    buf[12] = command_len & 0xFF;
+    buf[13] = splice_command_type;
+    memcpy(buf + 14, command, command_len);
+    buf[14 + command_len] = 0; // descriptor_loop_length
+    buf[15 + command_len] = 0;
+
+    size_t len = 3 + section_length;
+    crc_t crc = crc_finalize(crc_update(crc_init(), buf, len - 4));
+    for (size_t i = 0; i < 4; ++i) {
+        buf[len - 4 + i] = crc >> (24 - i * 8);
+    }
+    if (corrupt_crc) {
+        buf[len - 1] ^= 1;
+    }
+
+    section->pid = 0x1FF;
+    section->data = buf;
+    section->len = len;
+    section->crc_32 = crc;
+    section->discontinuity = false;
+}
+
+START_TEST(test_time_signal)
+    uint8_t command[5];
+    write_splice_time(command, 900000);
+    uint8_t buf[64];
+    psi_section_t section;
+    make_splice_info_section(&section, buf, 0, TIME_SIGNAL, command, sizeof(command), false);
+
+    splice_info_section_t* sis = splice_info_section_parse(&section);
+    ck_assert_ptr_ne(sis, NULL);
+    ck_assert_uint_eq(sis->splice_command_type, TIME_SIGNAL);
+    ck_assert(sis->time_specified_flag);
+    ck_assert_uint_eq(sis->pts_time, 900000);
+
+    uint64_t pts;
+    ck_assert(splice_info_section_get_splice_point(sis, &pts));
+    ck_assert_uint_eq(pts, 900000);
+    splice_info_section_free(sis);
+END_TEST
+
+START_TEST(test_splice_insert)
+    uint8_t command[20] = {0x00, 0x00, 0x04, 0xD2, // splice_event_id = 1234
+            0x7F, // splice_event_cancel_indicator = 0
+            0xCF}; // out_of_network_indicator, program_splice_flag
+    size_t command_len = 6;
+    command_len += write_splice_time(command + command_len, PTS_MAX - 10);
+    command[command_len++] = 0x00; // unique_program_id
+    command[command_len++] = 0x01;
+    command[command_len++] = 0; // avail_num
+    command[command_len++] = 0; // avails_expected
+    uint8_t buf[64];
+    psi_section_t section;
+    make_splice_info_section(&section, buf, 100, SPLICE_INSERT, command, command_len, false);
+
+    splice_info_section_t* sis = splice_info_section_parse(&section);
+    ck_assert_ptr_ne(sis, NULL);
+    ck_assert_uint_eq(sis->splice_command_type, SPLICE_INSERT);
+    ck_assert_uint_eq(sis->splice_event_id, 1234);
+    ck_assert(!sis->splice_event_cancel_indicator);
+    ck_assert(sis->out_of_network_indicator);
+    ck_assert(sis->program_splice_flag);
+    ck_assert(!sis->splice_immediate_flag);
+    ck_assert_uint_eq(sis->pts_adjustment, 100);
+    ck_assert_uint_eq(sis->pts_time, PTS_MAX - 10);
+    ck_assert_uint_eq(sis->unique_program_id, 1);
+
+    /* pts_adjustment wraps around */
+    uint64_t pts;
+    ck_assert(splice_info_section_get_splice_point(sis, &pts));
+    ck_assert_uint_eq(pts, 89);
+    splice_info_section_free(sis);
+END_TEST
+
+START_TEST(test_splice_insert_cancel)
+    uint8_t command[] = {0x00, 0x00, 0x04, 0xD2, 0xFF};
+    uint8_t buf[64];
+    psi_section_t section;
+    make_splice_info_section(&section, buf, 0, SPLICE_INSERT, command, sizeof(command), false);
+
+    splice_info_section_t* sis = splice_info_section_parse(&section);
+    ck_assert_ptr_ne(sis, NULL);
+    ck_assert(sis->splice_event_cancel_indicator);
+
+    uint64_t pts;
+    ck_assert(!splice_info_section_get_splice_point(sis, &pts));
+    splice_info_section_free(sis);
+END_TEST
+
+START_TEST(test_bad_crc)
+    uint8_t command[5];
+    write_splice_time(command, 900000);
+    uint8_t buf[64];
+    psi_section_t section;
+    make_splice_info_section(&section, buf, 0, TIME_SIGNAL, command, sizeof(command), true);
+
+    ck_assert_ptr_eq(splice_info_section_parse(&section), NULL);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("SCTE 35");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_time_signal);
+    tcase_add_test(tc_core, test_splice_insert);
+    tcase_add_test(tc_core, test_splice_insert_cancel);
+    tcase_add_test(tc_core, test_bad_crc);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
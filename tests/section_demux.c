@@ -0,0 +1,277 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <string.h>
+
+#include "crc32m.h"
+#include "section_demux.h"
+#include "test_common.h"
+
+
+#define TEST_PID 0x100
+
+typedef struct {
+    GPtrArray* sections; /* GArray* with the bytes of each section passed to the processor */
+} section_test_t;
+
+static void record_section(const psi_section_t* section, elementary_stream_info_t* es_info, void* arg)
+{
+    section_test_t* test = arg;
+    GArray* bytes = g_array_new(false, false, 1);
+    g_array_append_vals(bytes, section->data, section->len);
+    g_ptr_array_add(test->sections, bytes);
+}
+
+static void free_bytes(void* bytes)
+{
+    g_array_free(bytes, true);
+}
+
+/* Writes a long-form section with a payload of payload_len bytes counting up from first_byte, and returns its
+ * length */
+static size_t make_section(uint8_t* buf, uint8_t table_id, uint8_t version_number, uint8_t section_number,
+        uint8_t last_section_number, uint8_t first_byte, size_t payload_len)
+{
+    size_t section_length = 5 + payload_len + 4;
+    buf[0] = table_id;
+    buf[1] = 0xB0 | (section_length >> 8);
+    buf[2] = section_length & 0xFF;
+    buf[3] = 0;
+    buf[4] = 1;
+    buf[5] = 0xC1 | (version_number << 1);
+    buf[6] = section_number;
+    buf[7] = last_section_number;
+    for (size_t i = 0; i < payload_len; ++i) {
+        buf[8 + i] = first_byte + i;
+    }
+    size_t len = 3 + section_length;
+    crc_t crc = crc_finalize(crc_update(crc_init(), buf, len - 4));
+    for (size_t i = 0; i < 4; ++i) {
+        buf[len - 4 + i] = crc >> (24 - i * 8);
+    }
+    return len;
+}
+
+/* Makes a packet on TEST_PID. If pointer_field is negative, payload_unit_start_indicator isn't set. */
+static void make_packet(ts_packet_t* ts, uint8_t continuity_counter, int pointer_field, const uint8_t* payload,
+        size_t payload_len)
+{
+    uint8_t buf[TS_SIZE];
+    memset(buf, 0xFF, sizeof(buf));
+    buf[0] = TS_SYNC_BYTE;
+    buf[1] = (pointer_field >= 0 ? 0x40 : 0) | (TEST_PID >> 8);
+    buf[2] = TEST_PID & 0xFF;
+    buf[3] = 0x10 | continuity_counter;
+    uint8_t* p = buf + 4;
+    if (pointer_field >= 0) {
+        *p++ = pointer_field;
+    }
+    ck_assert_uint_le(payload_len, (size_t)(buf + sizeof(buf) - p));
+    memcpy(p, payload, payload_len);
+    ck_assert(ts_read(ts, buf, sizeof(buf), 0));
+}
+
+static void run_test(section_test_t* test, ts_packet_t* packets, size_t num_packets)
+{
+    test->sections = g_ptr_array_new_with_free_func(free_bytes);
+    section_demux_t* sdm = section_demux_new(record_section);
+    sdm->arg = test;
+    for (size_t i = 0; i < num_packets; ++i) {
+        section_demux_process_ts_packet(&packets[i], NULL, sdm);
+    }
+    section_demux_free(sdm);
+}
+
+static void assert_section(section_test_t* test, size_t i, const uint8_t* bytes, size_t len)
+{
+    ck_assert_uint_gt(test->sections->len, i);
+    GArray* section = g_ptr_array_index(test->sections, i);
+    assert_bytes_eq((uint8_t*)section->data, section->len, bytes, len);
+}
+
+START_TEST(test_several_sections_in_one_packet)
+    uint8_t buf[100];
+    size_t len1 = make_section(buf, 0x80, 0, 0, 0, 0, 10);
+    size_t len2 = make_section(buf + len1, 0x81, 0, 0, 0, 50, 20);
+
+    ts_packet_t packets[1];
+    make_packet(&packets[0], 0, 0, buf, len1 + len2);
+
+    section_test_t test;
+    run_test(&test, packets, G_N_ELEMENTS(packets));
+    ck_assert_uint_eq(test.sections->len, 2);
+    assert_section(&test, 0, buf, len1);
+    assert_section(&test, 1, buf + len1, len2);
+    g_ptr_array_free(test.sections, true);
+END_TEST
+
+/* A section spanning four packets, which starts after the end of a section we never saw the start of and ends in the
+ * packet where the next one starts */
+START_TEST(test_section_spanning_packets)
+    uint8_t buf[700];
+    memset(buf, 0x55, 10);
+    size_t len1 = make_section(buf + 10, 0x80, 0, 0, 0, 0, 20);
+    size_t len2 = make_section(buf + 10 + len1, 0x81, 0, 0, 0, 7, 520);
+    size_t len3 = make_section(buf + 10 + len1 + len2, 0x82, 0, 0, 0, 9, 30);
+
+    ts_packet_t packets[5];
+    make_packet(&packets[0], 0, 10, buf, 183);
+    make_packet(&packets[1], 1, -1, buf + 183, 184);
+    make_packet(&packets[2], 2, -1, buf + 183 + 184, 184);
+    make_packet(&packets[3], 2, -1, buf + 183 + 184, 184); /* duplicate */
+    size_t offset = 183 + 184 * 2;
+    size_t pointer_field = 10 + len1 + len2 - offset;
+    make_packet(&packets[4], 3, pointer_field, buf + offset, pointer_field + len3);
+
+    section_test_t test;
+    run_test(&test, packets, G_N_ELEMENTS(packets));
+    ck_assert_uint_eq(test.sections->len, 3);
+    assert_section(&test, 0, buf + 10, len1);
+    assert_section(&test, 1, buf + 10 + len1, len2);
+    assert_section(&test, 2, buf + 10 + len1 + len2, len3);
+    g_ptr_array_free(test.sections, true);
+END_TEST
+
+START_TEST(test_bad_crc)
+    uint8_t buf[100];
+    size_t len1 = make_section(buf, 0x80, 0, 0, 0, 0, 10);
+    size_t len2 = make_section(buf + len1, 0x81, 0, 0, 0, 50, 20);
+    buf[len1 - 1] ^= 1;
+
+    ts_packet_t packets[1];
+    make_packet(&packets[0], 0, 0, buf, len1 + len2);
+
+    section_test_t test;
+    run_test(&test, packets, G_N_ELEMENTS(packets));
+    ck_assert_uint_eq(test.sections->len, 1);
+    assert_section(&test, 0, buf + len1, len2);
+    g_ptr_array_free(test.sections, true);
+END_TEST
+
+START_TEST(test_lost_packet)
+    uint8_t buf[500];
+    size_t len1 = make_section(buf, 0x80, 0, 0, 0, 0, 400);
+    size_t len2 = make_section(buf + len1, 0x81, 0, 0, 0, 50, 20);
+
+    ts_packet_t packets[2];
+    make_packet(&packets[0], 0, 0, buf, 183);
+    make_packet(&packets[1], 2, len1 - 183 - 184, buf + 183 + 184, len1 + len2 - 183 - 184);
+
+    section_test_t test;
+    run_test(&test, packets, G_N_ELEMENTS(packets));
+    ck_assert_uint_eq(test.sections->len, 1);
+    assert_section(&test, 0, buf + len1, len2);
+    g_ptr_array_free(test.sections, true);
+END_TEST
+
+START_TEST(test_section_table)
+    uint8_t buf[3][50];
+    psi_section_t sections[3] = {{0}};
+    for (size_t i = 0; i < 3; ++i) {
+        sections[i].data = buf[i];
+        /* sections 0 and 1 of version 0, and section 0 of version 1 */
+        sections[i].len = make_section(buf[i], 0, i / 2, i % 2, 1, i, 8);
+    }
+
+    section_table_t* table = section_table_new();
+    ck_assert(!section_table_add(table, &sections[1]));
+    ck_assert(!section_table_is_unchanged(table, &sections[1]));
+    ck_assert(section_table_add(table, &sections[0]));
+    ck_assert_uint_eq(table->complete->len, 2);
+    ck_assert(section_table_is_unchanged(table, &sections[0]));
+    ck_assert(section_table_is_unchanged(table, &sections[1]));
+
+    /* a new version has to be complete before it replaces the old one */
+    ck_assert(!section_table_is_unchanged(table, &sections[2]));
+    ck_assert(!section_table_add(table, &sections[2]));
+    ck_assert(section_table_is_unchanged(table, &sections[1]));
+    ck_assert(!section_table_add(table, &sections[1]));
+
+    section_table_reset(table);
+    ck_assert(!section_table_is_unchanged(table, &sections[0]));
+    section_table_free(table);
+END_TEST
+
+START_TEST(test_section_table_fingerprint)
+    uint8_t buf[3][50];
+    psi_section_t sections[3] = {{0}};
+    for (size_t i = 0; i < 2; ++i) {
+        sections[i].data = buf[i];
+        sections[i].len = make_section(buf[i], 0, 0, i, 1, 0, 8);
+    }
+    /* the same as section 0, except for version_number */
+    sections[2].data = buf[2];
+    sections[2].len = make_section(buf[2], 0, 1, 0, 1, 0, 8);
+
+    section_table_t* tables[2] = {section_table_new(), section_table_new()};
+    ck_assert_uint_eq(section_table_fingerprint(tables[0]), 0);
+
+    /* the order sections arrive in doesn't matter */
+    ck_assert(!section_table_add(tables[0], &sections[0]));
+    ck_assert(section_table_add(tables[0], &sections[1]));
+    ck_assert(!section_table_add(tables[1], &sections[1]));
+    ck_assert(section_table_add(tables[1], &sections[0]));
+    uint32_t fingerprint = section_table_fingerprint(tables[0]);
+    ck_assert_uint_ne(fingerprint, 0);
+    ck_assert_uint_eq(section_table_fingerprint(tables[1]), fingerprint);
+
+    ck_assert(!section_table_add(tables[1], &sections[2]));
+    ck_assert_uint_eq(section_table_fingerprint(tables[1]), fingerprint);
+    make_section(buf[1], 0, 1, 1, 1, 0, 8);
+    ck_assert(section_table_add(tables[1], &sections[1]));
+    ck_assert_uint_ne(section_table_fingerprint(tables[1]), fingerprint);
+
+    section_table_reset(tables[0]);
+    ck_assert_uint_eq(section_table_fingerprint(tables[0]), 0);
+    section_table_free(tables[0]);
+    section_table_free(tables[1]);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Section Demuxer");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_several_sections_in_one_packet);
+    tcase_add_test(tc_core, test_section_spanning_packets);
+    tcase_add_test(tc_core, test_bad_crc);
+    tcase_add_test(tc_core, test_lost_packet);
+    tcase_add_test(tc_core, test_section_table);
+    tcase_add_test(tc_core, test_section_table_fingerprint);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,330 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "segment_reader.h"
+#include "test_common.h"
+
+#define NUM_PACKETS 10000
+
+static void write_packet(uint8_t* packet, size_t packet_num)
+{
+    memset(packet, 0xFF, TS_SIZE);
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = 0x1F;
+    packet[2] = 0xFF;
+    packet[3] = 0x10 | (packet_num & 0x0F);
+}
+
+static char* write_tmp_file(const uint8_t* data, size_t len)
+{
+    char* file_name = NULL;
+    int fd = g_file_open_tmp("segment_reader_XXXXXX.ts", &file_name, NULL);
+    ck_assert_int_ne(fd, -1);
+    close(fd);
+    ck_assert(g_file_set_contents(file_name, (const gchar*)data, len, NULL));
+    return file_name;
+}
+
+/* Writes NUM_PACKETS null packets with incrementing continuity counters to a temporary file. If bad_packet is less
+ * than NUM_PACKETS, that packet gets an adaptation field that can't be parsed. */
+static char* write_ts_file(size_t bad_packet)
+{
+    uint8_t* data = g_new(uint8_t, NUM_PACKETS * TS_SIZE);
+    for (size_t i = 0; i < NUM_PACKETS; ++i) {
+        uint8_t* packet = data + i * TS_SIZE;
+        write_packet(packet, i);
+        if (i == bad_packet) {
+            /* stuffing bytes have to be 0xFF */
+            packet[3] |= 0x20;
+            packet[4] = 2;
+            packet[5] = 0;
+            packet[6] = 0;
+        }
+    }
+    char* file_name = write_tmp_file(data, NUM_PACKETS * TS_SIZE);
+    g_free(data);
+    return file_name;
+}
+
+static uint64_t read_all(segment_reader_t* reader, uint64_t first_packet)
+{
+    uint64_t packet_num = first_packet;
+    ts_packet_t* packets;
+    size_t num_packets;
+    while ((packets = segment_reader_next(reader, &num_packets)) != NULL) {
+        ck_assert_uint_gt(num_packets, 0);
+        ck_assert_uint_le(num_packets, SEGMENT_READER_BLOCK_PACKETS);
+        for (size_t i = 0; i < num_packets; ++i, ++packet_num) {
+            ck_assert_uint_eq(packets[i].pid, PID_NULL);
+            ck_assert_uint_eq(packets[i].continuity_counter, packet_num & 0x0F);
+            ck_assert_uint_eq(packets[i].pos_in_stream, (packet_num - first_packet) * TS_SIZE);
+        }
+    }
+    return packet_num - first_packet;
+}
+
+static void test_read(unsigned depth)
+{
+    segment_reader_pipeline_depth = depth;
+    char* file_name = write_ts_file(NUM_PACKETS);
+
+    segment_reader_t* reader = segment_reader_new(file_name, 0, 0);
+    ck_assert_ptr_ne(reader, NULL);
+    ck_assert_uint_eq(read_all(reader, 0), NUM_PACKETS);
+    ck_assert(!reader->error);
+    ck_assert(!reader->parse_error);
+    segment_reader_free(reader);
+
+    reader = segment_reader_new(file_name, 10 * TS_SIZE, 5010 * TS_SIZE);
+    ck_assert_ptr_ne(reader, NULL);
+    ck_assert_uint_eq(read_all(reader, 10), 5000);
+    ck_assert(!reader->error);
+    segment_reader_free(reader);
+
+    remove(file_name);
+    g_free(file_name);
+}
+
+static void test_parse_error(unsigned depth)
+{
+    segment_reader_pipeline_depth = depth;
+    char* file_name = write_ts_file(5000);
+
+    segment_reader_t* reader = segment_reader_new(file_name, 0, 0);
+    ck_assert_ptr_ne(reader, NULL);
+    ck_assert_uint_eq(read_all(reader, 0), 5000);
+    ck_assert(reader->parse_error);
+    ck_assert_uint_eq(reader->error_packet, 5000);
+    ck_assert_ptr_eq(segment_reader_next(reader, &(size_t){0}), NULL);
+    segment_reader_free(reader);
+
+    remove(file_name);
+    g_free(file_name);
+}
+
+START_TEST(test_segment_reader_sequential)
+    test_read(0);
+END_TEST
+
+START_TEST(test_segment_reader_pipelined)
+    test_read(1);
+    test_read(3);
+END_TEST
+
+START_TEST(test_segment_reader_parse_error_sequential)
+    test_parse_error(0);
+END_TEST
+
+START_TEST(test_segment_reader_parse_error_pipelined)
+    test_parse_error(2);
+END_TEST
+
+/* Junk before the first packet, and in the middle of a block, including sync bytes that don't repeat */
+static void test_resync(unsigned depth)
+{
+    segment_reader_pipeline_depth = depth;
+    const size_t junk_start = 3;
+    const size_t junk_len = 300;
+    const size_t junk_packet = 5000;
+    size_t len = NUM_PACKETS * TS_SIZE + junk_start + junk_len;
+    uint8_t* data = g_new(uint8_t, len);
+    memset(data, 0, len);
+    data[1] = TS_SYNC_BYTE;
+    uint8_t* packet = data + junk_start;
+    for (size_t i = 0; i < NUM_PACKETS; ++i, packet += TS_SIZE) {
+        if (i == junk_packet) {
+            packet[10] = TS_SYNC_BYTE;
+            packet[10 + TS_SIZE] = TS_SYNC_BYTE;
+            packet += junk_len;
+        }
+        write_packet(packet, i);
+    }
+    char* file_name = write_tmp_file(data, len);
+    g_free(data);
+
+    segment_reader_t* reader = segment_reader_new(file_name, 0, 0);
+    ck_assert_ptr_ne(reader, NULL);
+    uint64_t packet_num = 0;
+    ts_packet_t* packets;
+    size_t num_packets;
+    while ((packets = segment_reader_next(reader, &num_packets)) != NULL) {
+        for (size_t i = 0; i < num_packets; ++i, ++packet_num) {
+            ck_assert_uint_eq(packets[i].continuity_counter, packet_num & 0x0F);
+            uint64_t skipped = junk_start + (packet_num >= junk_packet ? junk_len : 0);
+            ck_assert_uint_eq(packets[i].pos_in_stream, packet_num * TS_SIZE + skipped);
+        }
+        ck_assert_uint_eq(reader->sync_gaps->len, packet_num > junk_packet ? 2 : 1);
+    }
+    ck_assert_uint_eq(packet_num, NUM_PACKETS);
+    ck_assert(!reader->error);
+    ck_assert(!reader->parse_error);
+
+    segment_sync_gap_t* gap = &g_array_index(reader->sync_gaps, segment_sync_gap_t, 0);
+    ck_assert_uint_eq(gap->offset, 0);
+    ck_assert_uint_eq(gap->length, junk_start);
+    gap = &g_array_index(reader->sync_gaps, segment_sync_gap_t, 1);
+    ck_assert_uint_eq(gap->offset, junk_start + junk_packet * TS_SIZE);
+    ck_assert_uint_eq(gap->length, junk_len);
+    segment_reader_free(reader);
+
+    remove(file_name);
+    g_free(file_name);
+}
+
+START_TEST(test_segment_reader_resync_sequential)
+    test_resync(0);
+END_TEST
+
+START_TEST(test_segment_reader_resync_pipelined)
+    test_resync(2);
+END_TEST
+
+/* Blocks parsed on several threads still come out in order */
+START_TEST(test_segment_reader_parser_threads)
+    segment_reader_parser_threads = 3;
+    test_read(1);
+    test_read(5);
+    test_parse_error(2);
+    test_resync(4);
+    segment_reader_parser_threads = 1;
+END_TEST
+
+START_TEST(test_segment_reader_free_early)
+    segment_reader_pipeline_depth = 2;
+    char* file_name = write_ts_file(NUM_PACKETS);
+
+    segment_reader_t* reader = segment_reader_new(file_name, 0, 0);
+    ck_assert_ptr_ne(reader, NULL);
+    size_t num_packets;
+    ck_assert_ptr_ne(segment_reader_next(reader, &num_packets), NULL);
+    segment_reader_free(reader);
+
+    remove(file_name);
+    g_free(file_name);
+END_TEST
+
+START_TEST(test_segment_reader_stats)
+    segment_reader_pipeline_depth = 0;
+    char* file_name = write_ts_file(NUM_PACKETS);
+
+    segment_reader_stats_t before;
+    segment_reader_get_stats(&before);
+    segment_reader_t* reader = segment_reader_new(file_name, 0, 0);
+    ck_assert_uint_eq(read_all(reader, 0), NUM_PACKETS);
+    segment_reader_free(reader);
+
+    segment_reader_stats_t after;
+    segment_reader_get_stats(&after);
+    ck_assert_uint_eq(after.segments_read - before.segments_read, 1);
+    ck_assert_uint_eq(after.bytes_read - before.bytes_read, NUM_PACKETS * TS_SIZE);
+    ck_assert_int_ge(after.stall_time, before.stall_time);
+
+    remove(file_name);
+    g_free(file_name);
+END_TEST
+
+START_TEST(test_segment_prefetcher)
+    char* file_name = write_ts_file(NUM_PACKETS);
+    GPtrArray* segments = g_ptr_array_new_with_free_func((GDestroyNotify)segment_free);
+    for (size_t i = 0; i < 5; ++i) {
+        segment_t* segment = segment_new(NULL);
+        segment->file_name = g_strdup(file_name);
+        segment->media_range_start = i * 1000 * TS_SIZE;
+        segment->media_range_end = (i + 1) * 1000 * TS_SIZE - 1;
+        g_ptr_array_add(segments, segment);
+    }
+
+    segment_reader_stats_t before;
+    segment_reader_stats_t after;
+    segment_reader_get_stats(&before);
+
+    segment_prefetch_depth = 0;
+    segment_prefetcher_t* prefetcher = segment_prefetcher_new(segments);
+    segment_prefetcher_advance(prefetcher, 0);
+    segment_reader_get_stats(&after);
+    ck_assert_uint_eq(after.segments_prefetched, before.segments_prefetched);
+    segment_prefetcher_free(prefetcher);
+
+    /* Each segment is only read ahead once */
+    segment_prefetch_depth = 2;
+    prefetcher = segment_prefetcher_new(segments);
+    segment_prefetcher_advance(prefetcher, 0);
+    segment_reader_get_stats(&after);
+    ck_assert_uint_eq(after.segments_prefetched - before.segments_prefetched, 3);
+    ck_assert_uint_eq(after.bytes_prefetched - before.bytes_prefetched, 3000 * TS_SIZE);
+    segment_prefetcher_advance(prefetcher, 1);
+    segment_reader_get_stats(&after);
+    ck_assert_uint_eq(after.segments_prefetched - before.segments_prefetched, 4);
+    segment_prefetcher_advance(prefetcher, 4);
+    segment_prefetcher_advance(prefetcher, 4);
+    segment_reader_get_stats(&after);
+    ck_assert_uint_eq(after.segments_prefetched - before.segments_prefetched, 5);
+    segment_prefetcher_free(prefetcher);
+
+    g_ptr_array_free(segments, true);
+    remove(file_name);
+    g_free(file_name);
+END_TEST
+
+START_TEST(test_segment_reader_missing_file)
+    segment_reader_pipeline_depth = 2;
+    ck_assert_ptr_eq(segment_reader_new("tests/does-not-exist.ts", 0, 0), NULL);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Segment Reader");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_segment_reader_sequential);
+    tcase_add_test(tc_core, test_segment_reader_pipelined);
+    tcase_add_test(tc_core, test_segment_reader_parse_error_sequential);
+    tcase_add_test(tc_core, test_segment_reader_parse_error_pipelined);
+    tcase_add_test(tc_core, test_segment_reader_resync_sequential);
+    tcase_add_test(tc_core, test_segment_reader_resync_pipelined);
+    tcase_add_test(tc_core, test_segment_reader_parser_threads);
+    tcase_add_test(tc_core, test_segment_reader_free_early);
+    tcase_add_test(tc_core, test_segment_reader_stats);
+    tcase_add_test(tc_core, test_segment_prefetcher);
+    tcase_add_test(tc_core, test_segment_reader_missing_file);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,114 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <check.h>
+#include <glib.h>
+#include <libxml/xmlstring.h>
+
+#include "segment_summary.h"
+#include "test_common.h"
+
+static representation_t* make_representation(const char* id)
+{
+    representation_t* representation = representation_new(NULL);
+    representation->id = (char*)xmlCharStrdup(id);
+    return representation;
+}
+
+static void add_segment(representation_t* representation, uint64_t start, uint64_t end, bool is_encrypted)
+{
+    segment_t* segment = segment_new(representation);
+    segment->file_name = g_strdup_printf("%s-%u.ts", representation->id, representation->segments->len);
+    segment->actual_start[VIDEO_CONTENT_COMPONENT] = start;
+    segment->actual_end[VIDEO_CONTENT_COMPONENT] = end;
+
+    segment_summary_t* summary = g_slice_new0(segment_summary_t);
+    summary->is_encrypted = is_encrypted;
+    summary->splice_points = g_array_new(false, false, sizeof(uint64_t));
+    segment->arg = summary;
+    segment->arg_free = (free_func_t)segment_summary_free;
+    g_ptr_array_add(representation->segments, segment);
+}
+
+START_TEST(test_representation_gaps)
+    GPtrArray* representations = g_ptr_array_new_with_free_func((GDestroyNotify)representation_free);
+    representation_t* a = make_representation("a");
+    representation_t* b = make_representation("b");
+    g_ptr_array_add(representations, a);
+    g_ptr_array_add(representations, b);
+    add_segment(a, 0, 90000, false);
+    add_segment(a, 90000, 180000, false);
+    add_segment(b, 0, 90000, false);
+    add_segment(b, 90000, 180000, false);
+    ck_assert_int_eq(check_representation_gaps(representations, VIDEO_CONTENT_COMPONENT, 0), 1);
+
+    /* b's second segment starts late, compared to the first segment of both */
+    segment_t* segment = g_ptr_array_index(b->segments, 1);
+    segment->actual_start[VIDEO_CONTENT_COMPONENT] = 90100;
+    ck_assert_int_eq(check_representation_gaps(representations, VIDEO_CONTENT_COMPONENT, 100), 1);
+    ck_assert_int_eq(check_representation_gaps(representations, VIDEO_CONTENT_COMPONENT, 99), 0);
+
+    g_ptr_array_free(representations, true);
+END_TEST
+
+START_TEST(test_representation_gaps_encrypted)
+    GPtrArray* representations = g_ptr_array_new_with_free_func((GDestroyNotify)representation_free);
+    representation_t* a = make_representation("a");
+    g_ptr_array_add(representations, a);
+
+    /* The timing of encrypted segments isn't known, so gaps to or from them aren't checked */
+    add_segment(a, 0, 90000, false);
+    add_segment(a, 180000, 270000, true);
+    add_segment(a, 270000, 360000, false);
+    ck_assert_int_eq(check_representation_gaps(representations, VIDEO_CONTENT_COMPONENT, 0), 1);
+
+    /* Unless they were decrypted */
+    segment_summary_t* summary = ((segment_t*)g_ptr_array_index(a->segments, 1))->arg;
+    summary->is_encrypted = false;
+    ck_assert_int_eq(check_representation_gaps(representations, VIDEO_CONTENT_COMPONENT, 0), 0);
+
+    g_ptr_array_free(representations, true);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Segment Summary");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_representation_gaps);
+    tcase_add_test(tc_core, test_representation_gaps_encrypted);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
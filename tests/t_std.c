@@ -0,0 +1,244 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <check.h>
+#include <glib.h>
+#include <string.h>
+
+#include "psi.h"
+#include "t_std.h"
+#include "test_common.h"
+
+
+#define AUDIO_PID 257
+/* 1 Mbit/s */
+#define TICKS_PER_BYTE 216
+
+static uint64_t first_pcr = 27000000;
+
+/* Makes a packet with a full payload. If pts isn't negative, the packet starts a PES packet with that PTS. */
+static void make_packet(ts_packet_t* ts, uint64_t offset, int64_t pts)
+{
+    memset(ts, 0, sizeof(*ts));
+    ts->pid = AUDIO_PID;
+    ts->has_payload = true;
+    ts->payload_len = TS_SIZE - 4;
+    ts->pos_in_stream = offset;
+    if (pts >= 0) {
+        uint8_t header[] = {0, 0, 1, 0xC0, 0, 0, 0x80, 0x80, 5,
+                0x21 | ((pts >> 29) & 0x0E), (pts >> 22) & 0xFF, ((pts >> 14) & 0xFE) | 1, (pts >> 7) & 0xFF,
+                ((pts << 1) & 0xFE) | 1};
+        memcpy(ts->payload, header, sizeof(header));
+        ts->payload_unit_start_indicator = true;
+    }
+}
+
+static uint64_t arrival_time(uint64_t offset, uint64_t ticks_per_byte)
+{
+    return (first_pcr + offset * ticks_per_byte) % PCR_ROLLOVER;
+}
+
+/* Sends num_packets audio packets with a PCR before every 10th, starting a PES packet every 4 packets. Each PES
+ * packet's PTS is pts_delay (90 kHz) after its first packet arrives, or late_pts for the PES packet at late_pes. */
+static void run_stream(t_std_t* t_std, t_std_es_t* es, size_t num_packets, uint64_t ticks_per_byte,
+        uint64_t pts_delay, size_t late_pes, int64_t late_pts)
+{
+    for (size_t i = 0; i < num_packets; ++i) {
+        uint64_t offset = i * TS_SIZE;
+        if (i % 10 == 0) {
+            t_std_pcr(t_std, arrival_time(offset, ticks_per_byte), offset, false);
+        }
+        int64_t pts = -1;
+        if (i % 4 == 0) {
+            pts = i / 4 == late_pes ? late_pts
+                    : (int64_t)((arrival_time(offset, ticks_per_byte) / 300 + pts_delay) % PTS_ROLLOVER);
+        }
+        ts_packet_t ts;
+        make_packet(&ts, offset, pts);
+        t_std_add_ts_packet(t_std, es, &ts);
+    }
+    t_std_flush(t_std);
+}
+
+START_TEST(test_t_std_params)
+    t_std_params_t params;
+    ck_assert(t_std_params_for_stream_type(STREAM_TYPE_MPEG2_AAC, &params));
+    ck_assert_uint_eq(params.rbx, 0);
+    ck_assert(t_std_params_for_stream_type(STREAM_TYPE_AVC, &params));
+    ck_assert_uint_gt(params.rbx, 0);
+    ck_assert_uint_gt(params.rx, params.rbx);
+    ck_assert_uint_gt(params.mb_size, 0);
+    ck_assert(!t_std_params_for_stream_type(STREAM_TYPE_SCTE35, &params));
+    ck_assert_ptr_eq(t_std_es_new(AUDIO_PID, STREAM_TYPE_SCTE35), NULL);
+END_TEST
+
+START_TEST(test_t_std_valid)
+    t_std_t* t_std = t_std_new();
+    t_std_es_t* es = t_std_es_new(AUDIO_PID, STREAM_TYPE_MPEG2_AAC);
+    ck_assert_ptr_ne(es, NULL);
+
+    /* 20 ms after each PES packet starts arriving, so about 2.5 KB is buffered */
+    run_stream(t_std, es, 200, TICKS_PER_BYTE, 1800, SIZE_MAX, 0);
+    ck_assert_uint_eq(t_std->errors->len, 0);
+
+    t_std_es_free(es);
+    t_std_free(t_std);
+END_TEST
+
+START_TEST(test_t_std_eb_underflow)
+    t_std_t* t_std = t_std_new();
+    t_std_es_t* es = t_std_es_new(AUDIO_PID, STREAM_TYPE_MPEG2_AAC);
+
+    /* Packets arrive every 135 (90 kHz) ticks, so PES packets are due just after their last packet arrives. PES packet
+     * 10 starts at packet 40, and is due before its second packet arrives. */
+    uint64_t late_offset = 40 * TS_SIZE;
+    int64_t late_pts = arrival_time(late_offset + TS_SIZE, TICKS_PER_BYTE) / 300 + 100;
+    run_stream(t_std, es, 200, TICKS_PER_BYTE, 600, 10, late_pts);
+    ck_assert_uint_eq(t_std->errors->len, 1);
+    t_std_error_t* error = &g_array_index(t_std->errors, t_std_error_t, 0);
+    ck_assert(error->underflow);
+    ck_assert_int_eq(error->buffer, T_STD_EB);
+    ck_assert_uint_eq(error->pid, AUDIO_PID);
+    ck_assert_uint_eq(error->offset, late_offset);
+    ck_assert_uint_eq(error->dts, late_pts);
+    ck_assert_uint_eq(error->size, TS_SIZE - 4);
+    ck_assert_uint_eq(error->fullness, TS_SIZE - 4);
+
+    t_std_es_free(es);
+    t_std_free(t_std);
+END_TEST
+
+START_TEST(test_t_std_rollover)
+    t_std_t* t_std = t_std_new();
+    t_std_es_t* es = t_std_es_new(AUDIO_PID, STREAM_TYPE_MPEG2_AAC);
+
+    /* The PCR and PTS wrap around 50 ms in */
+    first_pcr = PCR_ROLLOVER - 27000000 / 20;
+    run_stream(t_std, es, 200, TICKS_PER_BYTE, 1800, SIZE_MAX, 0);
+    ck_assert(t_std->has_clock);
+    ck_assert_uint_eq(t_std->errors->len, 0);
+
+    /* and underflows after it are still found */
+    t_std_reset(t_std);
+    uint64_t late_offset = 40 * TS_SIZE;
+    int64_t late_pts = arrival_time(late_offset + TS_SIZE, TICKS_PER_BYTE) / 300 + 100;
+    ck_assert_int_lt(late_pts, 90000);
+    run_stream(t_std, es, 200, TICKS_PER_BYTE, 600, 10, late_pts);
+    ck_assert_uint_eq(t_std->errors->len, 1);
+    t_std_error_t* error = &g_array_index(t_std->errors, t_std_error_t, 0);
+    ck_assert(error->underflow);
+    ck_assert_uint_eq(error->offset, late_offset);
+    ck_assert_uint_eq(error->dts, late_pts);
+    first_pcr = 27000000;
+
+    t_std_es_free(es);
+    t_std_free(t_std);
+END_TEST
+
+START_TEST(test_t_std_tb_overflow)
+    t_std_t* t_std = t_std_new();
+    t_std_es_t* es = t_std_es_new(AUDIO_PID, STREAM_TYPE_MPEG2_AAC);
+
+    /* 216 Mbit/s is much faster than TB leaks */
+    run_stream(t_std, es, 20, 1, 1800, SIZE_MAX, 0);
+    ck_assert_uint_eq(t_std->errors->len, 1);
+    t_std_error_t* error = &g_array_index(t_std->errors, t_std_error_t, 0);
+    ck_assert(!error->underflow);
+    ck_assert_int_eq(error->buffer, T_STD_TB);
+    ck_assert_uint_eq(error->offset, 2 * TS_SIZE);
+    ck_assert_uint_eq(error->size, T_STD_TB_SIZE);
+    ck_assert_uint_gt(error->fullness, T_STD_TB_SIZE);
+
+    t_std_es_free(es);
+    t_std_free(t_std);
+END_TEST
+
+START_TEST(test_t_std_eb_overflow)
+    t_std_t* t_std = t_std_new();
+    t_std_es_t* es = t_std_es_new(AUDIO_PID, STREAM_TYPE_MPEG2_AAC);
+
+    /* Each PES packet waits 10 seconds */
+    run_stream(t_std, es, 200, TICKS_PER_BYTE, 900000, SIZE_MAX, 0);
+    ck_assert_uint_eq(t_std->errors->len, 1);
+    t_std_error_t* error = &g_array_index(t_std->errors, t_std_error_t, 0);
+    ck_assert(!error->underflow);
+    ck_assert_int_eq(error->buffer, T_STD_EB);
+    ck_assert_uint_eq(error->size, 8976);
+    /* 8976 bytes is about 49 packets of payload */
+    ck_assert_uint_ge(error->offset, 48 * TS_SIZE);
+    ck_assert_uint_le(error->offset, 52 * TS_SIZE);
+
+    t_std_es_free(es);
+    t_std_free(t_std);
+END_TEST
+
+START_TEST(test_t_std_no_clock)
+    t_std_t* t_std = t_std_new();
+    t_std_es_t* es = t_std_es_new(AUDIO_PID, STREAM_TYPE_MPEG2_AAC);
+
+    /* Without a PCR, packets can't be timed */
+    for (size_t i = 0; i < 20; ++i) {
+        ts_packet_t ts;
+        make_packet(&ts, i * TS_SIZE, i % 4 == 0 ? 0 : -1);
+        t_std_add_ts_packet(t_std, es, &ts);
+    }
+    t_std_flush(t_std);
+    ck_assert_uint_eq(t_std->errors->len, 0);
+    ck_assert(!es->started);
+
+    /* A PCR discontinuity starts the model again */
+    run_stream(t_std, es, 20, 1, 1800, SIZE_MAX, 0);
+    ck_assert_uint_eq(t_std->errors->len, 1);
+    t_std_pcr(t_std, 0, 100 * TS_SIZE, true);
+    ck_assert(!t_std->has_clock);
+    ck_assert_uint_ne(es->generation, t_std->generation);
+
+    t_std_es_free(es);
+    t_std_free(t_std);
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("T-STD");
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_t_std_params);
+    tcase_add_test(tc_core, test_t_std_valid);
+    tcase_add_test(tc_core, test_t_std_eb_underflow);
+    tcase_add_test(tc_core, test_t_std_rollover);
+    tcase_add_test(tc_core, test_t_std_tb_overflow);
+    tcase_add_test(tc_core, test_t_std_eb_overflow);
+    tcase_add_test(tc_core, test_t_std_no_clock);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -28,6 +28,7 @@
  */
 #include <check.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ts.h"
 #include "test_common.h"
@@ -165,6 +166,75 @@ START_TEST(test_read_ts_with_adaptation_field)
     ck_assert_uint_eq(af->program_clock_reference, 810000000);
 END_TEST
 
+START_TEST(test_read_ts_headers)
+    uint8_t bytes[TS_SIZE * 4];
+    memset(bytes, 0xFF, sizeof(bytes));
+    uint8_t headers_bytes[][4] = {
+        {71, 64, 0, 22},
+        {71, 159, 255, 31},
+        {71, 33, 0, 0xA5},
+        {0, 0, 0, 0}
+    };
+    for (size_t i = 0; i < 4; ++i) {
+        memcpy(bytes + i * TS_SIZE, headers_bytes[i], 4);
+    }
+    /* adaptation_field_length = 1, discontinuity_indicator = 1 */
+    bytes[2 * TS_SIZE + 4] = 1;
+    bytes[2 * TS_SIZE + 5] = 0x80;
+
+    ts_headers_t* headers = ts_headers_new(8);
+    ck_assert_uint_eq(ts_headers_read(headers, bytes, 4), 3);
+    ck_assert_uint_eq(headers->len, 3);
+
+    ck_assert_uint_eq(headers->pid[0], 0);
+    ck_assert(headers->payload_unit_start_indicator[0]);
+    ck_assert(!headers->transport_error_indicator[0]);
+    ck_assert_uint_eq(headers->transport_scrambling_control[0], 0);
+    ck_assert_uint_eq(headers->adaptation_field_control[0], TS_PAYLOAD);
+    ck_assert_uint_eq(headers->continuity_counter[0], 6);
+    ck_assert(!headers->discontinuity_indicator[0]);
+
+    ck_assert_uint_eq(headers->pid[1], PID_NULL);
+    ck_assert(!headers->payload_unit_start_indicator[1]);
+    ck_assert(headers->transport_error_indicator[1]);
+    ck_assert_uint_eq(headers->adaptation_field_control[1], TS_PAYLOAD);
+    ck_assert_uint_eq(headers->continuity_counter[1], 15);
+    ck_assert(!headers->discontinuity_indicator[1]);
+
+    ck_assert_uint_eq(headers->pid[2], 256);
+    ck_assert(!headers->payload_unit_start_indicator[2]);
+    ck_assert_uint_eq(headers->transport_scrambling_control[2], 2);
+    ck_assert_uint_eq(headers->adaptation_field_control[2], TS_ADAPTATION_FIELD);
+    ck_assert_uint_eq(headers->continuity_counter[2], 5);
+    ck_assert(headers->discontinuity_indicator[2]);
+
+    /* Never reads past capacity */
+    ts_headers_t* small = ts_headers_new(2);
+    ck_assert_uint_eq(ts_headers_read(small, bytes, 4), 2);
+    ts_headers_free(small);
+
+    ts_headers_free(headers);
+END_TEST
+
+START_TEST(test_find_sync)
+    uint8_t bytes[TS_SIZE * 4];
+    memset(bytes, 0, sizeof(bytes));
+
+    ck_assert_uint_eq(ts_find_sync(bytes, sizeof(bytes), 3), sizeof(bytes));
+
+    /* Needs a sync byte every TS_SIZE bytes */
+    bytes[5] = TS_SYNC_BYTE;
+    bytes[20] = TS_SYNC_BYTE;
+    bytes[20 + TS_SIZE] = TS_SYNC_BYTE;
+    bytes[20 + TS_SIZE * 2] = TS_SYNC_BYTE;
+    ck_assert_uint_eq(ts_find_sync(bytes, sizeof(bytes), 3), 20);
+    ck_assert_uint_eq(ts_find_sync(bytes, sizeof(bytes), 1), 5);
+
+    /* Near the end of the buffer, whatever packets fit are enough */
+    ck_assert_uint_eq(ts_find_sync(bytes + 30, 400, 3), 20 + TS_SIZE - 30);
+    ck_assert_uint_eq(ts_find_sync(bytes, 25 + TS_SIZE, 3), 20);
+END_TEST
+
 Suite *suite(void)
 {
     Suite *s;
@@ -179,6 +249,8 @@ Suite *suite(void)
     tcase_add_test(tc_core, test_read_ts_too_short);
     tcase_add_test(tc_core, test_read_ts_too_long);
     tcase_add_test(tc_core, test_read_ts_with_adaptation_field);
+    tcase_add_test(tc_core, test_read_ts_headers);
+    tcase_add_test(tc_core, test_find_sync);
 
     suite_add_tcase(s, tc_core);
 
@@ -26,54 +26,316 @@
  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
 #include <inttypes.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <getopt.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <libxml/parser.h>
 #include "log.h"
 
+#include "file_cache.h"
+#include "json.h"
+#include "segment_reader.h"
+#include "segment_summary.h"
 #include "segment_validator.h"
 #include "mpd.h"
 
 
-int check_representation_gaps(GPtrArray* representations, content_component_t, int64_t max_delta);
 int check_segment_timing(GPtrArray* segments, content_component_t);
+int check_splice_points(GPtrArray* segments);
 bool check_segment_psi_identical(const char* file_name1, dash_validator_t*, const char* file_name2, dash_validator_t*);
+bool check_segment_summary_psi_identical(const char* file_name1, segment_summary_t*, const char* file_name2,
+        segment_summary_t*);
 bool check_psi_identical(GPtrArray* representations);
+bool check_bitstream_switching(GPtrArray* representations);
+bool check_adaptation_set_mime_type(adaptation_set_t*);
+bool check_representation_mime_type(representation_t*);
+int validate_mpd(char* file_name, GHashTable* worker_results, bool* completed);
+bool validate_representation_start(representation_t*, adaptation_set_t*, dash_validator_t** validator_init_segment);
+bool validate_representation_segment(representation_t*, adaptation_set_t*, segment_t*,
+        dash_validator_t* validator_init_segment);
+int validate_single_segment(char* file_name, char* initialization_file_name);
+void print_to_report(const gchar*);
+bool read_line(FILE*, GString* line);
+
+/* Seconds a client can leave its results unread before we stop sending them, so it doesn't hold up jobs from other
+ * clients */
+#define DAEMON_SEND_TIMEOUT 10
+
+typedef struct {
+    int fd;
+    GThreadPool* pool;
+    bool failed; /* the client went away or stopped reading */
+    GMutex mutex; /* for writing */
+    volatile gint refcount; /* the connection's thread and each job that hasn't finished */
+} daemon_connection_t;
+
+/* Where a job's output goes. Batch jobs save everything to print at the end, and daemon jobs send each print as an
+ * NDJSON record as soon as it happens. */
+typedef struct {
+    GString* buffer;
+    daemon_connection_t* connection;
+    gchar* id; /* JSON value identifying the daemon job */
+} report_t;
+
+typedef struct {
+    char* file_name;
+    size_t index;
+    bool passed;
+} batch_job_t;
+
+typedef struct {
+    const char* report_dir;
+    GMutex mutex; /* for stdout */
+} batch_t;
+
+void validate_batch_job(gpointer data, gpointer user_data);
+int validate_batch(const char* list_file_name, const char* report_dir, unsigned jobs);
+
+typedef struct {
+    daemon_connection_t* connection;
+    gchar* id;
+    gchar* mpd_file_name;
+    gchar* segment_file_name;
+    gchar* initialization_file_name;
+} daemon_job_t;
+
+daemon_connection_t* daemon_connection_new(int fd, GThreadPool*);
+void daemon_connection_unref(daemon_connection_t*);
+void daemon_send(daemon_connection_t*, const char* type, const char* id, const char* key, const char* value);
+daemon_job_t* daemon_job_new(daemon_connection_t*, const char* request, size_t request_num, GString* error);
+void daemon_job_free(daemon_job_t*);
+void run_daemon_job(gpointer data, gpointer user_data);
+gpointer daemon_connection_thread(gpointer);
+int run_daemon(const char* socket_path, unsigned jobs);
+
+int run_worker(char* file_name, unsigned shard, unsigned num_shards);
+void send_worker_result(const char* key, bool passed, segment_t*, const GString* text);
+gpointer read_worker_output(gpointer);
+bool add_worker_result(GHashTable* worker_results, const char* line, const char* name);
+bool use_worker_result(GHashTable* worker_results, const char* key, const char* name, segment_t*);
+int validate_sharded(char* file_name, const char* program_name, unsigned num_shards, bool* completed);
+int merge_worker_results(char* file_name, char** result_file_names, size_t num_result_files, bool* completed);
+
+typedef struct {
+    FILE* file;
+    GPtrArray* lines;
+} worker_output_t;
+
+static GPrivate current_report = G_PRIVATE_INIT(NULL);
+
+/* --keys, to pass on to workers */
+static const char* key_file_name = NULL;
+/* --reuse-frame-index */
+static bool reuse_frame_index = false;
+
+#define MAX_LIST_LINE 4096
 
 static struct option long_options[] = {
     { "verbose", no_argument, NULL, 'v' },
+    { "pipeline", optional_argument, NULL, 'p' },
+    { "parser-threads", required_argument, NULL, 'P' },
+    { "read-ahead", required_argument, NULL, 'a' },
+    { "max-open-files", required_argument, NULL, 'f' },
+    { "pid-threads", required_argument, NULL, 'j' },
+    { "keys", required_argument, NULL, 'k' },
+    { "frame-index", no_argument, NULL, 'i' },
+    { "reuse-frame-index", no_argument, NULL, 'R' },
+    { "batch", required_argument, NULL, 'b' },
+    { "jobs", required_argument, NULL, 'J' },
+    { "report-dir", required_argument, NULL, 'r' },
+    { "daemon", required_argument, NULL, 'd' },
+    { "shards", required_argument, NULL, 'S' },
+    { "worker", required_argument, NULL, 'w' },
+    { "merge", no_argument, NULL, 'm' },
     { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
 };
 
 static char options[] =
     "\t-v, --verbose\n"
+    "\t-p, --pipeline[=DEPTH]    read and parse segments in separate threads, with DEPTH blocks in flight "
+    "(default 4)\n"
+    "\t-P, --parser-threads=N     parse TS packets on N threads (implies --pipeline)\n"
+    "\t-a, --read-ahead=SEGMENTS  ask the OS to start reading up to SEGMENTS segments ahead of the one being "
+    "validated\n"
+    "\t-f, --max-open-files=N     keep at most N unused segment files open (default 32)\n"
+    "\t-j, --pid-threads=N        validate PES packets for different PIDs and subsegments on up to N threads\n"
+    "\t-k, --keys=FILE            decrypt CETS encrypted segments with the keys in FILE (one KID:KEY in hex per line) "
+    "and validate their PES packets too (--pid-threads is ignored)\n"
+    "\t-i, --frame-index          write an index of each media segment's PES packets to SEGMENT.fidx (or "
+    "SEGMENT.START-END.fidx for a mediaRange)\n"
+    "\t-R, --reuse-frame-index    don't read media segments again if they passed when their --frame-index was "
+    "written and only the MPD's timing or @startWithSAP changed since\n"
+    "\t-b, --batch=LIST           validate every MPD listed in the file LIST (- for stdin), one per line\n"
+    "\t-J, --jobs=N               with --batch, validate up to N MPDs at once (default: number of processors)\n"
+    "\t-r, --report-dir=DIR       with --batch, write each MPD's report to DIR instead of stdout\n"
+    "\t-d, --daemon=SOCKET        accept jobs on the Unix domain socket SOCKET and send NDJSON results back, "
+    "running up to --jobs of them at once\n"
+    "\t-S, --shards=N             split the MPD's segments between N worker processes, and check the results across "
+    "segments and Representations here\n"
+    "\t-w, --worker=K/N           validate the K-th (from 0) of N shards of the MPD's segments, and write the results "
+    "to stdout for --merge\n"
+    "\t-m, --merge                check the results that --worker processes wrote to the files after the MPD\n"
     "\t-h, --help\n";
 
 static void usage(char* name)
 {
-    fprintf(stderr, "Usage: \n%s [options] MPD_file\n\nOptions:\n%s\n", name,
-            options);
+    fprintf(stderr, "Usage: \n%s [options] MPD_file\n%s [options] --batch=LIST\n%s [options] --daemon=SOCKET\n"
+            "%s [options] --merge MPD_file WORKER_RESULTS...\n\nOptions:\n%s\n",
+            name, name, name, name, options);
 }
 
 int main(int argc, char* argv[])
 {
     int c, long_options_index;
+    char* batch_file_name = NULL;
+    char* report_dir = NULL;
+    char* socket_path = NULL;
+    unsigned num_shards = 0;
+    unsigned worker_shard = 0;
+    unsigned worker_num_shards = 0;
+    bool merge = false;
+    unsigned jobs = g_get_num_processors();
 
     if(argc < 2) {
         usage(argv[0]);
         return 1;
     }
 
-    while((c = getopt_long(argc, argv, "vh", long_options, &long_options_index)) != -1) {
+    while((c = getopt_long(argc, argv, "vp::P:a:f:j:k:iRb:J:r:d:S:w:mh", long_options, &long_options_index)) != -1) {
         switch(c) {
         case 'v':
             if(tslib_loglevel < TSLIB_LOG_LEVEL_DEBUG) {
                 tslib_loglevel++;
             }
             break;
+        case 'p':
+            segment_reader_pipeline_depth = 4;
+            if (optarg) {
+                char* end;
+                unsigned long depth = strtoul(optarg, &end, 10);
+                if (*end != 0 || depth == 0 || depth > 64) {
+                    fprintf(stderr, "Invalid pipeline depth: %s\n", optarg);
+                    usage(argv[0]);
+                    return 1;
+                }
+                segment_reader_pipeline_depth = depth;
+            }
+            break;
+        case 'P': {
+            char* end;
+            unsigned long threads = strtoul(optarg, &end, 10);
+            if (*end != 0 || threads == 0 || threads > 64) {
+                fprintf(stderr, "Invalid number of parser threads: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            segment_reader_parser_threads = threads;
+            if (segment_reader_pipeline_depth == 0) {
+                segment_reader_pipeline_depth = 4;
+            }
+            break;
+        }
+        case 'a': {
+            char* end;
+            unsigned long depth = strtoul(optarg, &end, 10);
+            if (*end != 0 || depth > 1024) {
+                fprintf(stderr, "Invalid read-ahead depth: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            segment_prefetch_depth = depth;
+            break;
+        }
+        case 'f': {
+            char* end;
+            unsigned long max_open = strtoul(optarg, &end, 10);
+            if (*end != 0 || max_open > 65536) {
+                fprintf(stderr, "Invalid maximum number of open files: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            file_cache_max_open = max_open;
+            break;
+        }
+        case 'j': {
+            char* end;
+            unsigned long threads = strtoul(optarg, &end, 10);
+            if (*end != 0 || threads == 0 || threads > 256) {
+                fprintf(stderr, "Invalid number of PID threads: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            segment_validator_pid_threads = threads;
+            break;
+        }
+        case 'k':
+            key_file_name = optarg;
+            break;
+        case 'i':
+            segment_validator_frame_index = true;
+            break;
+        case 'R':
+            reuse_frame_index = true;
+            break;
+        case 'b':
+            batch_file_name = optarg;
+            break;
+        case 'J': {
+            char* end;
+            unsigned long max_jobs = strtoul(optarg, &end, 10);
+            if (*end != 0 || max_jobs == 0 || max_jobs > 1024) {
+                fprintf(stderr, "Invalid number of jobs: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            jobs = max_jobs;
+            break;
+        }
+        case 'r':
+            report_dir = optarg;
+            break;
+        case 'd':
+            socket_path = optarg;
+            break;
+        case 'S': {
+            char* end;
+            unsigned long shards = strtoul(optarg, &end, 10);
+            if (*end != 0 || shards == 0 || shards > 1024) {
+                fprintf(stderr, "Invalid number of shards: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            num_shards = shards;
+            break;
+        }
+        case 'w': {
+            char* end;
+            unsigned long shard = strtoul(optarg, &end, 10);
+            unsigned long shards = *end == '/' ? strtoul(end + 1, &end, 10) : 0;
+            if (*end != 0 || shards == 0 || shards > 1024 || shard >= shards) {
+                fprintf(stderr, "Invalid worker shard: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            worker_shard = shard;
+            worker_num_shards = shards;
+            break;
+        }
+        case 'm':
+            merge = true;
+            break;
         case 'h':
         default:
             usage(argv[0]);
@@ -83,10 +345,22 @@ int main(int argc, char* argv[])
 
     g_log_set_default_handler(log_handler, NULL);
 
-    int overall_status = 1;    // overall pass/fail, with 1=PASS, 0=FAIL
+    if (key_file_name && (segment_validator_keys = cets_keys_read_file(key_file_name)) == NULL) {
+        return 1;
+    }
+    if (segment_validator_keys && segment_validator_pid_threads) {
+        /* PID threads read packets again from the file, where they are still encrypted */
+        fprintf(stderr, "Ignoring --pid-threads, since segments are validated on one thread when decrypting with "
+                "--keys\n");
+        segment_validator_pid_threads = 0;
+    }
 
-    /* This should probably be configurable */
-    int64_t max_gap_pts_ticks[NUM_CONTENT_COMPONENTS] = {0};
+    if (batch_file_name) {
+        return validate_batch(batch_file_name, report_dir, jobs);
+    }
+    if (socket_path) {
+        return run_daemon(socket_path, jobs);
+    }
 
     /* Read MPD file */
     char* file_name = argv[optind];
@@ -95,6 +369,47 @@ int main(int argc, char* argv[])
         usage(argv[0]);
         return 1;
     }
+
+    if (worker_num_shards) {
+        int result = run_worker(file_name, worker_shard, worker_num_shards);
+        file_cache_close_unused();
+        xmlCleanupParser();
+        return result;
+    }
+
+    bool completed;
+    int overall_status;
+    if (merge) {
+        overall_status = merge_worker_results(file_name, argv + optind + 1, argc - optind - 1, &completed);
+    } else if (num_shards) {
+        overall_status = validate_sharded(file_name, argv[0], num_shards, &completed);
+    } else {
+        overall_status = validate_mpd(file_name, NULL, &completed);
+    }
+    if (completed && !merge && !num_shards) {
+        segment_reader_stats_t stats;
+        segment_reader_get_stats(&stats);
+        g_info("Read %"PRIu64" bytes from %"PRIu64" segments and waited %.3f seconds for reads to finish. Read ahead "
+                "%"PRIu64" segments.", stats.bytes_read, stats.segments_read, stats.stall_time / 1000000.0,
+                stats.segments_prefetched);
+    }
+    file_cache_close_unused();
+    xmlCleanupParser();
+    return overall_status != 0;
+}
+
+/* Validates every Representation in an MPD and prints the results. Returns 1 if everything passed. completed is set to
+ * false if validation had to stop early. If worker_results isn't NULL, the Representations and segments aren't
+ * validated here, and the results that worker processes sent for them are used instead (see add_worker_result() and
+ * use_worker_result()). */
+int validate_mpd(char* file_name, GHashTable* worker_results, bool* completed)
+{
+    int overall_status = 1;    // overall pass/fail, with 1=PASS, 0=FAIL
+    *completed = false;
+
+    /* This should probably be configurable */
+    int64_t max_gap_pts_ticks[NUM_CONTENT_COMPONENTS] = {0};
+
     mpd_t* mpd = mpd_read_file(file_name);
     if (mpd == NULL) {
         g_critical("Error: Failed to read MPD.");
@@ -106,11 +421,7 @@ int main(int argc, char* argv[])
         period_t* period = g_ptr_array_index(mpd->periods, p_i);
         for (size_t a_i = 0; a_i < period->adaptation_sets->len; ++a_i) {
             adaptation_set_t* adaptation_set = g_ptr_array_index(period->adaptation_sets, a_i);
-            if (adaptation_set->mime_type && strcmp(adaptation_set->mime_type, "video/mp2t")
-                    && strcmp(adaptation_set->mime_type, "audio/mp2t")) {
-                g_warning("Ignoring Adaptation Set %"PRIu32" because MIME type \"%s\" does not match \"video/mp2t\" "
-                        "or \"audio/mp2t\".",
-                        adaptation_set->id, adaptation_set->mime_type);
+            if (!check_adaptation_set_mime_type(adaptation_set)) {
                 continue;
             }
             bool adaptation_set_valid = true;
@@ -119,11 +430,7 @@ int main(int argc, char* argv[])
             GPtrArray* validated_representations = g_ptr_array_new();
             for (size_t r_i = 0; r_i < adaptation_set->representations->len; ++r_i) {
                 representation_t* representation = g_ptr_array_index(adaptation_set->representations, r_i);
-                if (representation->mime_type && strcmp(representation->mime_type, "video/mp2t")
-                        && strcmp(representation->mime_type, "audio/mp2t")) {
-                    g_warning("Ignoring Representation %s because because MIME type \"%s\" does not match "
-                            "\"video/mp2t\" or \"audio/mp2t\".",
-                            representation->id, representation->mime_type);
+                if (!check_representation_mime_type(representation)) {
                     continue;
                 }
                 g_ptr_array_add(validated_representations, representation);
@@ -133,272 +440,49 @@ int main(int argc, char* argv[])
 
                 if (representation->segments->len == 0) {
                     g_critical("Representation has no segments!");
+                    g_ptr_array_free(validated_representations, true);
                     goto cleanup;
                 }
 
-                for (size_t s_i = 0; s_i < representation->segments->len; ++s_i) {
-                    segment_t* segment = g_ptr_array_index(representation->segments, s_i);
-                    dash_validator_t* validator = dash_validator_new(MEDIA_SEGMENT, representation->profile);
-                    validator->adaptation_set = adaptation_set;
-                    validator->segment = segment;
-
-                    segment->arg = validator;
-                    segment->arg_free = (free_func_t)dash_validator_free;
-                }
-
-                // if there is an initialization segment, process it first in order to get the PAT and PMT tables
-                dash_validator_t* validator_init_segment = NULL;
-                if (representation->initialization_file_name) {
-                    validator_init_segment = dash_validator_new(INITIALIZATION_SEGMENT, representation->profile);
-                    if (validate_segment(validator_init_segment, representation->initialization_file_name,
-                            representation->initialization_range_start,
-                            representation->initialization_range_end, NULL) != 0) {
-                        validator_init_segment->status = 0;
-                    }
-                    g_print("INITIALIZATION SEGMENT TEST RESULT: %s: %s\n", representation->initialization_file_name,
-                            validator_init_segment->status ? "SUCCESS" : "FAIL");
-                    representation_valid &= validator_init_segment->status;
-                }
-
-                /* Validate Bitstream Switching Segment */
-                if (representation->bitstream_switching_file_name) {
-                    dash_validator_t* validator = dash_validator_new(BITSTREAM_SWITCHING_SEGMENT,
-                            representation->profile);
-                    if (validate_segment(validator, representation->bitstream_switching_file_name,
-                            representation->bitstream_switching_range_start,
-                            representation->bitstream_switching_range_end, validator_init_segment) != 0) {
-                        validator->status = 0;
-                    }
-                    if (!check_segment_psi_identical(representation->initialization_file_name, validator_init_segment,
-                            representation->bitstream_switching_file_name, validator)) {
-                        g_critical("DASH Conformance: PSI in bitstream switching segment does not match PSI in "
-                                "initialization segment. 6.4.5 Bitstream Switching Segment: If initialization "
-                                "information is carried within a Bitstream Switching Segment, it shall be identical "
-                                "to the one in the Initialization Segment, if present, of the Representation.");
-                        validator->status = 0;
-                    }
-                    g_print("BITSTREAM SWITCHING SEGMENT TEST RESULT: %s: %s\n",
-                            representation->bitstream_switching_file_name, validator->status ? "SUCCESS" : "FAIL");
-                    representation_valid &= validator->status;
-                    dash_validator_free(validator);
-                }
-
-                /* Validate Representation Index */
-                if (representation->index_file_name) {
-                    index_segment_validator_t* index_validator = validate_index_segment(
-                            representation->index_file_name, NULL, representation, adaptation_set);
-                    if (index_validator->error) {
-                        representation_valid = false;
-                    }
-                    g_print("REPRESENTATION INDEX TEST RESULT: %s: %s\n", representation->index_file_name,
-                            index_validator->error ? "FAIL" : "SUCCESS");
-                    if (index_validator->segment_subsegments->len != 0 &&
-                            index_validator->segment_subsegments->len != representation->segments->len) {
-                        g_error("PROGRAMMING ERROR: index_segment_validator_t->segment_subsegments returned from "
-                                "validate_index_segment()  should have on subsegments GPtrArray* per segment, but we have "
-                                "%u segments and %u segment_subsegments", representation->segments->len,
-                                index_validator->segment_subsegments->len);
-                        /* g_error asserts */
-                    }
-                    for (size_t s_i = 0; s_i < index_validator->segment_subsegments->len; ++s_i) {
+                if (worker_results) {
+                    gchar* key = g_strdup_printf("%zu/%zu/%zu", p_i, a_i, r_i);
+                    representation_valid &= use_worker_result(worker_results, key, representation->id, NULL);
+                    g_free(key);
+                    for (size_t s_i = 0; s_i < representation->segments->len; ++s_i) {
                         segment_t* segment = g_ptr_array_index(representation->segments, s_i);
-                        dash_validator_t* validator = segment->arg;
-                        validator->has_subsegments = true;
-                        GPtrArray* subsegments = g_ptr_array_index(index_validator->segment_subsegments, s_i);
-                        for (size_t i = 0; i < subsegments->len; ++i) {
-                            g_ptr_array_add(validator->subsegments, g_ptr_array_index(subsegments, i));
-                        }
-                        g_ptr_array_set_size(subsegments, 0);
-                        
-                    }
-                    index_segment_validator_free(index_validator);
-                }
-
-                for (size_t s_i = 0; s_i < representation->segments->len; ++s_i) {
-                    segment_t* segment = g_ptr_array_index(representation->segments, s_i);
-
-                    /* Validate Segment Index */
-                    if (segment->index_file_name) {
-                        index_segment_validator_t* index_validator = validate_index_segment(
-                                segment->index_file_name, segment, representation, adaptation_set);
-                        if (index_validator->error) {
-                            representation_valid = false;
-                        }
-                        g_print("SINGLE SEGMENT INDEX TEST RESULT: %s: %s\n", segment->index_file_name,
-                                index_validator->error ? "FAIL" : "SUCCESS");
-                        if (index_validator->segment_subsegments->len != 0) {
-                            GPtrArray* subsegments = g_ptr_array_index(index_validator->segment_subsegments, 0);
-                            dash_validator_t* validator = segment->arg;
-                            if (validator->subsegments->len != 0) {
-                                g_critical("DASH Conformance: Segment %s has a representation index and a single "
-                                        "segment index, but should only have one or the other. 6.4.6 Index Segment: "
-                                        "Index Segments may either be associated to a single Media Segment as "
-                                        "specified in 6.4.6.2 or may be associated to all Media Segments in one "
-                                        "Representation as specified in 6.4.6.3.", segment->file_name);
-                                representation_valid = false;
-                            } else {
-                                validator->has_subsegments = true;
-                                for (size_t i = 0; i < subsegments->len; ++i) {
-                                    g_ptr_array_add(validator->subsegments, g_ptr_array_index(subsegments, i));
-                                }
-                                g_ptr_array_set_size(subsegments, 0);
-                            }
-                        }
-                        index_segment_validator_free(index_validator);
+                        key = g_strdup_printf("%zu/%zu/%zu/%zu", p_i, a_i, r_i, s_i);
+                        representation_valid &= use_worker_result(worker_results, key, segment->file_name,
+                                segment);
+                        g_free(key);
                     }
-
-                    if (!segment->index_file_name && !representation->index_file_name
-                            && representation->subrepresentations->len > 0) {
-                        g_critical("DASH Conformance: Segment %s has no index segment, but there is a "
-                                "SubRepresentation present. 7.4.4 Sub-Representations: The Subsegment Index box shall contain "
-                                "at least one entry for the value of SubRepresentation@level and for each value provided in "
-                                "the SubRepresentation@dependencyLevel.", segment->file_name);
-                        representation_valid = false;
-                    }
-
-                    /* Validate Segment */
-                    dash_validator_t* validator = segment->arg;
-                    if (!validate_segment(validator, segment->file_name, segment->media_range_start,
-                            segment->media_range_end, validator_init_segment) != 0) {
-                        // GORP: what if there is no video in the segment??
-                        for (gsize pid_i = 0; pid_i < validator->pids->len; pid_i++) {
-                            pid_validator_t* pv = g_ptr_array_index(validator->pids, pid_i);
-
-                            // refine duration by including duration of last frame (audio and video are different rates)
-                            // start time is relative to the start time of the first segment
-
-                            // units of 90kHz ticks
-                            int64_t actual_start = pv->earliest_playout_time;
-                            int64_t actual_duration = (pv->latest_playout_time - pv->earliest_playout_time) + pv->duration;
-                            int64_t actual_end = actual_start + actual_duration;
-
-                            segment->actual_start[pv->content_component] = actual_start;
-                            segment->actual_end[pv->content_component] = actual_end;
-
-                            g_debug("%s: %04X: %s STARTTIME=%"PRId64", ENDTIME=%"PRId64", DURATION=%"PRId64"",
-                                    segment->file_name, pv->pid, content_component_to_string(pv->content_component),
-                                    actual_start, actual_end, actual_duration);
-
-                            uint8_t expected_sap = representation->start_with_sap;
-                            if (adaptation_set->bitstream_switching && (expected_sap == 0 || expected_sap > 2)) {
-                                expected_sap = 3;
-                            }
-                            if (expected_sap != 0 && pv->content_component == VIDEO_CONTENT_COMPONENT) {
-                                bool fail = false;
-                                if (pv->sap == 0) {
-                                    g_critical("DASH Conformance: Missing SAP in segment %s PID %"PRIu16". "
-                                            "Expected SAP_type <= %d, actual (none). Table 9 - Common Adaptation Set, "
-                                            "Representation and Sub-Representation attributes and elements: "
-                                            "@startWithSAP: when present and greater than 0, specifies that in the "
-                                            "associated Representations, each Media Segment starts with a SAP of "
-                                            "type less than or equal to the value of this attribute value in each "
-                                            "media stream.",
-                                            segment->file_name, pv->pid, expected_sap);
-                                    fail = true;
-                                } else if (pv->sap > expected_sap) {
-                                    g_critical("DASH Conformance: Invalid SAP Type in segment %s PID %"PRIu16". "
-                                            "Expected SAP_type <= %d, actual %d. Table 9 — Common Adaptation Set, "
-                                            "Representation and Sub-Representation attributes and elements: "
-                                            "@startWithSAP: when present and greater than 0, specifies that in the "
-                                            "associated Representations, each Media Segment starts with a SAP of "
-                                            "type less than or equal to the value of this attribute value in each "
-                                            "media stream.",
-                                            segment->file_name, pv->pid, expected_sap, pv->sap_type);
-                                    fail = true;
-                                }
-                                if (fail) {
-                                    if (adaptation_set->bitstream_switching) {
-                                        g_critical("7.3.3.2 Bitstream switching: The conditions required for setting "
-                                                "(i) the @startWithSAP attribute to 2 for the Adaptation Set, or (ii) "
-                                                "the conditions required for all Representations within the "
-                                                "Adaptation Set to share the same value of @mediaStreamStructureId "
-                                                "and setting the @startWithSAP attribute to 3 for the Adaptation Set, "
-                                                "are fulfilled.");
-                                    }
-                                    validator->status = 0;
-                                }
-                            }
-                        }
+                } else {
+                    segment_prefetcher_t* prefetcher = segment_prefetcher_new(representation->segments);
+                    segment_prefetcher_advance(prefetcher, 0);
+                    dash_validator_t* validator_init_segment = NULL;
+                    representation_valid &= validate_representation_start(representation, adaptation_set,
+                            &validator_init_segment);
+                    for (size_t s_i = 0; s_i < representation->segments->len; ++s_i) {
+                        segment_prefetcher_advance(prefetcher, s_i);
+                        representation_valid &= validate_representation_segment(representation, adaptation_set,
+                                g_ptr_array_index(representation->segments, s_i), validator_init_segment);
                     }
-
-                    g_print("SEGMENT TEST RESULT: %s: %s\n", segment->file_name,
-                            validator->status ? "SUCCESS" : "FAIL");
-                    g_info("");
-                    representation_valid &= validator->status;
+                    segment_prefetcher_free(prefetcher);
+                    dash_validator_free(validator_init_segment);
                 }
 
                 /* Check that segments in the same representation don't have gaps between them */
                 representation_valid &= check_segment_timing(representation->segments, AUDIO_CONTENT_COMPONENT);
                 representation_valid &= check_segment_timing(representation->segments, VIDEO_CONTENT_COMPONENT);
+                representation_valid &= check_splice_points(representation->segments);
 
                 g_print("REPRESENTATION TEST RESULT: %s: %s\n", representation->id,
                         representation_valid ? "SUCCESS" : "FAIL");
                 g_info("");
                 adaptation_set_valid &= representation_valid;
-
-                dash_validator_free(validator_init_segment);
             }
 
             if (adaptation_set->bitstream_switching) {
-                for (gsize x = 0; x < validated_representations->len; ++x) {
-                    representation_t* representation_x = g_ptr_array_index(validated_representations, x);
-                    const char* file_names[4];
-                    uint64_t byte_starts[4];
-                    uint64_t byte_ends[4];
-                    size_t f_i = 0;
-                    if (representation_x->initialization_file_name) {
-                        file_names[f_i] = representation_x->initialization_file_name;
-                        byte_starts[f_i] = representation_x->initialization_range_start;
-                        byte_ends[f_i] = representation_x->initialization_range_end;
-                        f_i++;
-                    }
-                    for (gsize s_i = 0; s_i + 1 < representation_x->segments->len; ++s_i) {
-                        segment_t* segment_x = g_ptr_array_index(representation_x->segments, s_i);
-                        file_names[f_i] = segment_x->file_name;
-                        byte_starts[f_i] = segment_x->media_range_start;
-                        byte_ends[f_i] =  segment_x->media_range_end;
-                        for (gsize y = 0; y < validated_representations->len; ++y) {
-                            if (x == y) {
-                                continue;
-                            }
-                            representation_t* representation_y = g_ptr_array_index(validated_representations, y);
-                            if (representation_y->segments->len != representation_x->segments->len) {
-                                g_critical("Representations %s and %s are in the same adaptation set and have "
-                                        "bitstream switching set, but don't have the same number of segments.",
-                                        representation_x->id, representation_y->id);
-                                adaptation_set_valid = false;
-                                break;
-                            }
-                            g_info("Testing bitstream switching from representation %s segment %"G_GSIZE_FORMAT
-                                    " to %s segment %"G_GSIZE_FORMAT".",
-                                    representation_x->id, s_i, representation_y->id, s_i + 1);
-                            size_t f_j = f_i + 1;
-                            if (representation_y->bitstream_switching_file_name) {
-                                file_names[f_j] = representation_y->bitstream_switching_file_name;
-                                byte_starts[f_j] = representation_y->bitstream_switching_range_start;
-                                byte_ends[f_j] = representation_y->bitstream_switching_range_end;
-                                f_j++;
-                            }
-                            segment_t* segment_y = g_ptr_array_index(representation_y->segments, s_i + 1);
-                            file_names[f_j] = segment_y->file_name;
-                            byte_starts[f_j] = segment_y->media_range_start;
-                            byte_ends[f_j] =  segment_y->media_range_end;
-                            if (!validate_bitstream_switching(file_names, byte_starts, byte_ends, f_j + 1)) {
-                                g_critical("DASH Conformance: Error parsing TS packet in segments. 7.4.3.4 Bitstream "
-                                        "switching: If @bitstreamSwitching flag is set to 'true' the Bitstream Switching Segment "
-                                        "may be present, indicated by BitstreamSwitching in the Segment Information. In this "
-                                        "case, for any two Representations, X and Y, within the same Adaptation Set, "
-                                        "concatenation of Media Segment i of X, Bitstream Switching Segment of Representation Y, "
-                                        "and Media Segment i+1 of Representation Y shall be a MPEG-2 TS conforming to ISO/IEC "
-                                        "13818-1.");
-                                g_critical("Segments concatenated for this test:");
-                                for (size_t i = 0; i < f_j + 1; ++i) {
-                                    g_critical("%s", file_names[i]);
-                                }
-                            }
-                        }
-                    }
-                }
+                adaptation_set_valid &= check_bitstream_switching(validated_representations);
             }
 
             // segment cross checking: check that the gap between all adjacent segments is acceptably small
@@ -429,96 +513,1049 @@ int main(int argc, char* argv[])
     }
 
     g_print("\nOVERALL TEST RESULT: %s\n", overall_status ? "PASS" : "FAIL");
+    *completed = true;
 cleanup:
     mpd_free(mpd);
-    xmlCleanupParser();
-    return overall_status != 0;
+    return overall_status;
 }
 
-int check_representation_gaps(GPtrArray* representations, content_component_t content_component, int64_t max_delta)
+bool check_adaptation_set_mime_type(adaptation_set_t* adaptation_set)
 {
-    g_return_val_if_fail(representations, 0);
+    if (adaptation_set->mime_type && strcmp(adaptation_set->mime_type, "video/mp2t")
+            && strcmp(adaptation_set->mime_type, "audio/mp2t")) {
+        g_warning("Ignoring Adaptation Set %"PRIu32" because MIME type \"%s\" does not match \"video/mp2t\" "
+                "or \"audio/mp2t\".",
+                adaptation_set->id, adaptation_set->mime_type);
+        return false;
+    }
+    return true;
+}
 
-    if (representations->len == 0) {
-        g_warning("Can't print gap matrix for empty set of representations.");
-        return 1;
+bool check_representation_mime_type(representation_t* representation)
+{
+    if (representation->mime_type && strcmp(representation->mime_type, "video/mp2t")
+            && strcmp(representation->mime_type, "audio/mp2t")) {
+        g_warning("Ignoring Representation %s because because MIME type \"%s\" does not match "
+                "\"video/mp2t\" or \"audio/mp2t\".",
+                representation->id, representation->mime_type);
+        return false;
     }
-    int status = 1;
-    representation_t* first_representation = g_ptr_array_index(representations, 0);
+    return true;
+}
 
-    /* First figure out if there are any gaps, so we can be quieter if there are none */
-    GLogLevelFlags flags = G_LOG_LEVEL_INFO;
-    for (gsize s_i = 1; s_i < first_representation->segments->len; ++s_i) {
-        for (gsize r_i = 0; r_i < representations->len; ++r_i) {
-            representation_t* representation1 = g_ptr_array_index(representations, r_i);
-            segment_t* segment1 = g_ptr_array_index(representation1->segments, s_i - 1);
-            dash_validator_t* dv1 = segment1->arg;
-            if (!dv1) {
-                g_critical("Attempting to check representation gaps on representations that haven't be validated!");
-                return 0;
+/* Sets up a validator for each segment of a Representation in segment->arg, and validates the segments that go with
+ * all of them: the Initialization Segment, Bitstream Switching Segment and Representation Index. The Initialization
+ * Segment's validator is returned in validator_init_segment, for validating the Media Segments. Returns false if
+ * anything failed. */
+bool validate_representation_start(representation_t* representation, adaptation_set_t* adaptation_set,
+        dash_validator_t** validator_init_segment_out)
+{
+    bool representation_valid = true;
+    for (size_t s_i = 0; s_i < representation->segments->len; ++s_i) {
+        segment_t* segment = g_ptr_array_index(representation->segments, s_i);
+        dash_validator_t* validator = dash_validator_new(MEDIA_SEGMENT, representation->profile);
+        validator->adaptation_set = adaptation_set;
+        validator->segment = segment;
+
+        segment->arg = validator;
+        segment->arg_free = (free_func_t)dash_validator_free;
+    }
+
+    // if there is an initialization segment, process it first in order to get the PAT and PMT tables
+    dash_validator_t* validator_init_segment = NULL;
+    if (representation->initialization_file_name) {
+        validator_init_segment = dash_validator_new(INITIALIZATION_SEGMENT, representation->profile);
+        if (validate_segment(validator_init_segment, representation->initialization_file_name,
+                representation->initialization_range_start,
+                representation->initialization_range_end, NULL) != 0) {
+            validator_init_segment->status = 0;
+        }
+        g_print("INITIALIZATION SEGMENT TEST RESULT: %s: %s\n", representation->initialization_file_name,
+                validator_init_segment->status ? "SUCCESS" : "FAIL");
+        representation_valid &= validator_init_segment->status;
+    }
+    *validator_init_segment_out = validator_init_segment;
+
+    /* Validate Bitstream Switching Segment */
+    if (representation->bitstream_switching_file_name) {
+        dash_validator_t* validator = dash_validator_new(BITSTREAM_SWITCHING_SEGMENT,
+                representation->profile);
+        if (validate_segment(validator, representation->bitstream_switching_file_name,
+                representation->bitstream_switching_range_start,
+                representation->bitstream_switching_range_end, validator_init_segment) != 0) {
+            validator->status = 0;
+        }
+        if (!check_segment_psi_identical(representation->initialization_file_name, validator_init_segment,
+                representation->bitstream_switching_file_name, validator)) {
+            g_critical("DASH Conformance: PSI in bitstream switching segment does not match PSI in "
+                    "initialization segment. 6.4.5 Bitstream Switching Segment: If initialization "
+                    "information is carried within a Bitstream Switching Segment, it shall be identical "
+                    "to the one in the Initialization Segment, if present, of the Representation.");
+            validator->status = 0;
+        }
+        g_print("BITSTREAM SWITCHING SEGMENT TEST RESULT: %s: %s\n",
+                representation->bitstream_switching_file_name, validator->status ? "SUCCESS" : "FAIL");
+        representation_valid &= validator->status;
+        dash_validator_free(validator);
+    }
+
+    /* Validate Representation Index */
+    if (representation->index_file_name) {
+        index_segment_validator_t* index_validator = validate_index_segment(
+                representation->index_file_name, NULL, representation, adaptation_set);
+        if (index_validator->error) {
+            representation_valid = false;
+        }
+        g_print("REPRESENTATION INDEX TEST RESULT: %s: %s\n", representation->index_file_name,
+                index_validator->error ? "FAIL" : "SUCCESS");
+        if (index_validator->segment_subsegments->len != 0 &&
+                index_validator->segment_subsegments->len != representation->segments->len) {
+            g_error("PROGRAMMING ERROR: index_segment_validator_t->segment_subsegments returned from "
+                    "validate_index_segment()  should have on subsegments GPtrArray* per segment, but we have "
+                    "%u segments and %u segment_subsegments", representation->segments->len,
+                    index_validator->segment_subsegments->len);
+            /* g_error asserts */
+        }
+        for (size_t s_i = 0; s_i < index_validator->segment_subsegments->len; ++s_i) {
+            segment_t* segment = g_ptr_array_index(representation->segments, s_i);
+            dash_validator_t* validator = segment->arg;
+            validator->has_subsegments = true;
+            GPtrArray* subsegments = g_ptr_array_index(index_validator->segment_subsegments, s_i);
+            for (size_t i = 0; i < subsegments->len; ++i) {
+                g_ptr_array_add(validator->subsegments, g_ptr_array_index(subsegments, i));
             }
-            if (dv1->is_encrypted) {
-                continue;
+            g_ptr_array_set_size(subsegments, 0);
+            
+        }
+        index_segment_validator_free(index_validator);
+    }
+    return representation_valid;
+}
+
+/* Validates a Media Segment set up by validate_representation_start(), and its Segment Index if it has one. The
+ * segment's validator is replaced by its summary once it's done. Returns false if anything failed. */
+bool validate_representation_segment(representation_t* representation, adaptation_set_t* adaptation_set,
+        segment_t* segment, dash_validator_t* validator_init_segment)
+{
+    bool representation_valid = true;
+
+    /* Validate Segment Index */
+    if (segment->index_file_name) {
+        index_segment_validator_t* index_validator = validate_index_segment(
+                segment->index_file_name, segment, representation, adaptation_set);
+        if (index_validator->error) {
+            representation_valid = false;
+        }
+        g_print("SINGLE SEGMENT INDEX TEST RESULT: %s: %s\n", segment->index_file_name,
+                index_validator->error ? "FAIL" : "SUCCESS");
+        if (index_validator->segment_subsegments->len != 0) {
+            GPtrArray* subsegments = g_ptr_array_index(index_validator->segment_subsegments, 0);
+            dash_validator_t* validator = segment->arg;
+            if (validator->subsegments->len != 0) {
+                g_critical("DASH Conformance: Segment %s has a representation index and a single "
+                        "segment index, but should only have one or the other. 6.4.6 Index Segment: "
+                        "Index Segments may either be associated to a single Media Segment as "
+                        "specified in 6.4.6.2 or may be associated to all Media Segments in one "
+                        "Representation as specified in 6.4.6.3.", segment->file_name);
+                representation_valid = false;
+            } else {
+                validator->has_subsegments = true;
+                for (size_t i = 0; i < subsegments->len; ++i) {
+                    g_ptr_array_add(validator->subsegments, g_ptr_array_index(subsegments, i));
+                }
+                g_ptr_array_set_size(subsegments, 0);
             }
+        }
+        index_segment_validator_free(index_validator);
+    }
+
+    if (!segment->index_file_name && !representation->index_file_name
+            && representation->subrepresentations->len > 0) {
+        g_critical("DASH Conformance: Segment %s has no index segment, but there is a "
+                "SubRepresentation present. 7.4.4 Sub-Representations: The Subsegment Index box shall contain "
+                "at least one entry for the value of SubRepresentation@level and for each value provided in "
+                "the SubRepresentation@dependencyLevel.", segment->file_name);
+        representation_valid = false;
+    }
+
+    /* Validate Segment */
+    dash_validator_t* validator = segment->arg;
+    bool reused = reuse_frame_index && validate_segment_from_frame_index(validator, segment->file_name,
+            segment->media_range_start, segment->media_range_end, validator_init_segment);
+    bool validated = reused || validate_segment(validator, segment->file_name, segment->media_range_start,
+            segment->media_range_end, validator_init_segment) == 0;
+    if (segment_validator_frame_index && !reused) {
+        /* Failing segments get an index too, since they're the ones most worth looking into */
+        dash_validator_write_frame_index(validator, segment->file_name, segment->media_range_start,
+                segment->media_range_end, validator_init_segment, validated);
+    }
+    if (validated) {
+        // GORP: what if there is no video in the segment??
+        for (gsize pid_i = 0; pid_i < validator->pids->len; pid_i++) {
+            pid_validator_t* pv = g_ptr_array_index(validator->pids, pid_i);
+
+            // refine duration by including duration of last frame (audio and video are different rates)
+            // start time is relative to the start time of the first segment
+
+            // units of 90kHz ticks
+            int64_t actual_start = pv->earliest_playout_time;
+            int64_t actual_duration = (pv->latest_playout_time - pv->earliest_playout_time) + pv->duration;
+            int64_t actual_end = actual_start + actual_duration;
 
-            for(gsize r_i2 = 0; r_i2 < representations->len; ++r_i2) {
-                representation_t* representation2 = g_ptr_array_index(representations, r_i2);
-                segment_t* segment2 = g_ptr_array_index(representation2->segments, s_i);
-                dash_validator_t* dv2 = segment1->arg;
-                if (!dv2) {
-                    g_critical("Attempting to check representation gaps on representations that haven't be validated!");
-                    return 0;
+            segment->actual_start[pv->content_component] = actual_start;
+            segment->actual_end[pv->content_component] = actual_end;
+
+            g_debug("%s: %04X: %s STARTTIME=%"PRId64", ENDTIME=%"PRId64", DURATION=%"PRId64"",
+                    segment->file_name, pv->pid, content_component_to_string(pv->content_component),
+                    actual_start, actual_end, actual_duration);
+
+            uint8_t expected_sap = representation->start_with_sap;
+            if (adaptation_set->bitstream_switching && (expected_sap == 0 || expected_sap > 2)) {
+                expected_sap = 3;
+            }
+            if (expected_sap != 0 && pv->content_component == VIDEO_CONTENT_COMPONENT) {
+                bool fail = false;
+                if (pv->sap == 0) {
+                    g_critical("DASH Conformance: Missing SAP in segment %s PID %"PRIu16". "
+                            "Expected SAP_type <= %d, actual (none). Table 9 - Common Adaptation Set, "
+                            "Representation and Sub-Representation attributes and elements: "
+                            "@startWithSAP: when present and greater than 0, specifies that in the "
+                            "associated Representations, each Media Segment starts with a SAP of "
+                            "type less than or equal to the value of this attribute value in each "
+                            "media stream.",
+                            segment->file_name, pv->pid, expected_sap);
+                    fail = true;
+                } else if (pv->sap > expected_sap) {
+                    g_critical("DASH Conformance: Invalid SAP Type in segment %s PID %"PRIu16". "
+                            "Expected SAP_type <= %d, actual %d. Table 9 — Common Adaptation Set, "
+                            "Representation and Sub-Representation attributes and elements: "
+                            "@startWithSAP: when present and greater than 0, specifies that in the "
+                            "associated Representations, each Media Segment starts with a SAP of "
+                            "type less than or equal to the value of this attribute value in each "
+                            "media stream.",
+                            segment->file_name, pv->pid, expected_sap, pv->sap_type);
+                    fail = true;
                 }
-                if (dv2->is_encrypted) {
-                    continue;
+                if (fail) {
+                    if (adaptation_set->bitstream_switching) {
+                        g_critical("7.3.3.2 Bitstream switching: The conditions required for setting "
+                                "(i) the @startWithSAP attribute to 2 for the Adaptation Set, or (ii) "
+                                "the conditions required for all Representations within the "
+                                "Adaptation Set to share the same value of @mediaStreamStructureId "
+                                "and setting the @startWithSAP attribute to 3 for the Adaptation Set, "
+                                "are fulfilled.");
+                    }
+                    validator->status = 0;
                 }
+            }
+        }
+    }
+
+    g_print("SEGMENT TEST RESULT: %s: %s\n", segment->file_name,
+            validator->status ? "SUCCESS" : "FAIL");
+    g_info("");
+    representation_valid &= validator->status;
 
-                int64_t pts_delta = segment2->actual_start[content_component] - \
-                        (int64_t)segment1->actual_end[content_component];
-                if (pts_delta) {
-                    flags = G_LOG_LEVEL_WARNING;
-                    if (pts_delta > max_delta) {
-                        g_critical("FAIL: %s gap between for segment %zu for representations %s and %s is %"PRId64" "
-                                "and exceeds limit %"PRId64,
-                                content_component_to_string(content_component), s_i, representation1->id,
-                                representation2->id, pts_delta, max_delta);
-                        status = 0;
+    /* The checks across segments and Representations only need the summary */
+    segment->arg = segment_summary_new(validator);
+    segment->arg_free = (free_func_t)segment_summary_free;
+    dash_validator_free(validator);
+    return representation_valid;
+}
+
+/* 7.4.3.4 Bitstream switching: Media Segment i of each Representation, followed by Media Segment i + 1 of any other
+ * one, has to be a valid transport stream. */
+bool check_bitstream_switching(GPtrArray* validated_representations)
+{
+    bool adaptation_set_valid = true;
+    for (gsize x = 0; x < validated_representations->len; ++x) {
+        representation_t* representation_x = g_ptr_array_index(validated_representations, x);
+        const char* file_names[4];
+        uint64_t byte_starts[4];
+        uint64_t byte_ends[4];
+        size_t f_i = 0;
+        if (representation_x->initialization_file_name) {
+            file_names[f_i] = representation_x->initialization_file_name;
+            byte_starts[f_i] = representation_x->initialization_range_start;
+            byte_ends[f_i] = representation_x->initialization_range_end;
+            f_i++;
+        }
+        for (gsize s_i = 0; s_i + 1 < representation_x->segments->len; ++s_i) {
+            segment_t* segment_x = g_ptr_array_index(representation_x->segments, s_i);
+            file_names[f_i] = segment_x->file_name;
+            byte_starts[f_i] = segment_x->media_range_start;
+            byte_ends[f_i] =  segment_x->media_range_end;
+            for (gsize y = 0; y < validated_representations->len; ++y) {
+                if (x == y) {
+                    continue;
+                }
+                representation_t* representation_y = g_ptr_array_index(validated_representations, y);
+                if (representation_y->segments->len != representation_x->segments->len) {
+                    g_critical("Representations %s and %s are in the same adaptation set and have "
+                            "bitstream switching set, but don't have the same number of segments.",
+                            representation_x->id, representation_y->id);
+                    adaptation_set_valid = false;
+                    break;
+                }
+                g_info("Testing bitstream switching from representation %s segment %"G_GSIZE_FORMAT
+                        " to %s segment %"G_GSIZE_FORMAT".",
+                        representation_x->id, s_i, representation_y->id, s_i + 1);
+                size_t f_j = f_i + 1;
+                if (representation_y->bitstream_switching_file_name) {
+                    file_names[f_j] = representation_y->bitstream_switching_file_name;
+                    byte_starts[f_j] = representation_y->bitstream_switching_range_start;
+                    byte_ends[f_j] = representation_y->bitstream_switching_range_end;
+                    f_j++;
+                }
+                segment_t* segment_y = g_ptr_array_index(representation_y->segments, s_i + 1);
+                file_names[f_j] = segment_y->file_name;
+                byte_starts[f_j] = segment_y->media_range_start;
+                byte_ends[f_j] =  segment_y->media_range_end;
+                if (!validate_bitstream_switching(file_names, byte_starts, byte_ends, f_j + 1)) {
+                    g_critical("DASH Conformance: Error parsing TS packet in segments. 7.4.3.4 Bitstream "
+                            "switching: If @bitstreamSwitching flag is set to 'true' the Bitstream Switching Segment "
+                            "may be present, indicated by BitstreamSwitching in the Segment Information. In this "
+                            "case, for any two Representations, X and Y, within the same Adaptation Set, "
+                            "concatenation of Media Segment i of X, Bitstream Switching Segment of Representation Y, "
+                            "and Media Segment i+1 of Representation Y shall be a MPEG-2 TS conforming to ISO/IEC "
+                            "13818-1.");
+                    g_critical("Segments concatenated for this test:");
+                    for (size_t i = 0; i < f_j + 1; ++i) {
+                        g_critical("%s", file_names[i]);
                     }
                 }
             }
         }
     }
+    return adaptation_set_valid;
+}
 
-    g_log(G_LOG_DOMAIN, flags, "%sGapMatrix", content_component_to_string(content_component));
-    for (gsize s_i = 1; s_i < first_representation->segments->len; ++s_i) {
-        GString* line = g_string_new("    \t");
-        for (gsize r_i = 0; r_i < representations->len; ++r_i) {
-            representation_t* representation = g_ptr_array_index(representations, r_i);
-            segment_t* segment = g_ptr_array_index(representation->segments, s_i);
-            g_string_append_printf(line, "%s\t", segment->file_name);
+/* Validates a media segment on its own, after its initialization segment if there is one. Checks that need the MPD,
+ * like timing and SAP types, are skipped. Returns 1 if everything passed. */
+int validate_single_segment(char* file_name, char* initialization_file_name)
+{
+    int status = 1;
+    mpd_t* mpd = mpd_new();
+    period_t* period = period_new(mpd);
+    g_ptr_array_add(mpd->periods, period);
+    adaptation_set_t* adaptation_set = adaptation_set_new(period);
+    g_ptr_array_add(period->adaptation_sets, adaptation_set);
+    representation_t* representation = representation_new(adaptation_set);
+    g_ptr_array_add(adaptation_set->representations, representation);
+    segment_t* segment = segment_new(representation);
+    segment->file_name = g_strdup(file_name);
+    g_ptr_array_add(representation->segments, segment);
+
+    dash_validator_t* validator_init_segment = NULL;
+    if (initialization_file_name) {
+        validator_init_segment = dash_validator_new(INITIALIZATION_SEGMENT, representation->profile);
+        if (validate_segment(validator_init_segment, initialization_file_name, 0, 0, NULL) != 0) {
+            validator_init_segment->status = 0;
+        }
+        g_print("INITIALIZATION SEGMENT TEST RESULT: %s: %s\n", initialization_file_name,
+                validator_init_segment->status ? "SUCCESS" : "FAIL");
+        status &= validator_init_segment->status;
+    }
+
+    dash_validator_t* validator = dash_validator_new(MEDIA_SEGMENT, representation->profile);
+    validator->adaptation_set = adaptation_set;
+    validator->segment = segment;
+    if (validate_segment(validator, file_name, 0, 0, validator_init_segment) != 0) {
+        validator->status = 0;
+    }
+    g_print("SEGMENT TEST RESULT: %s: %s\n", file_name, validator->status ? "SUCCESS" : "FAIL");
+    status &= validator->status;
+
+    dash_validator_free(validator);
+    dash_validator_free(validator_init_segment);
+    mpd_free(mpd);
+    return status;
+}
+
+/* Output from a thread validating a batch or daemon job goes to its report */
+void print_to_report(const gchar* string)
+{
+    report_t* report = g_private_get(&current_report);
+    if (report == NULL) {
+        fputs(string, stdout);
+    } else if (report->connection) {
+        daemon_send(report->connection, "output", report->id, "text", string);
+    } else {
+        g_string_append(report->buffer, string);
+    }
+}
+
+/* Reads a line of any length, without its newline. Returns false at the end of the file. */
+bool read_line(FILE* file, GString* line)
+{
+    char buffer[MAX_LIST_LINE];
+    g_string_truncate(line, 0);
+    while (fgets(buffer, sizeof(buffer), file)) {
+        g_string_append(line, buffer);
+        if (line->str[line->len - 1] == '\n') {
+            g_string_truncate(line, line->len - 1);
+            return true;
+        }
+    }
+    return line->len != 0;
+}
+
+void validate_batch_job(gpointer data, gpointer user_data)
+{
+    batch_job_t* job = data;
+    batch_t* batch = user_data;
+
+    report_t report = { .buffer = g_string_new(NULL) };
+    g_private_set(&current_report, &report);
+    bool completed;
+    job->passed = validate_mpd(job->file_name, NULL, &completed) && completed;
+    g_private_set(&current_report, NULL);
+
+    bool written = true;
+    if (batch->report_dir) {
+        gchar* base_name = g_path_get_basename(job->file_name);
+        gchar* report_name = g_strdup_printf("%zu-%s.txt", job->index, base_name);
+        gchar* report_path = g_build_filename(batch->report_dir, report_name, NULL);
+        GError* error = NULL;
+        if (!g_file_set_contents(report_path, report.buffer->str, report.buffer->len, &error)) {
+            g_mutex_lock(&batch->mutex);
+            fprintf(stderr, "Failed to write report for %s - %s\n", job->file_name, error->message);
+            g_mutex_unlock(&batch->mutex);
+            g_error_free(error);
+            written = false;
+        }
+        g_free(report_path);
+        g_free(report_name);
+        g_free(base_name);
+    }
+
+    /* Reports aren't interleaved, so each one reads like a single run */
+    g_mutex_lock(&batch->mutex);
+    if (!batch->report_dir) {
+        fputs(report.buffer->str, stdout);
+    }
+    printf("MPD TEST RESULT: %s: %s\n", job->file_name, job->passed && written ? "PASS" : "FAIL");
+    fflush(stdout);
+    g_mutex_unlock(&batch->mutex);
+    g_string_free(report.buffer, true);
+}
+
+/* Validates each MPD listed in list_file_name (- for stdin), one per line, with up to jobs of them at once. Files are
+ * shared through the file cache, so MPDs using the same segments don't keep separate descriptors open. */
+int validate_batch(const char* list_file_name, const char* report_dir, unsigned jobs)
+{
+    FILE* list = strcmp(list_file_name, "-") ? fopen(list_file_name, "r") : stdin;
+    if (list == NULL) {
+        g_critical("Cannot open MPD list %s - %s", list_file_name, strerror(errno));
+        return 1;
+    }
+    GPtrArray* file_names = g_ptr_array_new_with_free_func(g_free);
+    GString* line = g_string_new(NULL);
+    while (read_line(list, line)) {
+        const gchar* entry = g_strstrip(line->str);
+        if (entry[0] != 0 && entry[0] != '#') {
+            g_ptr_array_add(file_names, g_strdup(entry));
+        }
+    }
+    g_string_free(line, true);
+    if (list != stdin) {
+        fclose(list);
+    }
+
+    if (report_dir && g_mkdir_with_parents(report_dir, 0755) != 0) {
+        g_critical("Cannot create report directory %s - %s", report_dir, strerror(errno));
+        g_ptr_array_free(file_names, true);
+        return 1;
+    }
+
+    batch_t batch = { .report_dir = report_dir };
+    g_mutex_init(&batch.mutex);
+    batch_job_t* batch_jobs = g_new0(batch_job_t, file_names->len);
+
+    /* libxml2 has to be set up before it's used on more than one thread */
+    xmlInitParser();
+    g_set_print_handler(print_to_report);
+    GThreadPool* pool = g_thread_pool_new(validate_batch_job, &batch, jobs, true, NULL);
+    for (size_t i = 0; i < file_names->len; ++i) {
+        batch_jobs[i].file_name = g_ptr_array_index(file_names, i);
+        batch_jobs[i].index = i;
+        g_thread_pool_push(pool, &batch_jobs[i], NULL);
+    }
+    g_thread_pool_free(pool, false, true);
+    g_set_print_handler(NULL);
+
+    size_t num_passed = 0;
+    for (size_t i = 0; i < file_names->len; ++i) {
+        num_passed += batch_jobs[i].passed;
+    }
+    bool all_passed = num_passed == file_names->len;
+    printf("\nBATCH TEST RESULT: %zu of %u MPDs passed: %s\n", num_passed, file_names->len,
+            all_passed ? "PASS" : "FAIL");
+
+    segment_reader_stats_t stats;
+    segment_reader_get_stats(&stats);
+    g_info("Read %"PRIu64" bytes from %"PRIu64" segments and waited %.3f seconds for reads to finish. Read ahead "
+            "%"PRIu64" segments.", stats.bytes_read, stats.segments_read, stats.stall_time / 1000000.0,
+            stats.segments_prefetched);
+
+    g_free(batch_jobs);
+    g_ptr_array_free(file_names, true);
+    g_mutex_clear(&batch.mutex);
+    file_cache_close_unused();
+    xmlCleanupParser();
+    return all_passed;
+}
+
+/* Validates the Representations and segments in shard of num_shards of an MPD, and writes the results to stdout as
+ * JSON, one per line, for validate_mpd() to use. Segments are numbered across every Representation, and each shard
+ * gets the same number of them in a row, so most Representations are only started by one worker. Returns 0 unless the
+ * MPD can't be read. */
+int run_worker(char* file_name, unsigned shard, unsigned num_shards)
+{
+    mpd_t* mpd = mpd_read_file(file_name);
+    if (mpd == NULL) {
+        g_critical("Error: Failed to read MPD.");
+        return 1;
+    }
+
+    size_t num_segments = 0;
+    for (size_t p_i = 0; p_i < mpd->periods->len; ++p_i) {
+        period_t* period = g_ptr_array_index(mpd->periods, p_i);
+        for (size_t a_i = 0; a_i < period->adaptation_sets->len; ++a_i) {
+            adaptation_set_t* adaptation_set = g_ptr_array_index(period->adaptation_sets, a_i);
+            for (size_t r_i = 0; r_i < adaptation_set->representations->len; ++r_i) {
+                representation_t* representation = g_ptr_array_index(adaptation_set->representations, r_i);
+                num_segments += representation->segments->len;
+            }
         }
-        g_log(G_LOG_DOMAIN, flags, "%s", line->str);
+    }
+    size_t first_segment = num_segments * shard / num_shards;
+    size_t end_segment = num_segments * (shard + 1) / num_shards;
 
-        for (gsize r_i = 0; r_i < representations->len; ++r_i) {
-            representation_t* representation = g_ptr_array_index(representations, r_i);
-            segment_t* segment1 = g_ptr_array_index(representation->segments, s_i - 1);
-            g_string_printf(line, "%s\t", segment1->file_name);
+    /* The coordinator prints everything that isn't about this shard's segments itself */
+    report_t report = { .buffer = g_string_new(NULL) };
+    g_private_set(&current_report, &report);
+    g_set_print_handler(print_to_report);
+    size_t segment_num = 0;
+    for (size_t p_i = 0; p_i < mpd->periods->len; ++p_i) {
+        period_t* period = g_ptr_array_index(mpd->periods, p_i);
+        for (size_t a_i = 0; a_i < period->adaptation_sets->len; ++a_i) {
+            adaptation_set_t* adaptation_set = g_ptr_array_index(period->adaptation_sets, a_i);
+            bool validate_adaptation_set = check_adaptation_set_mime_type(adaptation_set);
+            for (size_t r_i = 0; r_i < adaptation_set->representations->len; ++r_i) {
+                representation_t* representation = g_ptr_array_index(adaptation_set->representations, r_i);
+                size_t start = segment_num;
+                segment_num += representation->segments->len;
+                if (!validate_adaptation_set || segment_num <= first_segment || start >= end_segment
+                        || !check_representation_mime_type(representation)) {
+                    continue;
+                }
 
-            for(gsize r_i2 = 0; r_i2 < representations->len; ++r_i2) {
-                representation_t* representation2 = g_ptr_array_index(representations, r_i2);
-                segment_t* segment2 = g_ptr_array_index(representation2->segments, s_i);
+                size_t s_i = MAX(start, first_segment) - start;
+                size_t s_end = MIN(segment_num, end_segment) - start;
+                segment_prefetcher_t* prefetcher = segment_prefetcher_new(representation->segments);
+                segment_prefetcher_advance(prefetcher, s_i);
+                g_string_truncate(report.buffer, 0);
+                dash_validator_t* validator_init_segment = NULL;
+                bool passed = validate_representation_start(representation, adaptation_set, &validator_init_segment);
+                if (s_i == 0) {
+                    gchar* key = g_strdup_printf("%zu/%zu/%zu", p_i, a_i, r_i);
+                    send_worker_result(key, passed, NULL, report.buffer);
+                    g_free(key);
+                }
 
-                int64_t pts_delta = segment2->actual_start[content_component] - segment1->actual_end[content_component];
-                g_string_append_printf(line, "%"PRId64"\t", pts_delta);
+                for (; s_i < s_end; ++s_i) {
+                    segment_t* segment = g_ptr_array_index(representation->segments, s_i);
+                    segment_prefetcher_advance(prefetcher, s_i);
+                    g_string_truncate(report.buffer, 0);
+                    passed = validate_representation_segment(representation, adaptation_set, segment,
+                            validator_init_segment);
+                    gchar* key = g_strdup_printf("%zu/%zu/%zu/%zu", p_i, a_i, r_i, s_i);
+                    send_worker_result(key, passed, segment, report.buffer);
+                    g_free(key);
+                }
+                segment_prefetcher_free(prefetcher);
+                dash_validator_free(validator_init_segment);
             }
-            g_log(G_LOG_DOMAIN, flags, "%s", line->str);
         }
-        g_log(G_LOG_DOMAIN, flags, " ");
-        g_string_free(line, true);
     }
+    g_set_print_handler(NULL);
+    g_private_set(&current_report, NULL);
+    g_string_free(report.buffer, true);
+    mpd_free(mpd);
+    return 0;
+}
+
+/* Writes what a worker found out about a Representation (without segment) or one of its segments. key is the
+ * period/adaptation set/representation[/segment] indexes in the MPD, and text is what was printed while validating
+ * it. */
+void send_worker_result(const char* key, bool passed, segment_t* segment, const GString* text)
+{
+    GString* result = g_string_new("{\"key\":");
+    json_append_string(result, key);
+    g_string_append_printf(result, ",\"passed\":%s,\"text\":", passed ? "true" : "false");
+    json_append_string(result, text->str);
+    if (segment) {
+        segment_summary_t* summary = segment->arg;
+        g_string_append_printf(result, ",\"encrypted\":%s,\"pat\":%"PRIu32",\"pmt\":%"PRIu32",\"cat\":%"PRIu32
+                ",\"sap\":%s", summary->is_encrypted ? "true" : "false", summary->pat_fingerprint,
+                summary->pmt_fingerprint, summary->cat_fingerprint, summary->starts_with_sap ? "true" : "false");
+        g_string_append(result, ",\"splice points\":[");
+        for (gsize i = 0; i < summary->splice_points->len; ++i) {
+            g_string_append_printf(result, "%s%"PRIu64, i ? "," : "",
+                    g_array_index(summary->splice_points, uint64_t, i));
+        }
+        g_string_append_c(result, ']');
+        for (content_component_t i = 0; i < NUM_CONTENT_COMPONENTS; ++i) {
+            g_string_append_printf(result, ",\"%s start\":%"PRIu64",\"%s end\":%"PRIu64,
+                    content_component_to_string(i), segment->actual_start[i],
+                    content_component_to_string(i), segment->actual_end[i]);
+        }
+    }
+    g_string_append(result, "}\n");
+    fwrite(result->str, 1, result->len, stdout);
+    fflush(stdout);
+    g_string_free(result, true);
+}
+
+/* Collects a worker's output on its own thread, so no worker blocks on a full pipe */
+gpointer read_worker_output(gpointer data)
+{
+    worker_output_t* output = data;
+    GString* line = g_string_new(NULL);
+    while (read_line(output->file, line)) {
+        g_ptr_array_add(output->lines, g_strdup(line->str));
+    }
+    g_string_free(line, true);
+    return NULL;
+}
+
+/* Adds a line written by send_worker_result() to worker_results, keyed by its key. name is where it came from, for
+ * error messages. */
+bool add_worker_result(GHashTable* worker_results, const char* line, const char* name)
+{
+    GHashTable* fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    const char* raw_key;
+    gchar* key;
+    if (!json_parse_object(line, fields) || (raw_key = g_hash_table_lookup(fields, "key")) == NULL
+            || (key = json_string_value(raw_key)) == NULL) {
+        g_critical("Invalid worker result in %s: %s", name, line);
+        g_hash_table_destroy(fields);
+        return false;
+    }
+    g_hash_table_replace(worker_results, key, fields);
+    return true;
+}
+
+/* Prints the result a worker sent for key, and if it's for a segment, sets the segment's times and summary. name is the
+ * Representation or segment, for error messages. Returns the result's pass/fail. */
+bool use_worker_result(GHashTable* worker_results, const char* key, const char* name, segment_t* segment)
+{
+    GHashTable* fields = g_hash_table_lookup(worker_results, key);
+    const char* raw_text = fields ? g_hash_table_lookup(fields, "text") : NULL;
+    gchar* text = raw_text ? json_string_value(raw_text) : NULL;
+    if (text == NULL) {
+        g_critical("No result from the workers for %s (%s)", name, key);
+        return false;
+    }
+    g_print("%s", text);
+    g_free(text);
+
+    bool valid = true;
+    if (segment) {
+        segment_summary_t* summary = g_slice_new0(segment_summary_t);
+        const char* value = g_hash_table_lookup(fields, "encrypted");
+        summary->is_encrypted = value && !strcmp(value, "true");
+        value = g_hash_table_lookup(fields, "pat");
+        summary->pat_fingerprint = value ? strtoul(value, NULL, 10) : 0;
+        value = g_hash_table_lookup(fields, "pmt");
+        summary->pmt_fingerprint = value ? strtoul(value, NULL, 10) : 0;
+        value = g_hash_table_lookup(fields, "cat");
+        summary->cat_fingerprint = value ? strtoul(value, NULL, 10) : 0;
+        value = g_hash_table_lookup(fields, "sap");
+        summary->starts_with_sap = value && !strcmp(value, "true");
+        value = g_hash_table_lookup(fields, "splice points");
+        summary->splice_points = value ? json_uint64_array_value(value) : NULL;
+        if (summary->splice_points == NULL) {
+            g_critical("Invalid splice points from the workers for %s (%s)", name, key);
+            summary->splice_points = g_array_new(false, false, sizeof(uint64_t));
+            valid = false;
+        }
+        segment->arg = summary;
+        segment->arg_free = (free_func_t)segment_summary_free;
+
+        for (content_component_t i = 0; i < NUM_CONTENT_COMPONENTS; ++i) {
+            gchar* field = g_strdup_printf("%s start", content_component_to_string(i));
+            value = g_hash_table_lookup(fields, field);
+            segment->actual_start[i] = value ? g_ascii_strtoull(value, NULL, 10) : 0;
+            g_free(field);
+            field = g_strdup_printf("%s end", content_component_to_string(i));
+            value = g_hash_table_lookup(fields, field);
+            segment->actual_end[i] = value ? g_ascii_strtoull(value, NULL, 10) : 0;
+            g_free(field);
+        }
+    }
+
+    const char* passed = g_hash_table_lookup(fields, "passed");
+    return valid && passed && !strcmp(passed, "true");
+}
+
+/* Validates an MPD with num_shards worker processes running program_name --worker, and then runs the checks across
+ * segments and Representations on their results. The workers get the same options as this process. */
+int validate_sharded(char* file_name, const char* program_name, unsigned num_shards, bool* completed)
+{
+    GHashTable* worker_results = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify)g_hash_table_destroy);
+    GPid* pids = g_new0(GPid, num_shards);
+    worker_output_t* outputs = g_new0(worker_output_t, num_shards);
+    GThread** threads = g_new0(GThread*, num_shards);
+    bool workers_ok = true;
+
+    GPtrArray* args = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(args, g_strdup(program_name));
+    g_ptr_array_add(args, NULL); /* --worker= */
+    for (int level = TSLIB_LOG_LEVEL_DEFAULT; level < tslib_loglevel; ++level) {
+        g_ptr_array_add(args, g_strdup("--verbose"));
+    }
+    if (segment_reader_pipeline_depth) {
+        g_ptr_array_add(args, g_strdup_printf("--pipeline=%u", segment_reader_pipeline_depth));
+    }
+    g_ptr_array_add(args, g_strdup_printf("--parser-threads=%u", segment_reader_parser_threads));
+    g_ptr_array_add(args, g_strdup_printf("--read-ahead=%u", segment_prefetch_depth));
+    g_ptr_array_add(args, g_strdup_printf("--max-open-files=%u", file_cache_max_open));
+    if (segment_validator_pid_threads) {
+        g_ptr_array_add(args, g_strdup_printf("--pid-threads=%u", segment_validator_pid_threads));
+    }
+    if (key_file_name) {
+        g_ptr_array_add(args, g_strdup_printf("--keys=%s", key_file_name));
+    }
+    if (segment_validator_frame_index) {
+        g_ptr_array_add(args, g_strdup("--frame-index"));
+    }
+    if (reuse_frame_index) {
+        g_ptr_array_add(args, g_strdup("--reuse-frame-index"));
+    }
+    g_ptr_array_add(args, g_strdup(file_name));
+    g_ptr_array_add(args, NULL);
+
+    for (unsigned i = 0; i < num_shards; ++i) {
+        g_free(args->pdata[1]);
+        args->pdata[1] = g_strdup_printf("--worker=%u/%u", i, num_shards);
+        GError* error = NULL;
+        int output_fd;
+        GSpawnFlags flags = G_SPAWN_DO_NOT_REAP_CHILD | (strchr(program_name, '/') ? 0 : G_SPAWN_SEARCH_PATH);
+        if (!g_spawn_async_with_pipes(NULL, (gchar**)args->pdata, NULL, flags, NULL, NULL, &pids[i], NULL,
+                &output_fd, NULL, &error)) {
+            g_critical("Cannot start worker %u - %s", i, error->message);
+            g_error_free(error);
+            workers_ok = false;
+            continue;
+        }
+        outputs[i].file = fdopen(output_fd, "r");
+        outputs[i].lines = g_ptr_array_new_with_free_func(g_free);
+        threads[i] = g_thread_new("worker-output", read_worker_output, &outputs[i]);
+    }
+    g_ptr_array_free(args, true);
+
+    for (unsigned i = 0; i < num_shards; ++i) {
+        if (threads[i] == NULL) {
+            continue;
+        }
+        g_thread_join(threads[i]);
+        fclose(outputs[i].file);
+        int status;
+        if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            g_critical("Worker %u did not finish", i);
+            workers_ok = false;
+        }
+        g_spawn_close_pid(pids[i]);
+
+        gchar* name = g_strdup_printf("worker %u", i);
+        for (size_t j = 0; j < outputs[i].lines->len; ++j) {
+            workers_ok &= add_worker_result(worker_results, g_ptr_array_index(outputs[i].lines, j), name);
+        }
+        g_free(name);
+        g_ptr_array_free(outputs[i].lines, true);
+    }
+
+    int status = validate_mpd(file_name, worker_results, completed) && workers_ok;
+
+    g_hash_table_destroy(worker_results);
+    g_free(threads);
+    g_free(outputs);
+    g_free(pids);
+    return status;
+}
+
+/* Runs the checks across segments and Representations on results that --worker processes wrote to files, so workers
+ * can run anywhere that sees the same files. */
+int merge_worker_results(char* file_name, char** result_file_names, size_t num_result_files, bool* completed)
+{
+    GHashTable* worker_results = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify)g_hash_table_destroy);
+    bool results_ok = true;
+    GString* line = g_string_new(NULL);
+    for (size_t i = 0; i < num_result_files; ++i) {
+        FILE* file = strcmp(result_file_names[i], "-") ? fopen(result_file_names[i], "r") : stdin;
+        if (file == NULL) {
+            g_critical("Cannot open worker results %s - %s", result_file_names[i], strerror(errno));
+            results_ok = false;
+            continue;
+        }
+        while (read_line(file, line)) {
+            results_ok &= add_worker_result(worker_results, line->str, result_file_names[i]);
+        }
+        if (file != stdin) {
+            fclose(file);
+        }
+    }
+    g_string_free(line, true);
+
+    int status = validate_mpd(file_name, worker_results, completed) && results_ok;
+    g_hash_table_destroy(worker_results);
     return status;
 }
 
+daemon_connection_t* daemon_connection_new(int fd, GThreadPool* pool)
+{
+    daemon_connection_t* connection = g_slice_new0(daemon_connection_t);
+    connection->fd = fd;
+    connection->pool = pool;
+    connection->refcount = 1;
+    g_mutex_init(&connection->mutex);
+    return connection;
+}
+
+/* The socket is closed once the client's requests are all finished, so the client knows there's nothing left */
+void daemon_connection_unref(daemon_connection_t* connection)
+{
+    if (connection == NULL || !g_atomic_int_dec_and_test(&connection->refcount)) {
+        return;
+    }
+    close(connection->fd);
+    g_mutex_clear(&connection->mutex);
+    g_slice_free(daemon_connection_t, connection);
+}
+
+/* Sends a record like {"type":"output","id":1,"text":"..."}. id is JSON, and value is a string, or JSON if key is
+ * NULL. */
+void daemon_send(daemon_connection_t* connection, const char* type, const char* id, const char* key,
+        const char* value)
+{
+    GString* record = g_string_new("{\"type\":");
+    json_append_string(record, type);
+    g_string_append_printf(record, ",\"id\":%s", id ? id : "null");
+    if (key) {
+        g_string_append_c(record, ',');
+        json_append_string(record, key);
+        g_string_append_c(record, ':');
+        json_append_string(record, value);
+    } else if (value) {
+        g_string_append_printf(record, ",%s", value);
+    }
+    g_string_append(record, "}\n");
+
+    g_mutex_lock(&connection->mutex);
+    for (size_t written = 0; !connection->failed && written < record->len;) {
+        ssize_t result = write(connection->fd, record->str + written, record->len - written);
+        if (result < 0 && errno != EINTR) {
+            /* Including EAGAIN after DAEMON_SEND_TIMEOUT. Jobs that already started keep running, but there's nobody
+             * to tell about them. */
+            connection->failed = true;
+        } else if (result > 0) {
+            written += result;
+        }
+    }
+    g_mutex_unlock(&connection->mutex);
+    g_string_free(record, true);
+}
+
+/* Requests look like {"id": 1, "mpd": "/path/to/manifest.mpd"} or {"segment": "/path/to/segment.ts", "init":
+ * "/path/to/init.ts"}. "id" is optional, and defaults to the request's number on its connection. */
+daemon_job_t* daemon_job_new(daemon_connection_t* connection, const char* request, size_t request_num,
+        GString* error)
+{
+    daemon_job_t* job = NULL;
+    GHashTable* fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if (!json_parse_object(request, fields)) {
+        g_string_assign(error, "Request is not a JSON object with only string and number values");
+        goto cleanup;
+    }
+
+    job = g_slice_new0(daemon_job_t);
+    job->connection = connection;
+    const char* id = g_hash_table_lookup(fields, "id");
+    job->id = id ? g_strdup(id) : g_strdup_printf("%zu", request_num);
+    const char* mpd = g_hash_table_lookup(fields, "mpd");
+    const char* segment = g_hash_table_lookup(fields, "segment");
+    const char* initialization = g_hash_table_lookup(fields, "init");
+    job->mpd_file_name = mpd ? json_string_value(mpd) : NULL;
+    job->segment_file_name = segment ? json_string_value(segment) : NULL;
+    job->initialization_file_name = initialization ? json_string_value(initialization) : NULL;
+    if ((mpd && !job->mpd_file_name) || (segment && !job->segment_file_name)
+            || (initialization && !job->initialization_file_name)) {
+        g_string_assign(error, "\"mpd\", \"segment\" and \"init\" have to be strings");
+    } else if (!job->mpd_file_name == !job->segment_file_name) {
+        g_string_assign(error, "Request needs either \"mpd\" or \"segment\"");
+    } else if (job->mpd_file_name && job->initialization_file_name) {
+        g_string_assign(error, "\"init\" only goes with \"segment\"");
+    }
+cleanup:
+    g_hash_table_destroy(fields);
+    return job;
+}
+
+void daemon_job_free(daemon_job_t* job)
+{
+    if (job == NULL) {
+        return;
+    }
+    g_free(job->id);
+    g_free(job->mpd_file_name);
+    g_free(job->segment_file_name);
+    g_free(job->initialization_file_name);
+    g_slice_free(daemon_job_t, job);
+}
+
+void run_daemon_job(gpointer data, gpointer user_data)
+{
+    daemon_job_t* job = data;
+    g_mutex_lock(&job->connection->mutex);
+    bool failed = job->connection->failed;
+    g_mutex_unlock(&job->connection->mutex);
+    if (failed) {
+        goto cleanup;
+    }
+
+    report_t report = { .connection = job->connection, .id = job->id };
+    g_private_set(&current_report, &report);
+    bool passed;
+    if (job->mpd_file_name) {
+        bool completed;
+        passed = validate_mpd(job->mpd_file_name, NULL, &completed) && completed;
+    } else {
+        passed = validate_single_segment(job->segment_file_name, job->initialization_file_name);
+    }
+    g_private_set(&current_report, NULL);
+
+    daemon_send(job->connection, "result", job->id, NULL, passed ? "\"passed\":true" : "\"passed\":false");
+cleanup:
+    daemon_connection_unref(job->connection);
+    daemon_job_free(job);
+}
+
+/* Reads one request per line until the client is done sending them */
+gpointer daemon_connection_thread(gpointer data)
+{
+    daemon_connection_t* connection = data;
+    int read_fd = dup(connection->fd);
+    FILE* input = read_fd < 0 ? NULL : fdopen(read_fd, "r");
+    if (input == NULL) {
+        g_critical("Cannot read from daemon connection - %s", strerror(errno));
+        if (read_fd >= 0) {
+            close(read_fd);
+        }
+        goto cleanup;
+    }
+
+    GString* request = g_string_new(NULL);
+    GString* error = g_string_new(NULL);
+    size_t request_num = 0;
+    while (read_line(input, request)) {
+        g_strstrip(request->str);
+        if (request->str[0] != 0) {
+            ++request_num;
+            g_string_truncate(error, 0);
+            daemon_job_t* job = daemon_job_new(connection, request->str, request_num, error);
+            if (error->len == 0) {
+                g_atomic_int_inc(&connection->refcount);
+                g_thread_pool_push(connection->pool, job, NULL);
+            } else {
+                char* id = job ? job->id : NULL;
+                gchar* default_id = id ? NULL : g_strdup_printf("%zu", request_num);
+                daemon_send(connection, "error", id ? id : default_id, "message", error->str);
+                g_free(default_id);
+                daemon_job_free(job);
+            }
+        }
+    }
+    g_string_free(request, true);
+    g_string_free(error, true);
+    fclose(input);
+cleanup:
+    daemon_connection_unref(connection);
+    return NULL;
+}
+
+/* Listens on socket_path and validates MPDs and segments that clients ask for, so the process (and the file cache)
+ * stays warm between jobs. Only returns if the socket can't be used. */
+int run_daemon(const char* socket_path, unsigned jobs)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        g_critical("Socket path %s is too long", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        g_critical("Cannot create socket - %s", strerror(errno));
+        return 1;
+    }
+    /* A socket left over from an earlier daemon would make bind() fail, but anything else at socket_path is probably
+     * there by mistake, so it's left alone */
+    struct stat st;
+    if (lstat(socket_path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            g_critical("Cannot listen on %s - it exists and isn't a socket", socket_path);
+            close(listen_fd);
+            return 1;
+        }
+        unlink(socket_path);
+    }
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+        g_critical("Cannot listen on %s - %s", socket_path, strerror(errno));
+        close(listen_fd);
+        return 1;
+    }
+
+    /* Clients that hang up early shouldn't kill the daemon */
+    signal(SIGPIPE, SIG_IGN);
+    xmlInitParser();
+    g_set_print_handler(print_to_report);
+    GThreadPool* pool = g_thread_pool_new(run_daemon_job, NULL, jobs, false, NULL);
+    g_print("Listening on %s\n", socket_path);
+    fflush(stdout);
+
+    while (true) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            g_critical("Cannot accept connection on %s - %s", socket_path, strerror(errno));
+            break;
+        }
+        struct timeval timeout = { .tv_sec = DAEMON_SEND_TIMEOUT };
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0) {
+            g_critical("Cannot set send timeout on daemon connection - %s", strerror(errno));
+            close(fd);
+            continue;
+        }
+        daemon_connection_t* connection = daemon_connection_new(fd, pool);
+        g_thread_unref(g_thread_new("daemon-connection", daemon_connection_thread, connection));
+        file_cache_close_unused();
+    }
+
+    g_thread_pool_free(pool, false, true);
+    g_set_print_handler(NULL);
+    close(listen_fd);
+    unlink(socket_path);
+    xmlCleanupParser();
+    return 1;
+}
+
 int check_segment_timing(GPtrArray* segments, content_component_t content_component)
 {
     if (segments->len == 0) {
@@ -584,21 +1621,108 @@ int check_segment_timing(GPtrArray* segments, content_component_t content_compon
     return status;
 }
 
+static gint compare_uint64(gconstpointer a, gconstpointer b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Checks that splice points signaled with SCTE 35 are at the start of a segment, so a splice doesn't need to cut into
+ * one, and that video segments that start at a splice point start with a SAP of type 1 or 2 on every video PID, so the
+ * stream can be joined there. Splice points are usually signaled ahead of time, so they're checked against every
+ * segment in the Representation and not just the one they were in. Times are compared modulo 2^33, since the PTS can
+ * wrap around between a segment's start and a splice point in it. */
+int check_splice_points(GPtrArray* segments)
+{
+    int status = 1;
+    content_component_t content_component = AUDIO_CONTENT_COMPONENT;
+    GArray* splice_points = g_array_new(false, false, sizeof(uint64_t));
+    for (gsize i = 0; i < segments->len; ++i) {
+        segment_t* segment = g_ptr_array_index(segments, i);
+        segment_summary_t* summary = segment->arg;
+        if (summary == NULL) {
+            continue;
+        }
+        if (segment->actual_end[VIDEO_CONTENT_COMPONENT] != 0) {
+            content_component = VIDEO_CONTENT_COMPONENT;
+        }
+        g_array_append_vals(splice_points, summary->splice_points->data, summary->splice_points->len);
+    }
+    g_array_sort(splice_points, compare_uint64);
+
+    for (gsize i = 0; i < splice_points->len; ++i) {
+        uint64_t pts = g_array_index(splice_points, uint64_t, i);
+        if (i > 0 && pts == g_array_index(splice_points, uint64_t, i - 1)) {
+            continue;
+        }
+
+        segment_t* segment = NULL;
+        for (gsize j = 0; j < segments->len && segment == NULL; ++j) {
+            segment_t* current = g_ptr_array_index(segments, j);
+            uint64_t start = current->actual_start[content_component];
+            uint64_t duration = current->actual_end[content_component] - start;
+            if (current->arg != NULL && (pts - start) % PTS_ROLLOVER < duration) {
+                segment = current;
+            }
+        }
+        if (segment == NULL) {
+            g_info("SCTE 35: Splice point at PTS %"PRIu64" isn't in any segment", pts);
+            continue;
+        }
+
+        if ((pts - segment->actual_start[content_component]) % PTS_ROLLOVER != 0) {
+            g_critical("SCTE 35: Splice point at PTS %"PRIu64" is inside segment %s (%s starts at %"PRIu64"), instead "
+                    "of at a segment boundary.", pts, segment->file_name,
+                    content_component_to_string(content_component), segment->actual_start[content_component]);
+            status = 0;
+        } else if (content_component == VIDEO_CONTENT_COMPONENT
+                && !((segment_summary_t*)segment->arg)->starts_with_sap) {
+            g_critical("SCTE 35: Segment %s starts at the splice point at PTS %"PRIu64", but doesn't start with a SAP "
+                    "of type 1 or 2.", segment->file_name, pts);
+            status = 0;
+        }
+    }
+    g_array_free(splice_points, true);
+    return status;
+}
+
 bool check_segment_psi_identical(const char* f1, dash_validator_t* v1, const char* f2, dash_validator_t* v2)
 {
     g_return_val_if_fail(v1 != NULL, false);
     g_return_val_if_fail(v2 != NULL, false);
 
     bool identical = true;
-    if (!program_association_section_equal(v1->pat, v2->pat)) {
+    if (v1->pat_fingerprint != v2->pat_fingerprint) {
+        g_warning("PAT in segments %s and %s are not identical.", f1, f2);
+        identical = false;
+    }
+    if (v1->pmt_fingerprint != v2->pmt_fingerprint) {
+        g_warning("PMT in segments %s and %s are not identical.", f1, f2);
+        identical = false;
+    }
+    if (v1->cat_fingerprint != v2->cat_fingerprint) {
+        g_warning("CAT in segments %s and %s are not identical.", f1, f2);
+        identical = false;
+    }
+    return identical;
+}
+
+bool check_segment_summary_psi_identical(const char* f1, segment_summary_t* s1, const char* f2, segment_summary_t* s2)
+{
+    g_return_val_if_fail(s1 != NULL, false);
+    g_return_val_if_fail(s2 != NULL, false);
+
+    bool identical = true;
+    if (s1->pat_fingerprint != s2->pat_fingerprint) {
         g_warning("PAT in segments %s and %s are not identical.", f1, f2);
         identical = false;
     }
-    if (!program_map_section_equal(v1->pmt, v2->pmt)) {
+    if (s1->pmt_fingerprint != s2->pmt_fingerprint) {
         g_warning("PMT in segments %s and %s are not identical.", f1, f2);
         identical = false;
     }
-    if (!conditional_access_section_equal(v1->cat, v2->cat)) {
+    if (s1->cat_fingerprint != s2->cat_fingerprint) {
         g_warning("CAT in segments %s and %s are not identical.", f1, f2);
         identical = false;
     }
@@ -620,7 +1744,8 @@ bool check_psi_identical(GPtrArray* representations)
             }
             segment_t* current = g_ptr_array_index(representation->segments, s_i);
 
-            if (!check_segment_psi_identical(reference->file_name, reference->arg, current->file_name, current->arg)) {
+            if (!check_segment_summary_psi_identical(reference->file_name, reference->arg, current->file_name,
+                    current->arg)) {
                 identical = false;
             }
         }
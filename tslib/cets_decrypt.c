@@ -0,0 +1,167 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cets_decrypt.h"
+
+#include <string.h>
+#include <openssl/evp.h>
+
+
+static bool read_hex(const char* hex, size_t hex_len, uint8_t* out, size_t out_len)
+{
+    if (hex_len != out_len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < out_len; ++i) {
+        int high = g_ascii_xdigit_value(hex[i * 2]);
+        int low = g_ascii_xdigit_value(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out[i] = high << 4 | low;
+    }
+    return true;
+}
+
+cets_keys_t* cets_keys_read_file(const char* file_name)
+{
+    g_return_val_if_fail(file_name, NULL);
+
+    cets_keys_t* keys = NULL;
+    gchar** lines = NULL;
+    gchar* contents = NULL;
+    GError* error = NULL;
+    if (!g_file_get_contents(file_name, &contents, NULL, &error)) {
+        g_critical("Can't read key file %s: %s", file_name, error->message);
+        g_error_free(error);
+        goto fail;
+    }
+
+    keys = g_slice_new0(cets_keys_t);
+    keys->keys = g_array_new(false, false, sizeof(cets_key_t));
+    lines = g_strsplit(contents, "\n", -1);
+    for (size_t i = 0; lines[i]; ++i) {
+        gchar* line = g_strstrip(lines[i]);
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+        const char* colon = strchr(line, ':');
+        cets_key_t key;
+        if (colon == NULL || !read_hex(line, colon - line, key.key_id, sizeof(key.key_id))
+                || !read_hex(colon + 1, strlen(colon + 1), key.key, sizeof(key.key))) {
+            g_critical("Invalid line %zu in key file %s. Each line should be KID:KEY, with each one 32 hex digits.",
+                    i + 1, file_name);
+            goto fail;
+        }
+        g_array_append_val(keys->keys, key);
+    }
+
+cleanup:
+    g_strfreev(lines);
+    g_free(contents);
+    return keys;
+fail:
+    cets_keys_free(keys);
+    keys = NULL;
+    goto cleanup;
+}
+
+void cets_keys_free(cets_keys_t* keys)
+{
+    if (keys == NULL) {
+        return;
+    }
+    g_array_free(keys->keys, true);
+    g_slice_free(cets_keys_t, keys);
+}
+
+const uint8_t* cets_keys_find(const cets_keys_t* keys, const uint8_t* key_id)
+{
+    g_return_val_if_fail(keys, NULL);
+    g_return_val_if_fail(key_id, NULL);
+
+    for (size_t i = 0; i < keys->keys->len; ++i) {
+        const cets_key_t* key = &g_array_index(keys->keys, cets_key_t, i);
+        if (!memcmp(key->key_id, key_id, sizeof(key->key_id))) {
+            return key->key;
+        }
+    }
+    return NULL;
+}
+
+cets_decryptor_t* cets_decryptor_new(void)
+{
+    cets_decryptor_t* obj = g_slice_new0(cets_decryptor_t);
+    obj->ctx = EVP_CIPHER_CTX_new();
+    if (obj->ctx == NULL) {
+        /* It can only run out of memory, which GLib allocations abort on too */
+        g_error("Cannot create an OpenSSL cipher context for decrypting");
+    }
+    return obj;
+}
+
+void cets_decryptor_free(cets_decryptor_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    EVP_CIPHER_CTX_free(obj->ctx);
+    g_slice_free(cets_decryptor_t, obj);
+}
+
+bool cets_decryptor_decrypt(cets_decryptor_t* decryptor, const cets_au_key_t* au_key, uint8_t* data, size_t len)
+{
+    g_return_val_if_fail(decryptor, false);
+    g_return_val_if_fail(au_key, false);
+    g_return_val_if_fail(data || len == 0, false);
+
+    if (au_key->key == NULL || (au_key->iv_size != 8 && au_key->iv_size != 16) || au_key->byte_offset > len) {
+        return false;
+    }
+
+    uint8_t counter[16] = {0};
+    memcpy(counter, au_key->iv, au_key->iv_size);
+
+    /* Only give OpenSSL the key if it changed, so it keeps the key schedule */
+    const EVP_CIPHER* cipher = NULL;
+    const uint8_t* key = NULL;
+    if (!decryptor->has_key || memcmp(decryptor->key, au_key->key, sizeof(decryptor->key))) {
+        cipher = EVP_aes_128_ctr();
+        key = au_key->key;
+        memcpy(decryptor->key, key, sizeof(decryptor->key));
+        decryptor->has_key = true;
+    }
+    int out_len;
+    uint8_t* encrypted = data + au_key->byte_offset;
+    if (!EVP_DecryptInit_ex(decryptor->ctx, cipher, NULL, key, counter)
+            || !EVP_DecryptUpdate(decryptor->ctx, encrypted, &out_len, encrypted, len - au_key->byte_offset)) {
+        decryptor->has_key = false;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_CETS_DECRYPT_H
+#define TSLIB_CETS_DECRYPT_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define CETS_KEY_SIZE 16
+
+typedef struct {
+    uint8_t key_id[CETS_KEY_SIZE];
+    uint8_t key[CETS_KEY_SIZE];
+} cets_key_t;
+
+/* Content keys for decrypting CETS encrypted TS packets, by key ID */
+typedef struct {
+    GArray* keys; /* cets_key_t */
+} cets_keys_t;
+
+/* Reads a key file with one KID:KEY pair per line, each 32 hex digits. Blank lines and lines starting with # are
+ * ignored. Returns NULL if the file can't be read or has an invalid line. */
+cets_keys_t* cets_keys_read_file(const char* file_name);
+void cets_keys_free(cets_keys_t*);
+/* Returns the key with the given key ID, or NULL if there isn't one */
+const uint8_t* cets_keys_find(const cets_keys_t*, const uint8_t* key_id);
+
+/* How to decrypt one scrambled TS packet payload, from an AU in a CETS ECM */
+typedef struct {
+    uint8_t key_id[CETS_KEY_SIZE];
+    const uint8_t* key; /* NULL if the key isn't known */
+    uint8_t iv[16];
+    uint8_t iv_size; /* 8 or 16 */
+    uint64_t byte_offset; /* bytes at the start of the payload that aren't encrypted */
+} cets_au_key_t;
+
+/* Decrypts AES-128 CTR encrypted payloads. The key schedule is only set up again when the key changes, so decrypting
+ * a run of packets with the same key only costs the AES rounds, which OpenSSL runs with AES-NI or VAES when the CPU
+ * has them. */
+typedef struct {
+    struct evp_cipher_ctx_st* ctx;
+    uint8_t key[CETS_KEY_SIZE];
+    bool has_key;
+} cets_decryptor_t;
+
+cets_decryptor_t* cets_decryptor_new(void);
+void cets_decryptor_free(cets_decryptor_t*);
+/* Decrypts data in place, leaving the first au_key->byte_offset bytes alone. An 8 byte IV is the upper half of the
+ * initial counter block, like in Common Encryption. Returns false if the AU can't be used to decrypt data. */
+bool cets_decryptor_decrypt(cets_decryptor_t*, const cets_au_key_t* au_key, uint8_t* data, size_t len);
+
+#endif
@@ -47,11 +47,9 @@ void cets_ecm_free(cets_ecm_t* obj)
     g_slice_free(cets_ecm_t, obj);
 }
 
-cets_ecm_t* cets_ecm_read(uint8_t* data, size_t len)
+/* Reads a CETS ECM into ecm. The AUs are only kept if read_au is true. Returns false if the ECM is invalid. */
+static bool cets_ecm_read_fields(cets_ecm_t* ecm, const uint8_t* data, size_t len, bool read_au)
 {
-    g_return_val_if_fail(data, NULL);
-
-    cets_ecm_t* ecm = cets_ecm_new();
     bitreader_new_stack(b, data, len);
 
     ecm->num_states = bitreader_read_bits(b, 2);
@@ -66,6 +64,16 @@ cets_ecm_t* cets_ecm_read(uint8_t* data, size_t len)
         cets_ecm_state_t* state = &ecm->states[i];
         state->transport_scrambling_control = bitreader_read_bits(b, 2);
         state->num_au = bitreader_read_bits(b, 6);
+        if (!read_au) {
+            state->au = NULL;
+            for (size_t j = 0; j < state->num_au; ++j) {
+                bool key_id_flag = bitreader_read_bit(b);
+                bitreader_skip_bits(b, 3); // reserved
+                uint8_t byte_offset_size = bitreader_read_bits(b, 4);
+                bitreader_skip_bits(b, ((key_id_flag ? 16 : 0) + byte_offset_size + ecm->iv_size) * 8);
+            }
+            continue;
+        }
         state->au = g_slice_alloc(state->num_au * sizeof(*state->au));
         for (size_t j = 0; j < state->num_au; ++j) {
             cets_ecm_au_t* au = &state->au[j];
@@ -94,17 +102,29 @@ cets_ecm_t* cets_ecm_read(uint8_t* data, size_t len)
     /* TODO: Remove this skip if MPEG fixes the spec to be byte aligned */
     bitreader_skip_bits(b, 2);
 
-    if (b->error || !bitreader_eof(b)) {
-        /* Adaptation field stuffing shall be used for smaller cets_ecm sizes. */
-        goto fail;
-    }
+    /* Adaptation field stuffing shall be used for smaller cets_ecm sizes. */
+    return !b->error && bitreader_eof(b);
+}
+
+cets_ecm_t* cets_ecm_read(uint8_t* data, size_t len)
+{
+    g_return_val_if_fail(data, NULL);
 
-cleanup:
+    cets_ecm_t* ecm = cets_ecm_new();
+    if (!cets_ecm_read_fields(ecm, data, len, true)) {
+        cets_ecm_free(ecm);
+        return NULL;
+    }
     return ecm;
-fail:
-    cets_ecm_free(ecm);
-    ecm = NULL;
-goto cleanup;
+}
+
+bool cets_ecm_read_states(const uint8_t* data, size_t len, cets_ecm_t* ecm)
+{
+    g_return_val_if_fail(data, false);
+    g_return_val_if_fail(ecm, false);
+
+    *ecm = (cets_ecm_t){0};
+    return cets_ecm_read_fields(ecm, data, len, false);
 }
 
 void cets_ecm_print(const cets_ecm_t* obj)
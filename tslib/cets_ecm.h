@@ -42,7 +42,7 @@ typedef struct {
 typedef struct {
     uint8_t transport_scrambling_control;
     uint8_t num_au;
-    cets_ecm_au_t* au;
+    cets_ecm_au_t* au; // NULL if read with cets_ecm_read_states()
 } cets_ecm_state_t;
 
 typedef struct {
@@ -56,6 +56,9 @@ typedef struct {
 } cets_ecm_t;
 
 cets_ecm_t* cets_ecm_read(uint8_t* data, size_t len);
+/* Reads a CETS ECM into ecm without allocating anything, skipping the AUs in each state. Returns false if it's
+ * invalid. ecm doesn't need to be freed. */
+bool cets_ecm_read_states(const uint8_t* data, size_t len, cets_ecm_t* ecm);
 void cets_ecm_free(cets_ecm_t*);
 void cets_ecm_print(const cets_ecm_t*);
 
@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "continuity_checker.h"
+
+#include <string.h>
+
+
+/* Not a valid continuity_counter, so we know we haven't seen the PID yet */
+#define NO_CONTINUITY_COUNTER 0xFF
+
+continuity_checker_t* continuity_checker_new(void)
+{
+    continuity_checker_t* obj = g_slice_new0(continuity_checker_t);
+    memset(obj->last_continuity_counter, NO_CONTINUITY_COUNTER, sizeof(obj->last_continuity_counter));
+    obj->errors = g_array_new(false, false, sizeof(continuity_error_t));
+    return obj;
+}
+
+void continuity_checker_free(continuity_checker_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_array_free(obj->errors, true);
+    g_slice_free(continuity_checker_t, obj);
+}
+
+size_t continuity_checker_check(continuity_checker_t* checker, const ts_headers_t* headers, size_t num_packets,
+        uint64_t offset)
+{
+    g_return_val_if_fail(checker, 0);
+    g_return_val_if_fail(headers, 0);
+
+    num_packets = MIN(num_packets, headers->len);
+    size_t num_errors = checker->errors->len;
+    for (size_t i = 0; i < num_packets; ++i) {
+        uint16_t pid = headers->pid[i];
+        uint8_t adaptation_field_control = headers->adaptation_field_control[i];
+        if (pid == PID_NULL || adaptation_field_control == 0) {
+            continue;
+        }
+
+        uint8_t continuity_counter = headers->continuity_counter[i];
+        uint8_t last = checker->last_continuity_counter[pid];
+        checker->last_continuity_counter[pid] = continuity_counter;
+        if (last == NO_CONTINUITY_COUNTER || headers->discontinuity_indicator[i]) {
+            checker->last_was_duplicate[pid] = false;
+            continue;
+        }
+
+        uint8_t expected = last;
+        if (adaptation_field_control & TS_PAYLOAD) {
+            expected = (last + 1) & 0x0F;
+            if (continuity_counter == last && !checker->last_was_duplicate[pid]) {
+                checker->last_was_duplicate[pid] = true;
+                continue;
+            }
+        }
+        checker->last_was_duplicate[pid] = false;
+
+        if (continuity_counter != expected) {
+            continuity_error_t error = {
+                .offset = offset + i * TS_SIZE,
+                .pid = pid,
+                .expected = expected,
+                .actual = continuity_counter
+            };
+            g_array_append_val(checker->errors, error);
+        }
+    }
+    return checker->errors->len - num_errors;
+}
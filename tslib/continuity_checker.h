@@ -0,0 +1,64 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_CONTINUITY_CHECKER_H
+#define TSLIB_CONTINUITY_CHECKER_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "ts.h"
+
+
+typedef struct {
+    uint64_t offset; /* byte offset of the packet in its file */
+    uint16_t pid;
+    uint8_t expected;
+    uint8_t actual;
+} continuity_error_t;
+
+/* Checks continuity_counter for every PID, following 2.4.3.3 of ISO/IEC 13818-1:
+ * - It increments by one (mod 16) for each packet with a payload
+ * - It doesn't increment for packets without a payload
+ * - A packet with a payload may be sent twice in a row, with the same continuity_counter
+ * - Anything goes when discontinuity_indicator is set
+ * Null packets and packets with the reserved adaptation_field_control value are ignored. */
+typedef struct {
+    uint8_t last_continuity_counter[TS_NUM_PIDS];
+    bool last_was_duplicate[TS_NUM_PIDS];
+    GArray* errors; /* continuity_error_t */
+} continuity_checker_t;
+
+continuity_checker_t* continuity_checker_new(void);
+void continuity_checker_free(continuity_checker_t*);
+
+/* Checks the first num_packets headers (or all of them, if there are fewer), which start at byte offset in the file,
+ * and appends any errors found to checker->errors. Returns the number of new errors. */
+size_t continuity_checker_check(continuity_checker_t*, const ts_headers_t*, size_t num_packets, uint64_t offset);
+
+#endif
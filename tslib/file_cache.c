@@ -0,0 +1,232 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "file_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+unsigned file_cache_max_open = FILE_CACHE_DEFAULT_MAX_OPEN;
+
+static GMutex cache_mutex;
+static GHashTable* open_files = NULL; /* file name -> file_handle_t* */
+static GQueue unused_files = G_QUEUE_INIT; /* least recently used first */
+static unsigned num_stale = 0; /* in use, but no longer in open_files */
+
+static void version_from_stat(const struct stat*, file_version_t*);
+static void file_handle_free(file_handle_t*);
+static bool file_handle_is_current(const file_handle_t*);
+static void close_unused(unsigned max_open);
+
+void version_from_stat(const struct stat* st, file_version_t* version)
+{
+    version->dev = st->st_dev;
+    version->ino = st->st_ino;
+    version->size = st->st_size;
+    version->mtime = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+bool file_version_get(const char* file_name, file_version_t* version)
+{
+    g_return_val_if_fail(file_name, false);
+    g_return_val_if_fail(version, false);
+
+    struct stat st;
+    if (stat(file_name, &st)) {
+        return false;
+    }
+    version_from_stat(&st, version);
+    return true;
+}
+
+bool file_version_equal(const file_version_t* a, const file_version_t* b)
+{
+    g_return_val_if_fail(a, false);
+    g_return_val_if_fail(b, false);
+
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size && a->mtime == b->mtime;
+}
+
+void file_handle_free(file_handle_t* handle)
+{
+    if (handle == NULL) {
+        return;
+    }
+    close(handle->fd);
+    g_free(handle->file_name);
+    g_slice_free(file_handle_t, handle);
+}
+
+bool file_handle_is_current(const file_handle_t* handle)
+{
+    file_version_t version;
+    return file_version_get(handle->file_name, &version) && file_version_equal(&version, &handle->version);
+}
+
+/* Must be called with cache_mutex held */
+void close_unused(unsigned max_open)
+{
+    while (open_files && g_hash_table_size(open_files) > max_open && !g_queue_is_empty(&unused_files)) {
+        file_handle_t* handle = g_queue_pop_head(&unused_files);
+        g_hash_table_remove(open_files, handle->file_name);
+        file_handle_free(handle);
+    }
+}
+
+file_handle_t* file_cache_open(const char* file_name)
+{
+    g_return_val_if_fail(file_name, NULL);
+
+    g_mutex_lock(&cache_mutex);
+    if (open_files == NULL) {
+        open_files = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+    file_handle_t* handle = g_hash_table_lookup(open_files, file_name);
+    if (handle && !file_handle_is_current(handle)) {
+        /* Anyone still reading the old file keeps its descriptor, but everyone else gets the new one */
+        g_hash_table_remove(open_files, handle->file_name);
+        if (handle->refcount == 0) {
+            g_queue_unlink(&unused_files, &handle->lru_link);
+            file_handle_free(handle);
+        } else {
+            handle->stale = true;
+            ++num_stale;
+        }
+        handle = NULL;
+    }
+    if (handle) {
+        if (handle->refcount == 0) {
+            g_queue_unlink(&unused_files, &handle->lru_link);
+        }
+        handle->refcount++;
+        g_mutex_unlock(&cache_mutex);
+        return handle;
+    }
+
+    /* Make room for the new descriptor */
+    close_unused(file_cache_max_open > 0 ? file_cache_max_open - 1 : 0);
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+        close_unused(0);
+        fd = open(file_name, O_RDONLY);
+    }
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        int err = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        g_mutex_unlock(&cache_mutex);
+        errno = err;
+        return NULL;
+    }
+
+    handle = g_slice_new0(file_handle_t);
+    handle->file_name = g_strdup(file_name);
+    handle->fd = fd;
+    version_from_stat(&st, &handle->version);
+    handle->refcount = 1;
+    handle->lru_link.data = handle;
+    g_hash_table_insert(open_files, handle->file_name, handle);
+    g_mutex_unlock(&cache_mutex);
+    return handle;
+}
+
+void file_cache_release(file_handle_t* handle)
+{
+    if (handle == NULL) {
+        return;
+    }
+
+    g_mutex_lock(&cache_mutex);
+    if (handle->refcount == 0) {
+        g_critical("Released file %s more times than it was opened.", handle->file_name);
+    } else if (--handle->refcount == 0 && handle->stale) {
+        --num_stale;
+        file_handle_free(handle);
+    } else if (handle->refcount == 0) {
+        g_queue_push_tail_link(&unused_files, &handle->lru_link);
+        close_unused(file_cache_max_open);
+    }
+    g_mutex_unlock(&cache_mutex);
+}
+
+void file_cache_close_unused(void)
+{
+    g_mutex_lock(&cache_mutex);
+    close_unused(0);
+    g_mutex_unlock(&cache_mutex);
+}
+
+unsigned file_cache_num_open(void)
+{
+    g_mutex_lock(&cache_mutex);
+    unsigned num_open = (open_files ? g_hash_table_size(open_files) : 0) + num_stale;
+    g_mutex_unlock(&cache_mutex);
+    return num_open;
+}
+
+bool file_handle_read(file_handle_t* handle, uint64_t offset, void* buf, size_t len, size_t* bytes_read)
+{
+    g_return_val_if_fail(handle, false);
+    g_return_val_if_fail(buf || len == 0, false);
+    g_return_val_if_fail(bytes_read, false);
+
+    *bytes_read = 0;
+    while (*bytes_read < len) {
+        ssize_t n = pread(handle->fd, (uint8_t*)buf + *bytes_read, len - *bytes_read, offset + *bytes_read);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        *bytes_read += n;
+    }
+    return true;
+}
+
+bool file_handle_get_size(file_handle_t* handle, uint64_t* size)
+{
+    g_return_val_if_fail(handle, false);
+    g_return_val_if_fail(size, false);
+
+    struct stat st;
+    if (fstat(handle->fd, &st)) {
+        return false;
+    }
+    *size = st.st_size;
+    return true;
+}
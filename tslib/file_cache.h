@@ -0,0 +1,81 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_FILE_CACHE_H
+#define TSLIB_FILE_CACHE_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+/* Maximum number of descriptors kept open. Files that are in use are never closed, so this is only a limit on how
+ * many unused files we keep around. */
+#define FILE_CACHE_DEFAULT_MAX_OPEN 32
+extern unsigned file_cache_max_open;
+
+/* Identifies one version of a file, so we can tell if it was replaced or changed */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    uint64_t size;
+    int64_t mtime; /* ns */
+} file_version_t;
+
+/* Gets the current version of the file at file_name. Returns false and sets errno if it can't be stat()ed. */
+bool file_version_get(const char* file_name, file_version_t*);
+bool file_version_equal(const file_version_t*, const file_version_t*);
+
+typedef struct {
+    char* file_name;
+    int fd;
+    unsigned refcount;
+    GList lru_link; /* in the unused list while refcount is 0 */
+    file_version_t version; /* when we opened it */
+    bool stale; /* replaced or changed since, so it's closed as soon as it's released */
+} file_handle_t;
+
+/* Returns a shared handle for file_name, opening it if it isn't already open. If the file was replaced or changed
+ * since it was opened, it's opened again. Returns NULL and sets errno if the file can't be opened. Each handle
+ * returned must be released with file_cache_release(). */
+file_handle_t* file_cache_open(const char* file_name);
+void file_cache_release(file_handle_t*);
+
+/* Closes every file that isn't in use */
+void file_cache_close_unused(void);
+
+/* Number of descriptors currently open */
+unsigned file_cache_num_open(void);
+
+/* Reads up to len bytes at offset, stopping early only at the end of the file. Safe to call from multiple threads
+ * on the same handle. Returns false and sets errno on a read error. */
+bool file_handle_read(file_handle_t*, uint64_t offset, void* buf, size_t len, size_t* bytes_read);
+bool file_handle_get_size(file_handle_t*, uint64_t* size);
+
+#endif
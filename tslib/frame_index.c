@@ -0,0 +1,444 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "frame_index.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include "bitreader.h"
+#include "psi.h"
+
+
+/* 'TSFI' */
+#define FRAME_INDEX_MAGIC 0x54534649
+#define FRAME_INDEX_HEADER_SIZE 60
+#define FRAME_INDEX_PID_HEADER_SIZE 36
+#define FRAME_INDEX_FRAME_SIZE 32
+
+frame_index_t* frame_index_new(uint16_t pid, uint8_t stream_type)
+{
+    frame_index_t* index = g_slice_new0(frame_index_t);
+    index->pid = pid;
+    index->stream_type = stream_type;
+    index->frames = g_array_new(false, false, sizeof(frame_t));
+    return index;
+}
+
+void frame_index_free(frame_index_t* index)
+{
+    if (index == NULL) {
+        return;
+    }
+    g_array_free(index->frames, true);
+    g_slice_free(frame_index_t, index);
+}
+
+void frame_index_append(frame_index_t* index, frame_index_t* other)
+{
+    g_return_if_fail(index);
+    g_return_if_fail(other);
+
+    g_array_append_vals(index->frames, other->frames->data, other->frames->len);
+    g_array_set_size(other->frames, 0);
+}
+
+/* Index of the first byte of the next NAL unit (or MPEG-2 video start code value) after a start code at or after
+ * start, or len if there isn't one */
+static size_t next_start_code(const uint8_t* data, size_t len, size_t start)
+{
+    while (start + 3 <= len) {
+        const uint8_t* one = memchr(data + start + 2, 1, len - start - 2);
+        if (one == NULL) {
+            break;
+        }
+        size_t i = one - data;
+        if (data[i - 1] == 0 && data[i - 2] == 0) {
+            return i + 1;
+        }
+        start = i - 1;
+    }
+    return len;
+}
+
+static uint32_t read_exp_golomb(bitreader_t* b)
+{
+    uint8_t leading_zeros = 0;
+    while (!bitreader_read_bit(b) && !b->error) {
+        if (++leading_zeros > 31) {
+            /* Too big for 32 bits, so the slice header is corrupt */
+            bitreader_set_error(b);
+            return 0;
+        }
+    }
+    return (UINT32_C(1) << leading_zeros) - 1 + bitreader_read_bits(b, leading_zeros);
+}
+
+/* slice_type from the start of an AVC slice header, or -1 if it's cut off */
+static int read_avc_slice_type(const uint8_t* data, size_t len)
+{
+    /* Enough for first_mb_in_slice and slice_type, without emulation_prevention_three_byte */
+    uint8_t rbsp[16];
+    size_t rbsp_len = 0;
+    unsigned zeros = 0;
+    for (size_t i = 0; i < len && rbsp_len < sizeof(rbsp); ++i) {
+        if (zeros >= 2 && data[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = data[i] == 0 ? zeros + 1 : 0;
+        rbsp[rbsp_len++] = data[i];
+    }
+
+    bitreader_new_stack(b, rbsp, rbsp_len);
+    read_exp_golomb(b); // first_mb_in_slice
+    uint32_t slice_type = read_exp_golomb(b);
+    return b->error ? -1 : (int)(slice_type % 5);
+}
+
+static void scan_avc(frame_t* frame, const uint8_t* data, size_t len, bool random_access)
+{
+    for (size_t i = next_start_code(data, len, 0); i < len; i = next_start_code(data, len, i)) {
+        uint8_t nal_unit_type = data[i] & 0x1F;
+        if (nal_unit_type != 1 && nal_unit_type != 5) {
+            continue;
+        }
+        switch (read_avc_slice_type(data + i + 1, len - i - 1)) {
+        case 0: /* P */
+        case 3: /* SP */
+            frame->picture_type = PICTURE_TYPE_P;
+            break;
+        case 1:
+            frame->picture_type = PICTURE_TYPE_B;
+            break;
+        case 2: /* I */
+        case 4: /* SI */
+            frame->picture_type = PICTURE_TYPE_I;
+            break;
+        }
+        /* The same SAP types validate_pes_packet() finds */
+        if (nal_unit_type == 5) {
+            frame->sap_type = 1;
+        } else if (random_access) {
+            frame->sap_type = 2;
+        }
+        return;
+    }
+}
+
+static void scan_hevc(frame_t* frame, const uint8_t* data, size_t len)
+{
+    for (size_t i = next_start_code(data, len, 0); i < len; i = next_start_code(data, len, i)) {
+        uint8_t nal_unit_type = (data[i] >> 1) & 0x3F;
+        if (nal_unit_type > 31) {
+            continue;
+        }
+        /* The slice type comes after fields whose sizes are in the PPS, so only IRAP pictures are known to be I */
+        switch (nal_unit_type) {
+        case 18: /* BLA_N_LP */
+        case 20: /* IDR_N_LP */
+            frame->sap_type = 1;
+            break;
+        case 17: /* BLA_W_RADL */
+        case 19: /* IDR_W_RADL */
+            frame->sap_type = 2;
+            break;
+        case 16: /* BLA_W_LP */
+        case 21: /* CRA_NUT */
+            frame->sap_type = 3;
+            break;
+        }
+        if (frame->sap_type) {
+            frame->picture_type = PICTURE_TYPE_I;
+        }
+        return;
+    }
+}
+
+static void scan_mpeg2_video(frame_t* frame, const uint8_t* data, size_t len, bool random_access)
+{
+    for (size_t i = next_start_code(data, len, 0); i < len; i = next_start_code(data, len, i)) {
+        if (data[i] != 0 /* picture_start_code */ || i + 2 >= len) {
+            continue;
+        }
+        /* temporal_reference (10 bits), then picture_coding_type (3 bits) */
+        uint8_t picture_coding_type = (data[i + 2] >> 3) & 0x7;
+        if (picture_coding_type >= PICTURE_TYPE_I && picture_coding_type <= PICTURE_TYPE_B) {
+            frame->picture_type = picture_coding_type;
+        }
+        if (random_access && frame->picture_type == PICTURE_TYPE_I) {
+            frame->sap_type = 1;
+        }
+        return;
+    }
+}
+
+void frame_index_add_pes(frame_index_t* index, const pes_packet_t* pes, uint64_t offset, uint32_t size,
+        bool random_access)
+{
+    g_return_if_fail(index);
+    g_return_if_fail(pes);
+
+    frame_t frame = {
+        .pts = pes->pts,
+        .dts = pes->dts_flag ? pes->dts : pes->pts,
+        .offset = offset,
+        .size = size,
+        .flags = (pes->pts_flag ? FRAME_HAS_PTS : 0) | (pes->dts_flag ? FRAME_HAS_DTS : 0)
+                | (random_access ? FRAME_RANDOM_ACCESS : 0)
+    };
+    switch (index->stream_type) {
+    case STREAM_TYPE_AVC:
+    case STREAM_TYPE_SVC:
+    case STREAM_TYPE_MVC:
+    case STREAM_TYPE_S3D_SC_AVC:
+        scan_avc(&frame, pes->payload, pes->payload_len, random_access);
+        break;
+    case STREAM_TYPE_HEVC:
+        scan_hevc(&frame, pes->payload, pes->payload_len);
+        break;
+    case STREAM_TYPE_MPEG1_VIDEO:
+    case STREAM_TYPE_MPEG2_VIDEO:
+    case STREAM_TYPE_S3D_SC_MPEG2:
+        scan_mpeg2_video(&frame, pes->payload, pes->payload_len, random_access);
+        break;
+    case STREAM_TYPE_MPEG1_AUDIO:
+    case STREAM_TYPE_MPEG2_AUDIO:
+    case STREAM_TYPE_MPEG2_AAC:
+    case STREAM_TYPE_MPEG4_AAC:
+    case STREAM_TYPE_MPEG4_AAC_RAW:
+        frame.sap_type = 1;
+        break;
+    default:
+        frame.sap_type = random_access ? 1 : 0;
+        break;
+    }
+    g_array_append_val(index->frames, frame);
+}
+
+gchar* frame_index_file_name(const char* segment_file_name, uint64_t range_start, uint64_t range_end)
+{
+    g_return_val_if_fail(segment_file_name, NULL);
+
+    if (range_start == 0 && range_end == 0) {
+        return g_strdup_printf("%s.fidx", segment_file_name);
+    }
+    return g_strdup_printf("%s.%"PRIu64"-%"PRIu64".fidx", segment_file_name, range_start, range_end);
+}
+
+static void append_bytes(GByteArray* data, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;) {
+        uint8_t byte = value >> (i * 8);
+        g_byte_array_append(data, &byte, 1);
+    }
+}
+
+frame_index_file_t* frame_index_file_new(void)
+{
+    frame_index_file_t* file = g_slice_new0(frame_index_file_t);
+    file->splice_points = g_array_new(false, false, sizeof(uint64_t));
+    file->indexes = g_ptr_array_new_with_free_func((GDestroyNotify)frame_index_free);
+    return file;
+}
+
+void frame_index_file_free(frame_index_file_t* file)
+{
+    if (file == NULL) {
+        return;
+    }
+    g_array_free(file->splice_points, true);
+    g_ptr_array_free(file->indexes, true);
+    g_slice_free(frame_index_file_t, file);
+}
+
+bool frame_index_file_write(const frame_index_file_t* file, const char* file_name, const char* segment_file_name,
+        const file_version_t* segment_version, uint64_t range_start, uint64_t range_end)
+{
+    g_return_val_if_fail(file, false);
+    g_return_val_if_fail(file_name, false);
+    g_return_val_if_fail(segment_file_name, false);
+    g_return_val_if_fail(segment_version, false);
+
+    file_version_t current_version;
+    if (!file_version_get(segment_file_name, &current_version)) {
+        g_critical("Can't write frame index for %s, because it can't be opened - %s", segment_file_name,
+                strerror(errno));
+        return false;
+    }
+    if (!file_version_equal(&current_version, segment_version)) {
+        g_warning("Not writing frame index for %s, since it changed while it was being validated",
+                segment_file_name);
+        return false;
+    }
+
+    size_t size = FRAME_INDEX_HEADER_SIZE + file->splice_points->len * 8;
+    for (size_t i = 0; i < file->indexes->len; ++i) {
+        frame_index_t* index = g_ptr_array_index(file->indexes, i);
+        size += FRAME_INDEX_PID_HEADER_SIZE + index->frames->len * FRAME_INDEX_FRAME_SIZE;
+    }
+    GByteArray* data = g_byte_array_sized_new(size);
+    append_bytes(data, FRAME_INDEX_MAGIC, 4);
+    append_bytes(data, FRAME_INDEX_VERSION, 1);
+    append_bytes(data, file->flags, 1);
+    append_bytes(data, file->indexes->len, 2);
+    append_bytes(data, segment_version->size, 8);
+    append_bytes(data, segment_version->mtime, 8);
+    append_bytes(data, range_start, 8);
+    append_bytes(data, range_end, 8);
+    append_bytes(data, file->key, 4);
+    append_bytes(data, file->pat_fingerprint, 4);
+    append_bytes(data, file->pmt_fingerprint, 4);
+    append_bytes(data, file->cat_fingerprint, 4);
+    append_bytes(data, file->splice_points->len, 4);
+    for (size_t i = 0; i < file->splice_points->len; ++i) {
+        append_bytes(data, g_array_index(file->splice_points, uint64_t, i), 8);
+    }
+    for (size_t i = 0; i < file->indexes->len; ++i) {
+        frame_index_t* index = g_ptr_array_index(file->indexes, i);
+        append_bytes(data, index->pid, 2);
+        append_bytes(data, index->stream_type, 1);
+        append_bytes(data, index->content_component, 1);
+        append_bytes(data, index->sap, 1);
+        append_bytes(data, index->sap_type, 1);
+        append_bytes(data, 0, 2);
+        append_bytes(data, index->frames->len, 4);
+        append_bytes(data, index->earliest_playout_time, 8);
+        append_bytes(data, index->latest_playout_time, 8);
+        append_bytes(data, index->duration, 8);
+        for (size_t j = 0; j < index->frames->len; ++j) {
+            frame_t* frame = &g_array_index(index->frames, frame_t, j);
+            append_bytes(data, frame->pts, 8);
+            append_bytes(data, frame->dts, 8);
+            append_bytes(data, frame->offset, 8);
+            append_bytes(data, frame->size, 4);
+            append_bytes(data, frame->picture_type, 1);
+            append_bytes(data, frame->sap_type, 1);
+            append_bytes(data, frame->flags, 1);
+            append_bytes(data, 0, 1);
+        }
+    }
+
+    GError* error = NULL;
+    bool written = g_file_set_contents(file_name, (const gchar*)data->data, data->len, &error);
+    if (!written) {
+        g_critical("Can't write frame index %s: %s", file_name, error->message);
+        g_error_free(error);
+    }
+    g_byte_array_free(data, true);
+    return written;
+}
+
+frame_index_file_t* frame_index_file_read(const char* file_name, const char* segment_file_name, uint64_t range_start,
+        uint64_t range_end)
+{
+    g_return_val_if_fail(file_name, NULL);
+    g_return_val_if_fail(segment_file_name, NULL);
+
+    frame_index_file_t* file = NULL;
+    gchar* contents = NULL;
+    gsize len;
+    if (!g_file_get_contents(file_name, &contents, &len, NULL)) {
+        goto fail;
+    }
+    file_version_t segment_version;
+    if (!file_version_get(segment_file_name, &segment_version)) {
+        goto fail;
+    }
+
+    bitreader_new_stack(b, (const uint8_t*)contents, len);
+    if (bitreader_read_uint32(b) != FRAME_INDEX_MAGIC || bitreader_read_uint8(b) != FRAME_INDEX_VERSION) {
+        g_debug("%s isn't a version %d frame index", file_name, FRAME_INDEX_VERSION);
+        goto fail;
+    }
+    file = frame_index_file_new();
+    file->flags = bitreader_read_uint8(b);
+    uint16_t num_pids = bitreader_read_uint16(b);
+    if (bitreader_read_uint64(b) != segment_version.size
+            || (int64_t)bitreader_read_uint64(b) != segment_version.mtime
+            || bitreader_read_uint64(b) != range_start || bitreader_read_uint64(b) != range_end) {
+        g_debug("%s is out of date, or for a different byte range of %s", file_name, segment_file_name);
+        goto fail;
+    }
+    file->key = bitreader_read_uint32(b);
+    file->pat_fingerprint = bitreader_read_uint32(b);
+    file->pmt_fingerprint = bitreader_read_uint32(b);
+    file->cat_fingerprint = bitreader_read_uint32(b);
+    uint32_t num_splice_points = bitreader_read_uint32(b);
+    if (b->error || bitreader_bytes_left(b) / 8 < num_splice_points) {
+        goto corrupt;
+    }
+    for (uint32_t i = 0; i < num_splice_points; ++i) {
+        uint64_t pts = bitreader_read_uint64(b);
+        g_array_append_val(file->splice_points, pts);
+    }
+
+    for (uint16_t i = 0; i < num_pids && !b->error; ++i) {
+        uint16_t pid = bitreader_read_uint16(b);
+        uint8_t stream_type = bitreader_read_uint8(b);
+        frame_index_t* index = frame_index_new(pid, stream_type);
+        g_ptr_array_add(file->indexes, index);
+        index->content_component = bitreader_read_uint8(b);
+        index->sap = bitreader_read_uint8(b);
+        index->sap_type = bitreader_read_uint8(b);
+        bitreader_skip_bytes(b, 2);
+        uint32_t num_frames = bitreader_read_uint32(b);
+        index->earliest_playout_time = bitreader_read_uint64(b);
+        index->latest_playout_time = bitreader_read_uint64(b);
+        index->duration = bitreader_read_uint64(b);
+        if (b->error || bitreader_bytes_left(b) / FRAME_INDEX_FRAME_SIZE < num_frames) {
+            goto corrupt;
+        }
+        g_array_set_size(index->frames, num_frames);
+        for (uint32_t j = 0; j < num_frames; ++j) {
+            frame_t* frame = &g_array_index(index->frames, frame_t, j);
+            frame->pts = bitreader_read_uint64(b);
+            frame->dts = bitreader_read_uint64(b);
+            frame->offset = bitreader_read_uint64(b);
+            frame->size = bitreader_read_uint32(b);
+            frame->picture_type = bitreader_read_uint8(b);
+            frame->sap_type = bitreader_read_uint8(b);
+            frame->flags = bitreader_read_uint8(b);
+            frame->reserved = 0;
+            bitreader_skip_bytes(b, 1);
+        }
+    }
+    if (b->error || file->indexes->len != num_pids || !bitreader_eof(b)) {
+        goto corrupt;
+    }
+
+cleanup:
+    g_free(contents);
+    return file;
+corrupt:
+    g_debug("Frame index %s is truncated or corrupt", file_name);
+fail:
+    frame_index_file_free(file);
+    file = NULL;
+    goto cleanup;
+}
@@ -0,0 +1,127 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_FRAME_INDEX_H
+#define TSLIB_FRAME_INDEX_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "file_cache.h"
+#include "pes.h"
+
+
+/* Sidecar layout, all big-endian: 'TSFI', version (8 bits), FRAME_INDEX_FILE_* flags (8), number of PIDs (16),
+ * segment size (64), segment modification time in ns (64), range start (64), range end (64), key (32), PAT, PMT and
+ * CAT fingerprints (32 each), number of splice points (32) and their PTS (64 each). Then for each PID: PID (16),
+ * stream_type (8), content_component (8), sap (8), sap_type (8), reserved (16), number of frames (32), earliest and
+ * latest playout time and duration (64 each), and that many frame_t. */
+#define FRAME_INDEX_VERSION 3
+
+typedef enum {
+    PICTURE_TYPE_UNKNOWN = 0,
+    PICTURE_TYPE_I,
+    PICTURE_TYPE_P,
+    PICTURE_TYPE_B
+} picture_type_t;
+
+#define FRAME_HAS_PTS        0x01
+#define FRAME_HAS_DTS        0x02
+#define FRAME_RANDOM_ACCESS  0x04 /* random_access_indicator was set in the first TS packet */
+
+/* One PES packet, which is normally one access unit. Stored as-is in memory, and as the same fields in order,
+ * big-endian, in the sidecar (32 bytes each). */
+typedef struct {
+    uint64_t pts; /* 90 kHz, if flags has FRAME_HAS_PTS */
+    uint64_t dts; /* 90 kHz, the PTS if the PES packet has no DTS */
+    uint64_t offset; /* byte offset of the first TS packet of the PES packet in the segment */
+    uint32_t size; /* bytes from the start of its first TS packet to the end of its last one */
+    uint8_t picture_type; /* picture_type_t */
+    uint8_t sap_type; /* 0 if it isn't a SAP */
+    uint8_t flags;
+    uint8_t reserved;
+} frame_t;
+
+/* The PES packets of one PID in a segment, in stream order */
+typedef struct {
+    uint16_t pid;
+    uint8_t stream_type;
+    GArray* frames; /* frame_t */
+
+    /* What the segment validator found for the PID, from pid_validator_t */
+    uint8_t content_component;
+    uint8_t sap;
+    uint8_t sap_type;
+    int64_t earliest_playout_time;
+    int64_t latest_playout_time;
+    int64_t duration;
+} frame_index_t;
+
+#define FRAME_INDEX_FILE_PASSED     0x01
+#define FRAME_INDEX_FILE_ENCRYPTED  0x02
+#define FRAME_INDEX_FILE_HAS_EMSG   0x04
+
+/* Everything in a sidecar besides the segment's size, modification time and byte range */
+typedef struct {
+    uint8_t flags; /* FRAME_INDEX_FILE_* */
+    uint32_t key; /* identifies what else the results depended on, so they're only used again if it's the same */
+    uint32_t pat_fingerprint;
+    uint32_t pmt_fingerprint;
+    uint32_t cat_fingerprint;
+    GArray* splice_points; /* uint64_t PTS */
+    GPtrArray* indexes; /* frame_index_t*, freed with the file */
+} frame_index_file_t;
+
+frame_index_t* frame_index_new(uint16_t pid, uint8_t stream_type);
+void frame_index_free(frame_index_t*);
+
+/* Adds a PES packet. Picture and SAP types come from the first slice (AVC), the NAL unit type (HEVC, which only finds
+ * IRAP pictures) or the picture header (MPEG-1/2 video), and every audio frame is a SAP of type 1. For other streams,
+ * packets with random_access_indicator are SAPs of type 1. */
+void frame_index_add_pes(frame_index_t*, const pes_packet_t*, uint64_t offset, uint32_t size, bool random_access);
+/* Moves the frames in other to the end of index */
+void frame_index_append(frame_index_t* index, frame_index_t* other);
+
+/* Name of the sidecar next to a segment: FILE.fidx for a whole file, or FILE.START-END.fidx for a mediaRange */
+gchar* frame_index_file_name(const char* segment_file_name, uint64_t range_start, uint64_t range_end);
+
+frame_index_file_t* frame_index_file_new(void);
+void frame_index_file_free(frame_index_file_t*);
+
+/* Writes a sidecar for the segment at segment_file_name to file_name, along with the segment's size and modification
+ * time. segment_version is the version of the segment that the sidecar describes, which is the one that was read
+ * (from its file_handle_t). If the segment changed since, nothing is written, so a sidecar never vouches for bytes
+ * that weren't read. Returns false and logs why on failure. */
+bool frame_index_file_write(const frame_index_file_t*, const char* file_name, const char* segment_file_name,
+        const file_version_t* segment_version, uint64_t range_start, uint64_t range_end);
+/* Reads a sidecar written by frame_index_file_write(). Returns NULL if it can't be read or the segment or byte range
+ * has changed since it was written. */
+frame_index_file_t* frame_index_file_read(const char* file_name, const char* segment_file_name, uint64_t range_start,
+        uint64_t range_end);
+
+#endif
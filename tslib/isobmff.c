@@ -28,11 +28,24 @@
  */
 #include "isobmff.h"
 
+#include <errno.h>
 #include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "file_cache.h"
 #include "log.h"
 
+#define SIDX_REFERENCE_SIZE 12
+#define PCRB_PCR_SIZE 6
 
+static bool read_file_range(const char* file_name, uint64_t start, uint64_t end, uint8_t** data_out,
+        size_t* len_out);
+static bool read_box_view(bitreader_t*, box_view_t*);
 static bool read_full_box(bitreader_t*, fullbox_t*);
+static bool read_sidx_header(bitreader_t*, sidx_t*);
+static void read_sidx_reference(bitreader_t*, sidx_reference_t*);
+static bool read_pcrb_header(bitreader_t*, pcrb_t*);
+static bool read_ssix_header(bitreader_t*, ssix_t*);
 static box_t* read_styp(bitreader_t*, int* error);
 static box_t* read_sidx(bitreader_t*, int* error);
 static box_t* read_pcrb(bitreader_t*, int* error);
@@ -109,7 +122,139 @@ void free_boxes(box_t** boxes, size_t num_boxes)
     g_free(boxes);
 }
 
+bool read_file_range(const char* file_name, uint64_t start, uint64_t end, uint8_t** data_out, size_t* len_out)
+{
+    bool ret = true;
+    uint8_t* data = NULL;
+    size_t len = 0;
+    file_handle_t* file = file_cache_open(file_name);
+    if (file == NULL) {
+        g_critical("While looking for ISOBMFF boxes, failed to open file %s - %s.", file_name, strerror(errno));
+        goto fail;
+    }
+
+    if (end == 0) {
+        uint64_t file_len;
+        if (!file_handle_get_size(file, &file_len)) {
+            g_critical("Error getting the size of %s - %s", file_name, strerror(errno));
+            goto fail;
+        }
+        if (file_len < start) {
+            g_critical("Byte range %"PRIu64"- is past the end of %s.", start, file_name);
+            goto fail;
+        }
+        len = file_len - start;
+    } else {
+        if (end < start) {
+            g_critical("Byte range %"PRIu64"-%"PRIu64" for %s is not a valid byte range.", start, end, file_name);
+            goto fail;
+        }
+        len = end - start + 1;
+    }
+
+    if (len != 0) {
+        data = g_try_malloc(len);
+        if (data == NULL) {
+            g_critical("Failed to allocate %zu bytes to read byte range %"PRIu64"-%"PRIu64" of %s.", len, start,
+                    end, file_name);
+            goto fail;
+        }
+        size_t bytes_read;
+        if (!file_handle_read(file, start, data, len, &bytes_read) || bytes_read != len) {
+            g_critical("Failed to read byte range %"PRIu64"-%"PRIu64" of %s. The file may be too short.", start,
+                    end, file_name);
+            goto fail;
+        }
+    }
+    *data_out = data;
+    *len_out = len;
+
+cleanup:
+    file_cache_release(file);
+    return ret;
+fail:
+    ret = false;
+    g_free(data);
+    goto cleanup;
+}
+
+box_iterator_t* box_iterator_new(const char* file_name, uint64_t start, uint64_t end)
+{
+    g_return_val_if_fail(file_name, NULL);
+
+    uint8_t* data;
+    size_t len;
+    if (!read_file_range(file_name, start, end, &data, &len)) {
+        return NULL;
+    }
+
+    box_iterator_t* obj = g_slice_new0(box_iterator_t);
+    obj->data = data;
+    obj->len = len;
+    obj->start = start;
+    bitreader_init(&obj->b, data, len);
+    return obj;
+}
+
+box_iterator_t* box_iterator_new_from_buffer(const uint8_t* data, size_t len)
+{
+    box_iterator_t* obj = g_slice_new0(box_iterator_t);
+    obj->len = len;
+    bitreader_init(&obj->b, data, len);
+    return obj;
+}
+
+void box_iterator_free(box_iterator_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_free(obj->data);
+    g_slice_free(box_iterator_t, obj);
+}
+
+box_t* box_iterator_next(box_iterator_t* it, int* error_out)
+{
+    g_return_val_if_fail(it, NULL);
+
+    if (bitreader_eof(&it->b)) {
+        return NULL;
+    }
+    return read_box(&it->b, error_out);
+}
+
+bool box_iterator_next_view(box_iterator_t* it, box_view_t* view, int* error_out)
+{
+    g_return_val_if_fail(it, false);
+    g_return_val_if_fail(view, false);
+
+    if (bitreader_eof(&it->b)) {
+        return false;
+    }
+    if (!read_box_view(&it->b, view)) {
+        if (error_out) {
+            *error_out = 1;
+        }
+        return false;
+    }
+    view->offset += it->start;
+    return true;
+}
+
+uint64_t box_iterator_offset(const box_iterator_t* it)
+{
+    g_return_val_if_fail(it, 0);
+
+    return it->start + it->b.bytes_read;
+}
+
 box_t** read_boxes_from_file(const char* file_name, size_t* num_boxes, int* error_out)
+{
+    return read_boxes_from_file_range(file_name, 0, 0, num_boxes, error_out);
+}
+
+box_t** read_boxes_from_file_range(const char* file_name, uint64_t start, uint64_t end, size_t* num_boxes,
+        int* error_out)
 {
     g_return_val_if_fail(file_name, NULL);
     g_return_val_if_fail(num_boxes, NULL);
@@ -117,21 +262,13 @@ box_t** read_boxes_from_file(const char* file_name, size_t* num_boxes, int* erro
     box_t** boxes = NULL;
     *num_boxes = 0;
 
-    gchar* file_contents = NULL;
-    size_t file_len;
-    GError* error = NULL;
-    if (!g_file_get_contents(file_name, &file_contents, &file_len, &error)) {
-        g_critical("While looking for ISOBMFF boxes, failed to open file %s. Error is: %s.", file_name, error->message);
+    box_iterator_t* it = box_iterator_new(file_name, start, end);
+    if (it == NULL) {
         goto fail;
     }
-
-    bitreader_new_stack(b, (uint8_t*)file_contents, file_len);
-    boxes = read_boxes_from_stream(b, num_boxes, error_out);
+    boxes = read_boxes_from_stream(&it->b, num_boxes, error_out);
 cleanup:
-    g_free(file_contents);
-    if (error) {
-        g_error_free(error);
-    }
+    box_iterator_free(it);
     return boxes;
 fail:
     if (error_out) {
@@ -172,6 +309,21 @@ box_t* read_box(bitreader_t* b, int* error_out)
 {
     g_return_val_if_fail(b, NULL);
 
+    box_view_t view;
+    if (!read_box_view(b, &view)) {
+        if (error_out) {
+            *error_out = 1;
+        }
+        return NULL;
+    }
+    return read_box_from_view(&view, error_out);
+}
+
+bool read_box_view(bitreader_t* b, box_view_t* view)
+{
+    g_return_val_if_fail(b, false);
+    g_return_val_if_fail(view, false);
+
     /*
     aligned(8) class Box (unsigned int(32) boxtype, optional unsigned int(8)[16] extended_type) {
         unsigned int(32) size;
@@ -186,8 +338,7 @@ box_t* read_box(bitreader_t* b, int* error_out)
         }
     }
     */
-    box_t* box = NULL;
-    bitreader_t* box_reader = NULL;
+    size_t box_start = b->bytes_read;
     uint64_t size = bitreader_read_uint32(b);
     uint32_t type = bitreader_read_uint32(b);
     char type_str[5] = {0};
@@ -195,27 +346,50 @@ box_t* read_box(bitreader_t* b, int* error_out)
 
     if (size == 1) {
         size = bitreader_read_uint64(b);
-    } else if (size == 0) {
-        size = bitreader_bytes_left(b); // box extends to the end of the file
+    }
+    size_t header_size = b->bytes_read - box_start;
+    if (size == 0) {
+        size = header_size + bitreader_bytes_left(b); // box extends to the end of the file
     }
 
     if (b->error) {
         g_critical("Error reading size or type for ISOBMFF box. Size: %"PRIu64", Type: 0x%"PRIx32" (%s)",
                 size, type, type_str);
-        goto fail;
+        return false;
     }
 
-    if (size < 8) {
-        g_critical("ISOBMFF box with type 0x%"PRIx32" (%s) has size %"PRIu64", but should be >= 8.",
-                type, type_str, size);
+    if (size < header_size) {
+        g_critical("ISOBMFF box with type 0x%"PRIx32" (%s) has size %"PRIu64", but should be >= %zu.",
+                type, type_str, size, header_size);
+        return false;
     }
 
     /* Ignore size for Box itself */
-    box_reader = bitreader_read_bytes_as_bitreader(b, size - 8);
-    if (!box_reader) {
+    uint64_t data_len = size - header_size;
+    if (data_len > bitreader_bytes_left(b)) {
         g_critical("Failed to read box with type 0x%"PRIx32" (%s), not data to read.", type, type_str);
-        goto fail;
-    }
+        return false;
+    }
+    view->size = size;
+    view->type = type;
+    view->offset = box_start;
+    view->data = b->data + b->bytes_read;
+    view->data_len = data_len;
+    bitreader_skip_bytes(b, data_len);
+    return true;
+}
+
+box_t* read_box_from_view(const box_view_t* view, int* error_out)
+{
+    g_return_val_if_fail(view, NULL);
+
+    box_t* box = NULL;
+    uint32_t type = view->type;
+    uint64_t size = view->size;
+    char type_str[5] = {0};
+    uint32_to_string(type_str, type);
+
+    bitreader_new_stack(box_reader, view->data, view->data_len);
     int error = 0;
     switch (type) {
     case BOX_TYPE_STYP:
@@ -234,9 +408,7 @@ box_t* read_box(bitreader_t* b, int* error_out)
         box = read_emsg(box_reader, &error);
         break;
     default: {
-        char tmp[5] = {0};
-        uint32_to_string(tmp, type);
-        g_debug("Unknown box type: %s.", tmp);
+        g_debug("Unknown box type: %s.", type_str);
         box = g_slice_new(box_t);
     }
     }
@@ -259,16 +431,13 @@ box_t* read_box(bitreader_t* b, int* error_out)
         goto fail;
     }
 
-cleanup:
-    bitreader_free(box_reader);
     return box;
 fail:
     if (error_out) {
         *error_out = 1;
     }
     free_box(box);
-    box = NULL;
-    goto cleanup;
+    return NULL;
 }
 
 bool read_full_box(bitreader_t* b, fullbox_t* box)
@@ -370,24 +539,10 @@ box_t* read_sidx(bitreader_t* b, int* error_out)
     }
     */
     sidx_t* box = g_slice_new0(sidx_t);
-    if (!read_full_box(b, (fullbox_t*)box)) {
+    if (!read_sidx_header(b, box)) {
         goto fail;
     }
 
-    box->reference_id = bitreader_read_uint32(b);
-    box->timescale = bitreader_read_uint32(b);
-
-    if (box->version == 0) {
-        box->earliest_presentation_time = bitreader_read_uint32(b);
-        box->first_offset = bitreader_read_uint32(b);
-    } else {
-        box->earliest_presentation_time = bitreader_read_uint64(b);
-        box->first_offset = bitreader_read_uint64(b);
-    }
-
-    bitreader_skip_bytes(b, 2); // reserved
-    box->reference_count = bitreader_read_uint16(b);
-
     if (box->reference_count > 0) {
         box->references = g_try_new(sidx_reference_t, box->reference_count);
         if (!box->references) {
@@ -395,15 +550,7 @@ box_t* read_sidx(bitreader_t* b, int* error_out)
             goto fail;
         }
         for (size_t i = 0; i < box->reference_count; ++i) {
-            sidx_reference_t* reference = &box->references[i];
-            uint32_t tmp = bitreader_read_uint32(b);
-            reference->reference_type = tmp >> 31;
-            reference->referenced_size = tmp & 0x7fffffff;
-            reference->subsegment_duration = bitreader_read_uint32(b);
-            tmp = bitreader_read_uint32(b);
-            reference->starts_with_sap = tmp >> 31;
-            reference->sap_type = (tmp >> 28) & 0x7;
-            reference->sap_delta_time = tmp & 0x0fffffff;
+            read_sidx_reference(b, &box->references[i]);
         }
     }
     return (box_t*)box;
@@ -415,6 +562,79 @@ fail:
     return NULL;
 }
 
+bool read_sidx_header(bitreader_t* b, sidx_t* box)
+{
+    if (!read_full_box(b, (fullbox_t*)box)) {
+        return false;
+    }
+
+    box->reference_id = bitreader_read_uint32(b);
+    box->timescale = bitreader_read_uint32(b);
+
+    if (box->version == 0) {
+        box->earliest_presentation_time = bitreader_read_uint32(b);
+        box->first_offset = bitreader_read_uint32(b);
+    } else {
+        box->earliest_presentation_time = bitreader_read_uint64(b);
+        box->first_offset = bitreader_read_uint64(b);
+    }
+
+    bitreader_skip_bytes(b, 2); // reserved
+    box->reference_count = bitreader_read_uint16(b);
+    return !b->error;
+}
+
+void read_sidx_reference(bitreader_t* b, sidx_reference_t* reference)
+{
+    uint32_t tmp = bitreader_read_uint32(b);
+    reference->reference_type = tmp >> 31;
+    reference->referenced_size = tmp & 0x7fffffff;
+    reference->subsegment_duration = bitreader_read_uint32(b);
+    tmp = bitreader_read_uint32(b);
+    reference->starts_with_sap = tmp >> 31;
+    reference->sap_type = (tmp >> 28) & 0x7;
+    reference->sap_delta_time = tmp & 0x0fffffff;
+}
+
+bool read_sidx_view(const box_view_t* view, sidx_t* box)
+{
+    g_return_val_if_fail(view, false);
+    g_return_val_if_fail(view->type == BOX_TYPE_SIDX, false);
+    g_return_val_if_fail(box, false);
+
+    memset(box, 0, sizeof(*box));
+    box->size = view->size;
+    box->type = view->type;
+
+    bitreader_new_stack(b, view->data, view->data_len);
+    if (!read_sidx_header(b, box)) {
+        g_critical("Input error reading 'sidx' box of size %"PRIu64".", view->size);
+        return false;
+    }
+    if (bitreader_bytes_left(b) != box->reference_count * SIDX_REFERENCE_SIZE) {
+        g_critical("'sidx' box has reference_count %"PRIu16", indicating the remaining size should be %d bytes, but "
+                "the box has %zu bytes left.", box->reference_count, box->reference_count * SIDX_REFERENCE_SIZE,
+                bitreader_bytes_left(b));
+        return false;
+    }
+    box->reference_data = b->data + b->bytes_read;
+    return true;
+}
+
+void sidx_get_reference(const sidx_t* sidx, size_t i, sidx_reference_t* reference)
+{
+    g_return_if_fail(sidx);
+    g_return_if_fail(i < sidx->reference_count);
+    g_return_if_fail(reference);
+
+    if (sidx->references) {
+        *reference = sidx->references[i];
+        return;
+    }
+    bitreader_new_stack(b, sidx->reference_data + i * SIDX_REFERENCE_SIZE, SIDX_REFERENCE_SIZE);
+    read_sidx_reference(b, reference);
+}
+
 void free_pcrb(pcrb_t* box)
 {
     if (box == NULL) {
@@ -439,17 +659,7 @@ box_t* read_pcrb(bitreader_t* b, int* error_out)
     */
     pcrb_t* box = g_slice_new0(pcrb_t);
 
-    box->subsegment_count = bitreader_read_uint32(b);
-
-    uint64_t pcr_size = box->subsegment_count * (48 / 8);
-    if (pcr_size != bitreader_bytes_left(b)) {
-        g_critical("pcrb box has subsegment_count %"PRIu32", indicating the remaining size should be %"PRIu64" bytes, "
-                "but the box has %"PRIu64" bytes left.",
-                box->subsegment_count, pcr_size, bitreader_bytes_left(b));
-        if (bitreader_bytes_left(b) == box->subsegment_count * 8) {
-            g_critical("Note: Your encoder appears to be writing 64-bit pcrb entries instead of 48-bit. See "
-                    "https://github.com/gpac/gpac/issues/34 for details.");
-        }
+    if (!read_pcrb_header(b, box)) {
         goto fail;
     }
     if (box->subsegment_count) {
@@ -473,6 +683,54 @@ fail:
     return NULL;
 }
 
+bool read_pcrb_header(bitreader_t* b, pcrb_t* box)
+{
+    box->subsegment_count = bitreader_read_uint32(b);
+
+    uint64_t pcr_size = box->subsegment_count * (uint64_t)PCRB_PCR_SIZE;
+    if (pcr_size != bitreader_bytes_left(b)) {
+        g_critical("pcrb box has subsegment_count %"PRIu32", indicating the remaining size should be %"PRIu64" bytes, "
+                "but the box has %zu bytes left.",
+                box->subsegment_count, pcr_size, bitreader_bytes_left(b));
+        if (bitreader_bytes_left(b) == box->subsegment_count * 8) {
+            g_critical("Note: Your encoder appears to be writing 64-bit pcrb entries instead of 48-bit. See "
+                    "https://github.com/gpac/gpac/issues/34 for details.");
+        }
+        return false;
+    }
+    return !b->error;
+}
+
+bool read_pcrb_view(const box_view_t* view, pcrb_t* box)
+{
+    g_return_val_if_fail(view, false);
+    g_return_val_if_fail(view->type == BOX_TYPE_PCRB, false);
+    g_return_val_if_fail(box, false);
+
+    memset(box, 0, sizeof(*box));
+    box->size = view->size;
+    box->type = view->type;
+
+    bitreader_new_stack(b, view->data, view->data_len);
+    if (!read_pcrb_header(b, box)) {
+        return false;
+    }
+    box->pcr_data = b->data + b->bytes_read;
+    return true;
+}
+
+uint64_t pcrb_get_pcr(const pcrb_t* pcrb, size_t i)
+{
+    g_return_val_if_fail(pcrb, 0);
+    g_return_val_if_fail(i < pcrb->subsegment_count, 0);
+
+    if (pcrb->pcr) {
+        return pcrb->pcr[i];
+    }
+    bitreader_new_stack(b, pcrb->pcr_data + i * PCRB_PCR_SIZE, PCRB_PCR_SIZE);
+    return bitreader_read_bits(b, 42);
+}
+
 void free_ssix(ssix_t* box)
 {
     if (box == NULL) {
@@ -504,14 +762,7 @@ box_t* read_ssix(bitreader_t* b, int* error_out)
     }
     */
     ssix_t* box = g_slice_new0(ssix_t);
-    if (!read_full_box(b, (fullbox_t*)box)) {
-        goto fail;
-    }
-
-    box->subsegment_count = bitreader_read_uint32(b);
-    if (box->subsegment_count * 4 > bitreader_bytes_left(b)) {
-        g_critical("Not enough bytes left in 'ssix' box to read the required %"PRIu32" subsegments.",
-                box->subsegment_count);
+    if (!read_ssix_header(b, box)) {
         goto fail;
     }
     if (box->subsegment_count > 0) {
@@ -551,6 +802,105 @@ fail:
     return NULL;
 }
 
+bool read_ssix_header(bitreader_t* b, ssix_t* box)
+{
+    if (!read_full_box(b, (fullbox_t*)box)) {
+        return false;
+    }
+
+    box->subsegment_count = bitreader_read_uint32(b);
+    if (box->subsegment_count * 4 > bitreader_bytes_left(b)) {
+        g_critical("Not enough bytes left in 'ssix' box to read the required %"PRIu32" subsegments.",
+                box->subsegment_count);
+        return false;
+    }
+    return !b->error;
+}
+
+bool read_ssix_view(const box_view_t* view, ssix_t* box)
+{
+    g_return_val_if_fail(view, false);
+    g_return_val_if_fail(view->type == BOX_TYPE_SSIX, false);
+    g_return_val_if_fail(box, false);
+
+    memset(box, 0, sizeof(*box));
+    box->size = view->size;
+    box->type = view->type;
+
+    bitreader_new_stack(b, view->data, view->data_len);
+    if (!read_ssix_header(b, box)) {
+        return false;
+    }
+    box->subsegment_data = b->data + b->bytes_read;
+    box->subsegment_data_len = bitreader_bytes_left(b);
+
+    /* Check that the ranges fit in the box now, so walking them later can't fail */
+    for (uint32_t i = 0; i < box->subsegment_count; ++i) {
+        uint32_t ranges_count = bitreader_read_uint32(b);
+        if (ranges_count * (uint64_t)4 > bitreader_bytes_left(b)) {
+            g_critical("Not enough bytes left in 'ssix' box to read the required %"PRIu32" ranges.", ranges_count);
+            return false;
+        }
+        bitreader_skip_bytes(b, ranges_count * 4);
+    }
+    if (b->error || !bitreader_eof(b)) {
+        g_critical("'ssix' box with size %"PRIu64" had extra data that was ignored.", view->size);
+        return false;
+    }
+    return true;
+}
+
+void ssix_cursor_init(ssix_cursor_t* cursor, const ssix_t* ssix)
+{
+    g_return_if_fail(cursor);
+    g_return_if_fail(ssix);
+
+    cursor->ssix = ssix;
+    bitreader_init(&cursor->b, ssix->subsegment_data, ssix->subsegment_data_len);
+    cursor->subsegment = 0;
+    cursor->range = 0;
+    cursor->ranges_count = 0;
+}
+
+bool ssix_cursor_next_subsegment(ssix_cursor_t* cursor, uint32_t* ranges_count_out)
+{
+    g_return_val_if_fail(cursor, false);
+
+    if (cursor->subsegment >= cursor->ssix->subsegment_count) {
+        return false;
+    }
+    if (cursor->ssix->subsegments) {
+        cursor->ranges_count = cursor->ssix->subsegments[cursor->subsegment].ranges_count;
+    } else {
+        bitreader_skip_bytes(&cursor->b, (cursor->ranges_count - cursor->range) * 4);
+        cursor->ranges_count = bitreader_read_uint32(&cursor->b);
+    }
+    cursor->subsegment++;
+    cursor->range = 0;
+    if (ranges_count_out) {
+        *ranges_count_out = cursor->ranges_count;
+    }
+    return true;
+}
+
+bool ssix_cursor_next_range(ssix_cursor_t* cursor, ssix_subsegment_range_t* range)
+{
+    g_return_val_if_fail(cursor, false);
+    g_return_val_if_fail(range, false);
+
+    if (cursor->subsegment == 0 || cursor->range >= cursor->ranges_count) {
+        return false;
+    }
+    if (cursor->ssix->subsegments) {
+        *range = cursor->ssix->subsegments[cursor->subsegment - 1].ranges[cursor->range];
+    } else {
+        range->level = bitreader_read_uint8(&cursor->b);
+        range->range_size = bitreader_read_uint24(&cursor->b);
+    }
+    cursor->range++;
+    return true;
+}
+
 void free_emsg(emsg_t* box)
 {
     if (box == NULL) {
@@ -621,6 +971,19 @@ void print_boxes(box_t* const* boxes, size_t num_boxes)
     }
 }
 
+void print_box_view(const box_view_t* view)
+{
+    g_return_if_fail(view);
+    if (tslib_loglevel < TSLIB_LOG_LEVEL_DEBUG) {
+        return;
+    }
+    box_t* box = read_box_from_view(view, NULL);
+    if (box) {
+        print_box(box);
+        free_box(box);
+    }
+}
+
 void print_box(const box_t* box)
 {
     g_return_if_fail(box);
@@ -82,6 +82,8 @@ typedef struct {
 
     uint16_t reference_count;
     sidx_reference_t* references;
+    /* Set instead of references when read with read_sidx_view() */
+    const uint8_t* reference_data;
 } sidx_t;
 
 typedef struct {
@@ -101,6 +103,9 @@ typedef struct {
     uint32_t flags;
     uint32_t subsegment_count;
     ssix_subsegment_t* subsegments;
+    /* Set instead of subsegments when read with read_ssix_view() */
+    const uint8_t* subsegment_data;
+    size_t subsegment_data_len;
 } ssix_t;
 
 typedef struct {
@@ -108,6 +113,8 @@ typedef struct {
     uint32_t type;
     uint32_t subsegment_count;
     uint64_t* pcr;
+    /* Set instead of pcr when read with read_pcrb_view() */
+    const uint8_t* pcr_data;
 } pcrb_t;
 
 typedef struct {
@@ -133,7 +140,60 @@ typedef enum {
     BOX_TYPE_STYP = 0x73747970
 } box_type_t;
 
+/* Iterates over the boxes in a byte range of a file, reading only that range from disk. */
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    uint64_t start;
+    bitreader_t b;
+} box_iterator_t;
+
+box_iterator_t* box_iterator_new(const char* file_name, uint64_t start, uint64_t end);
+box_iterator_t* box_iterator_new_from_buffer(const uint8_t* data, size_t len);
+void box_iterator_free(box_iterator_t*);
+box_t* box_iterator_next(box_iterator_t*, int* error);
+uint64_t box_iterator_offset(const box_iterator_t*);
+
+/* A box which hasn't been decoded yet. data points into the iterator's buffer and is only valid until the iterator
+ * is freed. */
+typedef struct {
+    uint64_t size;
+    uint32_t type;
+    uint64_t offset; // offset of the start of the box in the file
+    const uint8_t* data; // box contents following the header
+    size_t data_len;
+} box_view_t;
+
+bool box_iterator_next_view(box_iterator_t*, box_view_t*, int* error);
+box_t* read_box_from_view(const box_view_t*, int* error);
+void print_box_view(const box_view_t*);
+
+/* These decode the fixed-size part of a box without allocating. Variable length arrays are left in the buffer and
+ * decoded on demand with the accessors below. */
+bool read_sidx_view(const box_view_t*, sidx_t*);
+bool read_ssix_view(const box_view_t*, ssix_t*);
+bool read_pcrb_view(const box_view_t*, pcrb_t*);
+
+void sidx_get_reference(const sidx_t*, size_t i, sidx_reference_t*);
+uint64_t pcrb_get_pcr(const pcrb_t*, size_t i);
+
+/* Walks the subsegments and ranges of an 'ssix' box, whether it was read with read_ssix_view() or not */
+typedef struct {
+    const ssix_t* ssix;
+    bitreader_t b;
+    uint32_t subsegment;
+    uint32_t range;
+    uint32_t ranges_count;
+} ssix_cursor_t;
+
+void ssix_cursor_init(ssix_cursor_t*, const ssix_t*);
+bool ssix_cursor_next_subsegment(ssix_cursor_t*, uint32_t* ranges_count);
+bool ssix_cursor_next_range(ssix_cursor_t*, ssix_subsegment_range_t*);
+
 box_t** read_boxes_from_file(const char* file_name, size_t* num_boxes, int* error);
+/* Reads boxes from the inclusive byte range start-end of a file. If end is 0, reads to the end of the file. */
+box_t** read_boxes_from_file_range(const char* file_name, uint64_t start, uint64_t end, size_t* num_boxes,
+        int* error);
 box_t** read_boxes_from_stream(bitreader_t*, size_t* num_boxes, int* error);
 
 box_t* read_box(bitreader_t*, int* error);
@@ -0,0 +1,360 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "json.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+
+static const char* skip_string(const char* json);
+static const char* skip_number(const char* json);
+static const char* skip_number_array(const char* json);
+static int read_hex4(const char*);
+
+/* Returns the end of the JSON string starting at json, or NULL if there isn't one */
+const char* skip_string(const char* json)
+{
+    if (*json != '"') {
+        return NULL;
+    }
+    for (const char* p = json + 1; *p; ++p) {
+        if ((unsigned char)*p < 0x20) {
+            /* Control characters have to be escaped */
+            return NULL;
+        } else if (*p == '\\') {
+            if (*++p == 0) {
+                return NULL;
+            }
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the end of the JSON number starting at json, or NULL if there isn't one */
+const char* skip_number(const char* json)
+{
+    const char* p = json;
+    if (*p == '-') {
+        ++p;
+    }
+    if (*p == '0') {
+        ++p;
+    } else if (g_ascii_isdigit(*p)) {
+        while (g_ascii_isdigit(*p)) {
+            ++p;
+        }
+    } else {
+        return NULL;
+    }
+    if (*p == '.') {
+        ++p;
+        if (!g_ascii_isdigit(*p)) {
+            return NULL;
+        }
+        while (g_ascii_isdigit(*p)) {
+            ++p;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        ++p;
+        if (*p == '+' || *p == '-') {
+            ++p;
+        }
+        if (!g_ascii_isdigit(*p)) {
+            return NULL;
+        }
+        while (g_ascii_isdigit(*p)) {
+            ++p;
+        }
+    }
+    return p;
+}
+
+/* Returns the end of the JSON array of numbers starting at json, or NULL if there isn't one */
+const char* skip_number_array(const char* json)
+{
+    const char* p = json;
+    if (*p++ != '[') {
+        return NULL;
+    }
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
+    if (*p == ']') {
+        return p + 1;
+    }
+    while (true) {
+        p = skip_number(p);
+        if (p == NULL) {
+            return NULL;
+        }
+        while (isspace((unsigned char)*p)) {
+            ++p;
+        }
+        if (*p == ']') {
+            return p + 1;
+        }
+        if (*p++ != ',') {
+            return NULL;
+        }
+        while (isspace((unsigned char)*p)) {
+            ++p;
+        }
+    }
+}
+
+/* Stops at the first character that isn't a hex digit, so it never reads past the end of a string */
+int read_hex4(const char* p)
+{
+    int value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        int digit = g_ascii_xdigit_value(p[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+bool json_parse_object(const char* text, GHashTable* fields)
+{
+    g_return_val_if_fail(text, false);
+    g_return_val_if_fail(fields, false);
+
+    const char* p = text;
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
+    if (*p++ != '{') {
+        return false;
+    }
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
+    if (*p == '}') {
+        ++p;
+        goto end;
+    }
+    while (true) {
+        while (isspace((unsigned char)*p)) {
+            ++p;
+        }
+        const char* end = skip_string(p);
+        if (end == NULL) {
+            return false;
+        }
+        gchar* raw_name = g_strndup(p, end - p);
+        gchar* name = json_string_value(raw_name);
+        g_free(raw_name);
+        if (name == NULL) {
+            return false;
+        }
+        p = end;
+        while (isspace((unsigned char)*p)) {
+            ++p;
+        }
+        if (*p++ != ':') {
+            g_free(name);
+            return false;
+        }
+        while (isspace((unsigned char)*p)) {
+            ++p;
+        }
+        if (*p == '"') {
+            end = skip_string(p);
+        } else if (g_str_has_prefix(p, "true") || g_str_has_prefix(p, "null")) {
+            end = p + 4;
+        } else if (g_str_has_prefix(p, "false")) {
+            end = p + 5;
+        } else if (*p == '[') {
+            end = skip_number_array(p);
+        } else {
+            end = skip_number(p);
+        }
+        if (end == NULL) {
+            g_free(name);
+            return false;
+        }
+        g_hash_table_replace(fields, name, g_strndup(p, end - p));
+        p = end;
+        while (isspace((unsigned char)*p)) {
+            ++p;
+        }
+        if (*p == '}') {
+            ++p;
+            break;
+        }
+        if (*p++ != ',') {
+            return false;
+        }
+    }
+end:
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
+    return *p == 0;
+}
+
+gchar* json_string_value(const char* json)
+{
+    g_return_val_if_fail(json, NULL);
+
+    const char* end = skip_string(json);
+    if (end == NULL || *end != 0) {
+        return NULL;
+    }
+    GString* value = g_string_sized_new(end - json);
+    for (const char* p = json + 1; p < end - 1; ++p) {
+        if (*p != '\\') {
+            g_string_append_c(value, *p);
+            continue;
+        }
+        ++p;
+        switch (*p) {
+        case '"':
+        case '\\':
+        case '/':
+            g_string_append_c(value, *p);
+            continue;
+        case 'b':
+            g_string_append_c(value, '\b');
+            continue;
+        case 'f':
+            g_string_append_c(value, '\f');
+            continue;
+        case 'n':
+            g_string_append_c(value, '\n');
+            continue;
+        case 'r':
+            g_string_append_c(value, '\r');
+            continue;
+        case 't':
+            g_string_append_c(value, '\t');
+            continue;
+        case 'u':
+            break;
+        default:
+            goto fail;
+        }
+        int code_point = read_hex4(p + 1);
+        if (code_point < 0) {
+            goto fail;
+        }
+        p += 4;
+        if (code_point >= 0xD800 && code_point < 0xDC00) {
+            int low = p[1] == '\\' && p[2] == 'u' ? read_hex4(p + 3) : -1;
+            if (low < 0xDC00 || low >= 0xE000) {
+                goto fail;
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+        }
+        /* Lone low surrogates aren't characters */
+        if (code_point == 0 || (code_point >= 0xDC00 && code_point < 0xE000)) {
+            goto fail;
+        }
+        char utf8[6];
+        g_string_append_len(value, utf8, g_unichar_to_utf8(code_point, utf8));
+    }
+    return g_string_free(value, false);
+fail:
+    g_string_free(value, true);
+    return NULL;
+}
+
+GArray* json_uint64_array_value(const char* json)
+{
+    g_return_val_if_fail(json, NULL);
+
+    const char* end = skip_number_array(json);
+    if (end == NULL || *end != 0) {
+        return NULL;
+    }
+    GArray* values = g_array_new(false, false, sizeof(uint64_t));
+    for (const char* p = json + 1; *p != ']';) {
+        if (*p == ',' || isspace((unsigned char)*p)) {
+            ++p;
+            continue;
+        }
+        /* skip_number_array() only lets through numbers, so anything but digits means it isn't a uint64_t */
+        const char* number_end = skip_number(p);
+        if (strspn(p, "0123456789") != (size_t)(number_end - p)) {
+            goto fail;
+        }
+        errno = 0;
+        uint64_t value = g_ascii_strtoull(p, NULL, 10);
+        if (errno == ERANGE) {
+            goto fail;
+        }
+        g_array_append_val(values, value);
+        p = number_end;
+    }
+    return values;
+fail:
+    g_array_free(values, true);
+    return NULL;
+}
+
+void json_append_string(GString* json, const char* string)
+{
+    g_return_if_fail(json);
+    g_return_if_fail(string);
+
+    g_string_append_c(json, '"');
+    for (const char* p = string; *p; ++p) {
+        switch (*p) {
+        case '"':
+            g_string_append(json, "\\\"");
+            break;
+        case '\\':
+            g_string_append(json, "\\\\");
+            break;
+        case '\n':
+            g_string_append(json, "\\n");
+            break;
+        case '\r':
+            g_string_append(json, "\\r");
+            break;
+        case '\t':
+            g_string_append(json, "\\t");
+            break;
+        default:
+            if ((unsigned char)*p < 0x20) {
+                g_string_append_printf(json, "\\u%04x", (unsigned char)*p);
+            } else {
+                g_string_append_c(json, *p);
+            }
+        }
+    }
+    g_string_append_c(json, '"');
+}
@@ -0,0 +1,55 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_JSON_H
+#define TSLIB_JSON_H
+
+#include <glib.h>
+#include <stdbool.h>
+
+
+/* Just enough JSON for the daemon's requests and results and for worker results: flat objects whose values are
+ * strings, numbers, arrays of numbers, true, false or null. */
+
+/* Parses a flat JSON object, putting the raw JSON of each value into fields, keyed by the unescaped name. Objects and
+ * arrays of anything but numbers aren't accepted as values. Returns false if text isn't such an object, with nothing
+ * but whitespace around it. fields may have been partly filled in even then. */
+bool json_parse_object(const char* text, GHashTable* fields);
+
+/* Returns the value of a raw JSON string, or NULL if json isn't a valid string. Strings containing NUL (\u0000) or
+ * unpaired surrogates aren't valid, since the value has to be a C string. */
+gchar* json_string_value(const char* json);
+
+/* Returns the values of a raw JSON array of integers from 0 to UINT64_MAX as a GArray of uint64_t, or NULL if json
+ * isn't one */
+GArray* json_uint64_array_value(const char* json);
+
+/* Appends string to json as a JSON string */
+void json_append_string(GString* json, const char* string);
+
+#endif
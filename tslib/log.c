@@ -35,6 +35,10 @@
 
 int tslib_loglevel = TSLIB_LOG_LEVEL_DEFAULT;
 
+static GPrivate current_capture = G_PRIVATE_INIT(NULL);
+
+static int compare_log_records(const void*, const void*);
+
 const char* LOG_INDENT_BUFFER = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
 const int LOG_INDENT_LEN = sizeof(LOG_INDENT_BUFFER);
 
@@ -116,5 +120,83 @@ void log_handler(const char* domain, GLogLevelFlags log_level, const char* messa
     } else if ((log_level & G_LOG_LEVEL_CRITICAL) && tslib_loglevel < TSLIB_LOG_LEVEL_CRITICAL) {
         return;
     }
+
+    log_capture_t* capture = g_private_get(&current_capture);
+    if (capture) {
+        log_record_t record = {
+            .key = capture->key,
+            .seq = capture->records->len,
+            .domain = g_strdup(domain),
+            .log_level = log_level,
+            .message = g_strdup(message)
+        };
+        g_array_append_val(capture->records, record);
+        return;
+    }
     g_print("%s\n", message);
 }
+
+log_capture_t* log_capture_new(void)
+{
+    log_capture_t* obj = g_slice_new0(log_capture_t);
+    obj->records = g_array_new(false, false, sizeof(log_record_t));
+    return obj;
+}
+
+void log_capture_free(log_capture_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    log_capture_clear(obj);
+    g_array_free(obj->records, true);
+    g_slice_free(log_capture_t, obj);
+}
+
+void log_capture_clear(log_capture_t* capture)
+{
+    g_return_if_fail(capture);
+
+    for (size_t i = 0; i < capture->records->len; ++i) {
+        log_record_t* record = &g_array_index(capture->records, log_record_t, i);
+        g_free(record->domain);
+        g_free(record->message);
+    }
+    g_array_set_size(capture->records, 0);
+}
+
+void log_capture_set(log_capture_t* capture)
+{
+    g_private_set(&current_capture, capture);
+}
+
+int compare_log_records(const void* a, const void* b)
+{
+    const log_record_t* ra = *(log_record_t* const*)a;
+    const log_record_t* rb = *(log_record_t* const*)b;
+    if (ra->key != rb->key) {
+        return ra->key < rb->key ? -1 : 1;
+    }
+    if (ra->seq != rb->seq) {
+        return ra->seq < rb->seq ? -1 : 1;
+    }
+    return 0;
+}
+
+void log_capture_replay(log_capture_t** captures, size_t num_captures)
+{
+    g_return_if_fail(captures || num_captures == 0);
+
+    GPtrArray* records = g_ptr_array_new();
+    for (size_t i = 0; i < num_captures; ++i) {
+        for (size_t j = 0; j < captures[i]->records->len; ++j) {
+            g_ptr_array_add(records, &g_array_index(captures[i]->records, log_record_t, j));
+        }
+    }
+    g_ptr_array_sort(records, compare_log_records);
+    for (size_t i = 0; i < records->len; ++i) {
+        log_record_t* record = g_ptr_array_index(records, i);
+        g_log(record->domain, record->log_level, "%s", record->message);
+    }
+    g_ptr_array_free(records, true);
+}
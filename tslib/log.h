@@ -90,4 +90,32 @@ extern int tslib_loglevel;
 
 void log_handler(const char* domain, GLogLevelFlags log_level, const char* message, void*);
 
+typedef struct {
+    uint64_t key;
+    size_t seq;
+    gchar* domain;
+    GLogLevelFlags log_level;
+    gchar* message;
+} log_record_t;
+
+/* Holds messages sent to log_handler() on one thread, so messages from several threads can be logged later in a
+ * deterministic order. Records are ordered by key, and then by the order they were captured in, so each key should
+ * only be used by one capture. */
+typedef struct {
+    GArray* records; /* log_record_t */
+    uint64_t key; /* given to new records */
+} log_capture_t;
+
+log_capture_t* log_capture_new(void);
+void log_capture_free(log_capture_t*);
+void log_capture_clear(log_capture_t*);
+
+/* Sends messages logged on this thread to capture instead of printing them, until this is called with NULL. Only
+ * messages handled by log_handler() are captured. */
+void log_capture_set(log_capture_t*);
+
+/* Logs every record in the captures in order. If this thread is capturing, the records go to its capture, so none of
+ * captures should be the one being captured to. */
+void log_capture_replay(log_capture_t** captures, size_t num_captures);
+
 #endif
\ No newline at end of file
@@ -49,6 +49,65 @@ static void demux_pid_handler_free(demux_pid_handler_t* obj)
     g_free(obj);
 }
 
+section_filter_t* section_filter_new(uint8_t table_id, uint8_t table_id_mask, section_processor_t process_section)
+{
+    section_filter_t* obj = g_new0(section_filter_t, 1);
+    obj->table_id = table_id;
+    obj->table_id_mask = table_id_mask;
+    obj->process_section = process_section;
+    return obj;
+}
+
+static void section_filter_free(section_filter_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    if (obj->arg_destructor && obj->arg) {
+        obj->arg_destructor(obj->arg);
+    }
+    g_free(obj);
+}
+
+/* The section filters on one PID, with the filter for each table_id looked up ahead of time */
+typedef struct _section_pid {
+    section_demux_t* demux;
+    GPtrArray* filters;
+    section_filter_t* filter_by_table_id[256];
+} section_pid_t;
+
+static void section_pid_process_section(const psi_section_t* section, elementary_stream_info_t* es_info, void* arg)
+{
+    section_pid_t* sp = arg;
+    section_filter_t* filter = sp->filter_by_table_id[section->data[0]];
+    if (filter != NULL && filter->process_section != NULL) {
+        filter->process_section(section, es_info, filter->arg);
+    }
+}
+
+static section_pid_t* section_pid_new(void)
+{
+    section_pid_t* sp = g_new0(section_pid_t, 1);
+    sp->demux = section_demux_new(section_pid_process_section);
+    sp->demux->arg = sp;
+    sp->filters = g_ptr_array_new_with_free_func((GDestroyNotify)section_filter_free);
+    return sp;
+}
+
+static void section_pid_free(section_pid_t* sp)
+{
+    if (sp == NULL) {
+        return;
+    }
+    section_demux_free(sp->demux);
+    g_ptr_array_free(sp->filters, true);
+    g_free(sp);
+}
+
+static void mpeg2ts_program_read_pmt_section(const psi_section_t*, elementary_stream_info_t*, void*);
+static void mpeg2ts_stream_read_pat_section(const psi_section_t*, elementary_stream_info_t*, void*);
+static void mpeg2ts_stream_read_cat_section(const psi_section_t*, elementary_stream_info_t*, void*);
+
 static pid_info_t* pid_info_new(void)
 {
     pid_info_t* obj = g_new0(pid_info_t, 1);
@@ -75,6 +134,9 @@ mpeg2ts_program_t* mpeg2ts_program_new(uint16_t program_number, uint16_t pid)
     m2p->pids = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)pid_info_free);
     m2p->pid = pid;
     m2p->program_number = program_number;
+    m2p->pmt_demux = section_demux_new(mpeg2ts_program_read_pmt_section);
+    m2p->pmt_demux->arg = m2p;
+    m2p->pmt_table = section_table_new();
 
     // initialize PCR state
     m2p->pcr_info.first_pcr = m2p->pcr_info.pcr[0] =  m2p->pcr_info.pcr[1] = INT64_MAX;
@@ -93,7 +155,8 @@ void mpeg2ts_program_free(mpeg2ts_program_t* m2p)
 
     // TODO: if this is a test with an initialization segment, then dont want to free the pmt
     program_map_section_unref(m2p->pmt);
-    g_free(m2p->pmt_bytes);
+    section_demux_free(m2p->pmt_demux);
+    section_table_free(m2p->pmt_table);
 
     if (m2p->arg_destructor && m2p->arg) {
         m2p->arg_destructor(m2p->arg);
@@ -136,6 +199,7 @@ int mpeg2ts_program_register_pid_processor(mpeg2ts_program_t* m2p, uint16_t pid,
 int mpeg2ts_program_unregister_pid_processor(mpeg2ts_program_t* m2p, uint16_t pid)
 {
     g_hash_table_remove(m2p->pids, GINT_TO_POINTER(pid));
+    m2p->pids_version++;
     return 0;
 }
 
@@ -146,6 +210,7 @@ int mpeg2ts_program_replace_pid_processor(mpeg2ts_program_t* m2p, pid_info_t* pi
     }
 
     g_hash_table_replace(m2p->pids, GINT_TO_POINTER(pi_new->es_info->elementary_pid), pi_new);
+    m2p->pids_version++;
     return 0;
 }
 
@@ -158,6 +223,12 @@ mpeg2ts_stream_t* mpeg2ts_stream_new(void)
 {
     mpeg2ts_stream_t* m2s = g_new0(mpeg2ts_stream_t, 1);
     m2s->programs = g_ptr_array_new_with_free_func((GDestroyNotify)mpeg2ts_program_free);
+    m2s->pat_demux = section_demux_new(mpeg2ts_stream_read_pat_section);
+    m2s->pat_demux->arg = m2s;
+    m2s->pat_table = section_table_new();
+    m2s->cat_demux = section_demux_new(mpeg2ts_stream_read_cat_section);
+    m2s->cat_demux->arg = m2s;
+    m2s->cat_table = section_table_new();
     return m2s;
 }
 
@@ -168,82 +239,172 @@ void mpeg2ts_stream_free(mpeg2ts_stream_t* m2s)
     }
     g_ptr_array_free(m2s->programs, true);
     conditional_access_section_unref(m2s->cat);
-    g_free(m2s->cat_bytes);
+    section_demux_free(m2s->cat_demux);
+    section_table_free(m2s->cat_table);
     program_association_section_unref(m2s->pat);
-    g_free(m2s->pat_bytes);
+    section_demux_free(m2s->pat_demux);
+    section_table_free(m2s->pat_table);
     demux_pid_handler_free(m2s->emsg_processor);
     demux_pid_handler_free(m2s->ts_processor);
+    if (m2s->section_pids != NULL) {
+        for (size_t pid = 0; pid < TS_NUM_PIDS; ++pid) {
+            section_pid_free(m2s->section_pids[pid]);
+        }
+        g_free(m2s->section_pids);
+    }
     if (m2s->arg_destructor && m2s->arg) {
         m2s->arg_destructor(m2s->arg);
     }
     g_free(m2s);
 }
 
-static int mpeg2ts_stream_read_cat(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
+int mpeg2ts_stream_register_section_filter(mpeg2ts_stream_t* m2s, uint16_t pid, section_filter_t* filter)
 {
-    g_return_val_if_fail(m2s, 1);
-    g_return_val_if_fail(ts, 1);
+    g_return_val_if_fail(m2s, 0);
+    g_return_val_if_fail(pid < TS_NUM_PIDS, 0);
+    g_return_val_if_fail(filter, 0);
 
-    if (!ts->payload || !ts->payload_len) {
-        g_critical("mpeg2ts_program_read_pat called with an empty TS payload.");
-        return 1;
+    if (m2s->section_pids == NULL) {
+        m2s->section_pids = g_new0(section_pid_t*, TS_NUM_PIDS);
+    }
+    section_pid_t* sp = m2s->section_pids[pid];
+    if (sp == NULL) {
+        sp = section_pid_new();
+        m2s->section_pids[pid] = sp;
     }
 
-    int ret = 0;
-    conditional_access_section_t* new_cas = conditional_access_section_read(ts->payload + 1,
-            ts->payload_len - 1);
-    if (new_cas == NULL) {
-        ret = 1;
-        goto cleanup;
+    g_ptr_array_add(sp->filters, filter);
+    for (size_t table_id = 0; table_id < G_N_ELEMENTS(sp->filter_by_table_id); ++table_id) {
+        if ((table_id & filter->table_id_mask) == (filter->table_id & filter->table_id_mask)) {
+            sp->filter_by_table_id[table_id] = filter;
+        }
+    }
+
+    // drop filters that lost all of their table IDs to this one
+    for (size_t i = sp->filters->len; i-- > 0;) {
+        section_filter_t* old = g_ptr_array_index(sp->filters, i);
+        bool used = false;
+        for (size_t table_id = 0; table_id < G_N_ELEMENTS(sp->filter_by_table_id) && !used; ++table_id) {
+            used = sp->filter_by_table_id[table_id] == old;
+        }
+        if (!used) {
+            g_ptr_array_remove_index(sp->filters, i);
+        }
+    }
+    return 1;
+}
+
+int mpeg2ts_stream_unregister_section_filters(mpeg2ts_stream_t* m2s, uint16_t pid)
+{
+    g_return_val_if_fail(m2s, 0);
+    g_return_val_if_fail(pid < TS_NUM_PIDS, 0);
+
+    if (m2s->section_pids != NULL) {
+        section_pid_free(m2s->section_pids[pid]);
+        m2s->section_pids[pid] = NULL;
+    }
+    return 0;
+}
+
+/* PSI is repeated every few hundred milliseconds and rarely changes, so sections that are the same as the ones in force
+ * don't need to be parsed again. A discontinuity always makes us use the new table. */
+static bool psi_table_add(section_table_t* table, const psi_section_t* section)
+{
+    if (!section->discontinuity && section_table_is_unchanged(table, section)) {
+        return false;
+    }
+    return section_table_add(table, section);
+}
+
+static void mpeg2ts_stream_read_cat_section(const psi_section_t* section, elementary_stream_info_t* es_info,
+        void* arg)
+{
+    mpeg2ts_stream_t* m2s = arg;
+    if (!psi_table_add(m2s->cat_table, section)) {
+        return;
+    }
+
+    conditional_access_section_t* new_cas = NULL;
+    for (size_t i = 0; i < m2s->cat_table->complete->len; ++i) {
+        conditional_access_section_t* cas = conditional_access_section_parse(
+                g_ptr_array_index(m2s->cat_table->complete, i));
+        if (cas == NULL) {
+            goto fail;
+        }
+        if (new_cas == NULL) {
+            new_cas = cas;
+        } else {
+            conditional_access_section_append(new_cas, cas);
+            conditional_access_section_unref(cas);
+        }
     }
     if (!new_cas->current_next_indicator) {
         g_warning("Ignoring CAT with current_next_indicator = 0");
-        goto cleanup;
+        goto fail;
     }
 
-    // TODO: allow >1 packet cat
-    if (!m2s->cat || m2s->cat->version_number != new_cas->version_number
-            || (ts->has_adaptation_field && ts->adaptation_field.discontinuity_indicator)) {
+    if (!m2s->cat || m2s->cat->version_number != new_cas->version_number || section->discontinuity) {
         if (m2s->cat != NULL) {
             g_info("New CAT section in force, discarding the old one");
             conditional_access_section_unref(m2s->cat);
         }
 
         m2s->cat = new_cas;
-
         if (m2s->cat_processor != NULL) {
             m2s->cat_processor(m2s, m2s->arg);
         }
+    } else {
+        conditional_access_section_unref(new_cas);
     }
+    return;
 
-cleanup:
-    return ret;
+fail:
+    // so we report it again the next time it's sent
+    section_table_reset(m2s->cat_table);
+    conditional_access_section_unref(new_cas);
 }
 
-static int mpeg2ts_stream_read_pat(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
+static int mpeg2ts_stream_read_cat(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
 {
     g_return_val_if_fail(m2s, 1);
     g_return_val_if_fail(ts, 1);
 
     if (!ts->payload || !ts->payload_len) {
-        g_critical("mpeg2ts_program_read_pat called with an empty TS payload.");
+        g_critical("mpeg2ts_program_read_cat called with an empty TS payload.");
         return 1;
     }
+    section_demux_process_ts_packet(ts, NULL, m2s->cat_demux);
+    return 0;
+}
 
-    int ret = 0;
-    program_association_section_t* new_pas = program_association_section_read(ts->payload, ts->payload_len);
-    if (new_pas == NULL) {
-        ret = 1;
-        goto cleanup;
+static void mpeg2ts_stream_read_pat_section(const psi_section_t* section, elementary_stream_info_t* es_info,
+        void* arg)
+{
+    mpeg2ts_stream_t* m2s = arg;
+    if (!psi_table_add(m2s->pat_table, section)) {
+        return;
+    }
+
+    program_association_section_t* new_pas = NULL;
+    for (size_t i = 0; i < m2s->pat_table->complete->len; ++i) {
+        program_association_section_t* pas = program_association_section_parse(
+                g_ptr_array_index(m2s->pat_table->complete, i));
+        if (pas == NULL) {
+            goto fail;
+        }
+        if (new_pas == NULL) {
+            new_pas = pas;
+        } else {
+            program_association_section_append(new_pas, pas);
+            program_association_section_unref(pas);
+        }
     }
     if (!new_pas->current_next_indicator) {
         g_warning("Ignoring PAT with current_next_indicator = 0");
-        goto cleanup;
+        goto fail;
     }
 
-    // TODO: allow >1 packet PAT
-    if (!m2s->pat || m2s->pat->version_number != new_pas->version_number
-            || (ts->has_adaptation_field && ts->adaptation_field.discontinuity_indicator)) {
+    if (!m2s->pat || m2s->pat->version_number != new_pas->version_number || section->discontinuity) {
         if (m2s->pat != NULL) {
             g_warning("New PAT section in force, discarding the old one");
             program_association_section_unref(m2s->pat);
@@ -254,6 +415,7 @@ static int mpeg2ts_stream_read_pat(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
             mpeg2ts_program_t* prog = mpeg2ts_program_new(
                     m2s->pat->programs[i].program_number,
                     m2s->pat->programs[i].program_map_pid);
+            prog->stream = m2s;
             g_ptr_array_add(m2s->programs, prog);
         }
 
@@ -263,9 +425,24 @@ static int mpeg2ts_stream_read_pat(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
     } else {
         program_association_section_unref(new_pas);
     }
+    return;
 
-cleanup:
-    return ret;
+fail:
+    section_table_reset(m2s->pat_table);
+    program_association_section_unref(new_pas);
+}
+
+static int mpeg2ts_stream_read_pat(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
+{
+    g_return_val_if_fail(m2s, 1);
+    g_return_val_if_fail(ts, 1);
+
+    if (!ts->payload || !ts->payload_len) {
+        g_critical("mpeg2ts_program_read_pat called with an empty TS payload.");
+        return 1;
+    }
+    section_demux_process_ts_packet(ts, NULL, m2s->pat_demux);
+    return 0;
 }
 
 static int mpeg2ts_stream_read_dash_event_msg(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
@@ -276,30 +453,25 @@ static int mpeg2ts_stream_read_dash_event_msg(mpeg2ts_stream_t* m2s, ts_packet_t
     return 0;
 }
 
-static int mpeg2ts_program_read_pmt(mpeg2ts_program_t* m2p, ts_packet_t* ts)
+static void mpeg2ts_program_read_pmt_section(const psi_section_t* section, elementary_stream_info_t* es_info,
+        void* arg)
 {
-    g_return_val_if_fail(m2p, 1);
-    g_return_val_if_fail(ts, 1);
-
-    if (!ts->payload || !ts->payload_len) {
-        g_critical("mpeg2ts_program_read_pmt called with an empty TS payload.");
-        return 1;
+    mpeg2ts_program_t* m2p = arg;
+    if (!psi_table_add(m2p->pmt_table, section)) {
+        return;
     }
 
-    int ret = 0;
-    program_map_section_t* new_pms = program_map_section_read(ts->payload, ts->payload_len);
+    // a PMT is always a single section, which program_map_section_parse() complains about if it's not
+    program_map_section_t* new_pms = program_map_section_parse(g_ptr_array_index(m2p->pmt_table->complete, 0));
     if (new_pms == NULL) {
-        ret = 1;
-        goto cleanup;
+        goto fail;
     }
     if (!new_pms->current_next_indicator) {
         g_warning("Ignoring PMT with current_next_indicator = 0");
-        goto cleanup;
+        goto fail;
     }
 
-    // TODO: allow >1 packet PAT
-    if (!m2p->pmt || m2p->pmt->version_number != new_pms->version_number
-            || (ts->has_adaptation_field && ts->adaptation_field.discontinuity_indicator)) {
+    if (!m2p->pmt || m2p->pmt->version_number != new_pms->version_number || section->discontinuity) {
         if (m2p->pmt != NULL) {
             g_info("New PMT in force, discarding the old one");
             g_hash_table_remove_all(m2p->pids);
@@ -313,6 +485,7 @@ static int mpeg2ts_program_read_pmt(mpeg2ts_program_t* m2p, ts_packet_t* ts)
             pi->es_info = es;
             g_hash_table_insert(m2p->pids, GINT_TO_POINTER(pi->es_info->elementary_pid), pi);
         }
+        m2p->pids_version++;
 
         if (m2p->pmt_processor != NULL) {
             m2p->pmt_processor(m2p, m2p->arg);
@@ -320,9 +493,24 @@ static int mpeg2ts_program_read_pmt(mpeg2ts_program_t* m2p, ts_packet_t* ts)
     } else {
         program_map_section_unref(new_pms);
     }
+    return;
 
-cleanup:
-    return ret;
+fail:
+    section_table_reset(m2p->pmt_table);
+    program_map_section_unref(new_pms);
+}
+
+static int mpeg2ts_program_read_pmt(mpeg2ts_program_t* m2p, ts_packet_t* ts)
+{
+    g_return_val_if_fail(m2p, 1);
+    g_return_val_if_fail(ts, 1);
+
+    if (!ts->payload || !ts->payload_len) {
+        g_critical("mpeg2ts_program_read_pmt called with an empty TS payload.");
+        return 1;
+    }
+    section_demux_process_ts_packet(ts, NULL, m2p->pmt_demux);
+    return 0;
 }
 
 void mpeg2ts_stream_reset(mpeg2ts_stream_t* m2s)
@@ -344,24 +532,141 @@ void mpeg2ts_stream_reset(mpeg2ts_stream_t* m2s)
     }
 }
 
+/* Finds the program a PID belongs to. Returns the PID's pid_info_t, or NULL if it's the PMT PID of *m2p_out or
+ * doesn't belong to any program. */
+static pid_info_t* mpeg2ts_stream_find_pid(mpeg2ts_stream_t* m2s, uint16_t pid, mpeg2ts_program_t** m2p_out)
+{
+    *m2p_out = NULL;
+    for (gsize i = 0; i < m2s->programs->len; ++i) {
+        mpeg2ts_program_t* m2p = g_ptr_array_index(m2s->programs, i);
+
+        if (m2p->pid == pid) {
+            *m2p_out = m2p;
+            return NULL;
+        }
+
+        pid_info_t* pi = mpeg2ts_program_get_pid_info(m2p, pid);
+
+        // pi == NULL => this PID does not belong to this program
+        if (pi != NULL) {
+            // TODO: this can misfire if we have an MPTS and same PID is "owned" by more than one program
+            // this is an *extremely unlikely* case
+            *m2p_out = m2p;
+            return pi;
+        }
+    }
+    return NULL;
+}
+
+static void mpeg2ts_stream_process_pid_packet(pid_info_t* pi, ts_packet_t* ts)
+{
+    if (pi->num_packets > 0 && ts->has_payload
+            && !(ts->has_adaptation_field && ts->adaptation_field.discontinuity_indicator)
+            && ts->continuity_counter == pi->last_continuity_counter) {
+        g_debug("Ignoring duplicate packet for PID %"PRIu16" with continuity_counter=%"PRIu8,
+                ts->pid, ts->continuity_counter);
+        return;
+    }
+    pi->last_continuity_counter = ts->continuity_counter;
+
+    // TODO: check for discontinuity
+
+    pi->num_packets++;
+
+    if (pi->demux_validator != NULL && pi->demux_validator->process_ts_packet != NULL) {
+        // TODO: check return value and do something intelligent
+        pi->demux_validator->process_ts_packet(ts, pi->es_info, pi->demux_validator->arg);
+    }
+
+    if (pi->demux_handler != NULL && pi->demux_handler->process_ts_packet != NULL) {
+        pi->demux_handler->process_ts_packet(ts, pi->es_info, pi->demux_handler->arg);
+    }
+}
+
+/* Reads the tables on fixed PIDs and PIDs with section filters. Returns false if ts isn't on one of them. */
+static bool mpeg2ts_stream_read_fixed_pid(mpeg2ts_stream_t* m2s, ts_packet_t* ts, int* ret)
+{
+    if (m2s->section_pids != NULL && m2s->section_pids[ts->pid] != NULL) {
+        section_demux_process_ts_packet(ts, NULL, m2s->section_pids[ts->pid]->demux);
+        *ret = 0;
+        return true;
+    }
+    switch (ts->pid) {
+    case PID_PAT:
+        *ret = mpeg2ts_stream_read_pat(m2s, ts);
+        return true;
+    case PID_CAT:
+        *ret = mpeg2ts_stream_read_cat(m2s, ts);
+        return true;
+    case PID_DASH_EMSG:
+        *ret = mpeg2ts_stream_read_dash_event_msg(m2s, ts);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Follows the program's clock through a packet on any PID */
+static void mpeg2ts_program_update_clock(mpeg2ts_program_t* m2p, const ts_packet_t* ts)
+{
+    m2p->pcr_info.packets_from_last_pcr++;
+    if (m2p->pmt == NULL || ts->pid != m2p->pmt->pcr_pid || !ts->adaptation_field.pcr_flag
+            || !PCR_IS_VALID(ts->adaptation_field.program_clock_reference)) {
+        return;
+    }
+
+    int64_t pcr = ts->adaptation_field.program_clock_reference;
+    if (m2p->pcr_info.first_pcr == INT64_MAX) {
+        m2p->pcr_info.first_pcr = pcr;
+    }
+    bool discontinuity = ts->adaptation_field.discontinuity_indicator || m2p->pcr_info.pcr[1] == INT64_MAX;
+    if (!discontinuity) {
+        int64_t last_pcr = m2p->pcr_info.pcr[1] - m2p->pcr_info.num_rollovers * PCR_ROLLOVER;
+        if (last_pcr - pcr > PCR_ROLLOVER / 2) {
+            m2p->pcr_info.num_rollovers++;
+        }
+    }
+    pcr += m2p->pcr_info.num_rollovers * PCR_ROLLOVER;
+    if (discontinuity || pcr <= m2p->pcr_info.pcr[1]) {
+        // keep the old rate until there are two PCRs on the new time base
+        m2p->pcr_info.pcr[0] = INT64_MAX;
+    } else {
+        m2p->pcr_info.pcr[0] = m2p->pcr_info.pcr[1];
+        m2p->pcr_info.pcr_rate = (double)(pcr - m2p->pcr_info.pcr[0]) / m2p->pcr_info.packets_from_last_pcr;
+    }
+    m2p->pcr_info.pcr[1] = pcr;
+    m2p->pcr_info.packets_from_last_pcr = 0;
+}
+
+static void mpeg2ts_stream_update_clocks(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
+{
+    ts->pcr_int = PCR_INVALID;
+    for (gsize i = 0; i < m2s->programs->len; ++i) {
+        mpeg2ts_program_t* m2p = g_ptr_array_index(m2s->programs, i);
+        mpeg2ts_program_update_clock(m2p, ts);
+        if (ts->pcr_int == PCR_INVALID && m2p->pcr_info.pcr[1] != INT64_MAX
+                && (m2p->pcr_info.packets_from_last_pcr == 0 || m2p->pcr_info.pcr_rate > 0)) {
+            int64_t pcr = m2p->pcr_info.pcr[1]
+                    + (int64_t)(m2p->pcr_info.packets_from_last_pcr * m2p->pcr_info.pcr_rate + 0.5);
+            ts->pcr_int = pcr % PCR_ROLLOVER;
+        }
+    }
+}
+
 int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
 {
     if (ts == NULL) {
         mpeg2ts_stream_reset(m2s);
         return 0;
     }
+    mpeg2ts_stream_update_clocks(m2s, ts);
     if (m2s->ts_processor && m2s->ts_processor->process_ts_packet) {
         m2s->ts_processor->process_ts_packet(ts, NULL, m2s->ts_processor->arg);
     }
 
-    if (ts->pid == PID_PAT) {
-        return mpeg2ts_stream_read_pat(m2s, ts);
-    }
-    if (ts->pid == PID_CAT) {
-        return mpeg2ts_stream_read_cat(m2s, ts);
-    }
-    if (ts->pid == PID_DASH_EMSG) {
-        return mpeg2ts_stream_read_dash_event_msg(m2s, ts);
+    int ret = 0;
+    if (mpeg2ts_stream_read_fixed_pid(m2s, ts, &ret)) {
+        return ret;
     }
     if (ts->pid == PID_NULL) {
         return 0;
@@ -372,46 +677,69 @@ int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t* m2s, ts_packet_t* ts)
         return 0;
     }
 
-    for (gsize i = 0; i < m2s->programs->len; ++i) {
-        mpeg2ts_program_t* m2p = g_ptr_array_index(m2s->programs, i);
+    mpeg2ts_program_t* m2p;
+    pid_info_t* pi = mpeg2ts_stream_find_pid(m2s, ts->pid, &m2p);
+    if (pi != NULL) {
+        mpeg2ts_stream_process_pid_packet(pi, ts);
+    } else if (m2p != NULL) {
+        return mpeg2ts_program_read_pmt(m2p, ts);    // got a PMT
+    }
+    return 0;
+}
 
-        if (m2p->pid == ts->pid) {
-            return mpeg2ts_program_read_pmt(m2p, ts);    // got a PMT
-        }
+int mpeg2ts_stream_read_ts_packets(mpeg2ts_stream_t* m2s, ts_packet_t* packets, size_t num_packets)
+{
+    g_return_val_if_fail(m2s, 1);
+    g_return_val_if_fail(packets || num_packets == 0, 1);
 
-        pid_info_t* pi = mpeg2ts_program_get_pid_info(m2p, ts->pid);
+    /* Packets have to be handled in order, since PSI changes where later packets go and the validators care where
+     * each packet is in the stream. What we can skip is looking up the same PID over and over, which stays valid
+     * until we read the PAT or a program's PIDs change. */
+    uint16_t cached_pid = PID_NULL;
+    mpeg2ts_program_t* cached_m2p = NULL;
+    unsigned cached_version = 0;
+    pid_info_t* cached_pi = NULL;
 
-        // pi == NULL => this PID does not belong to this program
-        if (pi == NULL) {
-            continue;
+    int ret = 0;
+    for (size_t i = 0; i < num_packets; ++i) {
+        ts_packet_t* ts = &packets[i];
+#ifdef __GNUC__
+        if (i + 1 < num_packets) {
+            __builtin_prefetch(&packets[i + 1]);
         }
-
-        if (pi->num_packets > 0 && ts->has_payload
-                && !(ts->has_adaptation_field && ts->adaptation_field.discontinuity_indicator)
-                && ts->continuity_counter == pi->last_continuity_counter) {
-            g_debug("Ignoring duplicate packet for PID %"PRIu16" with continuity_counter=%"PRIu8,
-                    ts->pid, ts->continuity_counter);
-            break;
+#endif
+        mpeg2ts_stream_update_clocks(m2s, ts);
+        if (m2s->ts_processor && m2s->ts_processor->process_ts_packet) {
+            m2s->ts_processor->process_ts_packet(ts, NULL, m2s->ts_processor->arg);
         }
-        pi->last_continuity_counter = ts->continuity_counter;
-
-        // TODO: check for discontinuity
 
-        pi->num_packets++;
+        int fixed_ret;
+        if (mpeg2ts_stream_read_fixed_pid(m2s, ts, &fixed_ret)) {
+            ret |= fixed_ret;
+            cached_pi = NULL;
+            continue;
+        }
+        if (ts->pid == PID_NULL) {
+            continue;
+        }
 
-        // TODO: this can misfire if we have an MPTS and same PID is "owned" by more than one program
-        // this is an *extremely unlikely* case
-        if (pi->demux_validator != NULL && pi->demux_validator->process_ts_packet != NULL) {
-            // TODO: check return value and do something intelligent
-            pi->demux_validator->process_ts_packet(ts, pi->es_info, pi->demux_validator->arg);
+        if (m2s->pat == NULL) {
+            g_info("PAT missing -- unknown PID 0x%02X", ts->pid);
+            continue;
         }
 
-        if (pi->demux_handler != NULL && pi->demux_handler->process_ts_packet != NULL) {
-            pi->demux_handler->process_ts_packet(ts, pi->es_info, pi->demux_handler->arg);
-            return 0;
+        if (cached_pi == NULL || cached_pid != ts->pid || cached_m2p->pids_version != cached_version) {
+            cached_pi = mpeg2ts_stream_find_pid(m2s, ts->pid, &cached_m2p);
+            if (cached_pi == NULL) {
+                if (cached_m2p != NULL) {
+                    ret |= mpeg2ts_program_read_pmt(cached_m2p, ts);    // got a PMT
+                }
+                continue;
+            }
+            cached_pid = ts->pid;
+            cached_version = cached_m2p->pids_version;
         }
-        break;
+        mpeg2ts_stream_process_pid_packet(cached_pi, ts);
     }
-
-    return 0;
+    return ret;
 }
\ No newline at end of file
@@ -36,6 +36,7 @@
 #include "pes.h"
 #include "psi.h"
 #include "descriptors.h"
+#include "section_demux.h"
 
 struct _mpeg2ts_stream;
 struct _mpeg2ts_program;
@@ -47,6 +48,15 @@ typedef void (*pmt_processor_t)(struct _mpeg2ts_program*, void*);
 
 typedef void (*arg_destructor_t)(void*);
 
+/* Gets the sections on a PID with (table_id & table_id_mask) == (filter table_id & table_id_mask) */
+typedef struct {
+    uint8_t table_id;
+    uint8_t table_id_mask;
+    section_processor_t process_section;
+    void* arg;                            // argument for section processor
+    arg_destructor_t arg_destructor;      // destructor for arg
+} section_filter_t;
+
 typedef struct {
     void* arg;                            // argument for ts packet processor
     arg_destructor_t arg_destructor;      // destructor for arg
@@ -54,23 +64,25 @@ typedef struct {
 } demux_pid_handler_t;
 
 struct _mpeg2ts_program {
+    struct _mpeg2ts_stream* stream; // stream this program is in
     uint16_t pid; // PMT PID
     uint16_t program_number;
 
     GHashTable* pids; // PIDs belonging to this program
     // each element is of type pid_info_t
+    unsigned pids_version; // incremented whenever pids changes
 
     struct {
-        int64_t first_pcr;
+        int64_t first_pcr;             // INT64_MAX until the first PCR
         int32_t num_rollovers;
-        int64_t pcr[2];
-        int32_t packets_from_last_pcr;
-        double pcr_rate;
-    } pcr_info; // information on STC clock state
+        int64_t pcr[2];                // last two PCRs, with rollovers added; pcr[0] is INT64_MAX after a discontinuity
+        int32_t packets_from_last_pcr; // TS packets on any PID since pcr[1]
+        double pcr_rate;               // 27 MHz ticks per TS packet between the last two PCRs
+    } pcr_info; // information on STC clock state, updated before packets are handled
 
     program_map_section_t* pmt;      // parsed PMT
-    uint8_t* pmt_bytes;
-    size_t pmt_len;
+    section_demux_t* pmt_demux;      // reassembles PMT sections
+    section_table_t* pmt_table;      // PMT sections, to skip repeats of the one in force
     pmt_processor_t pmt_processor;   // callback called after PMT was processed
     void* arg;                       // argument for PMT callback
     arg_destructor_t arg_destructor; // destructor for the callback argument
@@ -78,17 +90,18 @@ struct _mpeg2ts_program {
 
 struct _mpeg2ts_stream {
     program_association_section_t* pat; // PAT
-    uint8_t* pat_bytes;
-    size_t pat_len;
+    section_demux_t* pat_demux;         // reassembles PAT sections
+    section_table_t* pat_table;         // PAT sections, collected until the table is complete
     conditional_access_section_t* cat;  // CAT
-    uint8_t* cat_bytes;
-    size_t cat_len;
+    section_demux_t* cat_demux;         // reassembles CAT sections
+    section_table_t* cat_table;         // CAT sections, collected until the table is complete
     pat_processor_t pat_processor;      // callback called after PAT was processed
     cat_processor_t cat_processor;      // callback called after CAT was processed
     demux_pid_handler_t* emsg_processor; // handler for 'emsg' packets
     demux_pid_handler_t* ts_processor;  // handler for all TS packets
     GPtrArray* programs;                // list of programs in this multiplex
     GPtrArray* ca_systems;              // list of conditional access systems in this multiplex
+    struct _section_pid** section_pids; // indexed by PID, NULL until a section filter is registered
     void* arg;                          // argument for PAT/CAT callbacks
     arg_destructor_t arg_destructor;    // destructor for the callback argument
 };
@@ -107,7 +120,10 @@ typedef struct {
 
 mpeg2ts_stream_t* mpeg2ts_stream_new(void);
 void mpeg2ts_stream_free(mpeg2ts_stream_t* m2s);
+// Sets ts->pcr_int from the clock of the first program with one, extrapolating from its last two PCRs
 int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t* m2s, ts_packet_t* ts);
+// same as calling mpeg2ts_stream_read_ts_packet() on each packet in order, but cheaper
+int mpeg2ts_stream_read_ts_packets(mpeg2ts_stream_t* m2s, ts_packet_t* packets, size_t num_packets);
 
 mpeg2ts_program_t* mpeg2ts_program_new(uint16_t program_number, uint16_t pid);
 void mpeg2ts_program_free(mpeg2ts_program_t* m2p);
@@ -119,4 +135,11 @@ void mpeg2ts_stream_reset(mpeg2ts_stream_t* m2s);
 
 demux_pid_handler_t* demux_pid_handler_new(ts_pid_processor_t);
 
+section_filter_t* section_filter_new(uint8_t table_id, uint8_t table_id_mask, section_processor_t);
+/* Sends sections on pid that match the filter to it, instead of handling the PID's packets like any other. The stream
+ * takes ownership of the filter. Table IDs the filter matches are taken away from filters registered earlier on the
+ * same PID, so each table_id goes to at most one filter. */
+int mpeg2ts_stream_register_section_filter(mpeg2ts_stream_t* m2s, uint16_t pid, section_filter_t* filter);
+int mpeg2ts_stream_unregister_section_filters(mpeg2ts_stream_t* m2s, uint16_t pid);
+
 #endif
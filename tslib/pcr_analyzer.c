@@ -0,0 +1,226 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pcr_analyzer.h"
+
+#include <math.h>
+#include <string.h>
+
+
+pcr_analyzer_t* pcr_analyzer_new(void)
+{
+    pcr_analyzer_t* analyzer = g_slice_new0(pcr_analyzer_t);
+    analyzer->points = g_array_new(false, false, sizeof(pcr_point_t));
+    analyzer->errors = g_array_new(false, false, sizeof(pcr_error_t));
+    pcr_analyzer_reset(analyzer);
+    return analyzer;
+}
+
+void pcr_analyzer_free(pcr_analyzer_t* analyzer)
+{
+    if (analyzer == NULL) {
+        return;
+    }
+    g_array_free(analyzer->points, true);
+    g_array_free(analyzer->errors, true);
+    g_slice_free(pcr_analyzer_t, analyzer);
+}
+
+void pcr_analyzer_reset(pcr_analyzer_t* analyzer)
+{
+    g_return_if_fail(analyzer);
+
+    g_array_set_size(analyzer->points, 0);
+    g_array_set_size(analyzer->errors, 0);
+    analyzer->last_pcr = PCR_INVALID;
+    analyzer->num_rollovers = 0;
+    analyzer->run = 0;
+    analyzer->min_interval = UINT64_MAX;
+    analyzer->max_interval = 0;
+}
+
+static void add_error(pcr_analyzer_t* analyzer, pcr_error_type_t type, uint64_t pcr, uint64_t offset)
+{
+    pcr_error_t error = {
+        .type = type,
+        .offset = offset,
+        .pcr = pcr,
+        .previous = analyzer->last_pcr
+    };
+    g_array_append_val(analyzer->errors, error);
+}
+
+bool pcr_analyzer_add(pcr_analyzer_t* analyzer, uint64_t pcr, uint64_t offset, bool discontinuity)
+{
+    g_return_val_if_fail(analyzer, false);
+
+    if (pcr >= PCR_ROLLOVER) {
+        add_error(analyzer, PCR_OUT_OF_RANGE, pcr, offset);
+        return false;
+    }
+
+    bool valid = true;
+    if (PCR_IS_VALID(analyzer->last_pcr)) {
+        int64_t interval = (int64_t)pcr - (int64_t)analyzer->last_pcr;
+        if (discontinuity) {
+            ++analyzer->run;
+        } else {
+            if (interval < -PCR_ROLLOVER / 2) {
+                ++analyzer->num_rollovers;
+                interval += PCR_ROLLOVER;
+            } else if (interval > PCR_ROLLOVER / 2) {
+                /* Backwards, past a rollover */
+                interval -= PCR_ROLLOVER;
+            }
+            if (interval < 0) {
+                add_error(analyzer, PCR_BACKWARDS, pcr, offset);
+                valid = false;
+                /* Treat it like a discontinuity, so later intervals are still checked */
+                ++analyzer->run;
+            } else {
+                analyzer->min_interval = MIN(analyzer->min_interval, (uint64_t)interval);
+                analyzer->max_interval = MAX(analyzer->max_interval, (uint64_t)interval);
+                if (interval > PCR_MAX_INTERVAL) {
+                    add_error(analyzer, PCR_INTERVAL_TOO_LONG, pcr, offset);
+                    valid = false;
+                }
+            }
+        }
+    }
+
+    pcr_point_t point = {
+        .offset = offset,
+        .pcr = pcr + analyzer->num_rollovers * PCR_ROLLOVER,
+        .run = analyzer->run
+    };
+    g_array_append_val(analyzer->points, point);
+    analyzer->last_pcr = pcr;
+    return valid;
+}
+
+void pcr_analyzer_summarize(const pcr_analyzer_t* analyzer, pcr_summary_t* summary)
+{
+    g_return_if_fail(analyzer);
+    g_return_if_fail(summary);
+
+    memset(summary, 0, sizeof(*summary));
+    summary->num_pcrs = analyzer->points->len;
+    summary->num_discontinuities = analyzer->run;
+    summary->num_rollovers = analyzer->num_rollovers;
+    if (analyzer->min_interval <= analyzer->max_interval) {
+        summary->min_interval = analyzer->min_interval;
+        summary->max_interval = analyzer->max_interval;
+    }
+
+    const pcr_point_t* points = (const pcr_point_t*)analyzer->points->data;
+    size_t len = analyzer->points->len;
+    double bytes = 0;
+    double ticks = 0;
+    double sum_squares = 0;
+    size_t num_fit = 0;
+    size_t end;
+    for (size_t start = 0; start < len; start = end) {
+        for (end = start + 1; end < len && points[end].run == points[start].run; ++end);
+        size_t n = end - start;
+        if (n < 2 || points[end - 1].offset == points[start].offset) {
+            continue;
+        }
+
+        /* Least squares fit of PCR against offset, relative to the first PCR so doubles keep their precision */
+        double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+        for (size_t i = start; i < end; ++i) {
+            double x = points[i].offset - points[start].offset;
+            double y = points[i].pcr - points[start].pcr;
+            sum_x += x;
+            sum_y += y;
+            sum_xx += x * x;
+            sum_xy += x * y;
+        }
+        double slope = (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+        double intercept = (sum_y - slope * sum_x) / n;
+        for (size_t i = start; i < end; ++i) {
+            double x = points[i].offset - points[start].offset;
+            double y = points[i].pcr - points[start].pcr;
+            double deviation = fabs(y - (intercept + slope * x));
+            summary->max_deviation = MAX(summary->max_deviation, deviation);
+            sum_squares += deviation * deviation;
+            ++num_fit;
+        }
+        bytes += points[end - 1].offset - points[start].offset;
+        ticks += points[end - 1].pcr - points[start].pcr;
+    }
+    if (num_fit > 0) {
+        summary->rms_deviation = sqrt(sum_squares / num_fit);
+    }
+    if (ticks > 0) {
+        summary->bitrate = bytes * 8 * 27000000 / ticks;
+    }
+}
+
+uint64_t pcr_analyzer_pcr_at(const pcr_analyzer_t* analyzer, uint64_t offset)
+{
+    g_return_val_if_fail(analyzer, PCR_INVALID);
+
+    const pcr_point_t* points = (const pcr_point_t*)analyzer->points->data;
+    size_t len = analyzer->points->len;
+
+    /* First PCR after offset */
+    size_t low = 0;
+    size_t high = len;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (points[mid].offset <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    /* Bytes between the last PCR of a run and the discontinuity are still on the old time base */
+    const pcr_point_t* a;
+    if (low > 0 && low < len && points[low - 1].run == points[low].run) {
+        a = &points[low - 1];
+    } else if (low > 1 && points[low - 2].run == points[low - 1].run) {
+        a = &points[low - 2];
+    } else if (low == 0 && len > 1 && points[0].run == points[1].run) {
+        a = &points[0];
+    } else {
+        return PCR_INVALID;
+    }
+    const pcr_point_t* b = a + 1;
+    if (a->offset == b->offset) {
+        return PCR_INVALID;
+    }
+
+    double pcr = a->pcr + ((double)offset - (double)a->offset) * (b->pcr - a->pcr) / (double)(b->offset - a->offset);
+    int64_t result = llround(pcr) % PCR_ROLLOVER;
+    if (result < 0) {
+        result += PCR_ROLLOVER;
+    }
+    return result;
+}
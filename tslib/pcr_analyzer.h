@@ -0,0 +1,104 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_PCR_ANALYZER_H
+#define TSLIB_PCR_ANALYZER_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ts.h"
+
+
+/* Longest time between PCRs, 2.7.2 of ISO/IEC 13818-1 */
+#define PCR_MAX_INTERVAL (27000000 / 10)
+/* PCRs are accurate to +/- 500 ns, 2.4.2.2 of ISO/IEC 13818-1 */
+#define PCR_ACCURACY 13.5
+
+typedef enum {
+    PCR_INTERVAL_TOO_LONG,
+    PCR_BACKWARDS, /* without discontinuity_indicator */
+    PCR_OUT_OF_RANGE /* program_clock_reference_extension is 300 or more, so it's past PCR_ROLLOVER */
+} pcr_error_type_t;
+
+typedef struct {
+    pcr_error_type_t type;
+    uint64_t offset;   /* byte offset of the packet */
+    uint64_t pcr;
+    uint64_t previous; /* the PCR before it */
+} pcr_error_t;
+
+typedef struct {
+    uint64_t offset;
+    int64_t pcr; /* with rollovers added, so it only goes up between discontinuities */
+    uint32_t run; /* number of discontinuities before it */
+} pcr_point_t;
+
+typedef struct {
+    size_t num_pcrs;
+    uint32_t num_discontinuities;
+    uint32_t num_rollovers;
+    uint64_t min_interval; /* 27 MHz, 0 if there are less than 2 PCRs */
+    uint64_t max_interval;
+    double bitrate;        /* bits per second, 0 if there are less than 2 PCRs in a run */
+    /* How far PCRs are from a straight line through the PCRs in their run (the time bytes would arrive at a constant
+     * bitrate), in 27 MHz ticks */
+    double max_deviation;
+    double rms_deviation;
+} pcr_summary_t;
+
+/* Follows the PCRs of one program, checking that they're no more than 100 ms apart and only go backwards at
+ * discontinuities, and keeps them so the arrival time of any byte can be worked out once they've all been seen.
+ * Rollovers are handled, and discontinuities split the PCRs into runs that are fit separately. */
+typedef struct {
+    GArray* points; /* pcr_point_t */
+    GArray* errors; /* pcr_error_t */
+    uint64_t last_pcr; /* PCR_INVALID before the first PCR */
+    uint32_t num_rollovers;
+    uint32_t run;
+    uint64_t min_interval;
+    uint64_t max_interval;
+} pcr_analyzer_t;
+
+pcr_analyzer_t* pcr_analyzer_new(void);
+void pcr_analyzer_free(pcr_analyzer_t*);
+/* Forgets every PCR and error, for the next segment */
+void pcr_analyzer_reset(pcr_analyzer_t*);
+
+/* Adds the PCR in the packet at byte offset. discontinuity is the packet's discontinuity_indicator. Returns false if
+ * it was an error, which is appended to analyzer->errors. PCRs that are out of range are otherwise ignored. */
+bool pcr_analyzer_add(pcr_analyzer_t*, uint64_t pcr, uint64_t offset, bool discontinuity);
+
+void pcr_analyzer_summarize(const pcr_analyzer_t*, pcr_summary_t*);
+
+/* The PCR of byte offset, interpolated between the PCRs around it in the same run, or extrapolated from the last two
+ * in its run (or the first two, before the first PCR). Returns PCR_INVALID if its run has less than two PCRs. */
+uint64_t pcr_analyzer_pcr_at(const pcr_analyzer_t*, uint64_t offset);
+
+#endif
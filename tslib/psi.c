@@ -235,22 +235,11 @@ bool program_association_section_equal(const program_association_section_t* a, c
     return true;
 }
 
-program_association_section_t* program_association_section_read(uint8_t* buf, size_t buf_len)
+static program_association_section_t* program_association_section_read_section(const uint8_t* buf, size_t buf_len,
+        bool check_crc)
 {
-    g_return_val_if_fail(buf, NULL);
-    if (!buf_len) {
-        g_critical("Buffer for program association section is empty.");
-        return NULL;
-    }
-
-    uint8_t offset = buf[0] + 1;
-    if (offset > buf_len) {
-        g_critical("Invalid pointer field %"PRIu8" in PAT", offset - 1);
-        return NULL;
-    }
-
     program_association_section_t* pas = program_association_section_new();
-    bitreader_new_stack(b, buf + offset, buf_len - offset);
+    bitreader_new_stack(b, buf, buf_len);
 
     if (!section_header_read((mpeg2ts_section_t*)pas, b)) {
         goto fail;
@@ -272,9 +261,6 @@ program_association_section_t* program_association_section_read(uint8_t* buf, si
 
     pas->section_number = bitreader_read_uint8(b);
     pas->last_section_number = bitreader_read_uint8(b);
-    if(pas->section_number != 0 || pas->last_section_number != 0) {
-        g_warning("Multi-section PAT is not supported yet");
-    }
 
     // section_length gives us the length from the end of section_length
     // we used 5 bytes for the mandatory section fields, and will use another 4 bytes for CRC
@@ -300,13 +286,15 @@ program_association_section_t* program_association_section_read(uint8_t* buf, si
         goto fail;
     }
 
-    // check CRC
-    crc_t pas_crc = crc_init();
-    pas_crc = crc_update(pas_crc, b->data, pas->section_length + 3 - 4);
-    pas_crc = crc_finalize(pas_crc);
-    if (pas_crc != pas->crc_32) {
-        g_critical("PAT CRC_32 should be 0x%08X, but calculated as 0x%08X", pas->crc_32, pas_crc);
-        goto fail;
+    // sections from a section_demux_t had their CRC checked as they were reassembled
+    if (check_crc) {
+        crc_t pas_crc = crc_init();
+        pas_crc = crc_update(pas_crc, b->data, pas->section_length + 3 - 4);
+        pas_crc = crc_finalize(pas_crc);
+        if (pas_crc != pas->crc_32) {
+            g_critical("PAT CRC_32 should be 0x%08X, but calculated as 0x%08X", pas->crc_32, pas_crc);
+            goto fail;
+        }
     }
 
 cleanup:
@@ -317,6 +305,38 @@ fail:
     goto cleanup;
 }
 
+program_association_section_t* program_association_section_read(uint8_t* buf, size_t buf_len)
+{
+    g_return_val_if_fail(buf, NULL);
+    if (!buf_len) {
+        g_critical("Buffer for program association section is empty.");
+        return NULL;
+    }
+
+    uint8_t offset = buf[0] + 1;
+    if (offset > buf_len) {
+        g_critical("Invalid pointer field %"PRIu8" in PAT", offset - 1);
+        return NULL;
+    }
+    return program_association_section_read_section(buf + offset, buf_len - offset, true);
+}
+
+program_association_section_t* program_association_section_parse(const psi_section_t* section)
+{
+    g_return_val_if_fail(section, NULL);
+    return program_association_section_read_section(section->data, section->len, false);
+}
+
+void program_association_section_append(program_association_section_t* pas, program_association_section_t* other)
+{
+    g_return_if_fail(pas);
+    g_return_if_fail(other);
+
+    pas->programs = realloc(pas->programs, (pas->num_programs + other->num_programs) * sizeof(program_info_t));
+    memcpy(pas->programs + pas->num_programs, other->programs, other->num_programs * sizeof(program_info_t));
+    pas->num_programs += other->num_programs;
+}
+
 void program_association_section_print(const program_association_section_t* pas)
 {
     g_return_if_fail(pas);
@@ -483,22 +503,11 @@ bool program_map_section_equal(const program_map_section_t* a, const program_map
     return true;
 }
 
-program_map_section_t* program_map_section_read(uint8_t* buf, size_t buf_len)
+static program_map_section_t* program_map_section_read_section(const uint8_t* buf, size_t buf_len,
+        bool check_crc)
 {
-    g_return_val_if_fail(buf, NULL);
-    if (!buf_len) {
-        g_critical("Buffer for program map section is empty.");
-        return NULL;
-    }
-
-    uint8_t offset = buf[0] + 1;
-    if (offset > buf_len) {
-        g_critical("Invalid pointer field %"PRIu8" in PMT", offset - 1);
-        return NULL;
-    }
-
     program_map_section_t* pms = program_map_section_new();
-    bitreader_new_stack(b, buf + offset, buf_len - offset);
+    bitreader_new_stack(b, buf, buf_len);
     GPtrArray* es_info = NULL;
 
     if (!section_header_read((mpeg2ts_section_t*)pms, b)) {
@@ -571,13 +580,15 @@ program_map_section_t* program_map_section_read(uint8_t* buf, size_t buf_len)
         goto fail;
     }
 
-    // check CRC
-    crc_t pms_crc = crc_init();
-    pms_crc = crc_update(pms_crc, b->data, pms->section_length + 3 - 4);
-    pms_crc = crc_finalize(pms_crc);
-    if (pms_crc != pms->crc_32) {
-        g_critical("PMT CRC_32 should be 0x%08X, but calculated as 0x%08X", pms->crc_32, pms_crc);
-        goto fail;
+    // sections from a section_demux_t had their CRC checked as they were reassembled
+    if (check_crc) {
+        crc_t pms_crc = crc_init();
+        pms_crc = crc_update(pms_crc, b->data, pms->section_length + 3 - 4);
+        pms_crc = crc_finalize(pms_crc);
+        if (pms_crc != pms->crc_32) {
+            g_critical("PMT CRC_32 should be 0x%08X, but calculated as 0x%08X", pms->crc_32, pms_crc);
+            goto fail;
+        }
     }
 
 cleanup:
@@ -592,6 +603,28 @@ fail:
     goto cleanup;
 }
 
+program_map_section_t* program_map_section_read(uint8_t* buf, size_t buf_len)
+{
+    g_return_val_if_fail(buf, NULL);
+    if (!buf_len) {
+        g_critical("Buffer for program map section is empty.");
+        return NULL;
+    }
+
+    uint8_t offset = buf[0] + 1;
+    if (offset > buf_len) {
+        g_critical("Invalid pointer field %"PRIu8" in PMT", offset - 1);
+        return NULL;
+    }
+    return program_map_section_read_section(buf + offset, buf_len - offset, true);
+}
+
+program_map_section_t* program_map_section_parse(const psi_section_t* section)
+{
+    g_return_val_if_fail(section, NULL);
+    return program_map_section_read_section(section->data, section->len, false);
+}
+
 void program_map_section_print(program_map_section_t* pms)
 {
     g_return_if_fail(pms);
@@ -678,22 +711,11 @@ bool conditional_access_section_equal(const conditional_access_section_t* a, con
     return true;
 }
 
-conditional_access_section_t* conditional_access_section_read(uint8_t* buf, size_t buf_len)
+static conditional_access_section_t* conditional_access_section_read_section(const uint8_t* buf, size_t buf_len,
+        bool check_crc)
 {
-    g_return_val_if_fail(buf, NULL);
-    if (!buf_len) {
-        g_critical("Buffer for program association section is empty.");
-        return NULL;
-    }
-
-    uint8_t offset = buf[0] + 1;
-    if (offset > buf_len) {
-        g_critical("Invalid pointer field %"PRIu8" in PAT", offset - 1);
-        return NULL;
-    }
-
     conditional_access_section_t* cas = conditional_access_section_new();
-    bitreader_new_stack(b, buf + offset, buf_len - offset);
+    bitreader_new_stack(b, buf, buf_len);
 
     if (!section_header_read((mpeg2ts_section_t*)cas, b)) {
         goto fail;
@@ -714,9 +736,6 @@ conditional_access_section_t* conditional_access_section_read(uint8_t* buf, size
 
     cas->section_number = bitreader_read_uint8(b);
     cas->last_section_number = bitreader_read_uint8(b);
-    if (cas->section_number != 0 || cas->last_section_number != 0) {
-        g_warning("Multi-section CAT is not supported yet");
-    }
 
     if (cas->section_length < 9) {
         g_critical("Invalid CAT section length, %"PRIu16" is not long enough to hold required data.",
@@ -737,13 +756,15 @@ conditional_access_section_t* conditional_access_section_read(uint8_t* buf, size
         goto fail;
     }
 
-    // check CRC
-    crc_t crc = crc_init();
-    crc = crc_update(crc, b->data, cas->section_length + 3 - 4);
-    crc = crc_finalize(crc);
-    if (crc != cas->crc_32) {
-        g_critical("CAT CRC_32 should be 0x%08X, but calculated as 0x%08X", cas->crc_32, crc);
-        goto fail;
+    // sections from a section_demux_t had their CRC checked as they were reassembled
+    if (check_crc) {
+        crc_t crc = crc_init();
+        crc = crc_update(crc, b->data, cas->section_length + 3 - 4);
+        crc = crc_finalize(crc);
+        if (crc != cas->crc_32) {
+            g_critical("CAT CRC_32 should be 0x%08X, but calculated as 0x%08X", cas->crc_32, crc);
+            goto fail;
+        }
     }
 
 cleanup:
@@ -754,6 +775,41 @@ fail:
     goto cleanup;
 }
 
+conditional_access_section_t* conditional_access_section_read(uint8_t* buf, size_t buf_len)
+{
+    g_return_val_if_fail(buf, NULL);
+    if (!buf_len) {
+        g_critical("Buffer for program association section is empty.");
+        return NULL;
+    }
+
+    uint8_t offset = buf[0] + 1;
+    if (offset > buf_len) {
+        g_critical("Invalid pointer field %"PRIu8" in PAT", offset - 1);
+        return NULL;
+    }
+    return conditional_access_section_read_section(buf + offset, buf_len - offset, true);
+}
+
+conditional_access_section_t* conditional_access_section_parse(const psi_section_t* section)
+{
+    g_return_val_if_fail(section, NULL);
+    return conditional_access_section_read_section(section->data, section->len, false);
+}
+
+void conditional_access_section_append(conditional_access_section_t* cas, conditional_access_section_t* other)
+{
+    g_return_if_fail(cas);
+    g_return_if_fail(other);
+
+    cas->descriptors = realloc(cas->descriptors,
+            (cas->descriptors_len + other->descriptors_len) * sizeof(descriptor_t*));
+    memcpy(cas->descriptors + cas->descriptors_len, other->descriptors,
+            other->descriptors_len * sizeof(descriptor_t*));
+    cas->descriptors_len += other->descriptors_len;
+    other->descriptors_len = 0;
+}
+
 void conditional_access_section_print(const conditional_access_section_t* cas)
 {
     g_return_if_fail(cas);
@@ -90,7 +90,8 @@ enum {
     STREAM_TYPE_HEVC = 0x24,
     STREAM_TYPE_IPMP = 0x7F,
 //TODO: handle registration descriptor
-    STREAM_TYPE_AC3_AUDIO = 0x81 // ATSC A/52B, A3.1 AC3 Stream Type
+    STREAM_TYPE_AC3_AUDIO = 0x81, // ATSC A/52B, A3.1 AC3 Stream Type
+    STREAM_TYPE_SCTE35 = 0x86 // ANSI/SCTE 35 splice_info_section
 } ts_stream_type_t;
 
 #define GENERAL_PURPOSE_PID_MIN		0x0010
@@ -181,21 +182,39 @@ typedef struct {
     uint32_t crc_32;
 } program_map_section_t;
 
+/* A complete section, from table_id to the end of section_length */
+typedef struct {
+    uint16_t pid;
+    const uint8_t* data;
+    size_t len;
+    uint32_t crc_32;      // CRC_32 calculated over everything but the last 4 bytes
+    bool discontinuity;   // discontinuity_indicator was set in a packet the section was in
+} psi_section_t;
+
+/* The *_parse() functions read a section reassembled by a section_demux_t, which has already checked the CRC_32.
+ * The *_append() functions add the programs or descriptors from a later section of the same table, so a table sent in
+ * several sections can be handled as one. The descriptors are moved, not copied. */
+
 program_association_section_t* program_association_section_ref(program_association_section_t*);
 void program_association_section_unref(program_association_section_t*);
 program_association_section_t* program_association_section_read(uint8_t* buf, size_t buf_len);
+program_association_section_t* program_association_section_parse(const psi_section_t*);
+void program_association_section_append(program_association_section_t*, program_association_section_t* other);
 void program_association_section_print(const program_association_section_t*);
 bool program_association_section_equal(const program_association_section_t*, const program_association_section_t*);
 
 conditional_access_section_t* conditional_access_section_ref(conditional_access_section_t*);
 void conditional_access_section_unref(conditional_access_section_t* );
 conditional_access_section_t* conditional_access_section_read(uint8_t* buf, size_t buf_len);
+conditional_access_section_t* conditional_access_section_parse(const psi_section_t*);
+void conditional_access_section_append(conditional_access_section_t*, conditional_access_section_t* other);
 void conditional_access_section_print(const conditional_access_section_t*);
 bool conditional_access_section_equal(const conditional_access_section_t*, const conditional_access_section_t*);
 
 program_map_section_t* program_map_section_ref(program_map_section_t*);
 void program_map_section_unref(program_map_section_t*);
 program_map_section_t* program_map_section_read(uint8_t* buf, size_t buf_size);
+program_map_section_t* program_map_section_parse(const psi_section_t*);
 void program_map_section_print(program_map_section_t*);
 bool program_map_section_equal(const program_map_section_t*, const program_map_section_t*);
 
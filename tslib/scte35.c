@@ -0,0 +1,216 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "scte35.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include "bitreader.h"
+#include "log.h"
+
+
+#define PTS_MASK ((UINT64_C(1) << 33) - 1)
+
+static splice_info_section_t* splice_info_section_new(void)
+{
+    splice_info_section_t* obj = g_slice_new0(splice_info_section_t);
+    return obj;
+}
+
+void splice_info_section_free(splice_info_section_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_slice_free(splice_info_section_t, obj);
+}
+
+static void splice_time_read(splice_info_section_t* sis, bitreader_t* b)
+{
+    sis->time_specified_flag = bitreader_read_bit(b);
+    if (sis->time_specified_flag) {
+        bitreader_skip_bits(b, 6); // reserved
+        sis->pts_time = bitreader_read_bits(b, 33);
+    } else {
+        bitreader_skip_bits(b, 7); // reserved
+    }
+}
+
+static void splice_insert_read(splice_info_section_t* sis, bitreader_t* b)
+{
+    sis->splice_event_id = bitreader_read_uint32(b);
+    sis->splice_event_cancel_indicator = bitreader_read_bit(b);
+    bitreader_skip_bits(b, 7); // reserved
+    if (sis->splice_event_cancel_indicator) {
+        return;
+    }
+
+    sis->out_of_network_indicator = bitreader_read_bit(b);
+    sis->program_splice_flag = bitreader_read_bit(b);
+    sis->duration_flag = bitreader_read_bit(b);
+    sis->splice_immediate_flag = bitreader_read_bit(b);
+    bitreader_skip_bits(b, 4); // reserved
+
+    if (sis->program_splice_flag && !sis->splice_immediate_flag) {
+        splice_time_read(sis, b);
+    }
+    if (!sis->program_splice_flag) {
+        uint8_t component_count = bitreader_read_uint8(b);
+        for (size_t i = 0; i < component_count; ++i) {
+            bitreader_skip_bits(b, 8); // component_tag
+            if (!sis->splice_immediate_flag) {
+                splice_info_section_t component = {0};
+                splice_time_read(&component, b);
+                if (i == 0) {
+                    sis->time_specified_flag = component.time_specified_flag;
+                    sis->pts_time = component.pts_time;
+                }
+            }
+        }
+    }
+    if (sis->duration_flag) {
+        sis->auto_return = bitreader_read_bit(b);
+        bitreader_skip_bits(b, 6); // reserved
+        sis->break_duration = bitreader_read_bits(b, 33);
+    }
+    sis->unique_program_id = bitreader_read_uint16(b);
+    sis->avail_num = bitreader_read_uint8(b);
+    sis->avails_expected = bitreader_read_uint8(b);
+}
+
+splice_info_section_t* splice_info_section_parse(const psi_section_t* section)
+{
+    g_return_val_if_fail(section, NULL);
+
+    splice_info_section_t* sis = splice_info_section_new();
+    bitreader_new_stack(b, section->data, section->len);
+
+    uint8_t table_id = bitreader_read_uint8(b);
+    if (table_id != TABLE_ID_SPLICE_INFO_SECTION) {
+        g_critical("Table ID in splice_info_section is 0x%02X instead of expected 0x%02X", table_id,
+                TABLE_ID_SPLICE_INFO_SECTION);
+        goto fail;
+    }
+    bitreader_skip_bits(b, 16); // section_syntax_indicator, private_indicator, sap_type, section_length
+
+    // splice_info_section() has a CRC_32 even though section_syntax_indicator is 0
+    if (section->len < 4 + 4) {
+        g_critical("splice_info_section on PID 0x%02X is too short", section->pid);
+        goto fail;
+    }
+    const uint8_t* crc_bytes = section->data + section->len - 4;
+    uint32_t crc_32 = (uint32_t)crc_bytes[0] << 24 | (uint32_t)crc_bytes[1] << 16 | (uint32_t)crc_bytes[2] << 8
+            | crc_bytes[3];
+    if (crc_32 != section->crc_32) {
+        g_critical("splice_info_section CRC_32 should be 0x%08X, but calculated as 0x%08X", crc_32, section->crc_32);
+        goto fail;
+    }
+
+    sis->protocol_version = bitreader_read_uint8(b);
+    sis->encrypted_packet = bitreader_read_bit(b);
+    sis->encryption_algorithm = bitreader_read_bits(b, 6);
+    sis->pts_adjustment = bitreader_read_bits(b, 33);
+    sis->cw_index = bitreader_read_uint8(b);
+    sis->tier = bitreader_read_bits(b, 12);
+    uint16_t splice_command_length = bitreader_read_bits(b, 12);
+    sis->splice_command_type = bitreader_read_uint8(b);
+    if (sis->encrypted_packet) {
+        // we can't read the splice command, but we know what it is
+        goto cleanup;
+    }
+
+    switch (sis->splice_command_type) {
+    case SPLICE_INSERT:
+        splice_insert_read(sis, b);
+        break;
+    case TIME_SIGNAL:
+        splice_time_read(sis, b);
+        break;
+    default:
+        // 0xFFF is a legacy value meaning the command's length isn't given
+        if (splice_command_length != 0xFFF) {
+            bitreader_skip_bytes(b, splice_command_length);
+        }
+        break;
+    }
+    if (b->error) {
+        g_critical("Invalid splice_info_section, splice command is longer than the section");
+        goto fail;
+    }
+
+cleanup:
+    return sis;
+fail:
+    splice_info_section_free(sis);
+    sis = NULL;
+    goto cleanup;
+}
+
+bool splice_info_section_get_splice_point(const splice_info_section_t* sis, uint64_t* pts)
+{
+    g_return_val_if_fail(sis, false);
+    g_return_val_if_fail(pts, false);
+
+    if (sis->encrypted_packet || (sis->splice_command_type != SPLICE_INSERT && sis->splice_command_type != TIME_SIGNAL)
+            || sis->splice_event_cancel_indicator || sis->splice_immediate_flag || !sis->time_specified_flag) {
+        return false;
+    }
+    *pts = (sis->pts_time + sis->pts_adjustment) & PTS_MASK;
+    return true;
+}
+
+void splice_info_section_print(const splice_info_section_t* sis)
+{
+    g_return_if_fail(sis);
+    if (tslib_loglevel < TSLIB_LOG_LEVEL_INFO) {
+        return;
+    }
+
+    g_info("Splice Info Section");
+    SKIT_LOG_UINT8(1, sis->protocol_version);
+    SKIT_LOG_UINT8(1, sis->encrypted_packet);
+    SKIT_LOG_UINT64(1, sis->pts_adjustment);
+    SKIT_LOG_UINT8(1, sis->splice_command_type);
+    if (sis->splice_command_type == SPLICE_INSERT) {
+        SKIT_LOG_UINT32(2, sis->splice_event_id);
+        SKIT_LOG_UINT8(2, sis->splice_event_cancel_indicator);
+        SKIT_LOG_UINT8(2, sis->out_of_network_indicator);
+        SKIT_LOG_UINT8(2, sis->program_splice_flag);
+        SKIT_LOG_UINT8(2, sis->splice_immediate_flag);
+        if (sis->duration_flag) {
+            SKIT_LOG_UINT8(2, sis->auto_return);
+            SKIT_LOG_UINT64(2, sis->break_duration);
+        }
+        SKIT_LOG_UINT16(2, sis->unique_program_id);
+        SKIT_LOG_UINT8(2, sis->avail_num);
+        SKIT_LOG_UINT8(2, sis->avails_expected);
+    }
+    if (sis->time_specified_flag) {
+        SKIT_LOG_UINT64(2, sis->pts_time);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_SCTE35_H
+#define TSLIB_SCTE35_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psi.h"
+
+
+#define TABLE_ID_SPLICE_INFO_SECTION 0xFC
+
+typedef enum {
+    SPLICE_NULL = 0x00,
+    SPLICE_SCHEDULE = 0x04,
+    SPLICE_INSERT = 0x05,
+    TIME_SIGNAL = 0x06,
+    BANDWIDTH_RESERVATION = 0x07,
+    PRIVATE_COMMAND = 0xFF
+} splice_command_type_t;
+
+/* splice_info_section() from ANSI/SCTE 35. Only the fields of splice_insert() and time_signal() are read from the
+ * splice command; for a component splice_insert(), splice_time() is the first component's. */
+typedef struct {
+    uint8_t protocol_version;
+    bool encrypted_packet;
+    uint8_t encryption_algorithm;
+    uint64_t pts_adjustment;
+    uint8_t cw_index;
+    uint16_t tier;
+    uint8_t splice_command_type;
+
+    // splice_insert()
+    uint32_t splice_event_id;
+    bool splice_event_cancel_indicator;
+    bool out_of_network_indicator;
+    bool program_splice_flag;
+    bool duration_flag;
+    bool splice_immediate_flag;
+    bool auto_return;
+    uint64_t break_duration;
+    uint16_t unique_program_id;
+    uint8_t avail_num;
+    uint8_t avails_expected;
+
+    // splice_time() in splice_insert() or time_signal()
+    bool time_specified_flag;
+    uint64_t pts_time;
+} splice_info_section_t;
+
+splice_info_section_t* splice_info_section_parse(const psi_section_t*);
+void splice_info_section_free(splice_info_section_t*);
+void splice_info_section_print(const splice_info_section_t*);
+
+/* Gets the PTS (with pts_adjustment applied) of the splice point a splice_insert() or time_signal() signals. Returns
+ * false if it doesn't signal one at a known time (other commands, cancelled events and splice_immediate_flag). */
+bool splice_info_section_get_splice_point(const splice_info_section_t*, uint64_t* pts);
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "section_demux.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+
+section_demux_t* section_demux_new(section_processor_t processor)
+{
+    section_demux_t* sdm = g_slice_new0(section_demux_t);
+    sdm->processor = processor;
+    sdm->crc = crc_init();
+    return sdm;
+}
+
+void section_demux_free(section_demux_t* sdm)
+{
+    if (sdm == NULL) {
+        return;
+    }
+    if (sdm->arg_destructor && sdm->arg) {
+        sdm->arg_destructor(sdm->arg);
+    }
+    g_slice_free(section_demux_t, sdm);
+}
+
+static void section_demux_reset(section_demux_t* sdm)
+{
+    sdm->section_len = 0;
+    sdm->bytes_read = 0;
+    sdm->crc = crc_init();
+    sdm->crc_len = 0;
+    sdm->discontinuity = false;
+}
+
+static void section_demux_finish(section_demux_t* sdm, uint16_t pid, elementary_stream_info_t* es_info)
+{
+    psi_section_t section = {
+        .pid = pid,
+        .data = sdm->section,
+        .len = sdm->section_len,
+        .crc_32 = crc_finalize(sdm->crc),
+        .discontinuity = sdm->discontinuity
+    };
+    section_demux_reset(sdm);
+
+    bool section_syntax_indicator = section.data[1] & 0x80;
+    if (section_syntax_indicator) {
+        const uint8_t* crc_bytes = section.data + section.len - 4;
+        uint32_t crc_32 = (uint32_t)crc_bytes[0] << 24 | (uint32_t)crc_bytes[1] << 16 | (uint32_t)crc_bytes[2] << 8
+                | crc_bytes[3];
+        if (crc_32 != section.crc_32) {
+            g_critical("CRC_32 of section with table_id 0x%02X on PID 0x%02X should be 0x%08X, but calculated as "
+                    "0x%08X", section.data[0], pid, crc_32, section.crc_32);
+            return;
+        }
+    }
+    if (sdm->processor != NULL) {
+        sdm->processor(&section, es_info, sdm->arg);
+    }
+}
+
+/* Adds up to len bytes to the section being reassembled, and passes the section on once it's complete. Returns the
+ * number of bytes used, or 0 if the section turned out to be invalid. */
+static size_t section_demux_append(section_demux_t* sdm, const uint8_t* data, size_t len, uint16_t pid,
+        elementary_stream_info_t* es_info)
+{
+    size_t used = 0;
+    if (sdm->section_len == 0) {
+        used = MIN(len, SECTION_HEADER_LEN - sdm->bytes_read);
+        memcpy(sdm->section + sdm->bytes_read, data, used);
+        sdm->bytes_read += used;
+        if (sdm->bytes_read < SECTION_HEADER_LEN) {
+            return used;
+        }
+
+        bool section_syntax_indicator = sdm->section[1] & 0x80;
+        uint16_t section_length = (sdm->section[1] & 0x0F) << 8 | sdm->section[2];
+        // with section_syntax_indicator, we need at least the 5 bytes after section_length and the CRC_32
+        if (section_length > MAX_PRIVATE_SECTION_LEN || (section_syntax_indicator && section_length < 9)) {
+            g_critical("Invalid section_length %"PRIu16" in section with table_id 0x%02X on PID 0x%02X",
+                    section_length, sdm->section[0], pid);
+            section_demux_reset(sdm);
+            return 0;
+        }
+        sdm->section_len = SECTION_HEADER_LEN + section_length;
+    }
+
+    size_t n = MIN(len - used, sdm->section_len - sdm->bytes_read);
+    memcpy(sdm->section + sdm->bytes_read, data + used, n);
+    sdm->bytes_read += n;
+    used += n;
+
+    // everything but the CRC_32 field goes into the CRC
+    size_t crc_end = sdm->section_len > 4 ? MIN(sdm->bytes_read, sdm->section_len - 4) : 0;
+    if (crc_end > sdm->crc_len) {
+        sdm->crc = crc_update(sdm->crc, sdm->section + sdm->crc_len, crc_end - sdm->crc_len);
+        sdm->crc_len = crc_end;
+    }
+
+    if (sdm->bytes_read == sdm->section_len) {
+        section_demux_finish(sdm, pid, es_info);
+    }
+    return used;
+}
+
+void section_demux_process_ts_packet(ts_packet_t* ts, elementary_stream_info_t* es_info, void* arg)
+{
+    section_demux_t* sdm = arg;
+    if (ts == NULL) {
+        // end of stream, anything we have left is incomplete
+        section_demux_reset(sdm);
+        sdm->has_continuity_counter = false;
+        return;
+    }
+    if (!ts->has_payload || ts->payload_len == 0) {
+        return;
+    }
+
+    /* Continuity only matters in the middle of a section. Otherwise a duplicate packet just repeats sections we've
+     * already seen, and the counter can start over between an initialization segment and a media segment. */
+    bool discontinuity = ts->has_adaptation_field && ts->adaptation_field.discontinuity_indicator;
+    if (sdm->bytes_read > 0 && sdm->has_continuity_counter && !discontinuity) {
+        if (ts->continuity_counter == sdm->last_continuity_counter) {
+            // duplicate packet
+            return;
+        }
+        if (ts->continuity_counter != ((sdm->last_continuity_counter + 1) & 0x0F)) {
+            g_warning("Packet lost on PID 0x%02X, dropping incomplete section with table_id 0x%02X", ts->pid,
+                    sdm->section[0]);
+            section_demux_reset(sdm);
+        }
+    }
+    sdm->has_continuity_counter = true;
+    sdm->last_continuity_counter = ts->continuity_counter;
+
+    const uint8_t* data = ts->payload;
+    size_t len = ts->payload_len;
+    if (!ts->payload_unit_start_indicator) {
+        // the rest of a section from an earlier packet, followed by stuffing if it ends here
+        if (sdm->bytes_read > 0) {
+            sdm->discontinuity |= discontinuity;
+            section_demux_append(sdm, data, len, ts->pid, es_info);
+        }
+        return;
+    }
+
+    size_t pointer_field = data[0];
+    data++;
+    len--;
+    if (pointer_field > len) {
+        g_critical("Invalid pointer_field %zu on PID 0x%02X", pointer_field, ts->pid);
+        section_demux_reset(sdm);
+        return;
+    }
+    // the pointer_field bytes finish the section from an earlier packet, and may be followed by stuffing
+    if (sdm->bytes_read > 0) {
+        sdm->discontinuity |= discontinuity;
+        section_demux_append(sdm, data, pointer_field, ts->pid, es_info);
+        if (sdm->bytes_read > 0) {
+            g_critical("Section with table_id 0x%02X on PID 0x%02X doesn't end where the next one starts",
+                    sdm->section[0], ts->pid);
+            section_demux_reset(sdm);
+        }
+    }
+    data += pointer_field;
+    len -= pointer_field;
+
+    // any number of sections can follow, with the last one possibly continuing in the next packet
+    while (len > 0 && data[0] != 0xFF) {
+        sdm->discontinuity = discontinuity;
+        size_t used = section_demux_append(sdm, data, len, ts->pid, es_info);
+        if (used == 0) {
+            break;
+        }
+        data += used;
+        len -= used;
+    }
+}
+
+/* Copies a section into a single allocation, so it can be freed with g_free() */
+static psi_section_t* section_copy(const psi_section_t* section)
+{
+    psi_section_t* copy = g_malloc(sizeof(psi_section_t) + section->len);
+    *copy = *section;
+    memcpy(copy + 1, section->data, section->len);
+    copy->data = (const uint8_t*)(copy + 1);
+    return copy;
+}
+
+section_table_t* section_table_new(void)
+{
+    section_table_t* table = g_slice_new0(section_table_t);
+    table->sections = g_ptr_array_new_with_free_func(g_free);
+    table->complete = g_ptr_array_new_with_free_func(g_free);
+    return table;
+}
+
+void section_table_free(section_table_t* table)
+{
+    if (table == NULL) {
+        return;
+    }
+    g_ptr_array_free(table->sections, true);
+    g_ptr_array_free(table->complete, true);
+    g_slice_free(section_table_t, table);
+}
+
+static bool section_has_syntax(const uint8_t* data)
+{
+    return data[1] & 0x80;
+}
+
+bool section_table_is_unchanged(const section_table_t* table, const psi_section_t* section)
+{
+    g_return_val_if_fail(table, false);
+    g_return_val_if_fail(section, false);
+
+    size_t section_number = section_has_syntax(section->data) ? section->data[6] : 0;
+    if (section_number >= table->complete->len) {
+        return false;
+    }
+    const psi_section_t* old = g_ptr_array_index(table->complete, section_number);
+    return old->len == section->len && !memcmp(old->data, section->data, section->len);
+}
+
+/* Whether two sections are part of the same table: same table_id, table_id_extension, version_number,
+ * current_next_indicator and last_section_number */
+static bool sections_in_same_table(const uint8_t* a, const uint8_t* b)
+{
+    return a[0] == b[0] && a[3] == b[3] && a[4] == b[4] && a[5] == b[5] && a[7] == b[7];
+}
+
+bool section_table_add(section_table_t* table, const psi_section_t* section)
+{
+    g_return_val_if_fail(table, false);
+    g_return_val_if_fail(section, false);
+
+    if (!section_has_syntax(section->data)) {
+        g_ptr_array_set_size(table->sections, 0);
+        table->num_sections = 0;
+        g_ptr_array_set_size(table->complete, 0);
+        g_ptr_array_add(table->complete, section_copy(section));
+        return true;
+    }
+
+    uint8_t section_number = section->data[6];
+    uint8_t last_section_number = section->data[7];
+    if (section_number > last_section_number) {
+        g_critical("section_number %"PRIu8" is larger than last_section_number %"PRIu8" in section with table_id "
+                "0x%02X on PID 0x%02X", section_number, last_section_number, section->data[0], section->pid);
+        return false;
+    }
+
+    if (table->num_sections > 0) {
+        const psi_section_t* first = NULL;
+        for (size_t i = 0; first == NULL; ++i) {
+            first = g_ptr_array_index(table->sections, i);
+        }
+        if (!sections_in_same_table(first->data, section->data)) {
+            g_ptr_array_set_size(table->sections, 0);
+            table->num_sections = 0;
+        }
+    }
+    if (table->num_sections == 0) {
+        g_ptr_array_set_size(table->sections, 0);
+        g_ptr_array_set_size(table->sections, last_section_number + 1);
+    }
+
+    psi_section_t** copy = (psi_section_t**)&g_ptr_array_index(table->sections, section_number);
+    if (*copy == NULL) {
+        table->num_sections++;
+    }
+    g_free(*copy);
+    *copy = section_copy(section);
+    if (table->num_sections < table->sections->len) {
+        return false;
+    }
+
+    GPtrArray* complete = table->complete;
+    table->complete = table->sections;
+    table->sections = complete;
+    g_ptr_array_set_size(table->sections, 0);
+    table->num_sections = 0;
+    return true;
+}
+
+void section_table_reset(section_table_t* table)
+{
+    g_return_if_fail(table);
+    g_ptr_array_set_size(table->complete, 0);
+}
+
+uint32_t section_table_fingerprint(const section_table_t* table)
+{
+    g_return_val_if_fail(table, 0);
+    if (table->complete->len == 0) {
+        return 0;
+    }
+    crc_t crc = crc_init();
+    for (size_t i = 0; i < table->complete->len; ++i) {
+        const psi_section_t* section = g_ptr_array_index(table->complete, i);
+        /* A CRC over a section including its CRC_32 is always the same, so leave that out */
+        size_t len = section_has_syntax(section->data) && section->len > 4 ? section->len - 4 : section->len;
+        crc = crc_update(crc, section->data, len);
+    }
+    return crc_finalize(crc);
+}
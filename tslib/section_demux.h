@@ -0,0 +1,92 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_SECTION_DEMUX_H
+#define TSLIB_SECTION_DEMUX_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "crc32m.h"
+#include "psi.h"
+#include "ts.h"
+
+
+/* Longest section_length any section can have (private sections can be longer than PSI's MAX_SECTION_LEN) */
+#define MAX_PRIVATE_SECTION_LEN 0x0FFD
+#define SECTION_HEADER_LEN 3
+
+typedef void (*section_processor_t)(const psi_section_t*, elementary_stream_info_t*, void*);
+typedef void (*section_arg_destructor_t)(void*);
+
+/* Reassembles the sections on one PID, following 2.4.4 of ISO/IEC 13818-1: the pointer_field in packets with
+ * payload_unit_start_indicator set, sections spanning several packets, several sections in one packet, and stuffing
+ * after the last one. The CRC is calculated as bytes arrive, and sections with section_syntax_indicator set and a bad
+ * CRC_32 are dropped instead of being passed to the processor. */
+typedef struct {
+    section_processor_t processor;
+    void* arg;
+    section_arg_destructor_t arg_destructor;
+
+    uint8_t section[SECTION_HEADER_LEN + MAX_PRIVATE_SECTION_LEN];
+    size_t section_len;   // length of the section being reassembled, or 0 if we don't have its header yet
+    size_t bytes_read;    // bytes of it we have so far, or 0 if we're not in a section
+    crc_t crc;            // CRC of the first crc_len bytes
+    size_t crc_len;
+    bool discontinuity;
+    bool has_continuity_counter;
+    uint8_t last_continuity_counter;
+} section_demux_t;
+
+section_demux_t* section_demux_new(section_processor_t);
+void section_demux_free(section_demux_t*);
+void section_demux_process_ts_packet(ts_packet_t*, elementary_stream_info_t*, void*);
+
+/* Collects the sections of a table that's sent in several (section_number 0 to last_section_number). A section with
+ * a different table_id, table_id_extension, version_number or last_section_number starts the collection over.
+ * Sections without section_syntax_indicator are a complete table on their own. */
+typedef struct {
+    GPtrArray* sections; // psi_section_t* for each section_number, NULL until it arrives
+    size_t num_sections; // sections that have arrived
+    GPtrArray* complete; // psi_section_t* for each section of the last complete table
+} section_table_t;
+
+section_table_t* section_table_new(void);
+void section_table_free(section_table_t*);
+/* Returns true if the section is the same as the one with its section_number in the last complete table */
+bool section_table_is_unchanged(const section_table_t*, const psi_section_t*);
+/* Adds a section. Returns true if that completes the table, whose sections are then in table->complete. */
+bool section_table_add(section_table_t*, const psi_section_t*);
+/* Forgets the last complete table, so the next copy of it isn't considered unchanged */
+void section_table_reset(section_table_t*);
+/* Returns a CRC of the raw bytes of the last complete table, so tables with the same fingerprint are almost certainly
+ * identical, version_number included. Returns 0 if there's no complete table. */
+uint32_t section_table_fingerprint(const section_table_t*);
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include "segment_reader.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+
+
+unsigned segment_reader_pipeline_depth = 0;
+unsigned segment_reader_parser_threads = 1;
+unsigned segment_prefetch_depth = 0;
+
+static GMutex stats_mutex;
+static segment_reader_stats_t stats;
+
+/* Sent to parser threads after the reader's last block, so every parser thread stops */
+static segment_block_t stop_parsing;
+
+static segment_block_t* segment_block_new(void);
+static void segment_block_free(segment_block_t*);
+static void segment_reader_read_block(segment_reader_t*, segment_block_t*);
+static void segment_reader_parse_block(segment_reader_t*, segment_block_t*);
+static gpointer segment_reader_thread(gpointer);
+static gpointer segment_parser_thread(gpointer);
+static segment_block_t* segment_reader_pop_parsed(segment_reader_t*);
+static void read_ahead(const char* file_name, uint64_t byte_range_start, uint64_t byte_range_end);
+
+segment_block_t* segment_block_new(void)
+{
+    segment_block_t* block = g_slice_new0(segment_block_t);
+    block->data = g_new(uint8_t, SEGMENT_READER_BLOCK_PACKETS * TS_SIZE);
+    block->headers = ts_headers_new(SEGMENT_READER_BLOCK_PACKETS);
+    block->packets = g_new(ts_packet_t, SEGMENT_READER_BLOCK_PACKETS);
+    block->log = log_capture_new();
+    return block;
+}
+
+void segment_block_free(segment_block_t* block)
+{
+    if (block == NULL) {
+        return;
+    }
+    g_free(block->data);
+    ts_headers_free(block->headers);
+    g_free(block->packets);
+    log_capture_free(block->log);
+    g_slice_free(segment_block_t, block);
+}
+
+/* Fills a block with the next packets in the file, skipping anything before them that isn't in sync. The block is
+ * marked last once we hit the end of the range, the end of the file, or a read error. */
+void segment_reader_read_block(segment_reader_t* reader, segment_block_t* block)
+{
+    block->first_packet = reader->packets_read;
+    block->skipped_bytes = 0;
+    block->num_packets = 0;
+    block->num_parsed = 0;
+    block->last = false;
+
+    size_t to_read;
+    size_t bytes_read;
+    while (true) {
+        to_read = MIN((reader->end_offset - reader->offset) / TS_SIZE, SEGMENT_READER_BLOCK_PACKETS);
+        bytes_read = 0;
+        if (!file_handle_read(reader->file, reader->offset, block->data, to_read * TS_SIZE, &bytes_read)) {
+            g_critical("Error reading %s - %s", reader->file_name, strerror(errno));
+            reader->error = true;
+        }
+        if (reader->error || bytes_read < TS_SIZE) {
+            break;
+        }
+
+        /* If we skipped anything, make sure there are enough packets after it this time, since the last read may
+         * have cut them off */
+        size_t skip = 0;
+        if (block->data[0] != TS_SYNC_BYTE || block->skipped_bytes > 0) {
+            skip = ts_find_sync(block->data, bytes_read, SEGMENT_READER_RESYNC_PACKETS);
+        }
+        if (skip == 0) {
+            break;
+        }
+        block->skipped_bytes += skip;
+        reader->offset += skip;
+    }
+    block->offset = reader->offset;
+    block->num_packets = bytes_read / TS_SIZE;
+
+    /* Stop before the next packet without a sync byte, so the next block starts by looking for sync */
+    bool lost_sync = false;
+    for (size_t i = 1; i < block->num_packets; ++i) {
+        if (block->data[i * TS_SIZE] != TS_SYNC_BYTE) {
+            block->num_packets = i;
+            lost_sync = true;
+            break;
+        }
+    }
+    reader->offset += block->num_packets * TS_SIZE;
+    reader->packets_read += block->num_packets;
+    block->last = reader->error || reader->end_offset - reader->offset < TS_SIZE
+            || (!lost_sync && bytes_read < to_read * TS_SIZE);
+}
+
+/* Parses as many packets as possible. If one is invalid, num_parsed will be less than num_packets. This only depends
+ * on the block, so blocks can be parsed in any order. */
+void segment_reader_parse_block(segment_reader_t* reader, segment_block_t* block)
+{
+    ts_headers_read(block->headers, block->data, block->num_packets);
+    for (block->num_parsed = 0; block->num_parsed < block->num_packets; ++block->num_parsed) {
+        uint64_t packet_num = block->first_packet + block->num_parsed;
+        ts_packet_t* packet = &block->packets[block->num_parsed];
+        if (!ts_read(packet, block->data + block->num_parsed * TS_SIZE, TS_SIZE, packet_num)) {
+            break;
+        }
+        /* Packet numbers don't count skipped bytes */
+        packet->pos_in_stream = block->offset - reader->start_offset + block->num_parsed * TS_SIZE;
+    }
+}
+
+gpointer segment_reader_thread(gpointer arg)
+{
+    segment_reader_t* reader = arg;
+    bool last = false;
+    while (!last) {
+        segment_block_t* block = g_async_queue_pop(reader->free_blocks);
+        if (g_atomic_int_get(&reader->cancelled)) {
+            block->num_packets = 0;
+            block->skipped_bytes = 0;
+            block->headers->len = 0;
+            block->num_parsed = 0;
+            block->last = true;
+        } else {
+            segment_reader_read_block(reader, block);
+        }
+        block->sequence = reader->blocks_read++;
+        last = block->last;
+        g_async_queue_push(reader->read_blocks, block);
+    }
+    for (unsigned i = 1; i < reader->num_parser_threads; ++i) {
+        g_async_queue_push(reader->read_blocks, &stop_parsing);
+    }
+    return NULL;
+}
+
+/* Every block is passed along, even after a parse error or cancellation, so the caller always sees the reader's
+ * last block and knows the threads are finished with the queues. Messages are captured, and logged when the caller
+ * gets to the block, so they come out in the same order as parsing in the caller's thread. */
+gpointer segment_parser_thread(gpointer arg)
+{
+    segment_reader_t* reader = arg;
+    bool last = false;
+    while (!last) {
+        segment_block_t* block = g_async_queue_pop(reader->read_blocks);
+        if (block == &stop_parsing) {
+            break;
+        }
+        last = block->last;
+        if (g_atomic_int_get(&reader->cancelled)) {
+            block->headers->len = 0;
+            block->num_parsed = 0;
+        } else {
+            log_capture_set(block->log);
+            segment_reader_parse_block(reader, block);
+            log_capture_set(NULL);
+        }
+        g_async_queue_push(reader->parsed_blocks, block);
+    }
+    return NULL;
+}
+
+/* Returns the next block in the order they were read */
+segment_block_t* segment_reader_pop_parsed(segment_reader_t* reader)
+{
+    while (true) {
+        for (guint i = 0; i < reader->early_blocks->len; ++i) {
+            segment_block_t* block = g_ptr_array_index(reader->early_blocks, i);
+            if (block->sequence == reader->next_sequence) {
+                g_ptr_array_remove_index_fast(reader->early_blocks, i);
+                reader->next_sequence++;
+                return block;
+            }
+        }
+        segment_block_t* block = g_async_queue_pop(reader->parsed_blocks);
+        if (block->sequence == reader->next_sequence) {
+            reader->next_sequence++;
+            return block;
+        }
+        g_ptr_array_add(reader->early_blocks, block);
+    }
+}
+
+segment_reader_t* segment_reader_new(const char* file_name, uint64_t byte_range_start, uint64_t byte_range_end)
+{
+    g_return_val_if_fail(file_name, NULL);
+
+    segment_reader_t* reader = g_slice_new0(segment_reader_t);
+    reader->file_name = g_strdup(file_name);
+    reader->end_offset = UINT64_MAX;
+    if (byte_range_end > 0) {
+        reader->end_offset = byte_range_start + (byte_range_end - byte_range_start) / TS_SIZE * TS_SIZE;
+    }
+
+    reader->start_offset = byte_range_start;
+    reader->offset = byte_range_start;
+    reader->sync_gaps = g_array_new(false, false, sizeof(segment_sync_gap_t));
+    reader->file = file_cache_open(file_name);
+    if (reader->file == NULL) {
+        g_critical("Cannot open file %s - %s", file_name, strerror(errno));
+        goto fail;
+    }
+
+    if (segment_reader_pipeline_depth == 0) {
+        reader->current = segment_block_new();
+        return reader;
+    }
+
+    reader->free_blocks = g_async_queue_new();
+    reader->read_blocks = g_async_queue_new();
+    reader->parsed_blocks = g_async_queue_new();
+    reader->early_blocks = g_ptr_array_new();
+    reader->num_parser_threads = MAX(segment_reader_parser_threads, 1);
+    unsigned num_blocks = MAX(segment_reader_pipeline_depth, reader->num_parser_threads + 1);
+    for (unsigned i = 0; i < num_blocks; ++i) {
+        g_async_queue_push(reader->free_blocks, segment_block_new());
+    }
+    reader->reader_thread = g_thread_new("segment-reader", segment_reader_thread, reader);
+    reader->parser_threads = g_new(GThread*, reader->num_parser_threads);
+    for (unsigned i = 0; i < reader->num_parser_threads; ++i) {
+        reader->parser_threads[i] = g_thread_new("segment-parser", segment_parser_thread, reader);
+    }
+    return reader;
+fail:
+    segment_reader_free(reader);
+    return NULL;
+}
+
+void segment_reader_free(segment_reader_t* reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    if (reader->reader_thread) {
+        g_atomic_int_set(&reader->cancelled, 1);
+        if (reader->current) {
+            g_async_queue_push(reader->free_blocks, reader->current);
+            reader->current = NULL;
+        }
+        /* Keep recycling blocks until the reader's last block has made it through, otherwise the reader could be
+         * stuck waiting for a free block */
+        while (!reader->finished) {
+            segment_block_t* block = segment_reader_pop_parsed(reader);
+            reader->finished = block->last;
+            g_async_queue_push(reader->free_blocks, block);
+        }
+        g_thread_join(reader->reader_thread);
+        for (unsigned i = 0; i < reader->num_parser_threads; ++i) {
+            g_thread_join(reader->parser_threads[i]);
+        }
+        g_free(reader->parser_threads);
+
+        segment_block_t* block;
+        while ((block = g_async_queue_try_pop(reader->free_blocks)) != NULL) {
+            segment_block_free(block);
+        }
+        g_ptr_array_free(reader->early_blocks, true);
+        g_async_queue_unref(reader->free_blocks);
+        g_async_queue_unref(reader->read_blocks);
+        g_async_queue_unref(reader->parsed_blocks);
+    }
+    segment_block_free(reader->current);
+
+    if (reader->file) {
+        file_cache_release(reader->file);
+
+        g_mutex_lock(&stats_mutex);
+        stats.segments_read++;
+        stats.bytes_read += reader->packets_read * TS_SIZE;
+        stats.stall_time += reader->stall_time;
+        g_mutex_unlock(&stats_mutex);
+    }
+    g_array_free(reader->sync_gaps, true);
+    g_free(reader->file_name);
+    g_slice_free(segment_reader_t, reader);
+}
+
+ts_packet_t* segment_reader_next(segment_reader_t* reader, size_t* num_packets)
+{
+    g_return_val_if_fail(reader, NULL);
+    g_return_val_if_fail(num_packets, NULL);
+
+    *num_packets = 0;
+    while (!reader->done) {
+        segment_block_t* block;
+        gint64 wait_start = g_get_monotonic_time();
+        if (reader->reader_thread) {
+            if (reader->current) {
+                g_async_queue_push(reader->free_blocks, reader->current);
+            }
+            block = segment_reader_pop_parsed(reader);
+            reader->current = block;
+            reader->stall_time += g_get_monotonic_time() - wait_start;
+            log_capture_replay(&block->log, 1);
+            log_capture_clear(block->log);
+        } else {
+            block = reader->current;
+            segment_reader_read_block(reader, block);
+            reader->stall_time += g_get_monotonic_time() - wait_start;
+            segment_reader_parse_block(reader, block);
+        }
+        reader->finished = block->last;
+        reader->done = block->last || block->num_parsed < block->num_packets;
+        if (block->num_parsed < block->num_packets) {
+            reader->parse_error = true;
+            reader->error_packet = block->first_packet + block->num_parsed;
+            /* Don't read any further than we have to */
+            g_atomic_int_set(&reader->cancelled, 1);
+        }
+        if (block->skipped_bytes > 0) {
+            segment_sync_gap_t gap = { block->offset - block->skipped_bytes, block->skipped_bytes };
+            g_array_append_val(reader->sync_gaps, gap);
+        }
+
+        if (block->num_parsed > 0) {
+            *num_packets = block->num_parsed;
+            return block->packets;
+        }
+    }
+    return NULL;
+}
+
+void segment_reader_get_stats(segment_reader_stats_t* out)
+{
+    g_return_if_fail(out);
+
+    g_mutex_lock(&stats_mutex);
+    *out = stats;
+    g_mutex_unlock(&stats_mutex);
+}
+
+/* This is only a hint, so failures are ignored. If the file can't be read, validating it will report that. */
+void read_ahead(const char* file_name, uint64_t byte_range_start, uint64_t byte_range_end)
+{
+    file_handle_t* file = file_cache_open(file_name);
+    if (file == NULL) {
+        return;
+    }
+    uint64_t length = byte_range_end > byte_range_start ? byte_range_end - byte_range_start + 1 : 0;
+#if defined(POSIX_FADV_WILLNEED)
+    /* Pages are read asynchronously into the page cache */
+    int err = posix_fadvise(file->fd, byte_range_start, length, POSIX_FADV_WILLNEED);
+    if (err) {
+        g_debug("Failed to read ahead %s - %s", file_name, strerror(err));
+    }
+#elif defined(F_RDADVISE)
+    if (length == 0) {
+        uint64_t size;
+        length = file_handle_get_size(file, &size) && size > byte_range_start ? size - byte_range_start : 0;
+    }
+    struct radvisory advisory = { .ra_offset = byte_range_start, .ra_count = MIN(length, INT_MAX) };
+    if (fcntl(file->fd, F_RDADVISE, &advisory) == -1) {
+        g_debug("Failed to read ahead %s - %s", file_name, strerror(errno));
+    }
+#endif
+    file_cache_release(file);
+
+    g_mutex_lock(&stats_mutex);
+    stats.segments_prefetched++;
+    stats.bytes_prefetched += length;
+    g_mutex_unlock(&stats_mutex);
+}
+
+segment_prefetcher_t* segment_prefetcher_new(GPtrArray* segments)
+{
+    g_return_val_if_fail(segments, NULL);
+
+    segment_prefetcher_t* prefetcher = g_slice_new0(segment_prefetcher_t);
+    prefetcher->segments = segments;
+    return prefetcher;
+}
+
+void segment_prefetcher_free(segment_prefetcher_t* prefetcher)
+{
+    if (prefetcher == NULL) {
+        return;
+    }
+    g_slice_free(segment_prefetcher_t, prefetcher);
+}
+
+void segment_prefetcher_advance(segment_prefetcher_t* prefetcher, size_t segment_index)
+{
+    g_return_if_fail(prefetcher);
+
+    if (segment_prefetch_depth == 0) {
+        return;
+    }
+    size_t end = MIN(segment_index + segment_prefetch_depth + 1, prefetcher->segments->len);
+    for (prefetcher->next = MAX(prefetcher->next, segment_index); prefetcher->next < end; ++prefetcher->next) {
+        segment_t* segment = g_ptr_array_index(prefetcher->segments, prefetcher->next);
+        read_ahead(segment->file_name, segment->media_range_start, segment->media_range_end);
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_SEGMENT_READER_H
+#define TSLIB_SEGMENT_READER_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "file_cache.h"
+#include "log.h"
+#include "mpd.h"
+#include "ts.h"
+
+
+/* Number of TS packets read and parsed at a time */
+#define SEGMENT_READER_BLOCK_PACKETS 4096
+
+/* Number of packets in a row that need sync bytes before we trust that we're back in sync */
+#define SEGMENT_READER_RESYNC_PACKETS 5
+
+/* Number of blocks in flight between the reader, parser and caller when reading with threads. 0 means everything
+ * is done in the caller's thread. */
+extern unsigned segment_reader_pipeline_depth;
+
+/* Number of threads parsing blocks when reading with threads. Blocks are parsed out of order, but the caller still
+ * gets them in order, along with anything logged while parsing them. At least this many blocks plus one are kept in
+ * flight, whatever segment_reader_pipeline_depth is. */
+extern unsigned segment_reader_parser_threads;
+
+/* Number of segments to read ahead of the one being validated. 0 disables read-ahead. */
+extern unsigned segment_prefetch_depth;
+
+typedef struct {
+    uint64_t segments_read;
+    uint64_t bytes_read;
+    uint64_t segments_prefetched;
+    uint64_t bytes_prefetched; /* 0 for segments read ahead to the end of the file */
+    gint64 stall_time; /* microseconds spent waiting for packets to be read */
+} segment_reader_stats_t;
+
+/* Bytes skipped to get back in sync */
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} segment_sync_gap_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t num_packets;
+    uint64_t first_packet;
+    uint64_t offset; /* of data in the file */
+    uint64_t skipped_bytes; /* right before data, because we lost sync */
+    ts_headers_t* headers; /* headers of data, up to the first bad sync byte */
+    ts_packet_t* packets;
+    size_t num_parsed;
+    bool last;
+    uint64_t sequence; /* order the reader read blocks in */
+    log_capture_t* log; /* messages from parsing, when parsed on another thread */
+} segment_block_t;
+
+typedef struct {
+    char* file_name;
+    file_handle_t* file;
+    uint64_t start_offset;
+    uint64_t end_offset; /* exclusive */
+    uint64_t offset;
+    uint64_t packets_read;
+    volatile gint cancelled;
+
+    gint64 stall_time;
+
+    bool error;
+    bool parse_error;
+    uint64_t error_packet;
+    GArray* sync_gaps; /* segment_sync_gap_t */
+
+    segment_block_t* current;
+    bool done; /* no more packets for the caller */
+    bool finished; /* got the reader's last block */
+
+    /* Only used when pipelined */
+    GThread* reader_thread;
+    GThread** parser_threads;
+    unsigned num_parser_threads;
+    GAsyncQueue* free_blocks;
+    GAsyncQueue* read_blocks;
+    GAsyncQueue* parsed_blocks;
+    GPtrArray* early_blocks; /* parsed before the blocks ahead of them */
+    uint64_t blocks_read;
+    uint64_t next_sequence;
+} segment_reader_t;
+
+typedef struct {
+    GPtrArray* segments; /* segment_t*, not owned */
+    size_t next;
+} segment_prefetcher_t;
+
+/* Reads TS packets from the byte range byte_range_start-byte_range_end of a file. If byte_range_end is 0, reads to
+ * the end of the file. */
+segment_reader_t* segment_reader_new(const char* file_name, uint64_t byte_range_start, uint64_t byte_range_end);
+void segment_reader_free(segment_reader_t*);
+
+/* Returns the next block of parsed packets, which are valid until the next call, or NULL when there are no more
+ * packets. If a packet couldn't be parsed, the packets before it are returned and then parse_error and error_packet
+ * are set. If we lose sync, we skip ahead to where packets start again and add the skipped bytes to sync_gaps before
+ * returning the packets after them. */
+ts_packet_t* segment_reader_next(segment_reader_t*, size_t* num_packets);
+
+/* Totals for every segment_reader_t freed so far */
+void segment_reader_get_stats(segment_reader_stats_t*);
+
+/* Asks the OS to start reading the segments in a representation before we get to them, so validating one segment
+ * doesn't have to wait on the disk (or network filesystem) for the next one. */
+segment_prefetcher_t* segment_prefetcher_new(GPtrArray* segments);
+void segment_prefetcher_free(segment_prefetcher_t*);
+
+/* Call before validating segments[segment_index] to read ahead that segment and the segment_prefetch_depth segments
+ * after it. Does nothing if segment_prefetch_depth is 0. */
+void segment_prefetcher_advance(segment_prefetcher_t*, size_t segment_index);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "segment_summary.h"
+#include <inttypes.h>
+
+
+segment_summary_t* segment_summary_new(const dash_validator_t* validator)
+{
+    segment_summary_t* summary = g_slice_new0(segment_summary_t);
+    summary->is_encrypted = validator->is_encrypted && (segment_validator_keys == NULL || validator->decrypt_failed);
+    summary->pat_fingerprint = validator->pat_fingerprint;
+    summary->pmt_fingerprint = validator->pmt_fingerprint;
+    summary->cat_fingerprint = validator->cat_fingerprint;
+    summary->starts_with_sap = true;
+    for (gsize i = 0; i < validator->pids->len; ++i) {
+        pid_validator_t* pv = g_ptr_array_index(validator->pids, i);
+        if (pv->content_component == VIDEO_CONTENT_COMPONENT) {
+            summary->starts_with_sap &= pv->sap != 0 && pv->sap <= 2;
+        }
+    }
+    summary->splice_points = g_array_new(false, false, sizeof(uint64_t));
+    for (gsize i = 0; i < validator->splice_points->len; ++i) {
+        g_array_append_val(summary->splice_points, g_array_index(validator->splice_points, splice_point_t, i).pts);
+    }
+    return summary;
+}
+
+void segment_summary_free(segment_summary_t* summary)
+{
+    if (summary == NULL) {
+        return;
+    }
+    g_array_free(summary->splice_points, true);
+    g_slice_free(segment_summary_t, summary);
+}
+
+int check_representation_gaps(GPtrArray* representations, content_component_t content_component, int64_t max_delta)
+{
+    g_return_val_if_fail(representations, 0);
+
+    if (representations->len == 0) {
+        g_warning("Can't print gap matrix for empty set of representations.");
+        return 1;
+    }
+    int status = 1;
+    representation_t* first_representation = g_ptr_array_index(representations, 0);
+
+    /* First figure out if there are any gaps, so we can be quieter if there are none */
+    GLogLevelFlags flags = G_LOG_LEVEL_INFO;
+    for (gsize s_i = 1; s_i < first_representation->segments->len; ++s_i) {
+        for (gsize r_i = 0; r_i < representations->len; ++r_i) {
+            representation_t* representation1 = g_ptr_array_index(representations, r_i);
+            segment_t* segment1 = g_ptr_array_index(representation1->segments, s_i - 1);
+            segment_summary_t* summary1 = segment1->arg;
+            if (!summary1) {
+                g_critical("Attempting to check representation gaps on representations that haven't be validated!");
+                return 0;
+            }
+            if (summary1->is_encrypted) {
+                continue;
+            }
+
+            for(gsize r_i2 = 0; r_i2 < representations->len; ++r_i2) {
+                representation_t* representation2 = g_ptr_array_index(representations, r_i2);
+                segment_t* segment2 = g_ptr_array_index(representation2->segments, s_i);
+                segment_summary_t* summary2 = segment2->arg;
+                if (!summary2) {
+                    g_critical("Attempting to check representation gaps on representations that haven't be validated!");
+                    return 0;
+                }
+                if (summary2->is_encrypted) {
+                    continue;
+                }
+
+                int64_t pts_delta = segment2->actual_start[content_component] - \
+                        (int64_t)segment1->actual_end[content_component];
+                if (pts_delta) {
+                    flags = G_LOG_LEVEL_WARNING;
+                    if (pts_delta > max_delta) {
+                        g_critical("FAIL: %s gap between for segment %zu for representations %s and %s is %"PRId64" "
+                                "and exceeds limit %"PRId64,
+                                content_component_to_string(content_component), s_i, representation1->id,
+                                representation2->id, pts_delta, max_delta);
+                        status = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    g_log(G_LOG_DOMAIN, flags, "%sGapMatrix", content_component_to_string(content_component));
+    for (gsize s_i = 1; s_i < first_representation->segments->len; ++s_i) {
+        GString* line = g_string_new("    \t");
+        for (gsize r_i = 0; r_i < representations->len; ++r_i) {
+            representation_t* representation = g_ptr_array_index(representations, r_i);
+            segment_t* segment = g_ptr_array_index(representation->segments, s_i);
+            g_string_append_printf(line, "%s\t", segment->file_name);
+        }
+        g_log(G_LOG_DOMAIN, flags, "%s", line->str);
+
+        for (gsize r_i = 0; r_i < representations->len; ++r_i) {
+            representation_t* representation = g_ptr_array_index(representations, r_i);
+            segment_t* segment1 = g_ptr_array_index(representation->segments, s_i - 1);
+            g_string_printf(line, "%s\t", segment1->file_name);
+
+            for(gsize r_i2 = 0; r_i2 < representations->len; ++r_i2) {
+                representation_t* representation2 = g_ptr_array_index(representations, r_i2);
+                segment_t* segment2 = g_ptr_array_index(representation2->segments, s_i);
+
+                int64_t pts_delta = segment2->actual_start[content_component] - segment1->actual_end[content_component];
+                g_string_append_printf(line, "%"PRId64"\t", pts_delta);
+            }
+            g_log(G_LOG_DOMAIN, flags, "%s", line->str);
+        }
+        g_log(G_LOG_DOMAIN, flags, " ");
+        g_string_free(line, true);
+    }
+    return status;
+}
@@ -0,0 +1,59 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_SEGMENT_SUMMARY_H
+#define TSLIB_SEGMENT_SUMMARY_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpd.h"
+#include "segment_validator.h"
+
+
+/* What's kept about a Media Segment once it's validated. Along with the segment's actual start and end times, this is
+ * all the checks across segments and Representations need, so it's also what worker processes send back when
+ * validation is sharded. */
+typedef struct {
+    bool is_encrypted; /* and not decrypted with --keys, so its timing isn't known */
+    uint32_t pat_fingerprint;
+    uint32_t pmt_fingerprint;
+    uint32_t cat_fingerprint;
+    bool starts_with_sap; /* every video PID starts with a SAP of type 1 or 2 */
+    GArray* splice_points; /* uint64_t PTS of each SCTE 35 splice point */
+} segment_summary_t;
+
+segment_summary_t* segment_summary_new(const dash_validator_t*);
+void segment_summary_free(segment_summary_t*);
+
+/* Checks the gap between the end of each segment and the start of the next one in every Representation, and logs a
+ * matrix of the gaps. Every segment's arg has to be its segment_summary_t. Gaps to or from an encrypted segment aren't
+ * checked, since its timing isn't known. Returns 0 if a gap is bigger than max_delta. */
+int check_representation_gaps(GPtrArray* representations, content_component_t, int64_t max_delta);
+
+#endif
@@ -30,21 +30,142 @@
 
 #include <inttypes.h>
 #include <errno.h>
+#include <string.h>
 
 #include "cets_ecm.h"
+#include "continuity_checker.h"
+#include "crc32m.h"
 #include "h264_stream.h"
 #include "mpeg2ts_demux.h"
 #include "pes_demux.h"
+#include "scte35.h"
+#include "segment_reader.h"
 
 
 static void cat_processor(mpeg2ts_stream_t*, void*);
 static void pat_processor(mpeg2ts_stream_t*, void*);
 static void pmt_processor(mpeg2ts_program_t*, void*);
 static void validate_ts_packet(ts_packet_t*, elementary_stream_info_t*, void*);
+static void report_t_std_errors(dash_validator_t*);
 static void validate_pes_packet(pes_packet_t*, elementary_stream_info_t*, GArray* ts_packets, void*);
+static void validate_splice_info_section(const psi_section_t*, elementary_stream_info_t*, void*);
 static int validate_emsg_msg(uint8_t* buffer, size_t len, unsigned segment_duration);
 static int analyze_sidx_references(sidx_t*, int* num_subsegments, int* num_nested_sidx, dash_profile_t);
-
+static const char* valid_ts_conformance(segment_type_t);
+static void report_sync_gaps(dash_validator_t*, segment_reader_t*, size_t* num_reported);
+static void check_subsegment_random_access(dash_validator_t*, size_t subsegment_index);
+static void check_subsegment_start_time(dash_validator_t*, const subsegment_t*, uint64_t pts);
+static crc_t crc_update_uint64s(crc_t, const uint64_t* values, size_t len);
+static uint32_t frame_index_key(const dash_validator_t*, const dash_validator_t* dash_validator_init, bool has_emsg);
+
+/* PID-parallel validation: The first pass does everything except PES validation as usual, and records which packets
+ * belong to each media PID and where each PES packet ends. Then worker threads put together and validate the PES
+ * packets of different PIDs at once, reading each PID's packets again from the segment file. When the segment is
+ * indexed, each PID's PES packets are split up further by subsegment. Checks that depend on more than one PID stay in
+ * the first pass, and messages are logged in the same order as validating in one thread. */
+
+#define PID_INDEX_INIT_PACKET (UINT64_C(1) << 63)
+
+typedef struct {
+    size_t packet_index; /* of the packet that ended the PES packet, or packets->len at the end of the segment */
+    uint64_t log_key;
+    size_t subsegment_index;
+    bool has_subsegment;
+    bool first_in_subsegment;
+} pes_end_t;
+
+typedef struct {
+    pid_validator_t* pid_validator;
+    GArray* packets; /* uint64_t pos_in_stream, or PID_INDEX_INIT_PACKET | index in the initialization segment */
+    GArray* pes_ends; /* pes_end_t */
+    size_t num_pending; /* packets in the PES packet being put together */
+    bool first_task_done;
+    struct _pid_parallel_validator* parent;
+} pid_index_t;
+
+/* One PID's PES packets that end in the same subsegment. Later PES packets are checked against the SAP type found in
+ * a PID's first PES packet, so each PID's first task has to finish before the rest of its tasks start. */
+typedef struct {
+    pid_index_t* index;
+    size_t first_packet;
+    size_t end_packet; /* exclusive */
+    size_t first_end;
+    size_t end_end; /* exclusive */
+    bool first_for_pid;
+    pid_validator_t pid_validator; /* our copy, for tasks after the first */
+    uint64_t pes_count_before;
+} pes_task_t;
+
+typedef struct {
+    size_t subsegment_index;
+    uint64_t log_key;
+} iframe_check_t;
+
+/* Each PID's packets tend to be close together, so workers read them again a block at a time */
+#define PID_PARALLEL_READ_PACKETS 256
+
+typedef struct {
+    uint8_t data[PID_PARALLEL_READ_PACKETS * TS_SIZE];
+    uint64_t pos_in_stream; /* of data[0] */
+    size_t length;
+} packet_block_t;
+
+typedef struct _pid_parallel_validator {
+    dash_validator_t* dash_validator;
+    log_capture_t* log; /* first pass */
+    GPtrArray* logs; /* log_capture_t*, one for the first pass and one for each worker */
+    GPtrArray* indexes; /* pid_index_t* */
+    GArray* tasks; /* pes_task_t, in stream order for each PID */
+    GPtrArray* schedule; /* pes_task_t*, in the order workers take them */
+    GPtrArray* retired_pids; /* pid_validator_t* replaced by a new PMT before their PES packets were validated */
+    GArray* iframe_checks; /* iframe_check_t */
+    GArray* init_packets; /* ts_packet_t from the initialization segment */
+
+    /* Used by the workers */
+    file_handle_t* file;
+    uint64_t start_offset;
+    uint64_t length; /* bytes read in the first pass */
+    volatile gint next_index;
+    volatile gint status;
+    gint* saw_random_access; /* for each subsegment */
+    GMutex mutex;
+    GCond first_task_done;
+} pid_parallel_validator_t;
+
+static pid_parallel_validator_t* pid_parallel_validator_new(dash_validator_t*);
+static void pid_parallel_validator_free(pid_parallel_validator_t*);
+static void pid_parallel_validator_finish(pid_parallel_validator_t*, segment_reader_t*);
+static pid_index_t* pid_index_new(pid_parallel_validator_t*, pid_validator_t*);
+static void pid_index_free(pid_index_t*);
+static void index_pes_ts_packet(ts_packet_t*, elementary_stream_info_t*, void*);
+static uint64_t reserve_log_key(pid_parallel_validator_t*);
+static bool read_indexed_packet(pid_parallel_validator_t*, packet_block_t*, uint64_t pos_in_stream, ts_packet_t*);
+static void add_pes_tasks(pid_parallel_validator_t*, pid_index_t*);
+static void validate_pes_task(pid_parallel_validator_t*, pes_task_t*, packet_block_t*, log_capture_t* log,
+        log_capture_t* scratch);
+static void merge_pes_task(pes_task_t*);
+static gpointer pid_parallel_thread(gpointer);
+static gint compare_pes_tasks(gconstpointer, gconstpointer);
+
+unsigned segment_validator_pid_threads = 0;
+cets_keys_t* segment_validator_keys = NULL;
+bool segment_validator_frame_index = false;
+
+
+const char* valid_ts_conformance(segment_type_t segment_type)
+{
+    switch (segment_type) {
+    case INITIALIZATION_SEGMENT:
+        return "6.4.3.2 Initialization Segment: An Initialization Segment shall be a valid MPEG-2 TS, conforming to "
+                "ISO/IEC 13818-1.";
+    case BITSTREAM_SWITCHING_SEGMENT:
+        return "6.4.5 Bitstream Switching Segment: A Bitstream Switching Segment shall be a valid MPEG-2 TS, "
+                "conforming to ISO/IEC 13818-1.";
+    default:
+        return "6.4.4.2 Basic Media Segment: A Media Segment shall be a valid MPEG-2 TS, conforming to ISO/IEC "
+                "13818-1.";
+    }
+}
 
 const char* content_component_to_string(content_component_t content_component)
 {
@@ -65,6 +186,7 @@ static subsegment_t* subsegment_new(void)
 {
     subsegment_t* obj = g_new0(subsegment_t, 1);
     obj->ssix_offsets = g_array_new(false, false, sizeof(uint64_t));
+    obj->pcr = PCR_INVALID;
     return obj;
 }
 
@@ -77,6 +199,15 @@ static void subsegment_free(subsegment_t* obj)
     g_free(obj);
 }
 
+static void subsegments_free(GPtrArray* subsegments)
+{
+    if (subsegments == NULL) {
+        return;
+    }
+    g_ptr_array_set_free_func(subsegments, (GDestroyNotify)subsegment_free);
+    g_ptr_array_free(subsegments, true);
+}
+
 static index_segment_validator_t* index_segment_validator_new(void)
 {
     index_segment_validator_t* obj = g_new0(index_segment_validator_t, 1);
@@ -91,20 +222,134 @@ void index_segment_validator_free(index_segment_validator_t* obj)
     }
 
     for (size_t i = 0; i < obj->segment_subsegments->len; ++i) {
-        GPtrArray* subsegments = g_ptr_array_index(obj->segment_subsegments, i);
-        g_ptr_array_set_free_func(subsegments, (GDestroyNotify)subsegment_free);
-        g_ptr_array_free(subsegments, true);
+        subsegments_free(g_ptr_array_index(obj->segment_subsegments, i));
     }
     g_ptr_array_free(obj->segment_subsegments, true);
     g_free(obj);
 }
 
+/* A CETS ECM PID, with the PIDs its ECMs apply to and the last ECM read from it. ECMs are usually repeated, so one
+ * that's the same as the last isn't read again. */
+typedef struct {
+    GPtrArray* pids; /* pid_validator_t* in dash_validator->pids with this ECM PID */
+    bool has_last_ecm;
+    bool last_ecm_valid;
+    uint8_t last_payload[TS_SIZE];
+    size_t last_payload_len;
+    cets_ecm_t last_ecm; /* without AUs */
+    cets_ecm_t* last_ecm_with_au; /* only read when decrypting */
+} ecm_pid_t;
+
+static ecm_pid_t* ecm_pid_new(void)
+{
+    ecm_pid_t* obj = g_slice_new0(ecm_pid_t);
+    obj->pids = g_ptr_array_new();
+    return obj;
+}
+
+static void ecm_pid_free(ecm_pid_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_ptr_array_free(obj->pids, true);
+    cets_ecm_free(obj->last_ecm_with_au);
+    g_slice_free(ecm_pid_t, obj);
+}
+
+/* Reads a CETS ECM, or gets the last one read from the PID if it's the same. The AUs are only read if read_au is true.
+ * Returns NULL if it's invalid. */
+static const cets_ecm_t* ecm_pid_read_ecm(ecm_pid_t* ecm_pid, ts_packet_t* ts, bool read_au)
+{
+    if (!ecm_pid->has_last_ecm || ecm_pid->last_payload_len != ts->payload_len
+            || memcmp(ecm_pid->last_payload, ts->payload, ts->payload_len)) {
+        if (read_au) {
+            cets_ecm_free(ecm_pid->last_ecm_with_au);
+            ecm_pid->last_ecm_with_au = cets_ecm_read(ts->payload, ts->payload_len);
+            ecm_pid->last_ecm_valid = ecm_pid->last_ecm_with_au != NULL;
+        } else {
+            ecm_pid->last_ecm_valid = cets_ecm_read_states(ts->payload, ts->payload_len, &ecm_pid->last_ecm);
+        }
+        memcpy(ecm_pid->last_payload, ts->payload, ts->payload_len);
+        ecm_pid->last_payload_len = ts->payload_len;
+        ecm_pid->has_last_ecm = true;
+    }
+    if (!ecm_pid->last_ecm_valid) {
+        return NULL;
+    }
+    return read_au ? ecm_pid->last_ecm_with_au : &ecm_pid->last_ecm;
+}
+
+/* Queues up the keys for decrypting the next packets a state in an ECM applies to */
+static void add_au_keys(pid_validator_t* pv, const cets_ecm_t* cets_ecm, const cets_ecm_state_t* state)
+{
+    GArray* au_keys = pv->au_keys[state->transport_scrambling_control];
+    for (size_t i = 0; i < state->num_au; ++i) {
+        const cets_ecm_au_t* au = &state->au[i];
+        cets_au_key_t au_key = {
+            .iv_size = cets_ecm->iv_size
+        };
+        memcpy(au_key.key_id, au->key_id_flag ? au->key_id : cets_ecm->default_key_id, sizeof(au_key.key_id));
+        au_key.key = cets_keys_find(segment_validator_keys, au_key.key_id);
+        memcpy(au_key.iv, au->initialization_vector, MIN(cets_ecm->iv_size, sizeof(au_key.iv)));
+        for (size_t j = 0; j < au->byte_offset_size; ++j) {
+            au_key.byte_offset = au_key.byte_offset << 8 | au->byte_offset[j];
+        }
+        g_array_append_val(au_keys, au_key);
+    }
+}
+
+/* Decrypts a scrambled TS packet in place with the next key from an ECM, so the PES packets it's part of can be
+ * validated like any other. It's marked as unscrambled afterwards, so it isn't decrypted again if it's read again
+ * (like the packets from an Initialization Segment are). */
+static void decrypt_ts_packet(dash_validator_t* dash_validator, pid_validator_t* pv, ts_packet_t* ts)
+{
+    uint8_t transport_scrambling_control = ts->transport_scrambling_control;
+    GArray* au_keys = pv->au_keys[transport_scrambling_control];
+    size_t* next_au_key = &pv->next_au_key[transport_scrambling_control];
+    if (*next_au_key >= au_keys->len) {
+        /* Already reported as a missing ECM */
+        dash_validator->decrypt_failed = true;
+        return;
+    }
+    const cets_au_key_t* au_key = &g_array_index(au_keys, cets_au_key_t, (*next_au_key)++);
+    if (*next_au_key == au_keys->len) {
+        g_array_set_size(au_keys, 0);
+        *next_au_key = 0;
+    }
+
+    if (dash_validator->decryptor == NULL) {
+        dash_validator->decryptor = cets_decryptor_new();
+    }
+    if (!cets_decryptor_decrypt(dash_validator->decryptor, au_key, ts->payload, ts->payload_len)) {
+        /* Once is enough, since the rest of the segment probably has the same problem */
+        if (!dash_validator->decrypt_failed) {
+            gchar key_id[CETS_KEY_SIZE * 2 + 1];
+            for (size_t i = 0; i < CETS_KEY_SIZE; ++i) {
+                g_snprintf(key_id + i * 2, 3, "%02x", au_key->key_id[i]);
+            }
+            g_critical("Can't decrypt TS packet on PID %"PRIu16" at byte %"PRIu64" in segment %s: %s %s.", ts->pid,
+                    ts->pos_in_stream, dash_validator->segment ? dash_validator->segment->file_name : "?",
+                    au_key->key == NULL ? "no key in the key file for key ID" :
+                    "invalid IV size or byte offset in the ECM for key ID", key_id);
+        }
+        dash_validator->decrypt_failed = true;
+        return;
+    }
+    ts->transport_scrambling_control = 0;
+}
+
 static pid_validator_t* pid_validator_new(uint16_t pid, content_component_t content_component)
 {
     pid_validator_t* obj = calloc(1, sizeof(*obj));
     obj->pid = pid;
     obj->content_component = content_component;
     obj->ecm_pids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    if (segment_validator_keys) {
+        for (size_t i = 1; i < TRANSPORT_SCRAMBLING_CONTROL_BITS; ++i) {
+            obj->au_keys[i] = g_array_new(false, false, sizeof(cets_au_key_t));
+        }
+    }
     return obj;
 }
 
@@ -114,6 +359,13 @@ static void pid_validator_free(pid_validator_t* obj)
         return;
     }
     g_hash_table_destroy(obj->ecm_pids);
+    t_std_es_free(obj->t_std);
+    frame_index_free(obj->frame_index);
+    for (size_t i = 1; i < TRANSPORT_SCRAMBLING_CONTROL_BITS; ++i) {
+        if (obj->au_keys[i]) {
+            g_array_free(obj->au_keys[i], true);
+        }
+    }
     free(obj);
 }
 
@@ -124,8 +376,11 @@ dash_validator_t* dash_validator_new(segment_type_t segment_type, dash_profile_t
     obj->profile = profile;
     obj->subsegments = g_ptr_array_new_with_free_func((GDestroyNotify)subsegment_free);
     obj->pids = g_ptr_array_new_with_free_func((GDestroyNotify)pid_validator_free);
-    obj->ecm_pids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    obj->ecm_pids = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)ecm_pid_free);
     obj->initialization_segment_ts = g_array_new(false, false, sizeof(ts_packet_t));
+    obj->splice_points = g_array_new(false, false, sizeof(splice_point_t));
+    obj->t_std = t_std_new();
+    obj->pcr_analyzer = pcr_analyzer_new();
     return obj;
 }
 
@@ -134,13 +389,14 @@ void dash_validator_free(dash_validator_t* obj)
     if (obj == NULL) {
         return;
     }
-    program_association_section_unref(obj->pat);
-    program_map_section_unref(obj->pmt);
-    conditional_access_section_unref(obj->cat);
     g_ptr_array_free(obj->subsegments, true);
     g_ptr_array_free(obj->pids, true);
     g_hash_table_destroy(obj->ecm_pids);
     g_array_free(obj->initialization_segment_ts, true);
+    g_array_free(obj->splice_points, true);
+    cets_decryptor_free(obj->decryptor);
+    t_std_free(obj->t_std);
+    pcr_analyzer_free(obj->pcr_analyzer);
     free(obj);
 }
 
@@ -152,7 +408,7 @@ static void pat_processor(mpeg2ts_stream_t* m2s, void* arg)
     g_return_if_fail(arg);
 
     dash_validator_t* dash_validator = arg;
-    dash_validator->pat = program_association_section_ref(m2s->pat);
+    dash_validator->pat_fingerprint = section_table_fingerprint(m2s->pat_table);
 
     if (m2s->programs->len != 1) {
         g_critical("DASH Conformance: 6.4.4.2  Media segments shall contain exactly one program (%u found)",
@@ -175,7 +431,7 @@ static void cat_processor(mpeg2ts_stream_t* m2s, void* arg)
     g_return_if_fail(arg);
 
     dash_validator_t* dash_validator = arg;
-    dash_validator->cat = conditional_access_section_ref(m2s->cat);
+    dash_validator->cat_fingerprint = section_table_fingerprint(m2s->cat_table);
 }
 
 static pid_validator_t* dash_validator_find_pid(int pid, dash_validator_t* dash_validator)
@@ -198,9 +454,12 @@ static void pmt_processor(mpeg2ts_program_t* m2p, void* arg)
     g_return_if_fail(arg);
 
     dash_validator_t* dash_validator = arg;
-    dash_validator->pmt = program_map_section_ref(m2p->pmt);
+    dash_validator->pmt_fingerprint = section_table_fingerprint(m2p->pmt_table);
 
     dash_validator->pcr_pid = m2p->pmt->pcr_pid;
+    /* Packets waiting for a PCR may be for PIDs that are about to go away */
+    t_std_flush(dash_validator->t_std);
+    report_t_std_errors(dash_validator);
 
     GHashTableIter i;
     g_hash_table_iter_init(&i, m2p->pids);
@@ -215,7 +474,18 @@ static void pmt_processor(mpeg2ts_program_t* m2p, void* arg)
 // TODO: we need to figure out what we do when section versions change
 // Do we need to fix something? Profile something out?
         if (pid_validator != NULL) {
-            g_ptr_array_remove(dash_validator->pids, pid_validator);
+            if (dash_validator->pid_parallel) {
+                /* Keep it until its PES packets have been validated */
+                for (guint j = 0; j < dash_validator->pids->len; ++j) {
+                    if (g_ptr_array_index(dash_validator->pids, j) == pid_validator) {
+                        g_ptr_array_add(dash_validator->pid_parallel->retired_pids,
+                                g_ptr_array_steal_index(dash_validator->pids, j));
+                        break;
+                    }
+                }
+            } else {
+                g_ptr_array_remove(dash_validator->pids, pid_validator);
+            }
         }
 
         switch (pi->es_info->stream_type) {
@@ -240,12 +510,25 @@ static void pmt_processor(mpeg2ts_program_t* m2p, void* arg)
             process_pid = 1;
             content_component = AUDIO_CONTENT_COMPONENT;
             break;
+        case STREAM_TYPE_SCTE35: {
+            section_filter_t* filter = section_filter_new(TABLE_ID_SPLICE_INFO_SECTION, 0xFF,
+                    validate_splice_info_section);
+            filter->arg = dash_validator;
+            mpeg2ts_stream_register_section_filter(m2p->stream, pid, filter);
+            process_pid = 0;
+            break;
+        }
         default:
             process_pid = 0;
         }
 
         if (process_pid) {
             pid_validator = pid_validator_new(pid, content_component);
+            pid_validator->t_std = t_std_es_new(pid, pi->es_info->stream_type);
+            pid_validator->pes_in_init_segment = dash_validator->reading_init_segment;
+            if (segment_validator_frame_index) {
+                pid_validator->frame_index = frame_index_new(pid, pi->es_info->stream_type);
+            }
             g_ptr_array_add(dash_validator->pids, pid_validator);
 
             // Register callback for TS packets on CA_PID
@@ -255,8 +538,12 @@ static void pmt_processor(mpeg2ts_program_t* m2p, void* arg)
                     dash_validator->is_encrypted = true;
                     ca_descriptor_t* ca_descriptor = (ca_descriptor_t*)descriptor;
                     if (ca_descriptor->ca_system_id == 0x6365 /* 'ce' */) {
-                        g_hash_table_add(dash_validator->ecm_pids, GINT_TO_POINTER(ca_descriptor->ca_pid));
-                        g_hash_table_add(pid_validator->ecm_pids, GINT_TO_POINTER(ca_descriptor->ca_pid));
+                        uint16_t ca_pid = ca_descriptor->ca_pid;
+                        if (!g_hash_table_contains(dash_validator->ecm_pids, GINT_TO_POINTER(ca_pid))) {
+                            g_hash_table_insert(dash_validator->ecm_pids, GINT_TO_POINTER(ca_pid), ecm_pid_new());
+                            dash_validator->ecm_pid_bits[ca_pid / 32] |= UINT32_C(1) << (ca_pid % 32);
+                        }
+                        g_hash_table_add(pid_validator->ecm_pids, GINT_TO_POINTER(ca_pid));
                     } else {
                         g_warning("Saw CA_descriptor with unknown system_id = %"PRIu16". Encrypted content must use "
                                 "common encryption to be tested by this utility.", ca_descriptor->ca_system_id);
@@ -264,19 +551,174 @@ static void pmt_processor(mpeg2ts_program_t* m2p, void* arg)
                 }
             }
 
-            // hook PES validation to PES demuxer
-            pes_demux_t* pd = pes_demux_new(validate_pes_packet);
-            pd->arg = dash_validator;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t* demux_handler = demux_pid_handler_new(pes_demux_process_ts_packet);
-            demux_handler->arg = pd;
-            demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;
+            demux_pid_handler_t* demux_handler;
+            if (dash_validator->pid_parallel) {
+                // PES packets are put together and validated after the first pass
+                demux_handler = demux_pid_handler_new(index_pes_ts_packet);
+                demux_handler->arg = pid_index_new(dash_validator->pid_parallel, pid_validator);
+            } else {
+                // hook PES validation to PES demuxer
+                pes_demux_t* pd = pes_demux_new(validate_pes_packet);
+                pd->arg = dash_validator;
+
+                // hook PES demuxer to the PID processor
+                demux_handler = demux_pid_handler_new(pes_demux_process_ts_packet);
+                demux_handler->arg = pd;
+                demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;
+            }
 
             // hook PID processor to PID
             mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_pid, demux_handler, NULL);
         }
     }
+
+    /* Work out which PIDs each ECM PID applies to now, instead of for every ECM */
+    GHashTableIter e;
+    g_hash_table_iter_init(&e, dash_validator->ecm_pids);
+    gpointer ca_pid;
+    ecm_pid_t* ecm_pid;
+    while (g_hash_table_iter_next(&e, &ca_pid, (void**)&ecm_pid)) {
+        g_ptr_array_set_size(ecm_pid->pids, 0);
+        for (gsize j = 0; j < dash_validator->pids->len; ++j) {
+            pid_validator_t* pv = g_ptr_array_index(dash_validator->pids, j);
+            if (g_hash_table_contains(pv->ecm_pids, ca_pid)) {
+                g_ptr_array_add(ecm_pid->pids, pv);
+            }
+        }
+    }
+}
+
+/* Keeps the splice points that SCTE 35 splice_info_sections signal, so they can be checked against segment boundaries
+ * once every segment's timing is known. */
+static void validate_splice_info_section(const psi_section_t* section, elementary_stream_info_t* esi, void* arg)
+{
+    dash_validator_t* dash_validator = arg;
+
+    splice_info_section_t* sis = splice_info_section_parse(section);
+    if (sis == NULL) {
+        return;
+    }
+    splice_info_section_print(sis);
+
+    splice_point_t splice_point = {0};
+    if (splice_info_section_get_splice_point(sis, &splice_point.pts)) {
+        splice_point.splice_command_type = sis->splice_command_type;
+        splice_point.splice_event_id = sis->splice_event_id;
+        splice_point.out_of_network_indicator = sis->out_of_network_indicator;
+
+        /* Splice commands are usually sent several times ahead of the splice point */
+        GArray* splice_points = dash_validator->splice_points;
+        splice_point_t* last = splice_points->len ?
+                &g_array_index(splice_points, splice_point_t, splice_points->len - 1) : NULL;
+        if (last == NULL || last->pts != splice_point.pts
+                || last->splice_command_type != splice_point.splice_command_type
+                || last->splice_event_id != splice_point.splice_event_id) {
+            g_debug("SCTE 35: splice point at PTS %"PRIu64" on PID %"PRIu16, splice_point.pts, section->pid);
+            g_array_append_val(splice_points, splice_point);
+        }
+    }
+    splice_info_section_free(sis);
+}
+
+/* Logs T-STD errors found since the last call */
+static void report_t_std_errors(dash_validator_t* dash_validator)
+{
+    GArray* errors = dash_validator->t_std->errors;
+    if (errors->len == 0) {
+        return;
+    }
+    for (size_t i = 0; i < errors->len; ++i) {
+        t_std_error_t* error = &g_array_index(errors, t_std_error_t, i);
+        if (error->underflow) {
+            g_critical("T-STD: %s underflow on PID %"PRIu16" in segment %s. The PES packet at byte %"PRIu64" isn't "
+                    "all in %s at its DTS %"PRIu64" (%"PRIu64" bytes of it are). 2.4.2 of ISO/IEC 13818-1.",
+                    t_std_buffer_to_string(error->buffer), error->pid,
+                    dash_validator->segment ? dash_validator->segment->file_name : "?", error->offset,
+                    t_std_buffer_to_string(error->buffer), error->dts, error->fullness);
+        } else {
+            g_critical("T-STD: %s overflow on PID %"PRIu16" at byte %"PRIu64" in segment %s. It has %"PRIu64" "
+                    "bytes, but only holds %"PRIu64". 2.4.2 of ISO/IEC 13818-1.",
+                    t_std_buffer_to_string(error->buffer), error->pid, error->offset,
+                    dash_validator->segment ? dash_validator->segment->file_name : "?", error->fullness, error->size);
+        }
+    }
+    g_array_set_size(errors, 0);
+    dash_validator->status = 0;
+}
+
+/* Logs PCR errors found since the last call */
+static void report_pcr_errors(dash_validator_t* dash_validator)
+{
+    GArray* errors = dash_validator->pcr_analyzer->errors;
+    for (size_t i = 0; i < errors->len; ++i) {
+        pcr_error_t* error = &g_array_index(errors, pcr_error_t, i);
+        const char* file_name = dash_validator->segment ? dash_validator->segment->file_name : "?";
+        switch (error->type) {
+        case PCR_INTERVAL_TOO_LONG:
+            g_critical("DASH Conformance: PCR %"PRIu64" on PID %"PRIu16" at byte %"PRIu64" in segment %s is %.1f ms "
+                    "after the one before it (%"PRIu64"). 2.7.2 of ISO/IEC 13818-1 says PCRs shall be at most 100 ms "
+                    "apart. %s", error->pcr, dash_validator->pcr_pid, error->offset, file_name,
+                    (error->pcr - error->previous + PCR_ROLLOVER) % PCR_ROLLOVER / 27000.0, error->previous,
+                    valid_ts_conformance(dash_validator->segment_type));
+            break;
+        case PCR_BACKWARDS:
+            g_critical("DASH Conformance: PCR %"PRIu64" on PID %"PRIu16" at byte %"PRIu64" in segment %s is before "
+                    "the one before it (%"PRIu64"), but discontinuity_indicator isn't set. 2.4.3.5 of ISO/IEC "
+                    "13818-1. %s", error->pcr, dash_validator->pcr_pid, error->offset, file_name, error->previous,
+                    valid_ts_conformance(dash_validator->segment_type));
+            break;
+        case PCR_OUT_OF_RANGE:
+            g_critical("DASH Conformance: PCR %"PRIu64" on PID %"PRIu16" at byte %"PRIu64" in segment %s is past "
+                    "the largest PCR (%"PRIu64"), so its program_clock_reference_extension is 300 or more. 2.4.3.5 "
+                    "of ISO/IEC 13818-1 says it shall be less than 300. %s", error->pcr, dash_validator->pcr_pid,
+                    error->offset, file_name, (uint64_t)PCR_ROLLOVER - 1,
+                    valid_ts_conformance(dash_validator->segment_type));
+            break;
+        }
+    }
+    g_array_set_size(errors, 0);
+    dash_validator->status = 0;
+}
+
+/* Logs a summary of the segment's PCRs, and checks the PCRs in the 'pcrb' box against them */
+static void check_pcrs(dash_validator_t* dash_validator, const char* file_name)
+{
+    pcr_summary_t* summary = &dash_validator->pcr_summary;
+    pcr_analyzer_summarize(dash_validator->pcr_analyzer, summary);
+    if (summary->num_pcrs == 0) {
+        return;
+    }
+    g_info("PCR: %zu PCRs on PID %"PRIu16" in segment %s, %.1f to %.1f ms apart, %"PRIu32" discontinuities, "
+            "%"PRIu32" rollovers, %.0f bits/s, %.0f ns (RMS %.0f ns) from the nearest constant bitrate.",
+            summary->num_pcrs, dash_validator->pcr_pid, file_name, summary->min_interval / 27000.0,
+            summary->max_interval / 27000.0, summary->num_discontinuities, summary->num_rollovers, summary->bitrate,
+            summary->max_deviation * 1000 / 27, summary->rms_deviation * 1000 / 27);
+
+    for (size_t i = 0; i < dash_validator->subsegments->len; ++i) {
+        subsegment_t* subsegment = g_ptr_array_index(dash_validator->subsegments, i);
+        if (!PCR_IS_VALID(subsegment->pcr)) {
+            continue;
+        }
+        uint64_t pcr = pcr_analyzer_pcr_at(dash_validator->pcr_analyzer, subsegment->start_byte);
+        if (!PCR_IS_VALID(pcr)) {
+            continue;
+        }
+        /* Taken as a 27 MHz value, like program_clock_reference_base * 300 + program_clock_reference_extension */
+        int64_t difference = (int64_t)subsegment->pcr - (int64_t)pcr;
+        if (difference > PCR_ROLLOVER / 2) {
+            difference -= PCR_ROLLOVER;
+        } else if (difference < -PCR_ROLLOVER / 2) {
+            difference += PCR_ROLLOVER;
+        }
+        if (llabs(difference) > PCR_ACCURACY) {
+            g_critical("DASH Conformance: 'pcrb' has PCR %"PRIu64" for subsegment %zu of %s, but the PCRs in the "
+                    "segment put its first byte (%"PRIu64") at %"PRIu64", %.0f ns away. 6.4.7.2 of ISO/IEC 23009-1: "
+                    "pcr is the MPEG-2 TS PCR corresponding to the first byte of the first MPEG-2 TS packet of the "
+                    "Subsegment.", subsegment->pcr, i, file_name, subsegment->start_byte, pcr,
+                    difference * 1000.0 / 27);
+            dash_validator->status = 0;
+        }
+    }
 }
 
 static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, void* arg)
@@ -297,6 +739,13 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
 
     if (dash_validator->pcr_pid == ts->pid && ts->adaptation_field.pcr_flag) {
         dash_validator->last_pcr = ts->adaptation_field.program_clock_reference;
+        t_std_pcr(dash_validator->t_std, dash_validator->last_pcr, ts->pos_in_stream,
+                ts->adaptation_field.discontinuity_indicator);
+        report_t_std_errors(dash_validator);
+        if (PCR_IS_VALID(dash_validator->last_pcr) && !pcr_analyzer_add(dash_validator->pcr_analyzer,
+                dash_validator->last_pcr, ts->pos_in_stream, ts->adaptation_field.discontinuity_indicator)) {
+            report_pcr_errors(dash_validator);
+        }
     }
 
     while (dash_validator->current_subsegment
@@ -307,10 +756,15 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
                     dash_validator->subsegment_index, dash_validator->segment->file_name);
             dash_validator->status = 0;
         } else {
-            if (!dash_validator->current_subsegment->saw_random_access) {
-                g_critical("Error: Did not see iframe for subsegment %zu in segment %s.",
-                        dash_validator->subsegment_index, dash_validator->segment->file_name);
-                dash_validator->status = 0;
+            if (dash_validator->pid_parallel) {
+                // PES packets haven't been validated yet, so check once they have
+                iframe_check_t check = {
+                    .subsegment_index = dash_validator->subsegment_index,
+                    .log_key = reserve_log_key(dash_validator->pid_parallel)
+                };
+                g_array_append_val(dash_validator->pid_parallel->iframe_checks, check);
+            } else {
+                check_subsegment_random_access(dash_validator, dash_validator->subsegment_index);
             }
             if (dash_validator->current_subsegment->ssix_offset_index != dash_validator->current_subsegment->ssix_offsets->len) {
                 uint64_t next_ssix_offset = g_array_index(dash_validator->current_subsegment->ssix_offsets,
@@ -331,6 +785,10 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
             pid_validator_t* pv = g_ptr_array_index(dash_validator->pids, i);
             for (size_t j = 1; j < TRANSPORT_SCRAMBLING_CONTROL_BITS; ++j) {
                 pv->au_for_transport_scrambling_control[j] = 0;
+                if (pv->au_keys[j]) {
+                    g_array_set_size(pv->au_keys[j], 0);
+                    pv->next_au_key[j] = 0;
+                }
             }
         }
     }
@@ -366,15 +824,16 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
         ++dash_validator->current_subsegment->ts_count;
     }
 
-    if (g_hash_table_contains(dash_validator->ecm_pids, GINT_TO_POINTER(ts->pid))) {
-        cets_ecm_t* cets_ecm = cets_ecm_read(ts->payload, ts->payload_len);
+    if (dash_validator->ecm_pid_bits[ts->pid / 32] & (UINT32_C(1) << (ts->pid % 32))) {
+        ecm_pid_t* ecm_pid = g_hash_table_lookup(dash_validator->ecm_pids, GINT_TO_POINTER(ts->pid));
+        const cets_ecm_t* cets_ecm = ecm_pid_read_ecm(ecm_pid, ts, segment_validator_keys != NULL);
         if (!cets_ecm) {
             g_critical("Invalid CETS ECM found on PID %"PRIu16, ts->pid);
         }
         /* Ignore keys that don't apply yet */
         else if (!cets_ecm->next_key_id_flag) {
             for (size_t s = 0; s < cets_ecm->num_states; ++s) {
-                cets_ecm_state_t* state = &cets_ecm->states[s];
+                const cets_ecm_state_t* state = &cets_ecm->states[s];
                 uint8_t transport_scrambling_control = state->transport_scrambling_control;
                 if (transport_scrambling_control == 0) {
                     g_warning("Segment %s contains CETS ECM with transport_scrambling_control = '00'. That value is "
@@ -383,15 +842,15 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
                     continue;
                 }
                 /* TODO check number of AU */
-                for (gsize i = 0; i < dash_validator->pids->len; ++i) {
-                    pid_validator_t* pv = g_ptr_array_index(dash_validator->pids, i);
-                    if (g_hash_table_contains(pv->ecm_pids, GINT_TO_POINTER(ts->pid))) {
-                        pv->au_for_transport_scrambling_control[transport_scrambling_control] += state->num_au;
+                for (gsize i = 0; i < ecm_pid->pids->len; ++i) {
+                    pid_validator_t* pv = g_ptr_array_index(ecm_pid->pids, i);
+                    pv->au_for_transport_scrambling_control[transport_scrambling_control] += state->num_au;
+                    if (segment_validator_keys) {
+                        add_au_keys(pv, cets_ecm, state);
                     }
                 }
             }
         }
-        cets_ecm_free(cets_ecm);
     }
 
     pid_validator_t* pid_validator = dash_validator_find_pid(ts->pid, dash_validator);
@@ -403,6 +862,9 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
     if (ts->transport_scrambling_control) {
         if (pid_validator->au_for_transport_scrambling_control[ts->transport_scrambling_control]) {
             --pid_validator->au_for_transport_scrambling_control[ts->transport_scrambling_control];
+            if (segment_validator_keys) {
+                decrypt_ts_packet(dash_validator, pid_validator, ts);
+            }
         } else {
             g_critical("DASH Conformance: Segment %s contains TS packet for PID %"PRIu16" with "
                     "transport_scrambling_control = '%d%d', but we have not seen a CETS ECM with that "
@@ -416,6 +878,7 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
                     (dash_validator->segment ? dash_validator->segment->file_name : "?"), ts->pid,
                     (bool)(ts->transport_scrambling_control & 2), ts->transport_scrambling_control & 1);
             dash_validator->status = 0;
+            dash_validator->decrypt_failed = true;
         }
     }
 
@@ -442,8 +905,12 @@ static void validate_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, v
         }
     }
 
+    if (pid_validator->t_std) {
+        t_std_add_ts_packet(dash_validator->t_std, pid_validator->t_std, ts);
+    }
+
+    // CC errors are checked per block in validate_segment()
     // TODO: check for discontinuities
-    //       -> CC errors, declared discontinuities
     //       -> PCR-PCR distances, with some arbitrary tolerance
     // we need to figure out what to do here -- we can let PES parsing fail and get a notice
 
@@ -500,6 +967,9 @@ void validate_pes_packet(pes_packet_t* pes, elementary_stream_info_t* esi, GArra
     ts_packet_t* first_ts = &g_array_index(ts_packets, ts_packet_t, 0);
     pid_validator_t* pid_validator = dash_validator_find_pid(first_ts->pid, dash_validator);
     g_return_if_fail(pid_validator);
+    bool pes_in_init_segment = pid_validator->pes_in_init_segment;
+    /* The packet that ended this PES packet starts the next one */
+    pid_validator->pes_in_init_segment = dash_validator->reading_init_segment;
 
     if (!validate_pes_packet_common(pes, ts_packets, dash_validator)) {
         dash_validator->status = 0;
@@ -548,6 +1018,14 @@ void validate_pes_packet(pes_packet_t* pes, elementary_stream_info_t* esi, GArra
         }
     }
 
+    /* Only index what's in the segment itself */
+    if (pid_validator->frame_index && !pes_in_init_segment) {
+        ts_packet_t* last_ts = &g_array_index(ts_packets, ts_packet_t, ts_packets->len - 1);
+        frame_index_add_pes(pid_validator->frame_index, pes, first_ts->pos_in_stream,
+                last_ts->pos_in_stream + TS_SIZE - first_ts->pos_in_stream,
+                first_ts->adaptation_field.random_access_indicator);
+    }
+
     // we are in the first PES packet of a PID
     if (pid_validator->pes_count == 0) {
         if (pes->pts_flag) {
@@ -623,12 +1101,7 @@ void validate_pes_packet(pes_packet_t* pes, elementary_stream_info_t* esi, GArra
         if (dash_validator->current_subsegment && first_ts->adaptation_field.random_access_indicator) {
             // check subsegment location against index file
             dash_validator->current_subsegment->saw_random_access = true;
-            // time location
-            if (dash_validator->current_subsegment->start_time != pes->pts) {
-                g_critical("DASH Conformance: expected subsegment PTS does not match actual.  Expected: %"PRIu64", "
-                        "Actual: %"PRIu64, dash_validator->current_subsegment->start_time, pes->pts);
-                dash_validator->status = 0;
-            }
+            check_subsegment_start_time(dash_validator, dash_validator->current_subsegment, pes->pts);
 
             // byte location
             if (dash_validator->current_subsegment->start_byte != pes->payload_pos_in_stream) {
@@ -756,6 +1229,7 @@ static void validate_emsg_pes_packet(pes_packet_t* pes, elementary_stream_info_t
         goto cleanup;
     }
 
+    dash_validator->has_emsg = true;
     if (validate_emsg_msg(pes->payload, pes->payload_len, dash_validator->segment->duration) != 0) {
         g_critical("DASH Conformance: validation of EMSG failed");
         dash_validator->status = 0;
@@ -765,6 +1239,406 @@ cleanup:
     pes_free(pes);
 }
 
+/* Validation carries on after the gap, so one bad byte doesn't hide everything after it */
+void report_sync_gaps(dash_validator_t* dash_validator, segment_reader_t* reader, size_t* num_reported)
+{
+    for (; *num_reported < reader->sync_gaps->len; ++*num_reported) {
+        segment_sync_gap_t* gap = &g_array_index(reader->sync_gaps, segment_sync_gap_t, *num_reported);
+        g_critical("DASH Conformance: Lost sync at byte %"PRIu64" in segment %s. Skipped %"PRIu64" bytes to the next "
+                "sync byte. %s", gap->offset, reader->file_name, gap->length,
+                valid_ts_conformance(dash_validator->segment_type));
+        dash_validator->status = 0;
+    }
+}
+
+void check_subsegment_random_access(dash_validator_t* dash_validator, size_t subsegment_index)
+{
+    subsegment_t* subsegment = g_ptr_array_index(dash_validator->subsegments, subsegment_index);
+    if (!subsegment->saw_random_access) {
+        g_critical("Error: Did not see iframe for subsegment %zu in segment %s.",
+                subsegment_index, dash_validator->segment->file_name);
+        dash_validator->status = 0;
+    }
+}
+
+/* The time location check for a PES packet with random_access_indicator in an indexed subsegment */
+void check_subsegment_start_time(dash_validator_t* dash_validator, const subsegment_t* subsegment, uint64_t pts)
+{
+    if (subsegment->start_time != pts) {
+        g_critical("DASH Conformance: expected subsegment PTS does not match actual.  Expected: %"PRIu64", "
+                "Actual: %"PRIu64, subsegment->start_time, pts);
+        dash_validator->status = 0;
+    }
+}
+
+pid_parallel_validator_t* pid_parallel_validator_new(dash_validator_t* dash_validator)
+{
+    pid_parallel_validator_t* obj = g_slice_new0(pid_parallel_validator_t);
+    obj->dash_validator = dash_validator;
+    obj->log = log_capture_new();
+    obj->logs = g_ptr_array_new_with_free_func((GDestroyNotify)log_capture_free);
+    g_ptr_array_add(obj->logs, obj->log);
+    obj->indexes = g_ptr_array_new_with_free_func((GDestroyNotify)pid_index_free);
+    obj->retired_pids = g_ptr_array_new_with_free_func((GDestroyNotify)pid_validator_free);
+    obj->iframe_checks = g_array_new(false, false, sizeof(iframe_check_t));
+    obj->tasks = g_array_new(false, false, sizeof(pes_task_t));
+    obj->schedule = g_ptr_array_new();
+    obj->status = 1;
+    g_mutex_init(&obj->mutex);
+    g_cond_init(&obj->first_task_done);
+    return obj;
+}
+
+void pid_parallel_validator_free(pid_parallel_validator_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_ptr_array_free(obj->logs, true);
+    g_ptr_array_free(obj->indexes, true);
+    g_ptr_array_free(obj->retired_pids, true);
+    g_array_free(obj->iframe_checks, true);
+    g_array_free(obj->tasks, true);
+    g_ptr_array_free(obj->schedule, true);
+    g_free(obj->saw_random_access);
+    g_mutex_clear(&obj->mutex);
+    g_cond_clear(&obj->first_task_done);
+    g_slice_free(pid_parallel_validator_t, obj);
+}
+
+pid_index_t* pid_index_new(pid_parallel_validator_t* parent, pid_validator_t* pid_validator)
+{
+    pid_index_t* obj = g_slice_new0(pid_index_t);
+    obj->pid_validator = pid_validator;
+    obj->packets = g_array_new(false, false, sizeof(uint64_t));
+    obj->pes_ends = g_array_new(false, false, sizeof(pes_end_t));
+    obj->parent = parent;
+    g_ptr_array_add(parent->indexes, obj);
+    return obj;
+}
+
+void pid_index_free(pid_index_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_array_free(obj->packets, true);
+    g_array_free(obj->pes_ends, true);
+    g_slice_free(pid_index_t, obj);
+}
+
+/* Gives something done after the first pass a place in the log between what the first pass has logged so far and
+ * what it logs next */
+uint64_t reserve_log_key(pid_parallel_validator_t* pid_parallel)
+{
+    uint64_t key = pid_parallel->log->key + 1;
+    pid_parallel->log->key += 2;
+    return key;
+}
+
+/* First pass handler for media PIDs, in place of pes_demux_process_ts_packet() */
+void index_pes_ts_packet(ts_packet_t* ts, elementary_stream_info_t* esi, void* arg)
+{
+    g_return_if_fail(arg);
+
+    pid_index_t* index = arg;
+    pid_parallel_validator_t* pid_parallel = index->parent;
+    dash_validator_t* dash_validator = pid_parallel->dash_validator;
+
+    // same test pes_demux_process_ts_packet() uses for the end of a PES packet
+    if ((ts == NULL || ts->payload_unit_start_indicator) && index->num_pending > 0) {
+        subsegment_t* subsegment = dash_validator->current_subsegment;
+        pes_end_t end = {
+            .packet_index = index->packets->len,
+            .log_key = reserve_log_key(pid_parallel),
+            .subsegment_index = dash_validator->subsegment_index,
+            .has_subsegment = subsegment != NULL,
+            .first_in_subsegment = subsegment != NULL && subsegment->pes_count == 0
+        };
+        g_array_append_val(index->pes_ends, end);
+        if (subsegment) {
+            subsegment->pes_count++;
+        }
+        index->num_pending = 0;
+    }
+
+    if (ts != NULL) {
+        uint64_t packet = ts->pos_in_stream;
+        if (pid_parallel->dash_validator->reading_init_segment) {
+            packet = PID_INDEX_INIT_PACKET | (uint64_t)(ts - (ts_packet_t*)pid_parallel->init_packets->data);
+        }
+        g_array_append_val(index->packets, packet);
+        ++index->num_pending;
+    }
+}
+
+bool read_indexed_packet(pid_parallel_validator_t* pid_parallel, packet_block_t* block, uint64_t pos_in_stream,
+        ts_packet_t* ts)
+{
+    if (pos_in_stream + TS_SIZE > pid_parallel->length) {
+        return false;
+    }
+    if (pos_in_stream < block->pos_in_stream || pos_in_stream + TS_SIZE > block->pos_in_stream + block->length) {
+        size_t to_read = MIN(sizeof(block->data), pid_parallel->length - pos_in_stream);
+        block->pos_in_stream = pos_in_stream;
+        block->length = 0;
+        if (!file_handle_read(pid_parallel->file, pid_parallel->start_offset + pos_in_stream, block->data, to_read,
+                &block->length) || block->length < TS_SIZE) {
+            block->length = 0;
+            return false;
+        }
+    }
+    if (!ts_read(ts, block->data + (pos_in_stream - block->pos_in_stream), TS_SIZE, 0)) {
+        return false;
+    }
+    ts->pos_in_stream = pos_in_stream;
+    return true;
+}
+
+/* Splits a PID's PES packets into one task for each subsegment they end in */
+void add_pes_tasks(pid_parallel_validator_t* pid_parallel, pid_index_t* index)
+{
+    if (index->packets->len == 0) {
+        return;
+    }
+
+    pes_task_t task = { .index = index, .first_for_pid = true };
+    for (size_t i = 0; i < index->pes_ends->len; ++i) {
+        pes_end_t* end = &g_array_index(index->pes_ends, pes_end_t, i);
+        pes_end_t* next = i + 1 < index->pes_ends->len ? &g_array_index(index->pes_ends, pes_end_t, i + 1) : NULL;
+        if (next && next->has_subsegment == end->has_subsegment && next->subsegment_index == end->subsegment_index) {
+            continue;
+        }
+        task.end_end = i + 1;
+        task.end_packet = next ? end->packet_index : index->packets->len;
+        g_array_append_val(pid_parallel->tasks, task);
+
+        task.first_packet = task.end_packet;
+        task.first_end = task.end_end;
+        task.first_for_pid = false;
+    }
+    if (index->pes_ends->len == 0) {
+        // nothing to validate, but the packets are still read again
+        task.end_packet = index->packets->len;
+        g_array_append_val(pid_parallel->tasks, task);
+    }
+}
+
+/* Puts together and validates some of a PID's PES packets, the same way pes_demux_process_ts_packet() and
+ * validate_pes_packet() would have during the first pass */
+void validate_pes_task(pid_parallel_validator_t* pid_parallel, pes_task_t* task, packet_block_t* block,
+        log_capture_t* log, log_capture_t* scratch)
+{
+    pid_index_t* index = task->index;
+    pid_validator_t* pid_validator = index->pid_validator;
+    if (!task->first_for_pid) {
+        g_mutex_lock(&pid_parallel->mutex);
+        while (!index->first_task_done) {
+            g_cond_wait(&pid_parallel->first_task_done, &pid_parallel->mutex);
+        }
+        g_mutex_unlock(&pid_parallel->mutex);
+
+        /* Duration comes from the last PES packet, so we need to know if this task set it */
+        task->pid_validator = *index->pid_validator;
+        task->pid_validator.duration = -1;
+        task->pes_count_before = task->pid_validator.pes_count;
+        task->pid_validator.pes_in_init_segment =
+                (g_array_index(index->packets, uint64_t, task->first_packet) & PID_INDEX_INIT_PACKET) != 0;
+        if (index->pid_validator->frame_index) {
+            task->pid_validator.frame_index = frame_index_new(pid_validator->pid,
+                    index->pid_validator->frame_index->stream_type);
+        }
+        pid_validator = &task->pid_validator;
+    }
+
+    /* Our own copy, so the only shared state validate_pes_packet() changes belongs to this task */
+    dash_validator_t dash_validator = *pid_parallel->dash_validator;
+    dash_validator.status = 1;
+    dash_validator.pids = g_ptr_array_new();
+    g_ptr_array_add(dash_validator.pids, pid_validator);
+    subsegment_t subsegment;
+
+    pes_demux_t* pd = pes_demux_new(validate_pes_packet);
+    pd->arg = &dash_validator;
+
+    size_t next_end = task->first_end;
+    for (size_t i = task->first_packet; i <= task->end_packet; ++i) {
+        ts_packet_t packet;
+        ts_packet_t* ts = NULL;
+        bool init_packet = false;
+        /* The packet at end_packet starts the next task's first PES packet */
+        if (i < task->end_packet) {
+            uint64_t pos = g_array_index(index->packets, uint64_t, i);
+            init_packet = (pos & PID_INDEX_INIT_PACKET) != 0;
+            if (init_packet) {
+                ts = &g_array_index(pid_parallel->init_packets, ts_packet_t, pos & ~PID_INDEX_INIT_PACKET);
+            } else {
+                // anything logged while parsing the packet was already logged in the first pass
+                log_capture_set(scratch);
+                bool ok = read_indexed_packet(pid_parallel, block, pos, &packet);
+                log_capture_clear(scratch);
+                log_capture_set(log);
+                if (!ok) {
+                    g_critical("Error reading TS packet at byte %"PRIu64" of %s again to validate PID %"PRIu16,
+                            pos, dash_validator.segment ? dash_validator.segment->file_name : "?",
+                            pid_validator->pid);
+                    dash_validator.status = 0;
+                    break;
+                }
+                ts = &packet;
+            }
+        }
+
+        pes_end_t* end = NULL;
+        if (next_end < task->end_end && g_array_index(index->pes_ends, pes_end_t, next_end).packet_index == i) {
+            end = &g_array_index(index->pes_ends, pes_end_t, next_end++);
+        }
+        if (end == NULL) {
+            if (ts) {
+                pes_demux_process_ts_packet(ts, NULL, pd);
+            }
+            continue;
+        }
+
+        // put things back the way they were when this PES packet ended in the first pass
+        log_capture_set(log);
+        log->key = end->log_key;
+        dash_validator.subsegment_index = end->subsegment_index;
+        dash_validator.reading_init_segment = init_packet;
+        dash_validator.current_subsegment = NULL;
+        if (end->has_subsegment) {
+            subsegment = *(subsegment_t*)g_ptr_array_index(dash_validator.subsegments, end->subsegment_index);
+            subsegment.pes_count = end->first_in_subsegment ? 0 : 1;
+            subsegment.saw_random_access = false;
+            dash_validator.current_subsegment = &subsegment;
+        }
+        pes_demux_process_ts_packet(ts, NULL, pd);
+        if (end->has_subsegment && subsegment.saw_random_access) {
+            g_atomic_int_set(&pid_parallel->saw_random_access[end->subsegment_index], 1);
+        }
+    }
+
+    if (!dash_validator.status) {
+        g_atomic_int_set(&pid_parallel->status, 0);
+    }
+    pes_demux_free(pd);
+    g_ptr_array_free(dash_validator.pids, true);
+
+    if (task->first_for_pid) {
+        g_mutex_lock(&pid_parallel->mutex);
+        index->first_task_done = true;
+        g_cond_broadcast(&pid_parallel->first_task_done);
+        g_mutex_unlock(&pid_parallel->mutex);
+    }
+}
+
+/* Adds what a later task found to its PID, as if the PID's PES packets had been validated in order. Call this on
+ * each PID's tasks in stream order. */
+void merge_pes_task(pes_task_t* task)
+{
+    if (task->first_for_pid) {
+        return;
+    }
+    pid_validator_t* pid_validator = task->index->pid_validator;
+    pid_validator->pes_count += task->pid_validator.pes_count - task->pes_count_before;
+    pid_validator->earliest_playout_time = MIN(pid_validator->earliest_playout_time,
+            task->pid_validator.earliest_playout_time);
+    pid_validator->latest_playout_time = MAX(pid_validator->latest_playout_time,
+            task->pid_validator.latest_playout_time);
+    if (task->pid_validator.duration != -1) {
+        pid_validator->duration = task->pid_validator.duration;
+    }
+    if (task->pid_validator.frame_index) {
+        frame_index_append(pid_validator->frame_index, task->pid_validator.frame_index);
+        frame_index_free(task->pid_validator.frame_index);
+    }
+}
+
+gpointer pid_parallel_thread(gpointer arg)
+{
+    pid_parallel_validator_t* pid_parallel = arg;
+    log_capture_t* log = log_capture_new();
+    log_capture_t* scratch = log_capture_new();
+    packet_block_t* block = g_slice_new0(packet_block_t);
+
+    gint i;
+    while ((i = g_atomic_int_add(&pid_parallel->next_index, 1)) < (gint)pid_parallel->schedule->len) {
+        validate_pes_task(pid_parallel, g_ptr_array_index(pid_parallel->schedule, i), block, log, scratch);
+    }
+    log_capture_set(NULL);
+    log_capture_free(scratch);
+    g_slice_free(packet_block_t, block);
+
+    g_mutex_lock(&pid_parallel->mutex);
+    g_ptr_array_add(pid_parallel->logs, log);
+    g_mutex_unlock(&pid_parallel->mutex);
+    return NULL;
+}
+
+/* Every PID's first task goes before any task that waits for one, so waiting can't deadlock. Otherwise biggest first,
+ * so one big task doesn't start last. */
+gint compare_pes_tasks(gconstpointer a, gconstpointer b)
+{
+    const pes_task_t* task_a = *(pes_task_t* const*)a;
+    const pes_task_t* task_b = *(pes_task_t* const*)b;
+    if (task_a->first_for_pid != task_b->first_for_pid) {
+        return task_a->first_for_pid ? -1 : 1;
+    }
+    size_t size_a = task_a->end_packet - task_a->first_packet;
+    size_t size_b = task_b->end_packet - task_b->first_packet;
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+/* Validates the PES packets from the first pass, then logs everything in order */
+void pid_parallel_validator_finish(pid_parallel_validator_t* pid_parallel, segment_reader_t* reader)
+{
+    dash_validator_t* dash_validator = pid_parallel->dash_validator;
+
+    pid_parallel->file = reader->file;
+    pid_parallel->start_offset = reader->start_offset;
+    pid_parallel->length = reader->offset - reader->start_offset;
+    pid_parallel->saw_random_access = g_new0(gint, dash_validator->subsegments->len);
+
+    for (size_t i = 0; i < pid_parallel->indexes->len; ++i) {
+        add_pes_tasks(pid_parallel, g_ptr_array_index(pid_parallel->indexes, i));
+    }
+    for (size_t i = 0; i < pid_parallel->tasks->len; ++i) {
+        g_ptr_array_add(pid_parallel->schedule, &g_array_index(pid_parallel->tasks, pes_task_t, i));
+    }
+    g_ptr_array_sort(pid_parallel->schedule, compare_pes_tasks);
+
+    unsigned num_threads = MIN(segment_validator_pid_threads, pid_parallel->schedule->len);
+    GThread** threads = g_new(GThread*, num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+        threads[i] = g_thread_new("pid-validator", pid_parallel_thread, pid_parallel);
+    }
+    for (unsigned i = 0; i < num_threads; ++i) {
+        g_thread_join(threads[i]);
+    }
+    g_free(threads);
+
+    for (size_t i = 0; i < pid_parallel->tasks->len; ++i) {
+        merge_pes_task(&g_array_index(pid_parallel->tasks, pes_task_t, i));
+    }
+    for (size_t i = 0; i < dash_validator->subsegments->len; ++i) {
+        if (pid_parallel->saw_random_access[i]) {
+            subsegment_t* subsegment = g_ptr_array_index(dash_validator->subsegments, i);
+            subsegment->saw_random_access = true;
+        }
+    }
+    for (size_t i = 0; i < pid_parallel->iframe_checks->len; ++i) {
+        iframe_check_t* check = &g_array_index(pid_parallel->iframe_checks, iframe_check_t, i);
+        pid_parallel->log->key = check->log_key;
+        check_subsegment_random_access(dash_validator, check->subsegment_index);
+    }
+    if (!pid_parallel->status) {
+        dash_validator->status = 0;
+    }
+
+    log_capture_set(NULL);
+    log_capture_replay((log_capture_t**)pid_parallel->logs->pdata, pid_parallel->logs->len);
+}
+
 #define TS_BUFFER_SIZE 4096 * TS_SIZE
 
 int validate_segment(dash_validator_t* dash_validator, char* file_name, uint64_t byte_range_start,
@@ -776,21 +1650,25 @@ int validate_segment(dash_validator_t* dash_validator, char* file_name, uint64_t
     dash_validator->current_subsegment = dash_validator->has_subsegments ?
             g_ptr_array_index(dash_validator->subsegments, 0) : NULL;
     mpeg2ts_stream_t* m2s = NULL;
+    continuity_checker_t* continuity = NULL;
+    pid_parallel_validator_t* pid_parallel = NULL;
 
-    FILE* infile = fopen(file_name, "rb");
-    if (infile == NULL) {
-        g_critical("Cannot open file %s - %s", file_name, strerror(errno));
+    segment_reader_t* reader = segment_reader_new(file_name, byte_range_start, byte_range_end);
+    if (reader == NULL) {
         goto fail;
     }
+    dash_validator->segment_version = reader->file->version;
 
-    if (byte_range_start > 0 && fseek(infile, byte_range_start, SEEK_SET)) {
-        g_critical("Error seeking to offset %ld in %s - %s", byte_range_start, file_name, strerror(errno));
-        goto fail;
+    if (segment_validator_pid_threads > 0 && segment_validator_keys == NULL) {
+        pid_parallel = pid_parallel_validator_new(dash_validator);
+        dash_validator->pid_parallel = pid_parallel;
+        log_capture_set(pid_parallel->log);
     }
 
     m2s = mpeg2ts_stream_new();
 
     dash_validator->last_pcr = PCR_INVALID;
+    t_std_reset(dash_validator->t_std);
     dash_validator->status = 1;
     if (dash_validator->pids->len != 0) {
         g_error("Re-using DASH validator pids!");
@@ -815,66 +1693,259 @@ int validate_segment(dash_validator_t* dash_validator, char* file_name, uint64_t
     m2s->ts_processor = ts_validator;
 
     // Read TS packets from initialization segment
-    for (gsize i = 0; dash_validator_init && i < dash_validator_init->initialization_segment_ts->len; ++i) {
-        ts_packet_t* ts = &g_array_index(dash_validator_init->initialization_segment_ts, ts_packet_t, i);
-        mpeg2ts_stream_read_ts_packet(m2s, ts);
-    }
-
-    long packet_buf_size = 4096;
-    uint64_t packets_read = 0;
-    long num_packets;
-    uint64_t packets_to_read =  UINT64_MAX;
-    uint8_t* ts_buf = malloc(TS_SIZE * packet_buf_size);
-
-    if (byte_range_end > 0) {
-        packets_to_read = (byte_range_end - byte_range_start) / (uint64_t)TS_SIZE;
-    }
-
-    while ((num_packets = fread(ts_buf, TS_SIZE, packet_buf_size, infile)) > 0) {
-        for (int i = 0; i < num_packets; i++) {
-            ts_packet_t ts;
-            if (!ts_read(&ts, ts_buf + i * TS_SIZE, TS_SIZE, packets_read)) {
-                g_critical("DASH Conformance: Error parsing TS packet %"PRIo64" in segment %s. %s",
-                        packets_read, file_name,
-                        dash_validator->segment_type == INITIALIZATION_SEGMENT ? "6.4.3.2 Initialization Segment: An "
-                        "Initialization Segment shall be a valid MPEG-2 TS, conforming to ISO/IEC 13818-1."
-                        : dash_validator->segment_type == BITSTREAM_SWITCHING_SEGMENT ? "6.4.5 Bitstream Switching "
-                        "Segment: A Bitstream Switching Segment shall be a valid MPEG-2 TS, conforming to ISO/IEC "
-                        "13818-1."
-                        : "6.4.4.2 Basic Media Segment: A Media Segment shall be a valid MPEG-2 TS, conforming to "
-                        "ISO/IEC 13818-1.");
-                goto fail;
-            }
-            if (dash_validator->segment_type == INITIALIZATION_SEGMENT) {
-                size_t new_i = dash_validator->initialization_segment_ts->len;
-                g_array_set_size(dash_validator->initialization_segment_ts, new_i + 1);
-                ts_copy(&g_array_index(dash_validator->initialization_segment_ts, ts_packet_t, new_i), &ts);
+    if (dash_validator_init) {
+        if (pid_parallel) {
+            pid_parallel->init_packets = dash_validator_init->initialization_segment_ts;
+        }
+        dash_validator->reading_init_segment = true;
+        mpeg2ts_stream_read_ts_packets(m2s, (ts_packet_t*)dash_validator_init->initialization_segment_ts->data,
+                dash_validator_init->initialization_segment_ts->len);
+        dash_validator->reading_init_segment = false;
+    }
+    /* PCRs are only compared within the segment */
+    pcr_analyzer_reset(dash_validator->pcr_analyzer);
+
+    continuity = continuity_checker_new();
+    size_t num_sync_gaps = 0;
+    ts_packet_t* packets;
+    size_t num_packets;
+    while ((packets = segment_reader_next(reader, &num_packets)) != NULL) {
+        report_sync_gaps(dash_validator, reader, &num_sync_gaps);
+        segment_block_t* block = reader->current;
+        size_t first_error = continuity->errors->len;
+        if (continuity_checker_check(continuity, block->headers, num_packets, block->offset)) {
+            for (size_t i = first_error; i < continuity->errors->len; ++i) {
+                continuity_error_t* error = &g_array_index(continuity->errors, continuity_error_t, i);
+                g_critical("DASH Conformance: Continuity counter error on PID %"PRIu16" at byte %"PRIu64" in segment "
+                        "%s. Expected continuity_counter = %"PRIu8", actual %"PRIu8". 2.4.3.3 of ISO/IEC 13818-1. %s",
+                        error->pid, error->offset, file_name, error->expected, error->actual,
+                        valid_ts_conformance(dash_validator->segment_type));
             }
-            mpeg2ts_stream_read_ts_packet(m2s, &ts);
-            packets_read++;
+            dash_validator->status = 0;
         }
 
-        if (packets_to_read - packets_read < packet_buf_size) {
-            packet_buf_size = packets_to_read - packets_read;
+        if (dash_validator->segment_type == INITIALIZATION_SEGMENT) {
+            g_array_append_vals(dash_validator->initialization_segment_ts, packets, num_packets);
         }
+        mpeg2ts_stream_read_ts_packets(m2s, packets, num_packets);
+    }
+    report_sync_gaps(dash_validator, reader, &num_sync_gaps);
+    if (reader->parse_error) {
+        g_critical("DASH Conformance: Error parsing TS packet %"PRIo64" in segment %s. %s",
+                reader->error_packet, file_name, valid_ts_conformance(dash_validator->segment_type));
+        goto fail;
+    }
+    if (reader->error) {
+        goto fail;
     }
-    free(ts_buf);
 
     // need to reset the mpeg stream to be sure to process the last PES packet
     mpeg2ts_stream_reset(m2s);
-    g_debug("%"PRIo64" TS packets read", packets_read);
+    g_debug("%"PRIo64" TS packets read", reader->packets_read);
+    t_std_flush(dash_validator->t_std);
+    report_t_std_errors(dash_validator);
+    check_pcrs(dash_validator, file_name);
 
 cleanup:
-    mpeg2ts_stream_free(m2s);
-    if (infile) {
-        fclose(infile);
+    t_std_reset(dash_validator->t_std);
+    if (pid_parallel) {
+        pid_parallel_validator_finish(pid_parallel, reader);
+        dash_validator->pid_parallel = NULL;
+        pid_parallel_validator_free(pid_parallel);
     }
+    mpeg2ts_stream_free(m2s);
+    continuity_checker_free(continuity);
+    segment_reader_free(reader);
     return dash_validator->status != 1;
 fail:
     dash_validator->status = 0;
     goto cleanup;
 }
 
+/* Big-endian, like the rest of the sidecar, so the key is the same on every host that reads it */
+crc_t crc_update_uint64s(crc_t crc, const uint64_t* values, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char bytes[8];
+        for (size_t j = 0; j < sizeof(bytes); ++j) {
+            bytes[j] = values[i] >> (56 - j * 8);
+        }
+        crc = crc_update(crc, bytes, sizeof(bytes));
+    }
+    return crc;
+}
+
+/* A CRC of everything besides the segment's own bytes that validate_segment()'s results depend on. Subsegment start
+ * times are left out, since they come from the MPD's timing and validate_segment_from_frame_index() checks them
+ * again. The segment's duration is only included if it has 'emsg' boxes, which are checked against it, so other
+ * segments can still be reused after the MPD's timing changes. */
+uint32_t frame_index_key(const dash_validator_t* dash_validator, const dash_validator_t* dash_validator_init,
+        bool has_emsg)
+{
+    const adaptation_set_t* adaptation_set = dash_validator->adaptation_set;
+    uint64_t values[] = {
+        dash_validator->segment_type,
+        dash_validator->profile,
+        adaptation_set->segment_alignment.has_int,
+        adaptation_set->segment_alignment.b,
+        adaptation_set->segment_alignment.i,
+        adaptation_set->subsegment_alignment.has_int,
+        adaptation_set->subsegment_alignment.b,
+        adaptation_set->subsegment_alignment.i,
+        adaptation_set->bitstream_switching,
+        segment_validator_keys != NULL,
+        dash_validator_init ? dash_validator_init->pat_fingerprint : 0,
+        dash_validator_init ? dash_validator_init->pmt_fingerprint : 0,
+        dash_validator_init ? dash_validator_init->cat_fingerprint : 0,
+        dash_validator_init ? dash_validator_init->initialization_segment_ts->len : 0,
+        dash_validator->has_subsegments ? dash_validator->subsegments->len : 0,
+        has_emsg ? dash_validator->segment->duration : 0
+    };
+    crc_t crc = crc_update_uint64s(crc_init(), values, G_N_ELEMENTS(values));
+    for (size_t i = 0; dash_validator->has_subsegments && i < dash_validator->subsegments->len; ++i) {
+        const subsegment_t* subsegment = g_ptr_array_index(dash_validator->subsegments, i);
+        uint64_t subsegment_values[] = {
+            subsegment->reference_id,
+            subsegment->start_byte,
+            subsegment->end_byte,
+            subsegment->starts_with_sap,
+            subsegment->sap_type,
+            subsegment->pcr,
+            subsegment->ssix_offsets->len
+        };
+        crc = crc_update_uint64s(crc, subsegment_values, G_N_ELEMENTS(subsegment_values));
+        crc = crc_update_uint64s(crc, (const uint64_t*)subsegment->ssix_offsets->data, subsegment->ssix_offsets->len);
+    }
+    return crc_finalize(crc);
+}
+
+bool dash_validator_write_frame_index(dash_validator_t* dash_validator, const char* file_name,
+        uint64_t byte_range_start, uint64_t byte_range_end, dash_validator_t* dash_validator_init, bool passed)
+{
+    g_return_val_if_fail(dash_validator, false);
+    g_return_val_if_fail(file_name, false);
+
+    static const file_version_t unopened = {0};
+    if (file_version_equal(&dash_validator->segment_version, &unopened)) {
+        return false;
+    }
+
+    frame_index_file_t* file = frame_index_file_new();
+    file->flags = (passed ? FRAME_INDEX_FILE_PASSED : 0)
+            | (dash_validator->is_encrypted ? FRAME_INDEX_FILE_ENCRYPTED : 0)
+            | (dash_validator->has_emsg ? FRAME_INDEX_FILE_HAS_EMSG : 0);
+    file->key = frame_index_key(dash_validator, dash_validator_init, dash_validator->has_emsg);
+    file->pat_fingerprint = dash_validator->pat_fingerprint;
+    file->pmt_fingerprint = dash_validator->pmt_fingerprint;
+    file->cat_fingerprint = dash_validator->cat_fingerprint;
+    for (size_t i = 0; i < dash_validator->splice_points->len; ++i) {
+        g_array_append_val(file->splice_points,
+                g_array_index(dash_validator->splice_points, splice_point_t, i).pts);
+    }
+    for (size_t i = 0; i < dash_validator->pids->len; ++i) {
+        pid_validator_t* pv = g_ptr_array_index(dash_validator->pids, i);
+        if (pv->frame_index == NULL) {
+            continue;
+        }
+        frame_index_t* index = pv->frame_index;
+        index->content_component = pv->content_component;
+        index->sap = pv->sap;
+        index->sap_type = pv->sap_type;
+        index->earliest_playout_time = pv->earliest_playout_time;
+        index->latest_playout_time = pv->latest_playout_time;
+        index->duration = pv->duration;
+        g_ptr_array_add(file->indexes, index);
+        pv->frame_index = NULL;
+    }
+
+    gchar* index_file_name = frame_index_file_name(file_name, byte_range_start, byte_range_end);
+    bool written = frame_index_file_write(file, index_file_name, file_name, &dash_validator->segment_version,
+            byte_range_start, byte_range_end);
+    if (written) {
+        g_debug("Wrote frame index %s", index_file_name);
+    }
+    g_free(index_file_name);
+    frame_index_file_free(file);
+    return written;
+}
+
+bool validate_segment_from_frame_index(dash_validator_t* dash_validator, const char* file_name,
+        uint64_t byte_range_start, uint64_t byte_range_end, dash_validator_t* dash_validator_init)
+{
+    g_return_val_if_fail(dash_validator, false);
+    g_return_val_if_fail(file_name, false);
+
+    bool used = false;
+    gchar* index_file_name = frame_index_file_name(file_name, byte_range_start, byte_range_end);
+    frame_index_file_t* file = frame_index_file_read(index_file_name, file_name, byte_range_start, byte_range_end);
+    if (file == NULL) {
+        goto cleanup;
+    }
+    if (!(file->flags & FRAME_INDEX_FILE_PASSED)) {
+        g_debug("Validating %s again, since it failed when %s was written", file_name, index_file_name);
+        goto cleanup;
+    }
+    if (file->key != frame_index_key(dash_validator, dash_validator_init, file->flags & FRAME_INDEX_FILE_HAS_EMSG)) {
+        g_debug("Validating %s again, since its initialization segment, index or MPD attributes changed after %s was "
+                "written", file_name, index_file_name);
+        goto cleanup;
+    }
+    if (dash_validator->pids->len != 0) {
+        g_error("Re-using DASH validator pids!");
+        goto cleanup;
+    }
+
+    dash_validator->status = 1;
+    dash_validator->is_encrypted = file->flags & FRAME_INDEX_FILE_ENCRYPTED;
+    dash_validator->has_emsg = file->flags & FRAME_INDEX_FILE_HAS_EMSG;
+    dash_validator->pat_fingerprint = file->pat_fingerprint;
+    dash_validator->pmt_fingerprint = file->pmt_fingerprint;
+    dash_validator->cat_fingerprint = file->cat_fingerprint;
+    for (size_t i = 0; i < file->splice_points->len; ++i) {
+        splice_point_t splice_point = { .pts = g_array_index(file->splice_points, uint64_t, i) };
+        g_array_append_val(dash_validator->splice_points, splice_point);
+    }
+    for (size_t i = 0; i < file->indexes->len; ++i) {
+        frame_index_t* index = g_ptr_array_index(file->indexes, i);
+        pid_validator_t* pv = pid_validator_new(index->pid, index->content_component);
+        pv->sap = index->sap;
+        pv->sap_type = index->sap_type;
+        pv->earliest_playout_time = index->earliest_playout_time;
+        pv->latest_playout_time = index->latest_playout_time;
+        pv->duration = index->duration;
+        pv->pes_count = index->frames->len;
+        g_ptr_array_add(dash_validator->pids, pv);
+
+        /* Subsegment start times are the only part of validate_pes_packet()'s checks that can change without the
+         * segment or its index changing */
+        if (!dash_validator->has_subsegments || pv->content_component != VIDEO_CONTENT_COMPONENT) {
+            continue;
+        }
+        size_t s = 0;
+        for (size_t j = 0; j < index->frames->len; ++j) {
+            frame_t* frame = &g_array_index(index->frames, frame_t, j);
+            while (s < dash_validator->subsegments->len
+                    && frame->offset >= ((subsegment_t*)g_ptr_array_index(dash_validator->subsegments, s))->end_byte) {
+                ++s;
+            }
+            if (s == dash_validator->subsegments->len) {
+                break;
+            }
+            subsegment_t* subsegment = g_ptr_array_index(dash_validator->subsegments, s);
+            if ((frame->flags & FRAME_RANDOM_ACCESS) && frame->offset >= subsegment->start_byte) {
+                check_subsegment_start_time(dash_validator, subsegment, frame->pts);
+            }
+        }
+    }
+    g_debug("Using %s instead of validating %s again", index_file_name, file_name);
+    used = true;
+
+cleanup:
+    frame_index_file_free(file);
+    g_free(index_file_name);
+    return used;
+}
+
 bool validate_bitstream_switching(const char* file_names[], uint64_t byte_starts[], uint64_t byte_ends[], size_t len)
 {
     g_return_val_if_fail(file_names, false);
@@ -946,7 +2017,8 @@ int analyze_sidx_references(sidx_t* sidx, int* pnum_subsegments, int* pnum_neste
     int originalnum_subsegments = *pnum_subsegments;
 
     for(int i = 0; i < sidx->reference_count; i++) {
-        sidx_reference_t ref = sidx->references[i];
+        sidx_reference_t ref;
+        sidx_get_reference(sidx, i, &ref);
         if (ref.reference_type == 1) {
             (*pnum_nested_sidx)++;
         } else {
@@ -982,8 +2054,8 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
     } else {
         segments = representation->segments;
     }
-    size_t num_boxes = 0;
-    box_t** boxes = NULL;
+    box_iterator_t* it = NULL;
+    GPtrArray* subsegments = NULL;
     index_segment_validator_t* validator = index_segment_validator_new();
 
     if (representation->segments->len == 0) {
@@ -991,140 +2063,168 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
         goto fail;
     }
 
-    int error = 0;
-    boxes = read_boxes_from_file(file_name, &num_boxes, &error);
-    if (error) {
-        goto fail;
-    }
-    print_boxes(boxes, num_boxes);
-
-    if (num_boxes == 0) {
-        g_critical("ERROR validating Index Segment %s: no boxes in segment.", file_name);
+    /* Only read the index range (if there is one), since it may point into a much larger media file */
+    uint64_t range_start = is_single_index ? segment_in->index_range_start : representation->index_range_start;
+    uint64_t range_end = is_single_index ? segment_in->index_range_end : representation->index_range_end;
+    it = box_iterator_new(file_name, range_start, range_end);
+    if (it == NULL) {
         goto fail;
     }
 
+    /* Boxes are validated in a single pass, decoding them in place as we go. The master 'sidx' is kept as a view
+     * into the iterator's buffer so its references can be checked against each segment's boxes. */
+    enum {
+        INDEX_STAGE_STYP,
+        INDEX_STAGE_MASTER_SIDX,
+        INDEX_STAGE_SEGMENTS
+    } stage = INDEX_STAGE_STYP;
     size_t box_index = 0;
-
+    size_t sidx_start = 0;
     bool found_ssss = false;
-    if (boxes[box_index]->type != BOX_TYPE_STYP) {
-        g_critical("DASH Conformance: First box in index segment %sis not an 'styp'. %s", file_name,
-                is_single_index ? "6.4.6.2 Single Index Segment: Each Single Index Segment shall begin with a ‘styp’ "
-                "box" : "6.4.6.3 Representation Index Segment: Each Representation Index Segment shall begin with an "
-                "‘styp’ box");
-        validator->error = true;
-    } else {
-        styp_t* styp = (styp_t*)boxes[box_index];
-        bool found_brand = false;
-        uint32_t expected_brand = is_single_index ? BRAND_SISX : BRAND_RISX;
-        for(size_t i = 0; i < styp->num_compatible_brands; ++i) {
-            uint32_t brand = styp->compatible_brands[i];
-            if (brand == expected_brand) {
-                found_brand = true;
-            } else if (brand == BRAND_SSSS) {
-                found_ssss = true;
+    sidx_t master_sidx_view;
+    sidx_t* master_sidx = NULL;
+    uint32_t master_reference_id = 0;
+
+    size_t segment_index = 0;
+    bool ssix_present = false;
+    bool pcrb_present = false;
+    bool saw_sidx = false;
+    bool subsegments_valid = true;
+    int num_nested_sidx = 0;
+    int num_subsegments = 0;
+    uint64_t referenced_size = 0;
+    uint64_t next_subsegment_byte_location = 0;
+    uint64_t last_subsegment_start_time = representation->presentation_time_offset;
+    uint64_t last_subsegment_duration = 0;
+
+    int error = 0;
+    box_view_t box;
+    for (; box_iterator_next_view(it, &box, &error); ++box_index) {
+        print_box_view(&box);
+
+        sidx_t sidx;
+        if (box.type == BOX_TYPE_SIDX) {
+            if (!read_sidx_view(&box, &sidx)) {
+                goto fail;
             }
-        }
-        if (!found_brand) {
-            g_critical("DASH Conformance: 'styp' box in index segment %s does not contain %s as a compatible brand. "
-                    "%s", file_name, is_single_index ? "sisx" : "risx",
-                    is_single_index ? "6.4.6.2 Single Index Segment: Each Single Index Segment shall begin with a "
-                    "‘styp’ box, and the brand ‘sisx’ shall be present in the ‘styp’ box." : "6.4.6.3 Representation "
-                    "Index Segment: Each Representation Index Segment shall begin with an ‘styp’ box, and the brand "
-                    "‘risx’ shall be present in the ‘styp’ box.");
-            g_info("Brands found are:");
-            g_info("styp major brand = %x", styp->major_brand);
-            for (size_t i = 0; i < styp->num_compatible_brands; ++i) {
-                char brand_str[5] = {0};
-                uint32_to_string(brand_str, styp->compatible_brands[i]);
-                g_info("styp compatible brand = %s", brand_str);
+            if (sidx.timescale != representation->timescale) {
+                g_critical("DASH Conformance: 'sidx' in box %zu of %s has timescale %"PRIu32", but "
+                        "SegmentBase@timescale is %"PRIu32". 5.3.9.6 Segment timeline: the value of @timescale shall "
+                        "be identical to the value of the timescale field in the first 'sidx' box",
+                        box_index, file_name, sidx.timescale, representation->timescale);
+                validator->error = true;
             }
-            validator->error = true;
         }
-        ++box_index;
-    }
 
-    for (size_t i = 0; i < num_boxes; ++i) {
-        if (boxes[i]->type != BOX_TYPE_SIDX) {
-            continue;
-        }
-        sidx_t* sidx = (sidx_t*)boxes[i];
-        if (sidx->timescale != representation->timescale) {
-            g_critical("DASH Conformance: 'sidx' in box %zu of %s has timescale %"PRIu32", but SegmentBase@timescale "
-                    "is %"PRIu32". 5.3.9.6 Segment timeline: the value of @timescale shall be identical to the value "
-                    "of the timescale field in the first 'sidx' box",
-                    i, file_name, sidx->timescale, representation->timescale);
-            validator->error = true;
+        if (stage == INDEX_STAGE_STYP) {
+            stage = is_single_index ? INDEX_STAGE_SEGMENTS : INDEX_STAGE_MASTER_SIDX;
+            if (box.type != BOX_TYPE_STYP) {
+                g_critical("DASH Conformance: First box in index segment %sis not an 'styp'. %s", file_name,
+                        is_single_index ? "6.4.6.2 Single Index Segment: Each Single Index Segment shall begin with a "
+                        "‘styp’ box" : "6.4.6.3 Representation Index Segment: Each Representation Index Segment shall "
+                        "begin with an ‘styp’ box");
+                validator->error = true;
+            } else {
+                int styp_error = 0;
+                styp_t* styp = (styp_t*)read_box_from_view(&box, &styp_error);
+                if (styp_error) {
+                    goto fail;
+                }
+                bool found_brand = false;
+                uint32_t expected_brand = is_single_index ? BRAND_SISX : BRAND_RISX;
+                for(size_t i = 0; i < styp->num_compatible_brands; ++i) {
+                    uint32_t brand = styp->compatible_brands[i];
+                    if (brand == expected_brand) {
+                        found_brand = true;
+                    } else if (brand == BRAND_SSSS) {
+                        found_ssss = true;
+                    }
+                }
+                if (!found_brand) {
+                    g_critical("DASH Conformance: 'styp' box in index segment %s does not contain %s as a compatible "
+                            "brand. %s", file_name, is_single_index ? "sisx" : "risx",
+                            is_single_index ? "6.4.6.2 Single Index Segment: Each Single Index Segment shall begin "
+                            "with a ‘styp’ box, and the brand ‘sisx’ shall be present in the ‘styp’ box." : "6.4.6.3 "
+                            "Representation Index Segment: Each Representation Index Segment shall begin with an "
+                            "‘styp’ box, and the brand ‘risx’ shall be present in the ‘styp’ box.");
+                    g_info("Brands found are:");
+                    g_info("styp major brand = %x", styp->major_brand);
+                    for (size_t i = 0; i < styp->num_compatible_brands; ++i) {
+                        char brand_str[5] = {0};
+                        uint32_to_string(brand_str, styp->compatible_brands[i]);
+                        g_info("styp compatible brand = %s", brand_str);
+                    }
+                    validator->error = true;
+                }
+                free_box((box_t*)styp);
+                sidx_start = box_index + 1;
+                continue;
+            }
         }
-    }
 
-    sidx_t* master_sidx = NULL;
-    uint32_t master_reference_id = 0;
-    if (!is_single_index) {
-        box_t* box = boxes[box_index];
-        if (box->type != BOX_TYPE_SIDX) {
-            char type_str[5] = {0};
-            uint32_to_string(type_str, box->type);
-            /* Is this strictly required? Couldn't there be other boxes that come first, and long as they're not
-             * 'ssix' or 'pcrb'? */
-            g_critical("DASH Conformance: Representation Index Segment %s has box type '%s' following styp, but "
-                    "should have an 'sidx'. 6.4.6.3 Representation Index Segment: The Segment Index for each Media "
-                    "Segments is concatenated in order, preceded by a single Segment Index box that indexes the "
-                    "Index Segment.", file_name, type_str);
-            validator->error = true;
-        } else {
-            // walk all references: they should all be of type 1 and should point to sidx boxes
-            master_sidx = (sidx_t*)boxes[box_index];
-            master_reference_id = master_sidx->reference_id;
-            if (master_reference_id != adaptation_set->video_pid) {
-                g_critical("ERROR validating Representation Index Segment: master ref ID does not equal video PID. "
-                        "Expected %d, actual %d.", adaptation_set->video_pid, master_reference_id);
+        if (stage == INDEX_STAGE_MASTER_SIDX) {
+            stage = INDEX_STAGE_SEGMENTS;
+            if (box.type != BOX_TYPE_SIDX) {
+                char type_str[5] = {0};
+                uint32_to_string(type_str, box.type);
+                /* Is this strictly required? Couldn't there be other boxes that come first, and long as they're not
+                 * 'ssix' or 'pcrb'? */
+                g_critical("DASH Conformance: Representation Index Segment %s has box type '%s' following styp, but "
+                        "should have an 'sidx'. 6.4.6.3 Representation Index Segment: The Segment Index for each "
+                        "Media Segments is concatenated in order, preceded by a single Segment Index box that indexes "
+                        "the Index Segment.", file_name, type_str);
                 validator->error = true;
-            }
-            for (size_t i = 0; i < master_sidx->reference_count; i++) {
-                sidx_reference_t ref = master_sidx->references[i];
-                if (ref.reference_type != 1) {
-                    g_critical("DASH Conformance: In Representation Index Segment %s, found reference_type != 1 in "
-                            "first 'sidx'. The first 'sidx' should index the representation index itself. 6.4.6.3 "
-                            "Representation Index Segment: The Segment Index for each Media Segments is concatenated "
-                            "in order, preceded by a single Segment Index box that indexes the Index Segment. This "
-                            "initial Segment Index box shall have one entry in its loop for each Media Segment, and "
-                            "each entry refers to the Segment Index information for a single Media Segment.",
-                            file_name);
+            } else {
+                // walk all references: they should all be of type 1 and should point to sidx boxes
+                master_sidx_view = sidx;
+                master_sidx = &master_sidx_view;
+                master_reference_id = master_sidx->reference_id;
+                if (master_reference_id != adaptation_set->video_pid) {
+                    g_critical("ERROR validating Representation Index Segment: master ref ID does not equal video "
+                            "PID. Expected %d, actual %d.", adaptation_set->video_pid, master_reference_id);
                     validator->error = true;
-                    /* Check this box as a normal sidx instead */
-                    --box_index;
-                    break;
                 }
-
-                // validate duration
-                if (i < segments->len) {
-                    segment_t* segment = g_ptr_array_index(representation->segments, i);
-                    if (segment->duration != ref.subsegment_duration) {
-                        /* Is this a valid test? What if we have more than one sidx per segment? If this is valid,
-                         * shouldn't we have an error for when there are too many references? */
-                        g_critical("ERROR validating Representation Index Segment: master ref segment duration does not equal "
-                                "segment duration.  Expected %"PRIu64", actual %d.", segment->duration, ref.subsegment_duration);
+                bool is_master_sidx = true;
+                for (size_t i = 0; i < master_sidx->reference_count; i++) {
+                    sidx_reference_t ref;
+                    sidx_get_reference(master_sidx, i, &ref);
+                    if (ref.reference_type != 1) {
+                        g_critical("DASH Conformance: In Representation Index Segment %s, found reference_type != 1 "
+                                "in first 'sidx'. The first 'sidx' should index the representation index itself. "
+                                "6.4.6.3 Representation Index Segment: The Segment Index for each Media Segments is "
+                                "concatenated in order, preceded by a single Segment Index box that indexes the Index "
+                                "Segment. This initial Segment Index box shall have one entry in its loop for each "
+                                "Media Segment, and each entry refers to the Segment Index information for a single "
+                                "Media Segment.", file_name);
                         validator->error = true;
+                        /* Check this box as a normal sidx instead */
+                        is_master_sidx = false;
+                        break;
+                    }
+
+                    // validate duration
+                    if (i < segments->len) {
+                        segment_t* segment = g_ptr_array_index(representation->segments, i);
+                        if (segment->duration != ref.subsegment_duration) {
+                            /* Is this a valid test? What if we have more than one sidx per segment? If this is
+                             * valid, shouldn't we have an error for when there are too many references? */
+                            g_critical("ERROR validating Representation Index Segment: master ref segment duration "
+                                    "does not equal segment duration.  Expected %"PRIu64", actual %d.",
+                                    segment->duration, ref.subsegment_duration);
+                            validator->error = true;
+                        }
                     }
                 }
+                if (is_master_sidx) {
+                    sidx_start = box_index + 1;
+                    continue;
+                }
             }
-            box_index++;
         }
-    }
 
-    size_t sidx_start = box_index;
-    size_t segment_index = 0;
-    bool ssix_present = false;
-    bool pcrb_present = false;
-    int num_nested_sidx = 0;
-    int num_subsegments = 0;
-    uint64_t referenced_size = 0;
-
-    // now walk all the boxes, validating that the number of sidx boxes is correct and doing a few other checks
-    sidx_t* current_sidx = NULL;
-    for (box_index = sidx_start; box_index < num_boxes; ++box_index) {
-        box_t* box = boxes[box_index];
-        switch(box->type) {
+        // now walk the rest of the boxes, validating that the number of sidx boxes is correct, doing a few other
+        // checks and filling in subsegment locations
+        switch(box.type) {
         case BOX_TYPE_SIDX: {
             if (box_index != sidx_start && !ssix_present && representation->subrepresentations->len > 0) {
                 g_critical("DASH Conformance: Segment index is missing a 'ssix' box for segment %zu, but there is a "
@@ -1135,20 +2235,24 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
             }
             ssix_present = false;
             pcrb_present = false;
+            saw_sidx = true;
 
-            sidx_t* sidx = (sidx_t*)box;
-            current_sidx = sidx;
             if (num_nested_sidx > 0) {
                 num_nested_sidx--;
+                next_subsegment_byte_location += sidx.first_offset;  // convert from 64-bit t0 32 bit
                 // GORP: check earliest presentation time
             } else {
                 // check size:
                 g_debug("Validating referenced_size for segment %zu.", segment_index);
-                if (segment_index > 1 && referenced_size != master_sidx->references[segment_index - 1].referenced_size) {
-                    g_critical("ERROR validating Representation Index Segment: referenced_size for segment %zu. "
-                            "Expected %"PRIu32", actual %"PRIu64"\n", segment_index,
-                            master_sidx->references[segment_index - 1].referenced_size, referenced_size);
-                    validator->error = true;
+                if (master_sidx && segment_index > 1 && segment_index - 1 < master_sidx->reference_count) {
+                    sidx_reference_t ref;
+                    sidx_get_reference(master_sidx, segment_index - 1, &ref);
+                    if (referenced_size != ref.referenced_size) {
+                        g_critical("ERROR validating Representation Index Segment: referenced_size for segment %zu. "
+                                "Expected %"PRIu32", actual %"PRIu64"\n", segment_index, ref.referenced_size,
+                                referenced_size);
+                        validator->error = true;
+                    }
                 }
 
                 referenced_size = 0;
@@ -1160,31 +2264,63 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
                 segment_index++;
 
                 g_debug("Validating earliest_presentation_time for segment %zu.", segment_index);
-                if (segment->start != sidx->earliest_presentation_time) {
+                if (segment->start != sidx.earliest_presentation_time) {
                     g_critical("ERROR validating Representation Index Segment: invalid earliest_presentation_time in "
                             "sidx box. Expected %"PRId64", actual %"PRId64".", segment->start,
-                            sidx->earliest_presentation_time);
+                            sidx.earliest_presentation_time);
                     validator->error = true;
                 }
+
+                if (subsegments) {
+                    g_ptr_array_add(validator->segment_subsegments, subsegments);
+                }
+                subsegments = g_ptr_array_new();
+                last_subsegment_start_time = segment->start;
+                last_subsegment_duration = 0;
+                next_subsegment_byte_location = sidx.first_offset;
             }
-            referenced_size += sidx->size;
+            referenced_size += sidx.size;
 
             g_debug("Validating reference_id");
-            if (!is_single_index && master_reference_id != sidx->reference_id) {
+            if (!is_single_index && master_reference_id != sidx.reference_id) {
                 g_critical("ERROR validating Representation Index Segment: invalid reference id in sidx box. "
-                        "Expected %d, actual %d.", master_reference_id, sidx->reference_id);
+                        "Expected %d, actual %d.", master_reference_id, sidx.reference_id);
                 validator->error = true;
             }
 
             // count number of subsegments and number of sidx boxes in reference list of this sidx
-            if (analyze_sidx_references(sidx, &num_subsegments, &num_nested_sidx, representation->profile) != 0) {
+            if (analyze_sidx_references(&sidx, &num_subsegments, &num_nested_sidx, representation->profile) != 0) {
                 validator->error = true;
             }
+
+            // fill in subsegment locations here
+            for (size_t i = 0; i < sidx.reference_count; i++) {
+                sidx_reference_t ref;
+                sidx_get_reference(&sidx, i, &ref);
+                if (ref.reference_type != 0) {
+                    continue;
+                }
+                subsegment_t* subsegment = subsegment_new();
+                subsegment->reference_id = sidx.reference_id;
+                subsegment->starts_with_sap = ref.starts_with_sap;
+                subsegment->sap_type = ref.sap_type;
+                subsegment->start_byte = next_subsegment_byte_location;
+                subsegment->end_byte = subsegment->start_byte + ref.referenced_size;
+                subsegment->start_time = last_subsegment_start_time + last_subsegment_duration + ref.sap_delta_time;
+                g_ptr_array_add(subsegments, subsegment);
+
+                last_subsegment_start_time = subsegment->start_time;
+                last_subsegment_duration = ref.subsegment_duration;
+                next_subsegment_byte_location += ref.referenced_size;
+            }
             break;
         }
         case BOX_TYPE_SSIX: {
-            ssix_t* ssix = (ssix_t*)box;
-            referenced_size += ssix->size;
+            ssix_t ssix;
+            if (!read_ssix_view(&box, &ssix)) {
+                goto fail;
+            }
+            referenced_size += ssix.size;
             g_debug("Validating ssix box");
             if (ssix_present) {
                 g_critical("ERROR validating Index Segment: More than one ssix box following sidx box.");
@@ -1202,12 +2338,14 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
                 g_critical("ERROR validating Index Segment: Saw ssix box, but 'ssss' is not in compatible brands. See 6.4.6.4.");
                 validator->error = true;
             }
-            if (current_sidx == NULL) {
+            if (!saw_sidx) {
                 g_critical("DASH Conformance: In Index Segment %s, saw an 'ssix' before the first 'sidx'. 6.4.6.4 "
                         "Subsegment Index Segment: The Subsegment Index box ('ssix') shall be present and shall "
                         "follow immediately after the 'sidx' box that documents the same Subsegment.", file_name);
                 validator->error = true;
             }
+            ssix_cursor_t cursor;
+            ssix_subsegment_range_t range;
             for (size_t sr = 0; sr < representation->subrepresentations->len; ++sr) {
                 subrepresentation_t* subrepresentation = g_ptr_array_index(representation->subrepresentations, sr);
                 /* This loop is messy, going over by 1 and then using that overflow to insert subrepresentation->level.
@@ -1216,11 +2354,10 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
                     uint32_t level = (l == subrepresentation->dependency_level->len) ? subrepresentation->level : \
                         g_array_index(subrepresentation->dependency_level, uint32_t, l);
                     bool found = false;
-                    for (uint32_t ss = 0; ss < ssix->subsegment_count && !found; ++ss) {
-                        ssix_subsegment_t* subsegment = &ssix->subsegments[ss];
-                        for (uint32_t r = 0; r < subsegment->ranges_count && !found; ++r) {
-                            ssix_subsegment_range_t* range = &subsegment->ranges[r];
-                            if (range->level == level) {
+                    ssix_cursor_init(&cursor, &ssix);
+                    while (!found && ssix_cursor_next_subsegment(&cursor, NULL)) {
+                        while (!found && ssix_cursor_next_range(&cursor, &range)) {
+                            if (range.level == level) {
                                 found = true;
                             }
                         }
@@ -1237,25 +2374,76 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
                     }
                 }
             }
+
+            if (!subsegments_valid) {
+                break;
+            }
+            if (subsegments == NULL || ssix.subsegment_count != subsegments->len) {
+                g_critical("Error: 'ssix' has %"PRIu32" subsegments, but the proceeding 'sidx' box has %u. 8.16.4.3 "
+                        "of ISO/IEC 14496-12 says: subsegment_count shall be equal to reference_count (i.e., the "
+                        "number of movie fragment references) in the immediately preceding Segment Index box.",
+                        ssix.subsegment_count, subsegments ? subsegments->len : 0);
+                subsegments_valid = false;
+                validator->error = true;
+                break;
+            }
+            ssix_cursor_init(&cursor, &ssix);
+            for (uint32_t i = 0; ssix_cursor_next_subsegment(&cursor, NULL); ++i) {
+                subsegment_t* subsegment = g_ptr_array_index(subsegments, i);
+                uint64_t byte_offset = subsegment->start_byte;
+                while (ssix_cursor_next_range(&cursor, &range)) {
+                    g_array_append_val(subsegment->ssix_offsets, byte_offset);
+                    byte_offset += range.range_size;
+                }
+            }
             break;
         }
         case BOX_TYPE_PCRB: {
-            pcrb_t* pcrb = (pcrb_t*)box;
-            referenced_size += pcrb->size;
+            pcrb_t pcrb;
+            if (!read_pcrb_view(&box, &pcrb)) {
+                goto fail;
+            }
+            referenced_size += pcrb.size;
             g_info("Validating pcrb box");
             if (pcrb_present) {
                 g_critical("ERROR validating Index Segment: More than one pcrb box following sidx box.");
                 validator->error = true;
-            } else {
-                pcrb_present = true;
+                break;
+            }
+            pcrb_present = true;
+
+            if (!subsegments_valid) {
+                break;
+            }
+            if (subsegments == NULL || pcrb.subsegment_count != subsegments->len) {
+                g_critical("Error: 'pcrb' has %"PRIu32" subsegments, but the proceeding 'sidx' box has %u. 6.4.7.2 "
+                        "of ISO/IEC 23009-1 says: subsegment_count shall be equal to reference_count in the "
+                        "immediately preceding Segment Index box.",
+                        pcrb.subsegment_count, subsegments ? subsegments->len : 0);
+                validator->error = true;
+                break;
+            }
+            /* Checked against the PCRs once the media segment has been read */
+            for (uint32_t i = 0; i < pcrb.subsegment_count; ++i) {
+                subsegment_t* subsegment = g_ptr_array_index(subsegments, i);
+                subsegment->pcr = pcrb_get_pcr(&pcrb, i);
             }
             break;
         }
         default:
-            g_warning("Invalid box type in Index Segment %s: %x.", file_name, box->type);
+            g_warning("Invalid box type in Index Segment %s: %x.", file_name, box.type);
             break;
         }
     }
+    if (error) {
+        goto fail;
+    }
+
+    if (box_index == 0) {
+        g_critical("ERROR validating Index Segment %s: no boxes in segment.", file_name);
+        goto fail;
+    }
+
     if (!ssix_present && representation->subrepresentations->len > 0) {
         g_critical("DASH Conformance: Segment index is missing a 'ssix' box for segment %zu, but there is a "
                 "SubRepresentation present. 7.4.4 Sub-Representations: The Subsegment Index box shall contain "
@@ -1265,11 +2453,14 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
     }
 
     // check the last reference size -- the last one is not checked in the above loop
-    if (master_sidx && segment_index > 0 && referenced_size != master_sidx->references[segment_index - 1].referenced_size) {
-        g_critical("ERROR validating Representation Index Segment: referenced_size for reference %zu. Expected "
-                "%"PRIu32", actual %"PRIu64".", segment_index,
-                master_sidx->references[segment_index - 1].referenced_size, referenced_size);
-        validator->error = true;
+    if (master_sidx && segment_index > 0 && segment_index - 1 < master_sidx->reference_count) {
+        sidx_reference_t ref;
+        sidx_get_reference(master_sidx, segment_index - 1, &ref);
+        if (referenced_size != ref.referenced_size) {
+            g_critical("ERROR validating Representation Index Segment: referenced_size for reference %zu. Expected "
+                    "%"PRIu32", actual %"PRIu64".", segment_index, ref.referenced_size, referenced_size);
+            validator->error = true;
+        }
     }
 
     if (num_nested_sidx != 0) {
@@ -1286,92 +2477,29 @@ index_segment_validator_t* validate_index_segment(char* file_name, segment_t* se
         goto fail;
     }
 
-    // fill in subsegment locations by walking the list of sidx's again, starting from the third box
-    num_nested_sidx = 0;
-    segment_index = 0;
-    uint64_t next_subsegment_byte_location = 0;
-    uint64_t last_subsegment_start_time = representation->presentation_time_offset;
-    uint64_t last_subsegment_duration = 0;
-    GPtrArray* subsegments = NULL;
-    for (box_index = sidx_start; box_index < num_boxes; ++box_index) {
-        box_t* box = boxes[box_index];
-        switch (box->type) {
-        case BOX_TYPE_SIDX: {
-            sidx_t* sidx = (sidx_t*)box;
-
-            if (num_nested_sidx > 0) {
-                num_nested_sidx--;
-                next_subsegment_byte_location += sidx->first_offset;  // convert from 64-bit t0 32 bit
-            } else {
-                segment_t* segment = g_ptr_array_index(segments, segment_index);
-                if (subsegments) {
-                    g_ptr_array_add(validator->segment_subsegments, subsegments);
-                }
-                subsegments = g_ptr_array_new();
-                last_subsegment_start_time = segment->start;
-                last_subsegment_duration = 0;
-                segment_index++;
-
-                next_subsegment_byte_location = sidx->first_offset;
-            }
-
-            // fill in subsegment locations here
-            for (size_t i = 0; i < sidx->reference_count; i++) {
-                sidx_reference_t ref = sidx->references[i];
-                if (ref.reference_type == 0) {
-                    subsegment_t* subsegment = subsegment_new();
-                    subsegment->reference_id = sidx->reference_id;
-                    subsegment->starts_with_sap = ref.starts_with_sap;
-                    subsegment->sap_type = ref.sap_type;
-                    subsegment->start_byte = next_subsegment_byte_location;
-                    subsegment->end_byte = subsegment->start_byte + ref.referenced_size;
-                    subsegment->start_time = last_subsegment_start_time + last_subsegment_duration + ref.sap_delta_time;
-                    g_ptr_array_add(subsegments, subsegment);
-
-                    last_subsegment_start_time = subsegment->start_time;
-                    last_subsegment_duration = ref.subsegment_duration;
-                    next_subsegment_byte_location += ref.referenced_size;
-                } else {
-                    num_nested_sidx++;
-                }
-            }
-            break;
-        }
-        case BOX_TYPE_SSIX: {
-            ssix_t* ssix = (ssix_t*)box;
-            if (ssix->subsegment_count != subsegments->len) {
-                g_critical("Error: 'ssix' has %"PRIu32" subsegments, but the proceeding 'sidx' box has %u. 8.16.4.3 "
-                        "of ISO/IEC 14496-12 says: subsegment_count shall be equal to reference_count (i.e., the "
-                        "number of movie fragment references) in the immediately preceding Segment Index box.",
-                        ssix->subsegment_count, subsegments->len);
-                goto fail;
-            }
-            for (uint32_t i = 0; i < ssix->subsegment_count; ++i) {
-                ssix_subsegment_t* s = &ssix->subsegments[i];
-                subsegment_t* subsegment = g_ptr_array_index(subsegments, i);
-                uint64_t byte_offset = subsegment->start_byte;
-                for (uint32_t j = 0; j < s->ranges_count; ++j) {
-                    ssix_subsegment_range_t* range = &s->ranges[j];
-                    g_array_append_val(subsegment->ssix_offsets, byte_offset);
-                    byte_offset += range->range_size;
-                }
-            }
-            break;
-        }
-        }
+    if (!subsegments_valid) {
+        goto fail;
     }
+
     if (subsegments) {
         g_ptr_array_add(validator->segment_subsegments, subsegments);
+        subsegments = NULL;
     }
 
 cleanup:
-    free_boxes(boxes, num_boxes);
+    subsegments_free(subsegments);
+    box_iterator_free(it);
     if (is_single_index) {
         g_ptr_array_free(segments, true);
     }
     return validator;
 fail:
     validator->error = true;
+    /* Callers expect either no subsegments or one list per segment */
+    for (size_t i = 0; i < validator->segment_subsegments->len; ++i) {
+        subsegments_free(g_ptr_array_index(validator->segment_subsegments, i));
+    }
+    g_ptr_array_set_size(validator->segment_subsegments, 0);
     goto cleanup;
 }
 
@@ -32,12 +32,16 @@
 #include <glib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include "cets_decrypt.h"
+#include "frame_index.h"
 #include "isobmff.h"
 #include "log.h"
 #include "mpd.h"
 #include "mpeg2ts_demux.h"
+#include "pcr_analyzer.h"
 #include "pes.h"
 #include "psi.h"
+#include "t_std.h"
 #include "ts.h"
 
 
@@ -55,6 +59,21 @@ typedef enum {
 
 #define TRANSPORT_SCRAMBLING_CONTROL_BITS 4
 
+/* Number of threads validating PES packets for different PIDs of a segment at once. PES packets in different
+ * subsegments of an indexed segment are validated at once too. 0 validates everything in the caller's thread.
+ * Messages from the other threads are logged in stream order as long as log_handler() is the default log handler. */
+extern unsigned segment_validator_pid_threads;
+
+/* Keys for decrypting CETS encrypted TS packets, so the PES packets in them can be validated. If this is NULL, we only
+ * check that there's an ECM for each scrambled packet. PES packets aren't validated on other threads when decrypting,
+ * since packets have to be decrypted in stream order. */
+extern cets_keys_t* segment_validator_keys;
+
+/* Build a frame_index_t of the PES packets of each media PID while validating, in pid_validator_t.frame_index */
+extern bool segment_validator_frame_index;
+
+struct _pid_parallel_validator;
+
 typedef struct {
     uint16_t pid;
     uint8_t sap;
@@ -68,6 +87,12 @@ typedef struct {
     int continuity_counter;
     GHashTable* ecm_pids;
     long au_for_transport_scrambling_control[TRANSPORT_SCRAMBLING_CONTROL_BITS];
+    /* cets_au_key_t from ECMs when decrypting, with the next to use at next_au_key */
+    GArray* au_keys[TRANSPORT_SCRAMBLING_CONTROL_BITS];
+    size_t next_au_key[TRANSPORT_SCRAMBLING_CONTROL_BITS];
+    t_std_es_t* t_std; /* NULL if the stream type isn't modeled */
+    bool pes_in_init_segment; /* the PES packet being put together started in the initialization segment */
+    frame_index_t* frame_index; /* NULL unless segment_validator_frame_index is set */
 } pid_validator_t;
 
 typedef struct {
@@ -83,21 +108,41 @@ typedef struct {
 
     size_t ssix_offset_index;
     GArray* ssix_offsets; /* uint64_t offsets from ssix boxes */
+    uint64_t pcr; /* from the 'pcrb' box, or PCR_INVALID */
 } subsegment_t;
 
+/* A splice point signaled by an SCTE 35 splice_insert() or time_signal() */
+typedef struct {
+    uint64_t pts; // with pts_adjustment applied
+    uint8_t splice_command_type;
+    uint32_t splice_event_id; // for splice_insert()
+    bool out_of_network_indicator;
+} splice_point_t;
+
 typedef struct {
     dash_profile_t profile;
     bool is_encrypted;
+    file_version_t segment_version; /* of the file validate_segment() read, or all 0 if it couldn't be opened */
+    bool has_emsg; /* its 'emsg' boxes were checked against the segment's duration */
     uint64_t  last_pcr;
     GPtrArray* pids;
     uint16_t pcr_pid;
-    GHashTable* ecm_pids;
-    program_association_section_t* pat;
-    program_map_section_t* pmt;
-    conditional_access_section_t* cat;
+    t_std_t* t_std; /* clock for the T-STD buffer model of each PID */
+    pcr_analyzer_t* pcr_analyzer; /* PCRs on pcr_pid in the current segment */
+    pcr_summary_t pcr_summary; /* of the last segment validated */
+    GHashTable* ecm_pids; /* ecm_pid_t by PID, for each CETS ECM PID in the PMT */
+    uint32_t ecm_pid_bits[TS_NUM_PIDS / 32]; /* set for each PID in ecm_pids */
+    cets_decryptor_t* decryptor; /* when decrypting */
+    bool decrypt_failed; /* a scrambled TS packet couldn't be decrypted */
+    /* section_table_fingerprint() of the last PAT, PMT and CAT, for checking that PSI is identical across segments
+     * without keeping it around */
+    uint32_t pat_fingerprint;
+    uint32_t pmt_fingerprint;
+    uint32_t cat_fingerprint;
     int status; // 0 == fail
     segment_type_t segment_type;
     GArray* initialization_segment_ts;
+    bool reading_init_segment; /* reading initialization_segment_ts again before a media segment */
 
     bool has_subsegments;
     size_t subsegment_index;
@@ -106,6 +151,10 @@ typedef struct {
 
     segment_t* segment;
     adaptation_set_t* adaptation_set;
+
+    GArray* splice_points; /* splice_point_t, from SCTE 35 sections in the segment */
+
+    struct _pid_parallel_validator* pid_parallel; /* only while validating a segment's PIDs in parallel */
 } dash_validator_t;
 
 typedef struct {
@@ -124,6 +173,20 @@ void index_segment_validator_free(index_segment_validator_t*);
 
 int validate_segment(dash_validator_t* dash_validator, char* file_name, uint64_t byte_range_start,
         uint64_t byte_range_end, dash_validator_t* dash_validator_init);
+
+/* Writes a frame index sidecar next to a segment that validate_segment() just validated, with what it found, and moves
+ * each PID's frame_index into it. passed is whether the segment passed validate_segment(); sidecars of segments that
+ * failed are only for looking at, and aren't used again. Returns false if the sidecar can't be written, or the
+ * segment couldn't be opened. */
+bool dash_validator_write_frame_index(dash_validator_t*, const char* file_name, uint64_t byte_range_start,
+        uint64_t byte_range_end, dash_validator_t* dash_validator_init, bool passed);
+/* Sets up dash_validator as if validate_segment() had just validated the segment, from the sidecar written by
+ * dash_validator_write_frame_index(), and checks the subsegment start times against its frames again. Returns false
+ * without changing anything if there's no sidecar, the segment changed since it was written, it failed then, or the
+ * initialization segment's PSI, the Segment Index, --keys or the MPD attributes validate_segment() checks changed. */
+bool validate_segment_from_frame_index(dash_validator_t*, const char* file_name, uint64_t byte_range_start,
+        uint64_t byte_range_end, dash_validator_t* dash_validator_init);
+
 bool validate_bitstream_switching(const char* file_names[], uint64_t byte_starts[], uint64_t byte_ends[], size_t len);
 
 index_segment_validator_t* validate_index_segment(char* file_name, segment_t*, representation_t*, adaptation_set_t*);
@@ -0,0 +1,459 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "t_std.h"
+
+#include <string.h>
+#include "bitreader.h"
+#include "pes.h"
+#include "psi.h"
+
+
+#define SYSTEM_CLOCK_FREQUENCY 27000000.0
+
+/* 2.14.3.1: BSmux = 0.004 s and BSoh = 1/750 s at the elementary stream rate */
+#define MB_SIZE(RATE) ((uint32_t)((RATE) * (0.004 + 1.0 / 750) / 8))
+
+bool t_std_params_for_stream_type(uint8_t stream_type, t_std_params_t* params)
+{
+    g_return_val_if_fail(params, false);
+
+    switch (stream_type) {
+    case STREAM_TYPE_AVC:
+    case STREAM_TYPE_SVC:
+    case STREAM_TYPE_MVC:
+    case STREAM_TYPE_S3D_SC_AVC:
+        /* Level 4.2: MaxBR 50000, MaxCPB 62500, times 1200 */
+        params->rbx = 60000000;
+        params->rx = 72000000;
+        params->mb_size = MB_SIZE(60000000);
+        params->eb_size = 75000000 / 8;
+        return true;
+    case STREAM_TYPE_HEVC:
+        /* Main tier Level 5.1: MaxBR 40000, MaxCPB 40000, times 1100 */
+        params->rbx = 44000000;
+        params->rx = 52800000;
+        params->mb_size = MB_SIZE(44000000);
+        params->eb_size = 44000000 / 8;
+        return true;
+    case STREAM_TYPE_MPEG1_VIDEO:
+    case STREAM_TYPE_MPEG2_VIDEO:
+    case STREAM_TYPE_MPEG4_VIDEO:
+    case STREAM_TYPE_S3D_SC_MPEG2:
+        /* Main Profile at High Level: Rmax 80 Mbit/s, VBV buffer 9781248 bits */
+        params->rbx = 80000000;
+        params->rx = 96000000;
+        params->mb_size = MB_SIZE(80000000);
+        params->eb_size = 9781248 / 8;
+        return true;
+    case STREAM_TYPE_MPEG1_AUDIO:
+    case STREAM_TYPE_MPEG2_AUDIO:
+        params->rbx = 0;
+        params->rx = 2000000;
+        params->mb_size = 0;
+        params->eb_size = 3584;
+        return true;
+    case STREAM_TYPE_MPEG2_AAC:
+    case STREAM_TYPE_MPEG4_AAC:
+    case STREAM_TYPE_MPEG4_AAC_RAW:
+        /* 2.4.2.6: 3 to 8 channels */
+        params->rbx = 0;
+        params->rx = 5529600;
+        params->mb_size = 0;
+        params->eb_size = 8976;
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* t_std_buffer_to_string(t_std_buffer_t buffer)
+{
+    switch (buffer) {
+    case T_STD_TB:
+        return "TB";
+    case T_STD_MB:
+        return "MB";
+    case T_STD_EB:
+        return "EB";
+    default:
+        return "unknown";
+    }
+}
+
+t_std_t* t_std_new(void)
+{
+    t_std_t* obj = g_slice_new0(t_std_t);
+    obj->last_pcr = PCR_INVALID;
+    obj->errors = g_array_new(false, false, sizeof(t_std_error_t));
+    return obj;
+}
+
+void t_std_free(t_std_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_array_free(obj->errors, true);
+    g_slice_free(t_std_t, obj);
+}
+
+void t_std_reset(t_std_t* t_std)
+{
+    g_return_if_fail(t_std);
+
+    t_std->last_pcr = PCR_INVALID;
+    t_std->has_clock = false;
+    ++t_std->generation;
+    t_std->deferred_start = t_std->deferred_len = 0;
+    g_array_set_size(t_std->errors, 0);
+}
+
+t_std_es_t* t_std_es_new(uint16_t pid, uint8_t stream_type)
+{
+    t_std_params_t params;
+    if (!t_std_params_for_stream_type(stream_type, &params)) {
+        return NULL;
+    }
+
+    t_std_es_t* obj = g_slice_new0(t_std_es_t);
+    obj->pid = pid;
+    obj->rx = params.rx / 8 / SYSTEM_CLOCK_FREQUENCY;
+    obj->rbx = params.rbx / 8 / SYSTEM_CLOCK_FREQUENCY;
+    obj->mb_size = params.mb_size;
+    obj->eb_size = params.eb_size;
+    return obj;
+}
+
+void t_std_es_free(t_std_es_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_slice_free(t_std_es_t, obj);
+}
+
+static void es_restart(t_std_es_t* es, unsigned generation)
+{
+    es->generation = generation;
+    es->started = false;
+    es->tb = es->tb_payload = es->mb = es->eb = es->eb_owed = 0;
+    es->tb_overflow = es->mb_overflow = es->eb_overflow = es->eb_underflow = false;
+    es->pending_start = es->pending_len = 0;
+    es->pes_pending = es->pes_late = false;
+}
+
+/* Moves bytes along from TB to EB up to the given time */
+static void es_leak(t_std_es_t* es, double time)
+{
+    double elapsed = time - es->time;
+    if (elapsed <= 0) {
+        return;
+    }
+    es->time = time;
+
+    double out = MIN(es->tb, es->rx * elapsed);
+    double payload = es->tb > 0 ? es->tb_payload * (out / es->tb) : 0;
+    es->tb -= out;
+    es->tb_payload = MAX(es->tb_payload - payload, 0);
+    if (es->rbx > 0) {
+        es->mb += payload;
+        payload = MIN(es->mb, es->rbx * elapsed);
+        es->mb -= payload;
+    }
+    double owed = MIN(es->eb_owed, payload);
+    es->eb_owed -= owed;
+    es->eb += payload - owed;
+}
+
+static void add_underflow(t_std_t* t_std, t_std_es_t* es, const t_std_au_t* au, double fullness)
+{
+    if (!es->eb_underflow) {
+        t_std_error_t error = {
+            .offset = au->offset,
+            .pid = es->pid,
+            .buffer = T_STD_EB,
+            .underflow = true,
+            .fullness = (uint64_t)fullness,
+            .size = au->size,
+            .dts = au->dts % PCR_ROLLOVER / 300
+        };
+        g_array_append_val(t_std->errors, error);
+    }
+    es->eb_underflow = true;
+}
+
+/* Removes the oldest pending PES packet from EB */
+static void es_remove_au(t_std_t* t_std, t_std_es_t* es)
+{
+    t_std_au_t* au = &es->pending[es->pending_start];
+    bool arriving = es->pes_pending && es->pes_index == es->pending_start;
+    double fullness = MIN(es->eb, au->size);
+
+    /* EB is first in, first out, so all of the PES packet is there if EB has at least that much */
+    if (es->eb + 0.5 < au->size) {
+        add_underflow(t_std, es, au, fullness);
+    } else if (!arriving) {
+        es->eb_underflow = false;
+    }
+    es->eb_owed += au->size - fullness;
+    es->eb -= fullness;
+
+    if (arriving) {
+        /* Anything more that arrives for it is too late */
+        es->pes_pending = false;
+        es->pes_late = es->pes_own_entry;
+        es->late_au = *au;
+        es->late_fullness = fullness;
+    }
+    es->pending_start = (es->pending_start + 1) % T_STD_MAX_PENDING_AU;
+    --es->pending_len;
+}
+
+/* Runs the model up to the given time, removing PES packets from EB at their decoding time */
+static void es_advance(t_std_t* t_std, t_std_es_t* es, double time)
+{
+    while (es->pending_len && es->pending[es->pending_start].dts <= time) {
+        es_leak(es, es->pending[es->pending_start].dts);
+        es_remove_au(t_std, es);
+    }
+    es_leak(es, time);
+}
+
+/* Reads the DTS (or PTS, if there's no DTS) from the start of a PES packet */
+static bool read_decoding_time(const uint8_t* data, size_t len, uint64_t* dts)
+{
+    bitreader_new_stack(b, data, len);
+    if (bitreader_read_uint24(b) != PES_PACKET_START_CODE_PREFIX) {
+        return false;
+    }
+    uint8_t stream_id = bitreader_read_uint8(b);
+    if (!HAS_PES_HEADER(stream_id)) {
+        return false;
+    }
+    bitreader_skip_bits(b, 24);
+    bool pts_flag = bitreader_read_bit(b);
+    bool dts_flag = bitreader_read_bit(b);
+    bitreader_skip_bits(b, 14);
+    if (!pts_flag) {
+        return false;
+    }
+    *dts = bitreader_read_90khz_timestamp(b, 4);
+    if (dts_flag) {
+        *dts = bitreader_read_90khz_timestamp(b, 4);
+    }
+    return !b->error;
+}
+
+/* Returns the 27 MHz time that a DTS (times 300), which wraps around at PCR_ROLLOVER, stands for on a clock that
+ * doesn't. It's the one nearest to now. */
+static uint64_t unwrap_time(uint64_t dts, double now)
+{
+    uint64_t now_ticks = (uint64_t)now;
+    int64_t difference = (int64_t)dts - (int64_t)(now_ticks % PCR_ROLLOVER);
+    if (difference > PCR_ROLLOVER / 2) {
+        difference -= PCR_ROLLOVER;
+    } else if (difference < -PCR_ROLLOVER / 2) {
+        difference += PCR_ROLLOVER;
+    }
+    return difference < 0 && (uint64_t)-difference > now_ticks ? 0 : now_ticks + difference;
+}
+
+static void es_start_pes_packet(t_std_t* t_std, t_std_es_t* es, const t_std_packet_t* packet)
+{
+    es->pes_late = false;
+
+    if (!packet->has_dts) {
+        /* Goes along with the PES packet before it, if that's still waiting */
+        es->pes_own_entry = false;
+        es->pes_pending = es->pending_len != 0;
+        es->pes_index = (es->pending_start + es->pending_len - 1) % T_STD_MAX_PENDING_AU;
+        return;
+    }
+
+    t_std_au_t au = {
+        .dts = unwrap_time(packet->dts, es->time),
+        .offset = packet->offset
+    };
+    es->pes_own_entry = true;
+    if (au.dts < es->time) {
+        /* Its decoding time passed before any of it arrived */
+        es->pes_pending = false;
+        es->pes_late = true;
+        es->late_au = au;
+        es->late_fullness = 0;
+        return;
+    }
+    if (es->pending_len == T_STD_MAX_PENDING_AU) {
+        /* Too far ahead to keep track of, so treat the oldest as decoded now */
+        es_remove_au(t_std, es);
+    }
+    es->pes_pending = true;
+    es->pes_index = (es->pending_start + es->pending_len) % T_STD_MAX_PENDING_AU;
+    es->pending[es->pes_index] = au;
+    ++es->pending_len;
+}
+
+static void check_overflow(t_std_t* t_std, t_std_es_t* es, const t_std_packet_t* packet, t_std_buffer_t buffer,
+        double fullness, uint32_t size, bool* overflow)
+{
+    if (fullness > size + 0.5) {
+        if (!*overflow) {
+            t_std_error_t error = {
+                .offset = packet->offset,
+                .pid = es->pid,
+                .buffer = buffer,
+                .fullness = (uint64_t)fullness,
+                .size = size
+            };
+            g_array_append_val(t_std->errors, error);
+        }
+        *overflow = true;
+    } else {
+        *overflow = false;
+    }
+}
+
+/* Runs the model for a packet that arrived at the given time */
+static void es_process_packet(t_std_t* t_std, const t_std_packet_t* packet, double time)
+{
+    t_std_es_t* es = packet->es;
+    if (es->generation != t_std->generation) {
+        es_restart(es, t_std->generation);
+    }
+    if (!es->started) {
+        if (!packet->pes_start) {
+            return;
+        }
+        es->started = true;
+        es->time = time;
+    }
+
+    es_advance(t_std, es, time);
+    if (packet->pes_start) {
+        es_start_pes_packet(t_std, es, packet);
+    }
+
+    es->tb += TS_SIZE;
+    es->tb_payload += packet->payload_len;
+    if (es->pes_pending) {
+        es->pending[es->pes_index].size += packet->payload_len;
+    } else {
+        es->eb_owed += packet->payload_len;
+        if (es->pes_late && packet->payload_len) {
+            add_underflow(t_std, es, &es->late_au, es->late_fullness);
+            es->pes_late = false;
+        }
+    }
+
+    check_overflow(t_std, es, packet, T_STD_TB, es->tb, T_STD_TB_SIZE, &es->tb_overflow);
+    if (es->rbx > 0) {
+        check_overflow(t_std, es, packet, T_STD_MB, es->mb, es->mb_size, &es->mb_overflow);
+    }
+    check_overflow(t_std, es, packet, T_STD_EB, es->eb, es->eb_size, &es->eb_overflow);
+}
+
+/* Runs the model for the oldest deferred packets, with the current clock */
+static void process_deferred(t_std_t* t_std, size_t num_packets)
+{
+    for (size_t i = 0; i < num_packets; ++i) {
+        const t_std_packet_t* packet = &t_std->deferred[t_std->deferred_start];
+        double time = t_std->last_pcr_time
+                + ((double)packet->offset + TS_SIZE - t_std->last_pcr_offset) * t_std->ticks_per_byte;
+        es_process_packet(t_std, packet, time);
+        t_std->deferred_start = (t_std->deferred_start + 1) % T_STD_MAX_DEFERRED;
+        --t_std->deferred_len;
+    }
+}
+
+void t_std_flush(t_std_t* t_std)
+{
+    g_return_if_fail(t_std);
+
+    if (t_std->has_clock) {
+        process_deferred(t_std, t_std->deferred_len);
+    }
+    t_std->deferred_start = t_std->deferred_len = 0;
+}
+
+void t_std_pcr(t_std_t* t_std, uint64_t pcr, uint64_t offset, bool discontinuity)
+{
+    g_return_if_fail(t_std);
+
+    /* The PCR wraps around, so a PCR less than half a rollover before the last one went backwards */
+    uint64_t elapsed = PCR_IS_VALID(t_std->last_pcr) ? (pcr + PCR_ROLLOVER - t_std->last_pcr) % PCR_ROLLOVER : 0;
+    if (discontinuity || !PCR_IS_VALID(t_std->last_pcr) || elapsed == 0 || elapsed > PCR_ROLLOVER / 2
+            || offset <= t_std->last_pcr_offset) {
+        t_std_flush(t_std);
+        if (PCR_IS_VALID(t_std->last_pcr)) {
+            ++t_std->generation;
+        }
+        t_std->has_clock = false;
+        t_std->last_pcr_time = pcr;
+    } else {
+        /* Bytes arrive at a constant rate between two PCRs */
+        t_std->has_clock = true;
+        t_std->ticks_per_byte = elapsed / (double)(offset - t_std->last_pcr_offset);
+        process_deferred(t_std, t_std->deferred_len);
+        t_std->last_pcr_time += elapsed;
+    }
+    t_std->last_pcr = pcr;
+    t_std->last_pcr_offset = offset;
+}
+
+void t_std_add_ts_packet(t_std_t* t_std, t_std_es_t* es, const ts_packet_t* ts)
+{
+    g_return_if_fail(t_std);
+    g_return_if_fail(es);
+    g_return_if_fail(ts);
+
+    if (!PCR_IS_VALID(t_std->last_pcr)) {
+        return;
+    }
+    if (t_std->deferred_len == T_STD_MAX_DEFERRED) {
+        /* The PCRs are too far apart, so guess when the oldest packet arrived from the rate before */
+        if (t_std->has_clock) {
+            process_deferred(t_std, 1);
+        } else {
+            t_std->deferred_start = (t_std->deferred_start + 1) % T_STD_MAX_DEFERRED;
+            --t_std->deferred_len;
+        }
+    }
+
+    t_std_packet_t* packet = &t_std->deferred[(t_std->deferred_start + t_std->deferred_len) % T_STD_MAX_DEFERRED];
+    ++t_std->deferred_len;
+    packet->es = es;
+    packet->offset = ts->pos_in_stream;
+    packet->payload_len = ts->payload_len;
+    packet->pes_start = ts->payload_unit_start_indicator && ts->has_payload;
+    uint64_t dts = 0;
+    /* The header of a scrambled packet can't be trusted */
+    packet->has_dts = packet->pes_start && ts->transport_scrambling_control == 0
+            && read_decoding_time(ts->payload, ts->payload_len, &dts);
+    packet->dts = dts * 300;
+}
@@ -0,0 +1,163 @@
+/*
+ Copyright (c) 2012-, ISO/IEC JTC1/SC29/WG11
+ Written by Alex Giladi <alex.giladi@gmail.com> and Vlad Zbarsky <zbarsky@cornell.edu>
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TSLIB_T_STD_H
+#define TSLIB_T_STD_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ts.h"
+
+
+/* Size of every transport buffer, 2.4.2.3 of ISO/IEC 13818-1 */
+#define T_STD_TB_SIZE 512
+/* PES packets waiting for their decoding time, per elementary stream */
+#define T_STD_MAX_PENDING_AU 128
+/* Packets waiting for the next PCR. PCRs are at most 100 ms apart, so this is enough for about 60 Mbit/s. */
+#define T_STD_MAX_DEFERRED 4096
+
+typedef enum {
+    T_STD_TB, /* transport buffer */
+    T_STD_MB, /* multiplex buffer, video only */
+    T_STD_EB  /* elementary stream buffer (B for audio) */
+} t_std_buffer_t;
+
+/* Buffer sizes and leak rates of the T-STD for one elementary stream */
+typedef struct {
+    uint32_t rx;      /* TB to MB (or EB) in bits per second */
+    uint32_t rbx;     /* MB to EB in bits per second, 0 if there's no MB */
+    uint32_t mb_size; /* in bytes */
+    uint32_t eb_size; /* in bytes */
+} t_std_params_t;
+
+typedef struct {
+    uint64_t offset; /* byte offset of the TS packet (overflow) or the start of the PES packet (underflow) */
+    uint16_t pid;
+    t_std_buffer_t buffer;
+    bool underflow;
+    uint64_t fullness; /* bytes in the buffer (overflow), or bytes of the PES packet in EB at its DTS (underflow) */
+    uint64_t size;     /* size of the buffer (overflow), or bytes of the PES packet that arrived by its DTS
+                          (underflow) */
+    uint64_t dts;      /* 90 kHz, for underflow */
+} t_std_error_t;
+
+typedef struct {
+    uint64_t dts; /* 27 MHz, on the same clock as t_std_es_t.time */
+    uint64_t offset;
+    uint32_t size; /* bytes that have arrived so far */
+} t_std_au_t;
+
+/* T-STD buffers for one elementary stream, following 2.4.2 of ISO/IEC 13818-1. Bytes move between buffers in bulk at
+ * each packet of the stream, each PES packet is removed from EB at its DTS (or PTS), and PES packets without either
+ * are removed along with the one before them. Video uses the leak method between MB and EB. The state has a fixed
+ * size, and each packet takes constant time apart from removing the PES packets that are due. */
+typedef struct {
+    uint16_t pid;
+    double rx; /* bytes per 27 MHz tick */
+    double rbx;
+    uint32_t mb_size;
+    uint32_t eb_size;
+
+    unsigned generation;
+    bool started; /* at the first PES packet after the clock started */
+    double time; /* 27 MHz, counting on past PCR_ROLLOVER instead of wrapping around */
+    double tb;
+    double tb_payload; /* bytes of tb that move on to MB or EB */
+    double mb;
+    double eb;
+    double eb_owed; /* bytes already removed from EB before they got there */
+    bool tb_overflow;
+    bool mb_overflow;
+    bool eb_overflow;
+    bool eb_underflow;
+
+    /* the PES packet currently arriving */
+    bool pes_pending; /* its bytes are added to pending[pes_index] */
+    size_t pes_index;
+    bool pes_own_entry; /* pending[pes_index] is for this PES packet, not the one before it */
+    bool pes_late; /* it was removed from EB before all of it arrived */
+    t_std_au_t late_au;
+    double late_fullness;
+
+    t_std_au_t pending[T_STD_MAX_PENDING_AU];
+    size_t pending_start;
+    size_t pending_len;
+} t_std_es_t;
+
+typedef struct {
+    t_std_es_t* es;
+    uint64_t offset;
+    uint64_t dts; /* 27 MHz */
+    uint16_t payload_len;
+    bool pes_start;
+    bool has_dts;
+} t_std_packet_t;
+
+/* The system time clock of a program, worked out from its PCRs, and the T-STD of each of its elementary streams.
+ * Bytes arrive at a constant rate between two PCRs, so packets wait in a fixed size queue until the next PCR before
+ * they go through the model. */
+typedef struct {
+    uint64_t last_pcr; /* 27 MHz */
+    double last_pcr_time; /* last_pcr, but counting on past PCR_ROLLOVER instead of wrapping around */
+    uint64_t last_pcr_offset;
+    bool has_clock; /* after two PCRs without a discontinuity */
+    double ticks_per_byte;
+    unsigned generation; /* changes whenever the clock starts again */
+
+    t_std_packet_t deferred[T_STD_MAX_DEFERRED];
+    size_t deferred_start;
+    size_t deferred_len;
+
+    GArray* errors; /* t_std_error_t */
+} t_std_t;
+
+/* Gets the T-STD parameters for a stream type. Video levels aren't known at the TS layer, so video streams get the
+ * limits of AVC Level 4.2, HEVC Main tier Level 5.1 or MPEG-2 Main Profile at High Level, and AAC gets the limits for
+ * up to 8 channels. Returns false for stream types that aren't modeled. */
+bool t_std_params_for_stream_type(uint8_t stream_type, t_std_params_t*);
+const char* t_std_buffer_to_string(t_std_buffer_t);
+
+t_std_t* t_std_new(void);
+void t_std_free(t_std_t*);
+/* Forgets the clock, any packets waiting for a PCR, and any errors, for a new segment */
+void t_std_reset(t_std_t*);
+/* Adds a PCR of the program, and runs the model for the packets since the last one */
+void t_std_pcr(t_std_t*, uint64_t pcr, uint64_t offset, bool discontinuity);
+/* Adds a TS packet of an elementary stream. It goes through the model at the next PCR, or t_std_flush(). */
+void t_std_add_ts_packet(t_std_t*, t_std_es_t*, const ts_packet_t*);
+/* Runs the model for the packets after the last PCR, at the rate before it. This has to be called before freeing any
+ * t_std_es_t with packets waiting. */
+void t_std_flush(t_std_t*);
+
+/* Returns NULL if the stream type isn't modeled */
+t_std_es_t* t_std_es_new(uint16_t pid, uint8_t stream_type);
+void t_std_es_free(t_std_es_t*);
+
+#endif
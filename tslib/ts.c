@@ -271,4 +271,87 @@ void ts_print(const ts_packet_t* ts)
         ts_print_adaptation_field(&ts->adaptation_field);
     }
     SKIT_LOG_UINT64_DBG("", (uint64_t)ts->payload_len);
-}
\ No newline at end of file
+}
+
+ts_headers_t* ts_headers_new(size_t capacity)
+{
+    ts_headers_t* obj = g_slice_new0(ts_headers_t);
+    obj->capacity = capacity;
+    obj->pid = g_new(uint16_t, capacity);
+    obj->continuity_counter = g_new(uint8_t, capacity);
+    obj->transport_scrambling_control = g_new(uint8_t, capacity);
+    obj->adaptation_field_control = g_new(uint8_t, capacity);
+    obj->transport_error_indicator = g_new(bool, capacity);
+    obj->payload_unit_start_indicator = g_new(bool, capacity);
+    obj->discontinuity_indicator = g_new(bool, capacity);
+    return obj;
+}
+
+void ts_headers_free(ts_headers_t* obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+    g_free(obj->pid);
+    g_free(obj->continuity_counter);
+    g_free(obj->transport_scrambling_control);
+    g_free(obj->adaptation_field_control);
+    g_free(obj->transport_error_indicator);
+    g_free(obj->payload_unit_start_indicator);
+    g_free(obj->discontinuity_indicator);
+    g_slice_free(ts_headers_t, obj);
+}
+
+size_t ts_headers_read(ts_headers_t* headers, const uint8_t* buf, size_t num_packets)
+{
+    g_return_val_if_fail(headers, 0);
+    g_return_val_if_fail(buf || num_packets == 0, 0);
+
+    size_t len = MIN(num_packets, headers->capacity);
+    for (size_t i = 0; i < len; ++i) {
+        if (buf[i * TS_SIZE] != TS_SYNC_BYTE) {
+            len = i;
+            break;
+        }
+    }
+
+    /* No branches in here, so these loops are simple enough for the compiler to unroll or vectorize */
+    for (size_t i = 0; i < len; ++i) {
+        const uint8_t* header = buf + i * TS_SIZE;
+        headers->transport_error_indicator[i] = header[1] >> 7;
+        headers->payload_unit_start_indicator[i] = (header[1] >> 6) & 1;
+        headers->pid[i] = ((header[1] & 0x1F) << 8) | header[2];
+    }
+    for (size_t i = 0; i < len; ++i) {
+        const uint8_t* header = buf + i * TS_SIZE;
+        headers->transport_scrambling_control[i] = header[3] >> 6;
+        headers->adaptation_field_control[i] = (header[3] >> 4) & 3;
+        headers->continuity_counter[i] = header[3] & 0x0F;
+        /* The flags are in the byte after adaptation_field_length, if the length isn't 0 */
+        headers->discontinuity_indicator[i] = (header[3] & 0x20) && header[4] > 0 && (header[5] & 0x80);
+    }
+    headers->len = len;
+    return len;
+}
+
+size_t ts_find_sync(const uint8_t* buf, size_t len, size_t num_packets)
+{
+    g_return_val_if_fail(buf || len == 0, len);
+
+    /* memchr is vectorized in any decent libc, and most bytes in a damaged stretch aren't sync bytes */
+    const uint8_t* start = buf;
+    const uint8_t* end = buf + len;
+    while (start < end && (start = memchr(start, TS_SYNC_BYTE, end - start)) != NULL) {
+        size_t i = 1;
+        for (; i < num_packets && start + i * TS_SIZE < end; ++i) {
+            if (start[i * TS_SIZE] != TS_SYNC_BYTE) {
+                break;
+            }
+        }
+        if (i == num_packets || start + i * TS_SIZE >= end) {
+            return start - buf;
+        }
+        ++start;
+    }
+    return len;
+}
@@ -37,6 +37,7 @@
 #define TS_SIZE                 188
 #define TS_HEADER_SIZE            4
 #define TS_SYNC_BYTE           0x47
+#define TS_NUM_PIDS            8192
 
 #define TS_PAYLOAD             0x01
 #define TS_ADAPTATION_FIELD    0x02
@@ -44,6 +45,10 @@
 #define PCR_MAX          (1LL << 42)
 #define PCR_INVALID       UINT64_MAX
 #define PCR_IS_VALID(P)  ((P) <  PCR_MAX)
+/* program_clock_reference_base * 300 + program_clock_reference_extension wraps around to 0 here */
+#define PCR_ROLLOVER     ((1LL << 33) * 300)
+/* PTS and DTS count 90 kHz ticks in 33 bits, so they wrap around to 0 here */
+#define PTS_ROLLOVER     (1LL << 33)
 
 /* 2.4.3.4 Adaptation field */
 typedef struct {
@@ -118,8 +123,32 @@ enum {
     PID_NULL = 0x1FFF
 } ts_pid_t;
 
+/* The fixed 4-byte headers of a run of packets, with one array per field so checks across many packets only touch
+ * the fields they need. */
+typedef struct {
+    size_t len;
+    size_t capacity;
+    uint16_t* pid;
+    uint8_t* continuity_counter;
+    uint8_t* transport_scrambling_control;
+    uint8_t* adaptation_field_control; /* TS_PAYLOAD and/or TS_ADAPTATION_FIELD */
+    bool* transport_error_indicator;
+    bool* payload_unit_start_indicator;
+    bool* discontinuity_indicator; /* from the adaptation field, if there is one */
+} ts_headers_t;
+
 void ts_copy(ts_packet_t*, const ts_packet_t*);
 bool ts_read(ts_packet_t*, uint8_t* buf, size_t buf_size, uint64_t packet_num);
 void ts_print(const ts_packet_t* ts);
 
+ts_headers_t* ts_headers_new(size_t capacity);
+void ts_headers_free(ts_headers_t*);
+/* Reads the headers of up to num_packets consecutive packets in buf, stopping before the first packet without a sync
+ * byte. Returns the number of headers read. */
+size_t ts_headers_read(ts_headers_t*, const uint8_t* buf, size_t num_packets);
+
+/* Finds where packets start again after losing sync: the first offset in buf with a sync byte every TS_SIZE bytes
+ * for num_packets packets, or for as many as fit in buf. Returns len if there isn't one. */
+size_t ts_find_sync(const uint8_t* buf, size_t len, size_t num_packets);
+
 #endif
\ No newline at end of file